@@ -51,18 +51,32 @@ SL_WEAK void app_init(void)
 {
   letimer0_init(); // initialize the timers
   gpio_init();     // initialize the gpio
-  int status = accel_init();
+  spi_init();      // initialize the accelerometer SPI transport
+  pipeline_init(); // empty the sample ring before the first drain
+
+  // stored offsets ride along in the batched init write, without any the
+  // first still period after boot calibrates them
+  accel_profile profile = *accel_default_profile();
+  int8_t offsets[3];
+  if (accel_offsets_load(offsets) == 0)
+  {
+    profile.ofsx = offsets[0];
+    profile.ofsy = offsets[1];
+    profile.ofsz = offsets[2];
+  }
+  else
+  {
+    pipeline_request_calibration();
+  }
+  int status = accel_init(&profile);
   LOG("accel_init() returned %d", status);
 }
 
 // process application actions
 SL_WEAK void app_process_action(void)
 {
-  // do nothing
-  //while(1)
-  //{
-  //  accel_get_acceleration();
-  //}
+  // consume samples queued by the FIFO drains
+  pipeline_process();
 }
 
 // Bluetooth stack event handler.
@@ -35,6 +35,8 @@
 #include "src/ble.h"
 #include "src/log.h"
 #include "src/gpio.h"
+#include "src/spi.h"
+#include "src/pipeline.h"
 #include "src/adxl343.h"
 #include "src/timers.h"
 
@@ -18,7 +18,10 @@ extern const sli_bt_gattdb_t gattdb;
 #define gattdb_fall_status                    21
 #define gattdb_activity_status                24
 #define gattdb_doubletap_status               27
-#define gattdb_ota_control                    31
+#define gattdb_blackbox_data                  30
+#define gattdb_event_stream                   32
+#define gattdb_raw_stream                     35
+#define gattdb_ota_control                    39
 
 
 #endif // __GATT_DB_H
@@ -0,0 +1,124 @@
+/* -----------------------------------------------------------------------------
+ * @file   accel_config.h
+ * @brief  Build-time range/resolution selection for the ADXL343 and unit
+ *         conversions from physical units (mg, ms) to register and sample
+ *         scale values
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Everything here is integer preprocessor arithmetic, so conversions fold to
+ * constants and are range-checked with #if at compile time. The range comes
+ * from the detector preset (detector_config.h) unless overridden with
+ * -DACCEL_RANGE_G=2|4|8|16, the resolution is set with -DACCEL_FULL_RES=0|1.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _ACCEL_CONFIG_H_
+#define _ACCEL_CONFIG_H_
+
+#include "detector_config.h"
+
+// DATA_FORMAT register map:
+// D7        | D6  | D5         | D4 | D3       | D2      | D1 D0 |
+// SELF_TEST | SPI | INT_INVERT | 0  | FULL_RES | Justify | Range |
+#define DATA_FORMAT_SELF_TEST   (0x80)
+#define DATA_FORMAT_SPI_3WIRE   (0x40)
+#define DATA_FORMAT_INT_INVERT  (0x20)
+#define DATA_FORMAT_FULL_RES    (0x08)
+#define DATA_FORMAT_JUSTIFY     (0x04)
+#define DATA_FORMAT_RANGE_2G    (0x0)
+#define DATA_FORMAT_RANGE_4G    (0x1)
+#define DATA_FORMAT_RANGE_8G    (0x2)
+#define DATA_FORMAT_RANGE_16G   (0x3)
+
+// impacts from falls clip at the +/-2 g power-on default
+#ifndef ACCEL_RANGE_G
+#define ACCEL_RANGE_G   DET_RANGE_G
+#endif
+
+// full resolution keeps 3.9 mg/LSB at every range
+#ifndef ACCEL_FULL_RES
+#define ACCEL_FULL_RES  (1)
+#endif
+
+#if ACCEL_RANGE_G == 2
+#define ACCEL_RANGE_BITS  DATA_FORMAT_RANGE_2G
+#elif ACCEL_RANGE_G == 4
+#define ACCEL_RANGE_BITS  DATA_FORMAT_RANGE_4G
+#elif ACCEL_RANGE_G == 8
+#define ACCEL_RANGE_BITS  DATA_FORMAT_RANGE_8G
+#elif ACCEL_RANGE_G == 16
+#define ACCEL_RANGE_BITS  DATA_FORMAT_RANGE_16G
+#else
+#error "ACCEL_RANGE_G must be 2, 4, 8 or 16"
+#endif
+
+// 4-wire SPI, active high interrupts, right justified
+#if ACCEL_FULL_RES
+#define ACCEL_DATA_FORMAT (DATA_FORMAT_FULL_RES | ACCEL_RANGE_BITS)
+#define ACCEL_LSB_PER_G   (256)
+#else
+#define ACCEL_DATA_FORMAT (ACCEL_RANGE_BITS)
+#define ACCEL_LSB_PER_G   (512 / ACCEL_RANGE_G) // 10-bit over +/-range
+#endif
+
+// largest sample magnitude the sensor reports, per axis
+#define ACCEL_MAX_LSB     (ACCEL_RANGE_G * ACCEL_LSB_PER_G)
+
+/* ============================================================================
+ *       UNIT CONVERSIONS (round to nearest)
+ * ===========================================================================*/
+// sample scale, for software thresholds on decoded samples
+#define ACCEL_MG_TO_LSB(mg)       (((mg) * ACCEL_LSB_PER_G + 500) / 1000)
+// squared, for comparisons against x^2 + y^2 + z^2 without a sqrt
+#define ACCEL_MG_TO_LSB2(mg)      (ACCEL_MG_TO_LSB(mg) * ACCEL_MG_TO_LSB(mg))
+
+// register scales, fixed by the part regardless of range
+#define ACCEL_MG_TO_THRESH(mg)    (((mg) * 16 + 500) / 1000)  // 62.5 mg/LSB
+#define ACCEL_MG_TO_OFS(mg)       (((mg) * 64 + 500) / 1000)  // 15.6 mg/LSB
+#define ACCEL_US_TO_DUR(us)       (((us) + 312) / 625)        // 625 us/LSB
+#define ACCEL_MS_TO_LATENT(ms)    (((ms) * 4 + 2) / 5)        // 1.25 ms/LSB
+#define ACCEL_MS_TO_WINDOW(ms)    (((ms) * 4 + 2) / 5)        // 1.25 ms/LSB
+#define ACCEL_MS_TO_TIME_FF(ms)   (((ms) + 2) / 5)            // 5 ms/LSB
+#define ACCEL_MS_TO_TIME_INACT(ms) (((ms) + 500) / 1000)      // 1 sec/LSB
+
+// offset register steps per g, a data LSB is 64/ACCEL_LSB_PER_G steps
+#define ACCEL_OFS_PER_G           (64)
+
+/* ============================================================================
+ *       DETECTION THRESHOLDS (physical units)
+ * ===========================================================================*/
+#if ACCEL_RANGE_G == 2
+#define ACCEL_TAP_THRESH_MG       (1900) // taps saturate at the range
+#else
+#define ACCEL_TAP_THRESH_MG       (3000)
+#endif
+#define ACCEL_TAP_DUR_US          (10000)
+#define ACCEL_TAP_LATENT_MS       (20)
+#define ACCEL_TAP_WINDOW_MS       (319)
+#define ACCEL_ACT_THRESH_MG       (250)
+#define ACCEL_INACT_THRESH_MG     (500)
+#define ACCEL_INACT_TIME_MS       (20000)
+#define ACCEL_FF_THRESH_MG        (313)  // 300-600 mg recommended
+#define ACCEL_FF_TIME_MS          (200)  // 100-350 ms recommended
+
+#define ACCEL_THRESH_TAP    ACCEL_MG_TO_THRESH(ACCEL_TAP_THRESH_MG)
+#define ACCEL_DUR           ACCEL_US_TO_DUR(ACCEL_TAP_DUR_US)
+#define ACCEL_LATENT        ACCEL_MS_TO_LATENT(ACCEL_TAP_LATENT_MS)
+#define ACCEL_WINDOW        ACCEL_MS_TO_WINDOW(ACCEL_TAP_WINDOW_MS)
+#define ACCEL_THRESH_ACT    ACCEL_MG_TO_THRESH(ACCEL_ACT_THRESH_MG)
+#define ACCEL_THRESH_INACT  ACCEL_MG_TO_THRESH(ACCEL_INACT_THRESH_MG)
+#define ACCEL_TIME_INACT    ACCEL_MS_TO_TIME_INACT(ACCEL_INACT_TIME_MS)
+#define ACCEL_THRESH_FF     ACCEL_MG_TO_THRESH(ACCEL_FF_THRESH_MG)
+#define ACCEL_TIME_FF       ACCEL_MS_TO_TIME_FF(ACCEL_FF_TIME_MS)
+
+#if ACCEL_THRESH_TAP > 255 || ACCEL_DUR > 255 || ACCEL_LATENT > 255 || \
+    ACCEL_WINDOW > 255 || ACCEL_THRESH_ACT > 255 || \
+    ACCEL_THRESH_INACT > 255 || ACCEL_TIME_INACT > 255 || \
+    ACCEL_THRESH_FF > 255 || ACCEL_TIME_FF > 255
+#error "a detection threshold does not fit its 8-bit register"
+#endif
+
+#if ACCEL_TAP_THRESH_MG >= ACCEL_RANGE_G * 1000
+#error "tap threshold is beyond the selected range"
+#endif
+
+#endif // _ACCEL_CONFIG_H_
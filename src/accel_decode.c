@@ -0,0 +1,91 @@
+/* -----------------------------------------------------------------------------
+ * @file   accel_decode.c
+ * @brief  Batch decoding of raw ADXL343 sample bytes into per-axis arrays
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include "accel_decode.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+  #include "em_device.h" // CMSIS core, SIMD intrinsics
+  #define ACCEL_DECODE_DSP (1)
+#else
+  #define ACCEL_DECODE_DSP (0)
+#endif
+
+static inline int16_t decode_axis(const uint8_t *raw)
+{
+  return (int16_t)( (raw[1] << 0x8) | raw[0] );
+}
+
+static inline uint32_t square(int16_t v)
+{
+  return (uint32_t)((int32_t)v * v);
+}
+
+void accel_decode_batch_ref(const uint8_t *raw, uint32_t n,
+                            int16_t *x, int16_t *y, int16_t *z, uint32_t *mag2)
+{
+  for (uint32_t i=0; i<n; i++)
+  {
+    const uint8_t *s = &raw[ACCEL_RAW_SAMPLE_LEN*i];
+    x[i] = decode_axis(&s[0]);
+    y[i] = decode_axis(&s[2]);
+    z[i] = decode_axis(&s[4]);
+    if (mag2 != NULL)
+    {
+      mag2[i] = square(x[i]) + square(y[i]) + square(z[i]);
+    }
+  }
+}
+
+#if (ACCEL_DECODE_DSP == 1)
+
+void accel_decode_batch(const uint8_t *raw, uint32_t n,
+                        int16_t *x, int16_t *y, int16_t *z, uint32_t *mag2)
+{
+  uint32_t i = 0;
+
+  // two samples per pass: 12 bytes = three words holding (hi:lo)
+  // w0 = y0:x0, w1 = x1:z0, w2 = z1:y1
+  for (; i+1<n; i+=2)
+  {
+    const uint8_t *s = &raw[ACCEL_RAW_SAMPLE_LEN*i];
+    uint32_t w0 = __UNALIGNED_UINT32_READ(&s[0]);
+    uint32_t w1 = __UNALIGNED_UINT32_READ(&s[4]);
+    uint32_t w2 = __UNALIGNED_UINT32_READ(&s[8]);
+
+    x[i]   = (int16_t)w0;
+    y[i]   = (int16_t)(w0 >> 16);
+    z[i]   = (int16_t)w1;
+    x[i+1] = (int16_t)(w1 >> 16);
+    y[i+1] = (int16_t)w2;
+    z[i+1] = (int16_t)(w2 >> 16);
+
+    if (mag2 != NULL)
+    {
+      // SMUAD: lo*lo + hi*hi, SMLAD adds the straddling axis via a masked
+      // copy of w1 so only the wanted half contributes
+      mag2[i]   = __SMLAD(w1, w1 & 0x0000FFFFUL, __SMUAD(w0, w0));
+      mag2[i+1] = __SMLAD(w1, w1 & 0xFFFF0000UL, __SMUAD(w2, w2));
+    }
+  }
+
+  // odd tail
+  if (i < n)
+  {
+    accel_decode_batch_ref(&raw[ACCEL_RAW_SAMPLE_LEN*i], n-i, &x[i], &y[i], &z[i],
+                           (mag2 != NULL) ? &mag2[i] : NULL);
+  }
+}
+
+#else
+
+void accel_decode_batch(const uint8_t *raw, uint32_t n,
+                        int16_t *x, int16_t *y, int16_t *z, uint32_t *mag2)
+{
+  accel_decode_batch_ref(raw, n, x, y, z, mag2);
+}
+
+#endif // ACCEL_DECODE_DSP
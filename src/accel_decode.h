@@ -0,0 +1,55 @@
+/* -----------------------------------------------------------------------------
+ * @file   accel_decode.h
+ * @brief  Batch decoding of raw ADXL343 sample bytes into per-axis arrays
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Raw samples are 6 bytes each, DATAX0..DATAZ1 little endian. The batch
+ * kernel de-interleaves them into structure-of-arrays form and optionally
+ * computes the squared magnitude x^2 + y^2 + z^2. On the Cortex-M4 the kernel
+ * works on two samples (three words) per iteration with the DSP extension
+ * (SMUAD/SMLAD dual 16-bit multiply-accumulate); accel_decode_batch_ref() is
+ * the portable reference both paths must match bit for bit.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _ACCEL_DECODE_H_
+#define _ACCEL_DECODE_H_
+
+#include <stdint.h>
+
+#define ACCEL_RAW_SAMPLE_LEN  (6)   // bytes per raw XYZ sample
+#define ACCEL_BLOCK_LEN       (32)  // samples per processing block
+
+// a block of samples in structure-of-arrays layout
+typedef struct
+{
+  int16_t x[ACCEL_BLOCK_LEN];
+  int16_t y[ACCEL_BLOCK_LEN];
+  int16_t z[ACCEL_BLOCK_LEN];
+  uint32_t mag2[ACCEL_BLOCK_LEN]; // x^2 + y^2 + z^2
+  const uint32_t *timestamps;     // msec, one per sample
+  uint32_t n;                     // valid samples in the block
+} accel_block;
+
+
+/* @brief  Decodes n raw samples into per-axis arrays
+ *
+ * @param  const uint8_t*, n*6 raw bytes, no alignment requirement
+ * @param  uint32_t, number of samples
+ * @param  int16_t*, x output, n entries
+ * @param  int16_t*, y output, n entries
+ * @param  int16_t*, z output, n entries
+ * @param  uint32_t*, squared magnitude output, n entries, NULL to skip
+ * @return None
+ */
+void accel_decode_batch(const uint8_t *raw, uint32_t n,
+                        int16_t *x, int16_t *y, int16_t *z, uint32_t *mag2);
+
+
+/* @brief  Portable scalar reference of accel_decode_batch()
+ *
+ * Same parameters and results as accel_decode_batch().
+ */
+void accel_decode_batch_ref(const uint8_t *raw, uint32_t n,
+                            int16_t *x, int16_t *y, int16_t *z, uint32_t *mag2);
+
+#endif // _ACCEL_DECODE_H_
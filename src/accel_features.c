@@ -0,0 +1,126 @@
+/* -----------------------------------------------------------------------------
+ * @file   accel_features.c
+ * @brief  Incremental sliding-window features over the accelerometer stream
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "accel_features.h"
+
+
+static inline uint32_t abs_diff(int16_t a, int16_t b)
+{
+  int32_t d = (int32_t)a - b;
+  return (uint32_t)((d < 0) ? -d : d);
+}
+
+// drops candidates that left the window from the front
+static inline void deque_expire(feature_deque *q, uint32_t oldest_seq)
+{
+  while (q->head != q->tail &&
+         (int32_t)(q->e[q->head & FEAT_WINDOW_MASK].seq - oldest_seq) < 0)
+  {
+    q->head++;
+  }
+}
+
+// is_max selects the ordering: back entries the new value dominates go
+static inline void deque_push(feature_deque *q, uint32_t seq, int16_t v,
+                              bool is_max)
+{
+  while (q->head != q->tail)
+  {
+    int16_t back = q->e[(q->tail - 1) & FEAT_WINDOW_MASK].value;
+    if (is_max ? (back > v) : (back < v)) break;
+    q->tail--;
+  }
+  q->e[q->tail & FEAT_WINDOW_MASK].seq = seq;
+  q->e[q->tail & FEAT_WINDOW_MASK].value = v;
+  q->tail++;
+}
+
+void features_init(feature_engine *fe)
+{
+  memset(fe, 0, sizeof(*fe));
+}
+
+void feature_push(feature_channel *ch, int16_t v)
+{
+  uint32_t pos = ch->seq & FEAT_WINDOW_MASK;
+
+  if (ch->count > 0)
+  {
+    int16_t newest = ch->history[(ch->seq - 1) & FEAT_WINDOW_MASK];
+    ch->jerk_sum += abs_diff(v, newest);
+  }
+
+  if (ch->count == FEAT_WINDOW)
+  {
+    // evict the oldest sample, it sits where the new one goes
+    int16_t old = ch->history[pos];
+    int16_t next = ch->history[(ch->seq + 1) & FEAT_WINDOW_MASK];
+    ch->sum -= old;
+    ch->sum2 -= (uint32_t)((int32_t)old * old);
+    ch->jerk_sum -= abs_diff(next, old);
+  }
+  else
+  {
+    ch->count++;
+  }
+
+  ch->history[pos] = v;
+  ch->sum += v;
+  ch->sum2 += (uint32_t)((int32_t)v * v);
+
+  // the window now holds seq-count+1 .. seq, expiring first keeps a deque
+  // within FEAT_WINDOW entries
+  uint32_t oldest_seq = ch->seq + 1 - ch->count;
+  deque_expire(&ch->min_q, oldest_seq);
+  deque_expire(&ch->max_q, oldest_seq);
+  deque_push(&ch->min_q, ch->seq, v, false);
+  deque_push(&ch->max_q, ch->seq, v, true);
+  ch->seq++;
+}
+
+// inlined twice: with n = FEAT_WINDOW the divisions fold to shifts (and a
+// multiply for the jerk), the variable n only serves the warm-up
+static inline void window_moments(const feature_channel *ch, int32_t n,
+                                  feature_values *out)
+{
+  out->mean_q4 = ch->sum * 16 / n;
+
+  // population variance, (n*sum2 - sum^2) / n^2
+  int64_t num = (int64_t)n * ch->sum2 - (int64_t)ch->sum * ch->sum;
+  out->var = (uint32_t)(num / ((int64_t)n * n));
+
+  out->jerk_q4 = (n > 1) ? ch->jerk_sum * 16 / (uint32_t)(n - 1) : 0;
+}
+
+void feature_get(const feature_channel *ch, feature_values *out)
+{
+  if (ch->count == 0)
+  {
+    memset(out, 0, sizeof(*out));
+    return;
+  }
+
+  if (ch->count == FEAT_WINDOW)
+  {
+    window_moments(ch, FEAT_WINDOW, out);
+  }
+  else
+  {
+    window_moments(ch, (int32_t)ch->count, out);
+  }
+
+  out->min = ch->min_q.e[ch->min_q.head & FEAT_WINDOW_MASK].value;
+  out->max = ch->max_q.e[ch->max_q.head & FEAT_WINDOW_MASK].value;
+  out->p2p = (uint16_t)(out->max - out->min);
+}
+
+void features_push_block(feature_engine *fe, const accel_block *blk)
+{
+  for (uint32_t i=0; i<blk->n; i++) feature_push(&fe->axis[0], blk->x[i]);
+  for (uint32_t i=0; i<blk->n; i++) feature_push(&fe->axis[1], blk->y[i]);
+  for (uint32_t i=0; i<blk->n; i++) feature_push(&fe->axis[2], blk->z[i]);
+}
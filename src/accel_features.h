@@ -0,0 +1,109 @@
+/* -----------------------------------------------------------------------------
+ * @file   accel_features.h
+ * @brief  Incremental sliding-window features over the accelerometer stream
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Each channel keeps running sums for mean/variance, monotonic deques for
+ * min/max and a running sum of absolute first differences for jerk, so a new
+ * sample costs O(1) (amortized for the deques) regardless of the window
+ * length. Integer arithmetic only: the sums are exact, so the moments match
+ * a full recompute bit for bit without the drift Welford's update guards
+ * against in floating point. The window length is the detector preset's
+ * power of two, so indexing is a mask and the full-window statistics divide
+ * by constants.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _ACCEL_FEATURES_H_
+#define _ACCEL_FEATURES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "accel_config.h"
+#include "accel_decode.h"
+
+#define FEAT_WINDOW       DET_WINDOW      // samples, power of two
+#define FEAT_WINDOW_MASK  DET_WINDOW_MASK
+
+// the sum of squares is kept in 32 bits
+#if FEAT_WINDOW * ACCEL_MAX_LSB * ACCEL_MAX_LSB > 4294967295
+#error "FEAT_WINDOW too long for the selected range"
+#endif
+
+typedef struct
+{
+  uint32_t seq;
+  int16_t value;
+} feature_deque_entry;
+
+// monotonic deque of the window's min or max candidates
+typedef struct
+{
+  feature_deque_entry e[FEAT_WINDOW];
+  uint32_t head;
+  uint32_t tail;
+} feature_deque;
+
+typedef struct
+{
+  int16_t history[FEAT_WINDOW];
+  uint32_t count;     // samples in the window, up to FEAT_WINDOW
+  uint32_t seq;       // samples pushed so far
+  int32_t sum;
+  uint32_t sum2;
+  uint32_t jerk_sum;  // sum of |x[i] - x[i-1]| within the window
+  feature_deque min_q;
+  feature_deque max_q;
+} feature_channel;
+
+typedef struct
+{
+  int32_t mean_q4;    // LSB, Q4
+  uint32_t var;       // LSB^2
+  int16_t min;
+  int16_t max;
+  uint16_t p2p;       // max - min
+  uint32_t jerk_q4;   // mean |difference| per sample, LSB Q4
+} feature_values;
+
+typedef struct
+{
+  feature_channel axis[3]; // x, y, z
+} feature_engine;
+
+
+/* @brief  Empties the engine
+ *
+ * @param  feature_engine*, the engine
+ * @return None
+ */
+void features_init(feature_engine *fe);
+
+
+/* @brief  Pushes one sample into a channel, evicting the oldest once full
+ *
+ * @param  feature_channel*, the channel
+ * @param  int16_t, new sample
+ * @return None
+ */
+void feature_push(feature_channel *ch, int16_t v);
+
+
+/* @brief  Reads the features of a channel's current window
+ *
+ * @param  const feature_channel*, the channel
+ * @param  feature_values*, destination, zeroed while the window is empty
+ * @return None
+ */
+void feature_get(const feature_channel *ch, feature_values *out);
+
+
+/* @brief  Pushes a decoded block into the x, y and z channels
+ *
+ * @param  feature_engine*, the engine
+ * @param  const accel_block*, decoded samples
+ * @return None
+ */
+void features_push_block(feature_engine *fe, const accel_block *blk);
+
+#endif // _ACCEL_FEATURES_H_
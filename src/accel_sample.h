@@ -0,0 +1,26 @@
+/* -----------------------------------------------------------------------------
+ * @file   accel_sample.h
+ * @brief  Sample type shared by the ADXL343 driver and the processing chain
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _ACCEL_SAMPLE_H_
+#define _ACCEL_SAMPLE_H_
+
+#include <stdint.h>
+
+// one XYZ sample as it appears in DATAX0..DATAZ1 (little endian)
+typedef struct
+{
+  int16_t x;
+  int16_t y;
+  int16_t z;
+} accel_sample;
+
+// the drains copy DATAX0..DATAZ1 straight in, the fields only read as
+// int16_t on a little endian core
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "accel_sample holds the little endian register image"
+#endif
+
+#endif // _ACCEL_SAMPLE_H_
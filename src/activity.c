@@ -0,0 +1,108 @@
+/* -----------------------------------------------------------------------------
+ * @file   activity.c
+ * @brief  Activity aggregation, debounces the activity/inactivity interrupt
+ *         edges and publishes a duty cycle summary at a fixed cadence
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "activity.h"
+
+static uint8_t percent(uint32_t part, uint32_t whole)
+{
+  if (whole == 0) return 0;
+  uint32_t p = (uint32_t)(((uint64_t)part * 100 + whole / 2) / whole);
+  return (uint8_t)((p > 100) ? 100 : p);
+}
+
+// accounts the time since the last update to the raw state, closing every
+// minute boundary crossed on the way. An edge dated before the last poll
+// (latched while an earlier event was being handled) is accounted from the
+// last update, time never runs backwards
+static void account(activity_context *ctx, uint32_t now_ms)
+{
+  if ((int32_t)(now_ms - ctx->last_update_ms) < 0) now_ms = ctx->last_update_ms;
+  while (now_ms - ctx->minute_start_ms >= ACTIVITY_MINUTE_MS)
+  {
+    uint32_t end = ctx->minute_start_ms + ACTIVITY_MINUTE_MS;
+    if (ctx->is_active)
+    {
+      ctx->minute_active_ms += end - ctx->last_update_ms;
+      ctx->publish_active_ms += end - ctx->last_update_ms;
+    }
+    ctx->minute_duty[ctx->minutes % ACTIVITY_MINUTES] =
+        percent(ctx->minute_active_ms, ACTIVITY_MINUTE_MS);
+    ctx->minutes++;
+    ctx->minute_active_ms = 0;
+    ctx->minute_start_ms = end;
+    ctx->last_update_ms = end;
+  }
+  if (ctx->is_active)
+  {
+    ctx->minute_active_ms += now_ms - ctx->last_update_ms;
+    ctx->publish_active_ms += now_ms - ctx->last_update_ms;
+  }
+  ctx->last_update_ms = now_ms;
+}
+
+void activity_init(activity_context *ctx, uint32_t cadence_ms, uint32_t now_ms)
+{
+  memset(ctx, 0x0, sizeof(*ctx));
+  ctx->last_edge_ms = now_ms;
+  ctx->last_update_ms = now_ms;
+  ctx->minute_start_ms = now_ms;
+  ctx->publish_start_ms = now_ms;
+  activity_set_cadence(ctx, cadence_ms);
+}
+
+void activity_set_cadence(activity_context *ctx, uint32_t cadence_ms)
+{
+  ctx->cadence_ms = (cadence_ms > 0) ? cadence_ms : ACTIVITY_DEFAULT_CADENCE_MS;
+}
+
+void activity_edge(activity_context *ctx, bool is_active, uint32_t now_ms)
+{
+  account(ctx, now_ms);
+  ctx->edges++;
+  if (is_active != ctx->is_active)
+  {
+    ctx->is_active = is_active;
+    ctx->last_edge_ms = now_ms;
+  }
+}
+
+bool activity_poll(activity_context *ctx, uint32_t now_ms, uint8_t *value)
+{
+  account(ctx, now_ms);
+
+  bool is_state_change = false;
+  if (ctx->is_active != ctx->is_published_active
+      && now_ms - ctx->last_edge_ms >= ACTIVITY_DEBOUNCE_MS)
+  {
+    ctx->is_published_active = ctx->is_active;
+    is_state_change = true;
+  }
+
+  uint32_t elapsed = now_ms - ctx->publish_start_ms;
+  bool is_due = (!ctx->is_published && is_state_change)
+                || elapsed >= ctx->cadence_ms;
+  if (!is_due) return false;
+
+  uint8_t v = percent(ctx->publish_active_ms, elapsed);
+  if (ctx->is_published_active) v |= ACTIVITY_STATE_BIT;
+  ctx->publish_start_ms = now_ms;
+  ctx->publish_active_ms = 0;
+
+  if (ctx->is_published && v == ctx->last_value) return false;
+  ctx->is_published = true;
+  ctx->last_value = v;
+  ctx->published++;
+  *value = v;
+  return true;
+}
+
+uint8_t activity_minute_duty(const activity_context *ctx, uint32_t ago)
+{
+  if (ago >= ACTIVITY_MINUTES || ago >= ctx->minutes) return 0;
+  return ctx->minute_duty[(ctx->minutes - 1 - ago) % ACTIVITY_MINUTES];
+}
@@ -0,0 +1,105 @@
+/* -----------------------------------------------------------------------------
+ * @file   activity.h
+ * @brief  Activity aggregation, debounces the activity/inactivity interrupt
+ *         edges and publishes a duty cycle summary at a fixed cadence
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Raw edges are accounted into per-minute duty cycle counters (the last
+ * ACTIVITY_MINUTES are kept). The published state only follows the raw state
+ * once it held for ACTIVITY_DEBOUNCE_MS, and a summary is offered at most
+ * once per cadence and only when it differs from the last one published, so
+ * a restless wearer costs one indication per cadence instead of two per
+ * movement. Falls do not go through here.
+ *
+ * Summary byte, as written to the activity status characteristic:
+ * D7    | D6..D0
+ * state | percent of the cadence interval spent active, 0-100
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _ACTIVITY_H_
+#define _ACTIVITY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ACTIVITY_DEBOUNCE_MS       (5000)
+#define ACTIVITY_DEFAULT_CADENCE_MS (5UL * 60 * 1000)
+#define ACTIVITY_MINUTES           (60)
+#define ACTIVITY_MINUTE_MS         (60000)
+#define ACTIVITY_STATE_BIT         (0x80)
+
+typedef struct
+{
+  bool is_active;            // raw, last edge
+  bool is_published_active;  // debounced
+  uint32_t last_edge_ms;
+  uint32_t last_update_ms;
+  uint32_t minute_start_ms;
+  uint32_t minute_active_ms;
+  uint8_t minute_duty[ACTIVITY_MINUTES]; // percent, ring
+  uint32_t minutes;          // minutes closed so far
+  uint32_t cadence_ms;
+  uint32_t publish_start_ms;
+  uint32_t publish_active_ms;
+  bool is_published;         // false until the first summary
+  uint8_t last_value;
+  uint32_t edges;            // raw edges seen
+  uint32_t published;        // summaries offered
+} activity_context;
+
+
+/* @brief  Starts the aggregator in the inactive state
+ *
+ * @param  activity_context*, aggregator state
+ * @param  uint32_t, publish cadence in msec, 0 for the default
+ * @param  uint32_t, current time in msec
+ * @return None
+ */
+void activity_init(activity_context *ctx, uint32_t cadence_ms, uint32_t now_ms);
+
+
+/* @brief  Records an activity or inactivity interrupt
+ *
+ * The edge may be dated before the last poll, the state then changes from
+ * the time of that poll on.
+ *
+ * @param  activity_context*, aggregator state
+ * @param  bool, true for activity, false for inactivity
+ * @param  uint32_t, time of the interrupt edge in msec
+ * @return None
+ */
+void activity_edge(activity_context *ctx, bool is_active, uint32_t now_ms);
+
+
+/* @brief  Advances the counters and returns a summary when one is due
+ *
+ * Cheap to call often. A summary is due once the cadence elapsed and the
+ * value differs from the previous summary; the first summary is due on the
+ * first debounced state change.
+ *
+ * @param  activity_context*, aggregator state
+ * @param  uint32_t, current time in msec
+ * @param  uint8_t*, the summary byte, set when due
+ * @return true if the summary should be published
+ */
+bool activity_poll(activity_context *ctx, uint32_t now_ms, uint8_t *value);
+
+
+/* @brief  Changes the publish cadence, takes effect with the next summary
+ *
+ * @param  activity_context*, aggregator state
+ * @param  uint32_t, cadence in msec, 0 for the default
+ * @return None
+ */
+void activity_set_cadence(activity_context *ctx, uint32_t cadence_ms);
+
+
+/* @brief  Returns the duty cycle of a closed minute
+ *
+ * @param  const activity_context*, aggregator state
+ * @param  uint32_t, minutes ago, 0 is the last closed minute
+ * @return uint8_t, percent active, 0 for minutes not recorded
+ */
+uint8_t activity_minute_duty(const activity_context *ctx, uint32_t ago);
+
+#endif // _ACTIVITY_H_
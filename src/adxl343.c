@@ -6,77 +6,142 @@
 
 #include "adxl343.h"
 
-#define ACCEL_CLK_PORT (gpioPortA)
-#define ACCEL_CLK_PIN  (0)
-#define ACCEL_CLK_LOC  (30)
+typedef struct
+{
+  accel_sample *buf;
+  uint32_t max_samples;
+  uint32_t entries;
+  uint32_t count;
+  bool is_active;
+  bool is_status_read;
+} fifo_drain_context;
 
-#define ACCEL_TX_PORT (gpioPortA)
-#define ACCEL_TX_PIN  (1)
-#define ACCEL_TX_LOC  (1)
+static int accel_read(uint8_t start_register, uint8_t *rx, uint32_t nbytes);
+static int accel_write(uint8_t start_register, const uint8_t *tx, uint32_t nbytes);
+static int accel_fifo_drain_next();
 
-#define ACCEL_RX_PORT (gpioPortA)
-#define ACCEL_RX_PIN  (2)
-#define ACCEL_RX_LOC  (1)
+static const spi_bus *bus = &spi_usart1_bus;
 
-#define ACCEL_CS_PORT (gpioPortA)
-#define ACCEL_CS_PIN  (5)
-#define ACCEL_CS_LOC  (2)
+// blocking frames
+static uint8_t tx_frame[SPI_MAX_FRAME];
+static uint8_t rx_frame[SPI_MAX_FRAME];
 
-#define ACCEL_INT1_PORT (gpioPortA)
-#define ACCEL_INT1_PIN  (4)
+// asynchronous FIFO drain frames: command + DATAX0..FIFO_STATUS
+static fifo_drain_context drain_ctx;
+static uint8_t drain_tx[9];
+static uint8_t drain_rx[9];
 
-static int accel_read(uint8_t start_register, uint8_t *rx, uint32_t nbytes);
-static int accel_write(uint8_t start_register, uint8_t *tx, uint32_t nbytes);
-static inline void accel_cs_high() { GPIO_PinOutSet(ACCEL_CS_PORT, ACCEL_CS_PIN); }
-static inline void accel_cs_low() { GPIO_PinOutClear(ACCEL_CS_PORT, ACCEL_CS_PIN); }
+// uptime of the last INT1 edge, dates the events of the next snapshot
+static volatile uint32_t int1_ms;
 
 void GPIO_EVEN_IRQHandler()
 {
   CORE_CRITICAL_SECTION(
     uint32_t flags = GPIO_IntGetEnabled() & 0x55555555; // pickoff even bits
     GPIO_IntClear(flags);
-    sl_bt_external_signal(evt_accel_GPIO_INT1);
+    if (flags & (1 << ACCEL_INT1_PIN))
+    {
+      int1_ms = letimer0_get_uptime_msec();
+      sl_bt_external_signal(evt_accel_GPIO_INT1);
+    }
+  );
+}
+
+void GPIO_ODD_IRQHandler()
+{
+  CORE_CRITICAL_SECTION(
+    uint32_t flags = GPIO_IntGetEnabled() & 0xAAAAAAAA; // pickoff odd bits
+    GPIO_IntClear(flags);
+    if (flags & (1 << ACCEL_INT2_PIN))
+    {
+      sl_bt_external_signal(evt_accel_GPIO_INT2);
+    }
   );
 }
 
-int accel_init()
+/* Default configuration, applied by accel_init() when no profile is given.
+ * Thresholds and timings come from the physical values in accel_config.h.
+ * Register maps for the packed fields:
+ *
+ * BW_RATE:
+ * D7 | D6 | D5 | D4        | D3 | D2 | D1 | D0 |
+ * 0  | 0  | 0  | LOW_POWER |      Rate         |
+ *
+ * ACT_INACT_CTL:
+ * D7          | D6              | D5              | D4             |
+ * ACT AC/DC   | ACT_X enable    | ACT_Y enable    | ACT_Z enable   |
+ * ------------+-----------------+-----------------+----------------+
+ * D3          | D2              | D1              | D0             |
+ * INACT AC/DC | INACT_X enable  | INACT_Y enable  | INACT_Z enable |
+ *
+ * TAP_AXES:
+ * D7 | D6 | D5 | D4 | D3        | D2 | D1 | D0 |
+ * 0  | 0  | 0  |  0 | supress   | X  | Y  | Z  |
+ *
+ * INT_ENABLE, INT_MAP, and INT_SOURCE:
+ * D7         | D6         | D5         | D4       |
+ * DATA_READY | SINGLE_TAP | DOUBLE_TAP | ACTIVITY |
+ * -----------+------------+------------+----------+
+ * D3         | D2         | D1         | D0       |
+ * INACTIVITY | FREE_FALL  | WATERMARK  | OVERRUN  |
+ *
+ * POWER_CTL:
+ * D7 | D6 | D5   | D4         | D3      | D2    | D1 | D0 |
+ * 0  | 0  | Link | AUTO_SLEEP | Measure | Sleep | Wakeup  |
+ */
+static const accel_profile default_profile = {
+  .thresh_tap =    ACCEL_THRESH_TAP,
+  .ofsx =          0,          // 15.6 mg/LSB
+  .ofsy =          0,
+  .ofsz =          0,
+  .dur =           ACCEL_DUR,
+  .latent =        ACCEL_LATENT,
+  .window =        ACCEL_WINDOW,
+  .thresh_act =    ACCEL_THRESH_ACT,
+  .thresh_inact =  ACCEL_THRESH_INACT,
+  .time_inact =    ACCEL_TIME_INACT,
+  .act_inact_ctl = 0b11111111, // all axis, ac coupled operation
+  .thresh_ff =     ACCEL_THRESH_FF,
+  .time_ff =       ACCEL_TIME_FF,
+  .tap_axes =      0b0000111,  // tap on all axes
+  .bw_rate =       DET_BW_RATE_CODE, // preset rate, normal power
+  // no AUTO_SLEEP: asleep the part samples at 8 Hz whatever BW_RATE says,
+  // while sample times are back-dated by the BW_RATE period. Monitoring
+  // saves power with BW_RATE LOW_POWER instead (see sampling.h)
+  .power_ctl =     POWER_CTL_LINK | POWER_CTL_MEASURE,
+  .int_enable =    0b00111110, // enable double tap, free fall, activity, inactivity, watermark
+  // data path (data ready, watermark, overrun) on INT2, semantic events on INT1
+  .int_map =       0b10000011,
+  .data_format =   ACCEL_DATA_FORMAT, // range/resolution, see accel_config.h
+  // stream mode keeps the newest 32 samples, watermark batches the wakeups
+  .fifo_ctl =      FIFO_MODE_STREAM | ACCEL_FIFO_WATERMARK
+};
+
+// contiguous writable register blocks, in the order they are written: the
+// block holding POWER_CTL/INT_ENABLE goes last so the part only starts
+// measuring and interrupting once everything else is in place
+static const struct
+{
+  accel_register first;
+  accel_register last;
+} write_blocks[] = {
+  { ADXL343_THRESH_TAP,  ADXL343_TAP_AXES },
+  { ADXL343_DATA_FORMAT, ADXL343_DATA_FORMAT },
+  { ADXL343_FIFO_CTL,    ADXL343_FIFO_CTL },
+  { ADXL343_BW_RATE,     ADXL343_INT_MAP }
+};
+
+// RAM copy of what has been written to the sensor, indexed by register
+static uint8_t shadow[ADXL343_FIFO_STATUS + 1];
+static bool is_shadow_valid = false;
+static accel_bus_stats bus_stats;
+
+int accel_init(const accel_profile *profile)
 {
-  // note: SPI is a part of the USART peripheral on the blue gecko
-  // Universal Synchronous Asynchronous Receiver Transmitter
-  // enable clocks for USART
-  CMU_ClockEnable(cmuClock_HFPER, true);
-  CMU_ClockEnable(cmuClock_USART1, true);
-  CMU_ClockEnable(cmuClock_GPIO, true);
-  
-  // setup and configure GPIO's, note that CS pin will be under application control
-  GPIO_PinModeSet(ACCEL_CLK_PORT, ACCEL_CLK_PIN, gpioModePushPull, 0);
-  GPIO_PinModeSet(ACCEL_TX_PORT, ACCEL_TX_PIN, gpioModePushPull, 0);
-  GPIO_PinModeSet(ACCEL_RX_PORT, ACCEL_RX_PIN, gpioModeInput, 0);
-  GPIO_PinModeSet(ACCEL_CS_PORT, ACCEL_CS_PIN, gpioModePushPull, 1);
-
-  // initialize USART1 for synchronous master mode, MSB first, CPOL=1, CPHA=1
-  USART_Reset(USART1);
-  USART_InitSync_TypeDef usart_init = USART_INITSYNC_DEFAULT;
-  usart_init.master = true;
-  usart_init.clockMode = usartClockMode3; // CPOL=1, CPHA=1
-  usart_init.msbf = true; // MSB first
-  USART_InitSync(USART1, &usart_init);
-  USART_BaudrateSyncSet(USART1, 0, 4000000);
-
-  // enable I/O and set tx,rx,clk locations - ref. manual pg 646
-  USART1->ROUTELOC0 = (USART1->ROUTELOC0 & ~(_USART_ROUTELOC0_TXLOC_MASK
-                        | _USART_ROUTELOC0_RXLOC_MASK | _USART_ROUTELOC0_CLKLOC_MASK))
-                        | (ACCEL_TX_LOC << _USART_ROUTELOC0_TXLOC_SHIFT)
-                        | (ACCEL_RX_LOC << _USART_ROUTELOC0_RXLOC_SHIFT)
-                        | (ACCEL_CLK_LOC << _USART_ROUTELOC0_CLKLOC_SHIFT);
-  // enable routes
-  USART1->ROUTEPEN |=   USART_ROUTEPEN_CLKPEN 
-                      | USART_ROUTEPEN_RXPEN 
-                      | USART_ROUTEPEN_TXPEN;
-
-  USART_Enable(USART1, usartEnable);
-
-  // TODO: setup accelerometer interrupt driven settings here
+  // the SPI transport (spi_init) must already be up
+  if (profile == NULL) profile = &default_profile;
+  accel_reset_bus_stats();
+
   // read the device ID 
   uint8_t val = 0;
   accel_read(ADXL343_DEVID, &val, 1);
@@ -85,91 +150,26 @@ int accel_init()
     LOG("Error: device ID != 0xe5, returned %d", val);
   }
 
-  int settings_len = 29;
-  uint8_t settings[settings_len]; 
-  accel_read(ADXL343_THRESH_TAP, settings, settings_len);
-  for (int i=0; i<settings_len; i++)
-  {
-    LOG("Reg: 0x%x = 0x%x", i+0x1d, settings[i]);
-  }
+  // standby with interrupts disabled during configuration, POWER_CTL and
+  // INT_ENABLE are adjacent so this is a single transaction
+  uint8_t standby[2] = { 0x0, 0x0 };
+  accel_write(ADXL343_POWER_CTL, standby, 2);
 
-  // disable interrupts during configuration
-  val = 0x0;
-  accel_write(ADXL343_INT_ENABLE, &val, 1);
-
-  // set bandwidth register:
-  // D7 | D6 | D5 | D4        | D3 | D2 | D1 | D0 |
-  // 0  | 0  | 0  | LOW_POWER |      Rate         |
-  val = 0b0000010;  // use 100 Hz
-  accel_write(ADXL343_BW_RATE, &val, 1); 
-
-  // ACTIVITY / INACTIVITY
-  // set inactivity threshold (scale factor = 62.5 mg/LSB)
-  val = 8; 
-  accel_write(ADXL343_THRESH_INACT, &val, 1);
-  // set inactivity time (scale factor = 1 sec/LSB)
-  val = 20; 
-  accel_write(ADXL343_TIME_INACT, &val, 1);
-  // set activity threshold (scale factor = 62.5 mg/LSB)
-  val = 4; 
-  accel_write(ADXL343_THRESH_ACT, &val, 1);
-  // activity/inactivity control
-  // D7          | D6              | D5              | D4           
-  // ACT AC/DC   | ACT_X enable    | ACT_Y enable    | ACT_Z enable   | 
-  // ------------+-----------------+-----------------+----------------+
-  // D3          | D2              | D1              | D0             |
-  // INACT AC/DC | INACT_X enable  | INACT_Y enable  | INACT_Z enable |
-  val = 0b11111111; // all axis, ac coupled operation
-  accel_write(ADXL343_ACT_INACT_CTL, &val, 1);
-
-
-  // DOUBLETAP
-  // set doubletap threshold (scale factor = 62.5 mg/LSB)
-  val = 0x30;
-  accel_write(ADXL343_THRESH_TAP, &val, 1);
-  // set doubletap duration (625 us/LSB)
-  val = 0x10;
-  accel_write(ADXL343_DUR, &val, 1);
-  // set doubletap latency (scale factor = 1.25 ms/LSB)
-  val = 0x10;
-  accel_write(ADXL343_LATENT, &val, 1);
-  // set doubletap window (scale factor = 1.25 ms/LSB)
-  val = 0xFF; 
-  accel_write(ADXL343_WINDOW, &val, 1);
-  // set axes register:
-  // D7 | D6 | D5 | D4 | D3        | D2 | D1 | D0 |
-  // 0  | 0  | 0  |  0 | supress   | X  | Y  | Z  |
-  val = 0b0000111; 
-  accel_write(ADXL343_TAP_AXES, &val, 1);
-
-  // FREEFALL
-  // set free-fall threshold (scale factor = 62.5 mg/LSB)
-  val = 5;
-  accel_write(ADXL343_THRESH_FF, &val, 1);
-  // set free-fall time (scale factor = 5 ms/LSB)
-  val = 40;
-  accel_write(ADXL343_TIME_FF, &val, 1);
-
-  // setup interrupts
-  // Below register map applies to INT_ENABLE, INT_MAP, and INT_SOURCE
-  // D7         | D6         | D5         | D4       |
-  // DATA_READY | SINGLE_TAP | DOUBLE_TAP | ACTIVITY | 
-  // -----------+------------+------------+----------+
-  // D3         | D2         | D1         | D0       |
-  // INACTIVITY | FREE_FALL  | WATERMARK  | OVERRUN  |
-  val = 0b00111100; // enable free fall, activity, inactivity
-  accel_write(ADXL343_INT_ENABLE, &val, 1);
-
-  // Power control register map:
-  // D7 | D6 | D5   | D4         | D3      | D2    | D1 | D0 |
-  // 0  | 0  | Link | AUTO_SLEEP | Measure | Sleep | Wakeup  |
-  val = 0b00111000; // enable link, auto sleep, measurement mode
-  accel_write(ADXL343_POWER_CTL, &val, 1);
+  // full write of every block, then read it back
+  is_shadow_valid = false;
+  int status = accel_apply_profile(profile);
+  if (status == 0) status = accel_verify();
+
+  accel_bus_stats stats;
+  accel_get_bus_stats(&stats);
+  LOG("accel_init: %lu SPI transactions, %lu bytes",
+      (unsigned long)stats.transactions, (unsigned long)stats.bytes);
 
   // clear interrupt sources
   accel_determine_interrupt_source(&val);
   // setup and configure interrupt GPIO's
   GPIO_PinModeSet(ACCEL_INT1_PORT, ACCEL_INT1_PIN, gpioModeInput, 0);
+  GPIO_PinModeSet(ACCEL_INT2_PORT, ACCEL_INT2_PIN, gpioModeInput, 0);
   // disable interrupts
   uint32_t flags = GPIO_IntGetEnabled();
   GPIO_IntDisable(flags);
@@ -181,85 +181,388 @@ int accel_init()
                      false,           // falling edge enable
                      true             // enable upon return
                     );
+  GPIO_ExtIntConfig( ACCEL_INT2_PORT, // port
+                     ACCEL_INT2_PIN,  // pin
+                     ACCEL_INT2_PIN,  // interrupt number
+                     true,            // rising edge enable
+                     false,           // falling edge enable
+                     true             // enable upon return
+                    );
   // don't forget the NVIC!!!
+  // INT1 (PA4) lands on the even handler, INT2 (PA3) on the odd handler
   NVIC_ClearPendingIRQ(GPIO_EVEN_IRQn);
   NVIC_EnableIRQ(GPIO_EVEN_IRQn);
+  NVIC_ClearPendingIRQ(GPIO_ODD_IRQn);
+  NVIC_EnableIRQ(GPIO_ODD_IRQn);
+
+  return status;
+}
+
+const accel_profile *accel_default_profile()
+{
+  return &default_profile;
+}
+
+static void accel_profile_to_regs(const accel_profile *p, uint8_t *regs)
+{
+  regs[ADXL343_THRESH_TAP] =    p->thresh_tap;
+  regs[ADXL343_OFSX] =          (uint8_t)p->ofsx;
+  regs[ADXL343_OFSY] =          (uint8_t)p->ofsy;
+  regs[ADXL343_OFSZ] =          (uint8_t)p->ofsz;
+  regs[ADXL343_DUR] =           p->dur;
+  regs[ADXL343_LATENT] =        p->latent;
+  regs[ADXL343_WINDOW] =        p->window;
+  regs[ADXL343_THRESH_ACT] =    p->thresh_act;
+  regs[ADXL343_THRESH_INACT] =  p->thresh_inact;
+  regs[ADXL343_TIME_INACT] =    p->time_inact;
+  regs[ADXL343_ACT_INACT_CTL] = p->act_inact_ctl;
+  regs[ADXL343_THRESH_FF] =     p->thresh_ff;
+  regs[ADXL343_TIME_FF] =       p->time_ff;
+  regs[ADXL343_TAP_AXES] =      p->tap_axes;
+  regs[ADXL343_BW_RATE] =       p->bw_rate;
+  regs[ADXL343_POWER_CTL] =     p->power_ctl;
+  regs[ADXL343_INT_ENABLE] =    p->int_enable;
+  regs[ADXL343_INT_MAP] =       p->int_map;
+  regs[ADXL343_DATA_FORMAT] =   p->data_format;
+  regs[ADXL343_FIFO_CTL] =      p->fifo_ctl;
+}
+
+static void accel_profile_from_regs(const uint8_t *regs, accel_profile *p)
+{
+  p->thresh_tap =    regs[ADXL343_THRESH_TAP];
+  p->ofsx =          (int8_t)regs[ADXL343_OFSX];
+  p->ofsy =          (int8_t)regs[ADXL343_OFSY];
+  p->ofsz =          (int8_t)regs[ADXL343_OFSZ];
+  p->dur =           regs[ADXL343_DUR];
+  p->latent =        regs[ADXL343_LATENT];
+  p->window =        regs[ADXL343_WINDOW];
+  p->thresh_act =    regs[ADXL343_THRESH_ACT];
+  p->thresh_inact =  regs[ADXL343_THRESH_INACT];
+  p->time_inact =    regs[ADXL343_TIME_INACT];
+  p->act_inact_ctl = regs[ADXL343_ACT_INACT_CTL];
+  p->thresh_ff =     regs[ADXL343_THRESH_FF];
+  p->time_ff =       regs[ADXL343_TIME_FF];
+  p->tap_axes =      regs[ADXL343_TAP_AXES];
+  p->bw_rate =       regs[ADXL343_BW_RATE];
+  p->power_ctl =     regs[ADXL343_POWER_CTL];
+  p->int_enable =    regs[ADXL343_INT_ENABLE];
+  p->int_map =       regs[ADXL343_INT_MAP];
+  p->data_format =   regs[ADXL343_DATA_FORMAT];
+  p->fifo_ctl =      regs[ADXL343_FIFO_CTL];
+}
+
+int accel_apply_profile(const accel_profile *profile)
+{
+  if (profile == NULL) return -1;
+
+  uint8_t regs[ADXL343_FIFO_STATUS + 1];
+  memcpy(regs, shadow, sizeof(regs));
+  accel_profile_to_regs(profile, regs);
+
+  for (uint32_t b=0; b<sizeof(write_blocks)/sizeof(write_blocks[0]); b++)
+  {
+    // shrink each block to the span between its first and last change, the
+    // unchanged registers in between ride along in the same burst
+    int first = -1;
+    int last = -1;
+    for (int r=write_blocks[b].first; r<=(int)write_blocks[b].last; r++)
+    {
+      if (!is_shadow_valid || regs[r] != shadow[r])
+      {
+        if (first < 0) first = r;
+        last = r;
+      }
+    }
+    if (first < 0) continue;
+
+    int status = accel_write(first, &regs[first], last-first+1);
+    if (status != 0) return status;
+    memcpy(&shadow[first], &regs[first], last-first+1);
+  }
+  is_shadow_valid = true;
+  return 0;
+}
+
+int accel_update_register(accel_register reg, uint8_t val)
+{
+  if (is_shadow_valid && shadow[reg] == val) return 0;
+  int status = accel_write(reg, &val, 1);
+  if (status == 0) shadow[reg] = val;
+  return status;
+}
+
+int accel_verify()
+{
+  if (!is_shadow_valid) return -1;
 
-  // read out final register settings
-  /*
-  memset(settings, 0x0, settings_len);
-  accel_read(ADXL343_THRESH_TAP, settings, settings_len);
-  for (int i=0; i<settings_len; i++)
+  // INT_SOURCE and DATAX0..DATAZ1 sit between the blocks, reading them would
+  // clear latched interrupts and pop a FIFO entry, so the readback skips
+  // them: THRESH_TAP..INT_MAP in one burst, then DATA_FORMAT and FIFO_CTL
+  static const struct
+  {
+    accel_register first;
+    accel_register last;
+  } read_spans[] = {
+    { ADXL343_THRESH_TAP,  ADXL343_INT_MAP },
+    { ADXL343_DATA_FORMAT, ADXL343_DATA_FORMAT },
+    { ADXL343_FIFO_CTL,    ADXL343_FIFO_CTL }
+  };
+  uint8_t regs[ADXL343_FIFO_CTL + 1];
+  int status = 0;
+  for (uint32_t s=0; s<sizeof(read_spans)/sizeof(read_spans[0]); s++)
   {
-    LOG("Reg: 0x%x = 0x%x", i+0x1d, settings[i]);
+    status = accel_read(read_spans[s].first, &regs[read_spans[s].first],
+                            read_spans[s].last - read_spans[s].first + 1);
+    if (status != 0) return status;
   }
-  */
 
+  for (uint32_t b=0; b<sizeof(write_blocks)/sizeof(write_blocks[0]); b++)
+  {
+    for (int r=write_blocks[b].first; r<=(int)write_blocks[b].last; r++)
+    {
+      if (regs[r] != shadow[r])
+      {
+        LOG("Error: reg 0x%x = 0x%x, expected 0x%x", r, regs[r], shadow[r]);
+        status = -1;
+      }
+    }
+  }
+  return status;
+}
+
+int accel_get_profile(accel_profile *profile)
+{
+  if (!is_shadow_valid) return -1;
+  accel_profile_from_regs(shadow, profile);
+  return 0;
+}
+
+int accel_set_offsets(const int8_t *offsets)
+{
+  // OFSX..OFSZ are adjacent within the first block, so the profile diff
+  // collapses to one 3 register burst
+  if (!is_shadow_valid) return -1;
+  accel_profile p;
+  accel_profile_from_regs(shadow, &p);
+  p.ofsx = offsets[0];
+  p.ofsy = offsets[1];
+  p.ofsz = offsets[2];
+  return accel_apply_profile(&p);
+}
+
+void accel_get_offsets(int8_t *offsets)
+{
+  offsets[0] = (int8_t)shadow[ADXL343_OFSX];
+  offsets[1] = (int8_t)shadow[ADXL343_OFSY];
+  offsets[2] = (int8_t)shadow[ADXL343_OFSZ];
+}
+
+int accel_offsets_load(int8_t *offsets)
+{
+  uint8_t buf[3];
+  size_t len = 0;
+  sl_status_t sc = sl_bt_nvm_load(ACCEL_NVM_KEY_OFFSETS, sizeof(buf), &len, buf);
+  if (sc != SL_STATUS_OK || len != sizeof(buf)) return -1;
+  memcpy(offsets, buf, sizeof(buf));
   return 0;
 }
 
+int accel_offsets_save(const int8_t *offsets)
+{
+  sl_status_t sc = sl_bt_nvm_save(ACCEL_NVM_KEY_OFFSETS, 3,
+                                  (const uint8_t *)offsets);
+  if (sc != SL_STATUS_OK)
+  {
+    LOG("Error: sl_bt_nvm_save() returned 0x%x", (unsigned int)sc);
+    return -1;
+  }
+  return 0;
+}
+
+void accel_get_bus_stats(accel_bus_stats *stats)
+{
+  if (stats != NULL) *stats = bus_stats;
+}
+
+void accel_reset_bus_stats()
+{
+  memset(&bus_stats, 0x0, sizeof(bus_stats));
+}
+
 void accel_determine_interrupt_source(uint8_t *reg) 
 {
   accel_read(ADXL343_INT_SOURCE, reg, 1);
 }
 
+int accel_snapshot(accel_int_snapshot *snap)
+{
+  if (snap == NULL) return -1;
+  // taken before the burst, so an edge raised once INT_SOURCE has been read
+  // is left to date the next snapshot
+  uint32_t int_ms = int1_ms;
+  uint8_t regs[ACCEL_SNAPSHOT_LEN];
+  int status = accel_read(ADXL343_ACT_TAP_STATUS, regs, ACCEL_SNAPSHOT_LEN);
+  if (status != 0) return status;
+  accel_snapshot_decode(regs, snap);
+  snap->int_ms = int_ms;
+  return 0;
+}
+
+void accel_snapshot_decode(const uint8_t *regs, accel_int_snapshot *snap)
+{
+  uint8_t tap_status = regs[0];
+
+  snap->int_source = regs[ADXL343_INT_SOURCE - ADXL343_ACT_TAP_STATUS];
+  snap->act_axes = (tap_status >> 4) & (AXIS_X | AXIS_Y | AXIS_Z);
+  snap->tap_axes = tap_status & (AXIS_X | AXIS_Y | AXIS_Z);
+  snap->is_asleep = (tap_status & ACT_TAP_STATUS_ASLEEP) != 0;
+}
+
+bool accel_is_int2_asserted()
+{
+  return GPIO_PinInGet(ACCEL_INT2_PORT, ACCEL_INT2_PIN) != 0;
+}
+
 int accel_get_acceleration()
 { 
-  uint8_t rx_buf[6];
-  int16_t accel[3];
-  accel_read(ADXL343_DATAX0, &rx_buf[0], 6);
-  for (int i=0; i<3; i++)
+  uint8_t rx_buf[ACCEL_RAW_SAMPLE_LEN];
+  int16_t x, y, z;
+  accel_read(ADXL343_DATAX0, &rx_buf[0], ACCEL_RAW_SAMPLE_LEN);
+  accel_decode_batch(rx_buf, 1, &x, &y, &z, NULL);
+  printf("%d %d %d\n", x, y, z);
+  return 0;
+}
+
+int accel_fifo_init(uint8_t watermark)
+{
+  if (watermark == 0 || watermark > FIFO_SAMPLES_MASK) return -1;
+  uint8_t val = FIFO_MODE_STREAM | (watermark & FIFO_SAMPLES_MASK);
+  return accel_update_register(ADXL343_FIFO_CTL, val);
+}
+
+void accel_set_bus(const spi_bus *new_bus)
+{
+  if (new_bus != NULL) bus = new_bus;
+}
+
+int accel_fifo_drain(accel_sample *buf, uint32_t max_samples)
+{
+  if (buf == NULL || max_samples == 0) return -1;
+
+  uint8_t status = 0;
+  if (accel_read(ADXL343_FIFO_STATUS, &status, 1) != 0) return -1;
+  uint32_t entries = status & FIFO_ENTRIES_MASK;
+  if (entries > max_samples) entries = max_samples;
+
+  // DATAX0..DATAZ1, FIFO_CTL, FIFO_STATUS
+  uint8_t rx_buf[8];
+  uint32_t n;
+  for (n=0; n<entries; n++)
   {
-    accel[i] = (int16_t)( (rx_buf[2*i+1] << 0x8) | rx_buf[2*i] );
-    printf("%d ", accel[i]);
+    // stop at a failed frame, the entries read so far are good
+    if (accel_read(ADXL343_DATAX0, rx_buf, sizeof(rx_buf)) != 0) break;
+    // accel_sample is the raw register image, decoding is left to the
+    // batch kernel on the processing side
+    memcpy(&buf[n], rx_buf, ACCEL_RAW_SAMPLE_LEN);
+  }
+  return (int)n;
+}
+
+int accel_fifo_drain_async(accel_sample *buf, uint32_t max_samples)
+{
+  if (buf == NULL || max_samples == 0 || drain_ctx.is_active) return -1;
+
+  drain_ctx.buf = buf;
+  drain_ctx.max_samples = max_samples;
+  drain_ctx.entries = 0;
+  drain_ctx.count = 0;
+  drain_ctx.is_status_read = false;
+  drain_ctx.is_active = true;
+
+  drain_tx[0] = SINGLE_READ_CMD(ADXL343_FIFO_STATUS);
+  drain_tx[1] = 0xFF;
+  if (bus->transfer_async(drain_tx, drain_rx, 2) != 0)
+  {
+    drain_ctx.is_active = false;
+    return -1;
   }
-  printf("\n");
   return 0;
 }
 
-static int accel_read(uint8_t start_register, uint8_t *rx, uint32_t nbytes)
+bool accel_fifo_drain_step(int *count)
 {
-  if (nbytes <= 0 || rx == NULL) return -1;
-  USART1->CMD |= USART_CMD_CLEARTX | USART_CMD_CLEARRX;
-  uint8_t cmd;
-  if (nbytes > 1) 
+  if (!drain_ctx.is_active) return false;
+
+  if (!drain_ctx.is_status_read)
   {
-    cmd = MULTI_READ_CMD(start_register);
+    drain_ctx.is_status_read = true;
+    drain_ctx.entries = drain_rx[1] & FIFO_ENTRIES_MASK;
+    if (drain_ctx.entries > drain_ctx.max_samples)
+    {
+      drain_ctx.entries = drain_ctx.max_samples;
+    }
   }
-  else if (nbytes == 1)
+  else
   {
-    cmd = SINGLE_READ_CMD(start_register);
+    memcpy(&drain_ctx.buf[drain_ctx.count++], &drain_rx[1],
+           ACCEL_RAW_SAMPLE_LEN);
   }
-  accel_cs_low();
-  USART_SpiTransfer(USART1, cmd);
-  for (uint32_t i=0; i<nbytes; i++)
+
+  if (drain_ctx.count < drain_ctx.entries && accel_fifo_drain_next() == 0)
   {
-    rx[i] = USART_SpiTransfer(USART1, 0xFF);
+    return false; // next entry in flight
   }
-  accel_cs_high();
-  return 0;
+
+  drain_ctx.is_active = false;
+  if (count != NULL) *count = (int)drain_ctx.count;
+  return true;
+}
+
+bool accel_fifo_is_draining()
+{
+  return drain_ctx.is_active;
 }
 
-static int accel_write(uint8_t start_register, uint8_t *tx, uint32_t nbytes) 
+static int accel_fifo_drain_next()
+{
+  drain_tx[0] = MULTI_READ_CMD(ADXL343_DATAX0);
+  memset(&drain_tx[1], 0xFF, sizeof(drain_tx)-1);
+  return bus->transfer_async(drain_tx, drain_rx, sizeof(drain_tx));
+}
+
+static int accel_read(uint8_t start_register, uint8_t *rx, uint32_t nbytes)
 {
-  if (nbytes <= 0 || tx == NULL) return -1;
-  USART1->CMD |= USART_CMD_CLEARTX | USART_CMD_CLEARRX;
-  uint8_t cmd;
-  if (nbytes > 1) 
+  if (nbytes <= 0 || rx == NULL || nbytes >= SPI_MAX_FRAME) return -1;
+  if (nbytes > 1)
   {
-    cmd = MULTI_WRITE_CMD(start_register);
+    tx_frame[0] = MULTI_READ_CMD(start_register);
   }
-  else if (nbytes == 1)
+  else
   {
-    cmd = SINGLE_WRITE_CMD(start_register);
+    tx_frame[0] = SINGLE_READ_CMD(start_register);
   }
-  accel_cs_low();
-  USART_SpiTransfer(USART1, cmd);
-  for (uint32_t i=0; i<nbytes; i++) 
+  memset(&tx_frame[1], 0xFF, nbytes);
+  bus_stats.transactions++;
+  bus_stats.bytes += nbytes+1;
+  int status = bus->transfer(tx_frame, rx_frame, nbytes+1);
+  // a failed frame holds whatever was on the wire, leave the caller's buffer
+  if (status == 0) memcpy(rx, &rx_frame[1], nbytes);
+  return status;
+}
+
+static int accel_write(uint8_t start_register, const uint8_t *tx, uint32_t nbytes)
+{
+  if (nbytes <= 0 || tx == NULL || nbytes >= SPI_MAX_FRAME) return -1;
+  if (nbytes > 1)
   {
-    USART_SpiTransfer(USART1, tx[i]); 
+    tx_frame[0] = MULTI_WRITE_CMD(start_register);
   }
-  accel_cs_high();
-  return 0;
+  else
+  {
+    tx_frame[0] = SINGLE_WRITE_CMD(start_register);
+  }
+  memcpy(&tx_frame[1], tx, nbytes);
+  bus_stats.transactions++;
+  bus_stats.bytes += nbytes+1;
+  return bus->transfer(tx_frame, rx_frame, nbytes+1);
 }
-
@@ -9,6 +9,7 @@
 #define  _ADXL343_H_
 
 #include <stdbool.h>
+#include <string.h>
 #include <em_core.h>
 #include <em_usart.h>
 #include <em_gpio.h>
@@ -17,6 +18,15 @@
 
 #include "events.h"
 #include "log.h"
+#include "spi.h"
+#include "gpio.h"
+#include "timers.h"
+#include "accel_config.h"
+#include "accel_decode.h"
+#include "accel_sample.h"
+
+// persistent store key for the calibrated offsets (user range 0x4000-0x407F)
+#define ACCEL_NVM_KEY_OFFSETS (0x4000)
 
 // Register masks / shifts:
 #define ADDRESS_MASK      (0x3F)
@@ -83,13 +93,292 @@ typedef enum
   INT_OVERRUN = 0x01
 } accel_interrupts;
 
+// FIFO_CTL register map:
+// D7 D6   | D5      | D4 D3 D2 D1 D0 |
+// FIFO_MODE | Trigger | Samples        |
+#define FIFO_MODE_BYPASS    (0x0 << 6)
+#define FIFO_MODE_FIFO      (0x1 << 6)
+#define FIFO_MODE_STREAM    (0x2 << 6)
+#define FIFO_MODE_TRIGGER   (0x3 << 6)
+#define FIFO_SAMPLES_MASK   (0x1F)
+#define FIFO_ENTRIES_MASK   (0x3F) // FIFO_STATUS entries field
+
+// POWER_CTL register map:
+// D7 | D6 | D5   | D4         | D3      | D2    | D1 | D0 |
+// 0  | 0  | Link | AUTO_SLEEP | Measure | Sleep | Wakeup  |
+#define POWER_CTL_LINK        (0x20)
+#define POWER_CTL_AUTO_SLEEP  (0x10)
+#define POWER_CTL_MEASURE     (0x08)
+#define POWER_CTL_SLEEP       (0x04)
+#define POWER_CTL_WAKEUP_MASK (0x03) // sleep rate 8 Hz >> Wakeup
+
+#define ACCEL_FIFO_DEPTH      (32) // samples held by the sensor FIFO
+#define ACCEL_FIFO_WATERMARK  (31) // ~3 watermark interrupts/sec at 100 Hz
+
+
+// ACT_TAP_STATUS register map:
+// D7 | D6    | D5    | D4    | D3     | D2    | D1    | D0    |
+// 0  | ACT_X | ACT_Y | ACT_Z | Asleep | TAP_X | TAP_Y | TAP_Z |
+#define ACT_TAP_STATUS_ASLEEP (0x08)
+#define AXIS_X                (0x4)
+#define AXIS_Y                (0x2)
+#define AXIS_Z                (0x1)
+
+// registers covered by one snapshot burst, ACT_TAP_STATUS..INT_SOURCE. The
+// burst stops short of DATAX0: reading the data registers would pop a FIFO
+// entry out from under the watermark drain
+#define ACCEL_SNAPSHOT_LEN    (ADXL343_INT_SOURCE - ADXL343_ACT_TAP_STATUS + 1)
+
+// decoded state of the sensor at the time of an interrupt
+typedef struct
+{
+  uint8_t int_source;   // INT_SOURCE, latched sources are cleared by the read
+  uint8_t act_axes;     // AXIS_X | AXIS_Y | AXIS_Z involved in activity
+  uint8_t tap_axes;     // AXIS_X | AXIS_Y | AXIS_Z involved in tap
+  bool is_asleep;       // AUTO_SLEEP has put the part in sleep
+  uint32_t int_ms;      // uptime latched by the INT1 edge
+} accel_int_snapshot;
+
+// declarative sensor configuration, one field per writable register
+typedef struct
+{
+  uint8_t thresh_tap;    // 0x1D
+  int8_t  ofsx;          // 0x1E
+  int8_t  ofsy;          // 0x1F
+  int8_t  ofsz;          // 0x20
+  uint8_t dur;           // 0x21
+  uint8_t latent;        // 0x22
+  uint8_t window;        // 0x23
+  uint8_t thresh_act;    // 0x24
+  uint8_t thresh_inact;  // 0x25
+  uint8_t time_inact;    // 0x26
+  uint8_t act_inact_ctl; // 0x27
+  uint8_t thresh_ff;     // 0x28
+  uint8_t time_ff;       // 0x29
+  uint8_t tap_axes;      // 0x2A
+  uint8_t bw_rate;       // 0x2C
+  uint8_t power_ctl;     // 0x2D
+  uint8_t int_enable;    // 0x2E
+  uint8_t int_map;       // 0x2F
+  uint8_t data_format;   // 0x31
+  uint8_t fifo_ctl;      // 0x38
+} accel_profile;
+
+// SPI traffic counters, used to benchmark configuration cost
+typedef struct
+{
+  uint32_t transactions;
+  uint32_t bytes;        // command bytes included
+} accel_bus_stats;
 
 /* ============================================================================
  *       FUNCTION PROTOTYPES 
  * ===========================================================================*/
-int accel_init();
+/* @brief  Brings up the ADXL343 with the given configuration profile
+ *
+ * Puts the part in standby, writes the whole profile with one burst per
+ * contiguous register block and reads it back with accel_verify(). The
+ * SPI traffic used is logged as a boot-time benchmark.
+ *
+ * @param  const accel_profile*, profile to apply, NULL for the default
+ * @return -1 upon error (including a failed verify), 0 upon success
+ */
+int accel_init(const accel_profile *profile);
+
+/* @brief  Returns the built-in default configuration profile
+ *
+ * @param  None
+ * @return const accel_profile*, never NULL
+ */
+const accel_profile *accel_default_profile();
+
+/* @brief  Applies a profile, writing only registers that differ from the shadow
+ *
+ * Changed registers are grouped per contiguous writable block and written
+ * with one burst spanning the first to last change of each block.
+ *
+ * @param  const accel_profile*, the profile to apply
+ * @return -1 upon error, 0 upon success
+ */
+int accel_apply_profile(const accel_profile *profile);
+
+/* @brief  Writes a single register through the shadow, skipped if unchanged
+ *
+ * @param  accel_register, writable register to update
+ * @param  uint8_t, new value
+ * @return -1 upon error, 0 upon success
+ */
+int accel_update_register(accel_register reg, uint8_t val);
+
+/* @brief  Reads back all writable registers and checks them against the shadow
+ *
+ *         Three bursts that step around INT_SOURCE and the data registers,
+ *         so latched interrupts and the FIFO are left alone
+ *
+ * @param  None
+ * @return -1 upon mismatch or error, 0 upon success
+ */
+int accel_verify();
+
+/* @brief  Copies the SPI transaction and byte counters
+ *
+ * @param  accel_bus_stats*, destination
+ * @return None
+ */
+void accel_get_bus_stats(accel_bus_stats *stats);
+
+/* @brief  Clears the SPI transaction and byte counters
+ *
+ * @param  None
+ * @return None
+ */
+void accel_reset_bus_stats();
+
+/* @brief  Returns the profile currently programmed, from the shadow
+ *
+ * @param  accel_profile*, destination
+ * @return -1 before the first profile was applied, 0 upon success
+ */
+int accel_get_profile(accel_profile *profile);
+
+/* @brief  Writes OFSX/OFSY/OFSZ with a single burst through the shadow
+ *
+ * @param  const int8_t*, OFSX..OFSZ in 15.6 mg/LSB
+ * @return -1 upon error, 0 upon success
+ */
+int accel_set_offsets(const int8_t *offsets);
+
+/* @brief  Returns the offsets currently programmed in the sensor
+ *
+ * @param  int8_t*, OFSX..OFSZ destination
+ * @return None
+ */
+void accel_get_offsets(int8_t *offsets);
+
+/* @brief  Loads calibrated offsets from the persistent store
+ *
+ * @param  int8_t*, OFSX..OFSZ destination
+ * @return -1 if nothing is stored, 0 upon success
+ */
+int accel_offsets_load(int8_t *offsets);
+
+/* @brief  Saves calibrated offsets to the persistent store
+ *
+ * @param  const int8_t*, OFSX..OFSZ
+ * @return -1 upon error, 0 upon success
+ */
+int accel_offsets_save(const int8_t *offsets);
+
 int accel_get_acceleration();
 void accel_determine_interrupt_source(uint8_t *reg);
+
+/* @brief  Captures the interrupt context with a single SPI burst
+ *
+ * Reads ACT_TAP_STATUS (0x2B) through INT_SOURCE (0x30) in one transaction,
+ * replacing separate INT_SOURCE and tap status reads. The data registers are
+ * left alone, samples only leave the FIFO through the drain.
+ *
+ * The events are dated with the uptime the INT1 handler latched on the
+ * rising edge, not the time of the read. INT1 stays high until INT_SOURCE
+ * is read, so that one edge stands for every source in the snapshot and
+ * dates them at the earliest of them.
+ *
+ * @param  accel_int_snapshot*, decoded result
+ * @return -1 upon error, 0 upon success
+ */
+int accel_snapshot(accel_int_snapshot *snap);
+
+/* @brief  Decodes a raw ACT_TAP_STATUS..INT_SOURCE register image
+ *
+ * @param  const uint8_t*, ACCEL_SNAPSHOT_LEN bytes starting at 0x2B
+ * @param  accel_int_snapshot*, decoded result
+ * @return None
+ */
+void accel_snapshot_decode(const uint8_t *regs, accel_int_snapshot *snap);
+
+/* @brief  Reads the level of the INT2 (data path) line
+ *
+ * INT2 is edge triggered, so a watermark that is still exceeded after a
+ * partial drain produces no new edge. Callers re-check the level after
+ * draining to avoid stalling.
+ *
+ * @param  None
+ * @return true if INT2 is high
+ */
+bool accel_is_int2_asserted();
+
+/* @brief  Puts the FIFO in stream mode with the given watermark
+ *
+ * The WATERMARK interrupt fires once the FIFO holds more than watermark
+ * samples, so the MCU only needs to wake once per batch.
+ *
+ * @param  uint8_t, watermark level in samples [1, 31]
+ * @return -1 upon error, 0 upon success
+ */
+int accel_fifo_init(uint8_t watermark);
+
+/* @brief  Drains all samples currently queued in the FIFO
+ *
+ * Reads FIFO_STATUS once, then pops each entry with a single burst over
+ * DATAX0..FIFO_STATUS. The two trailing bytes of each burst provide the 5 us
+ * FIFO update time the sensor requires between consecutive entry reads.
+ * A failed burst stops the drain, the entries before it are returned.
+ *
+ * @param  accel_sample*, caller-supplied buffer for the samples
+ * @param  uint32_t, capacity of the buffer in samples
+ * @return -1 upon error, else the number of samples written to buf
+ */
+int accel_fifo_drain(accel_sample *buf, uint32_t max_samples);
+
+/* @brief  Starts a non-blocking FIFO drain over the asynchronous transport
+ *
+ * Each completed transfer raises evt_spi_xfer_done; the event loop must then
+ * call accel_fifo_drain_step() until it reports the drain as finished. The
+ * core is free to sleep in EM1 while the transfers run.
+ *
+ * @param  accel_sample*, caller-supplied buffer, must outlive the drain
+ * @param  uint32_t, capacity of the buffer in samples
+ * @return -1 upon error (or a drain already running), 0 upon success
+ */
+int accel_fifo_drain_async(accel_sample *buf, uint32_t max_samples);
+
+/* @brief  Advances the asynchronous FIFO drain after evt_spi_xfer_done
+ *
+ * A transfer the transport refuses ends the drain early, count then holds
+ * the entries read before it.
+ *
+ * @param  int*, set to the number of samples drained once finished
+ * @return true once the drain has finished, false while transfers remain
+ */
+bool accel_fifo_drain_step(int *count);
+
+/* @brief  Reports whether an asynchronous FIFO drain is running
+ *
+ * @return true between accel_fifo_drain_async() and the final step
+ */
+bool accel_fifo_is_draining();
+
+/* @brief  Replaces the SPI transport used by the driver
+ *
+ * @param  const spi_bus*, transport to use, defaults to spi_usart1_bus
+ * @return None
+ */
+void accel_set_bus(const spi_bus *new_bus);
+
+/* @brief  GPIO even pin interrupt service routine (INT1, semantic events)
+ *
+ * Latches the uptime of the edge for accel_snapshot().
+ *
+ * @param  None
+ * @return None
+ */
 void GPIO_EVEN_IRQHandler();
 
+/* @brief  GPIO odd pin interrupt service routine (INT2, data path)
+ *
+ * @param  None
+ * @return None
+ */
+void GPIO_ODD_IRQHandler();
+
 #endif // _ADXL343_H_
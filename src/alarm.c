@@ -0,0 +1,142 @@
+/* -----------------------------------------------------------------------------
+ * @file   alarm.c
+ * @brief  Fall alarm lifecycle: detected, a grace window the wearer can
+ *         cancel with a double tap, then confirmed and escalated
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "alarm.h"
+
+static const char *state_names[ALARM_NUM_STATES] = {
+  "idle", "grace", "confirmed", "escalated", "cancelled"
+};
+
+void alarm_init(alarm_context *a)
+{
+  memset(a, 0x0, sizeof(*a));
+  a->state = ALARM_IDLE;
+}
+
+static uint32_t start_grace(alarm_context *a, uint32_t event_ms,
+                            uint32_t now_ms)
+{
+  a->state = ALARM_GRACE;
+  a->capture_ms = event_ms;
+  a->detected_ms = now_ms;
+  a->deadline_ms = now_ms + ALARM_GRACE_MS;
+  a->sends = 0;
+  a->is_measured = false;
+  a->offline_ms = 0;
+  a->timer_ms = ALARM_GRACE_MS;
+  return ALARM_ACT_START_TIMER;
+}
+
+static uint32_t send(alarm_context *a, uint32_t now_ms)
+{
+  if (a->sends++ == 0) a->sent_ms = now_ms;
+  if (a->is_link_up && !a->is_measured)
+  {
+    a->is_measured = true;
+    a->latency_ms = now_ms - a->capture_ms - a->offline_ms;
+    if (a->latency_ms > a->max_latency_ms) a->max_latency_ms = a->latency_ms;
+    if (a->latency_ms > ALARM_MAX_LATENCY_MS) a->late++;
+  }
+  a->timer_ms = ALARM_RETRY_MS;
+  return ALARM_ACT_SEND | ALARM_ACT_START_TIMER;
+}
+
+static uint32_t link(alarm_context *a, bool is_up, uint32_t now_ms)
+{
+  if (is_up == a->is_link_up) return ALARM_ACT_NONE;
+  a->is_link_up = is_up;
+  if (!is_up)
+  {
+    a->down_ms = now_ms;
+    return ALARM_ACT_NONE;
+  }
+
+  // only the time of the alarm in progress counts, from the verdict on
+  uint32_t from = ((int32_t)(a->down_ms - a->detected_ms) > 0)
+                  ? a->down_ms : a->detected_ms;
+  if (alarm_is_link_reserved(a) && !a->is_measured
+      && (int32_t)(now_ms - from) > 0)
+  {
+    a->offline_ms += now_ms - from;
+  }
+  // a confirmed alarm goes out to the new client right away
+  if (a->state == ALARM_CONFIRMED) return send(a, now_ms);
+  return ALARM_ACT_NONE;
+}
+
+uint32_t alarm_step(alarm_context *a, alarm_input in, uint32_t event_ms,
+                    uint32_t now_ms)
+{
+  if (in == ALARM_IN_RESET)
+  {
+    bool is_timed = alarm_is_link_reserved(a);
+    a->state = ALARM_IDLE;
+    return is_timed ? ALARM_ACT_STOP_TIMER : ALARM_ACT_NONE;
+  }
+  if (in == ALARM_IN_LINK_UP || in == ALARM_IN_LINK_DOWN)
+  {
+    return link(a, in == ALARM_IN_LINK_UP, now_ms);
+  }
+
+  switch (a->state)
+  {
+    case ALARM_IDLE:
+    case ALARM_ESCALATED:
+    case ALARM_CANCELLED:
+      if (in == ALARM_IN_FALL) return start_grace(a, event_ms, now_ms);
+      break;
+
+    case ALARM_GRACE:
+      // a tap captured inside the window cancels even when it is handled
+      // after the deadline. Once the expiry has been handled the alarm is
+      // CONFIRMED and out, taps no longer cancel it
+      if (in == ALARM_IN_DOUBLE_TAP
+          && (int32_t)(event_ms - a->deadline_ms) <= 0)
+      {
+        a->state = ALARM_CANCELLED;
+        a->cancelled++;
+        return ALARM_ACT_STOP_TIMER;
+      }
+      if (in == ALARM_IN_TIMER)
+      {
+        if ((int32_t)(now_ms - a->deadline_ms) < 0)
+        {
+          // early expiry, wait for the rest of the window
+          a->timer_ms = a->deadline_ms - now_ms;
+          return ALARM_ACT_START_TIMER;
+        }
+        a->state = ALARM_CONFIRMED;
+        return send(a, now_ms);
+      }
+      break;
+
+    case ALARM_CONFIRMED:
+      if (in == ALARM_IN_TIMER) return send(a, now_ms);
+      if (in == ALARM_IN_DELIVERED)
+      {
+        a->state = ALARM_ESCALATED;
+        a->escalated++;
+        return ALARM_ACT_STOP_TIMER;
+      }
+      break;
+
+    default:
+      break;
+  }
+  return ALARM_ACT_NONE;
+}
+
+bool alarm_is_link_reserved(const alarm_context *a)
+{
+  return a->state == ALARM_GRACE || a->state == ALARM_CONFIRMED;
+}
+
+const char *alarm_state_name(alarm_state s)
+{
+  return (s < ALARM_NUM_STATES) ? state_names[s] : "?";
+}
@@ -0,0 +1,146 @@
+/* -----------------------------------------------------------------------------
+ * @file   alarm.h
+ * @brief  Fall alarm lifecycle: detected, a grace window the wearer can
+ *         cancel with a double tap, then confirmed and escalated
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ *   IDLE --fall--> GRACE --double tap--> CANCELLED
+ *                    |
+ *                  timer
+ *                    v
+ *                CONFIRMED --delivered--> ESCALATED
+ *                  ^   |
+ *                  +---+ timer, resend every ALARM_RETRY_MS
+ *
+ * CANCELLED and ESCALATED accept a new fall, ALARM_IN_RESET returns any state
+ * to IDLE. Inputs carry the capture time of the event they report (the
+ * trigger sample of a fall, the INT1 edge of a tap), the grace window is
+ * timed from the verdict. A tap captured inside the window cancels even if
+ * it is handled after the deadline, as long as the expiry has not been
+ * handled first; once CONFIRMED the alarm is out and only the client can
+ * reset it. Like sampling.c this is a pure state machine, the caller runs a
+ * one-shot timer as told by the returned actions and feeds the expiry back
+ * as ALARM_IN_TIMER, so no deadline depends on polling.
+ *
+ * ALARM_IN_LINK_UP/DOWN report whether a client is subscribed to receive
+ * the alarm. A confirmed alarm is sent again as soon as one subscribes.
+ *
+ * Worst-case latency, from the capture of the free-fall to the alarm being
+ * handed to the stack with a client subscribed, is ALARM_MAX_LATENCY_MS: the
+ * detector's longest verdict, one full FIFO at the slowest rate, the grace
+ * window and the timer dispatch. Time without a subscribed client, from the
+ * verdict to that hand-off, is not counted: no latency bound holds with
+ * nobody to deliver to, the fall beacon covers that case. While an alarm is
+ * in GRACE or CONFIRMED the caller holds other indications back
+ * (alarm_is_link_reserved()), so the link is idle when the alarm goes out.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _ALARM_H_
+#define _ALARM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fall_detect.h"
+#include "sampling.h"
+
+#define ALARM_GRACE_MS        (10000) // wearer can cancel within
+#define ALARM_RETRY_MS        (5000)  // resend until delivered
+#define ALARM_DISPATCH_MS     (50)    // timer expiry to the event loop
+
+// the detector decides at the end of stillness, at most this long after the
+// trigger sample, and sees the samples at most one full FIFO late
+#define ALARM_DETECT_MAX_MS   (FD_IMPACT_WINDOW_MS + FD_SETTLE_MS + FD_STILL_MS)
+#define ALARM_PIPELINE_MAX_MS (32 * SAMPLING_MONITOR_PERIOD_MS)
+#define ALARM_MAX_LATENCY_MS  (ALARM_DETECT_MAX_MS + ALARM_PIPELINE_MAX_MS + \
+                               ALARM_GRACE_MS + ALARM_DISPATCH_MS)
+
+// values of the fall status characteristic
+#define ALARM_VALUE_NONE      (0x00)
+#define ALARM_VALUE_FALL      (0x01)
+
+typedef enum
+{
+  ALARM_IDLE = 0,
+  ALARM_GRACE,
+  ALARM_CONFIRMED,
+  ALARM_ESCALATED,
+  ALARM_CANCELLED,
+  ALARM_NUM_STATES
+} alarm_state;
+
+typedef enum
+{
+  ALARM_IN_FALL,        // the detector confirmed a fall
+  ALARM_IN_DOUBLE_TAP,  // the wearer double tapped
+  ALARM_IN_TIMER,       // the one-shot timer expired
+  ALARM_IN_DELIVERED,   // the client confirmed the alarm indication
+  ALARM_IN_RESET,       // the client acknowledged the alarm
+  ALARM_IN_LINK_UP,     // a client subscribed to the alarm
+  ALARM_IN_LINK_DOWN    // no client is subscribed any more
+} alarm_input;
+
+// actions for the caller, or'ed together
+#define ALARM_ACT_NONE        (0x0)
+#define ALARM_ACT_START_TIMER (0x1) // (re)start the timer for timer_ms
+#define ALARM_ACT_STOP_TIMER  (0x2)
+#define ALARM_ACT_SEND        (0x4) // indicate ALARM_VALUE_FALL now
+
+typedef struct
+{
+  alarm_state state;
+  uint32_t capture_ms;     // trigger sample of the current fall
+  uint32_t detected_ms;    // verdict
+  uint32_t deadline_ms;    // end of the grace window
+  uint32_t sent_ms;        // first hand-off to the stack
+  uint32_t timer_ms;       // delay for ALARM_ACT_START_TIMER
+  uint32_t sends;          // hand-offs for the current fall
+  bool is_link_up;         // a client is subscribed
+  bool is_measured;        // latency_ms is final for the current fall
+  uint32_t down_ms;        // start of the current time without a client
+  uint32_t offline_ms;     // time without a client since the verdict
+  uint32_t latency_ms;     // capture to first hand-off with a client,
+                           // offline_ms excluded, last alarm
+  uint32_t max_latency_ms; // worst latency_ms seen
+  uint32_t late;           // alarms over ALARM_MAX_LATENCY_MS
+  uint32_t cancelled;
+  uint32_t escalated;
+} alarm_context;
+
+
+/* @brief  Resets the alarm to IDLE and clears the statistics
+ *
+ * @param  alarm_context*, alarm state
+ * @return None
+ */
+void alarm_init(alarm_context *a);
+
+
+/* @brief  Advances the state machine
+ *
+ * @param  alarm_context*, alarm state
+ * @param  alarm_input, the event
+ * @param  uint32_t, capture time of the event in msec
+ * @param  uint32_t, current time in msec
+ * @return ALARM_ACT_* bits for the caller to carry out
+ */
+uint32_t alarm_step(alarm_context *a, alarm_input in, uint32_t event_ms,
+                    uint32_t now_ms);
+
+
+/* @brief  Returns true while other indications must wait for the alarm
+ *
+ * @param  const alarm_context*, alarm state
+ * @return true in GRACE and CONFIRMED
+ */
+bool alarm_is_link_reserved(const alarm_context *a);
+
+
+/* @brief  Returns a printable state name
+ *
+ * @param  alarm_state, the state
+ * @return const char*, never NULL
+ */
+const char *alarm_state_name(alarm_state s);
+
+#endif // _ALARM_H_
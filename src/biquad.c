@@ -0,0 +1,85 @@
+/* -----------------------------------------------------------------------------
+ * @file   biquad.c
+ * @brief  Q15 biquad (second-order IIR) cascades over x/y/z sample blocks
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "biquad.h"
+
+#define Y_MAX ((int64_t)INT16_MAX << BIQUAD_GUARD_BITS)
+#define Y_MIN ((int64_t)INT16_MIN * (1 << BIQUAD_GUARD_BITS))
+
+static void stage_run(const biquad_coeffs *c, uint32_t shift, biquad_state *s,
+                      const int16_t *in, int16_t *out, uint32_t n)
+{
+  int32_t x1 = s->x1;
+  int32_t x2 = s->x2;
+  int32_t y1 = s->y1;
+  int32_t y2 = s->y2;
+  const int32_t round = 1 << (BIQUAD_GUARD_BITS - 1);
+  const int64_t half = (int64_t)1 << (shift - 1);
+
+  for (uint32_t i=0; i<n; i++)
+  {
+    int32_t x = in[i];
+    int64_t ff = (int64_t)c->b0 * x + (int64_t)c->b1 * x1
+               + (int64_t)c->b2 * x2;
+    int64_t acc = ff * (1 << BIQUAD_GUARD_BITS) + (int64_t)c->a1 * y1
+                + (int64_t)c->a2 * y2;
+    // rounded, a floor bias would be amplified by the DC gain of the poles
+    int64_t y = (acc + half) >> shift;
+    if (y > Y_MAX) y = Y_MAX;
+    if (y < Y_MIN) y = Y_MIN;
+
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = (int32_t)y;
+    int32_t o = (y1 + round) >> BIQUAD_GUARD_BITS;
+    out[i] = (int16_t)((o > INT16_MAX) ? INT16_MAX : o);
+  }
+
+  s->x1 = (int16_t)x1;
+  s->x2 = (int16_t)x2;
+  s->y1 = y1;
+  s->y2 = y2;
+}
+
+int biquad_init(biquad_bank *bank, const biquad_design *design)
+{
+  if (design->n_stages > BIQUAD_MAX_STAGES || design->post_shift > 14)
+  {
+    return -1;
+  }
+  memset(bank, 0x0, sizeof(*bank));
+  bank->design = design;
+  return 0;
+}
+
+void biquad_process_axis(const biquad_design *design, biquad_state *state,
+                         const int16_t *in, int16_t *out, uint32_t n)
+{
+  uint32_t shift = 15 - design->post_shift;
+  for (uint32_t k=0; k<design->n_stages; k++)
+  {
+    // later stages run in place on the output
+    stage_run(&design->stages[k], shift, &state[k], (k == 0) ? in : out,
+              out, n);
+  }
+  if (design->n_stages == 0 && in != out)
+  {
+    memcpy(out, in, n * sizeof(int16_t));
+  }
+}
+
+void biquad_process_block(biquad_bank *bank, const accel_block *in,
+                          accel_block *out)
+{
+  uint32_t n = (in->n < ACCEL_BLOCK_LEN) ? in->n : ACCEL_BLOCK_LEN;
+  biquad_process_axis(bank->design, bank->state[0], in->x, out->x, n);
+  biquad_process_axis(bank->design, bank->state[1], in->y, out->y, n);
+  biquad_process_axis(bank->design, bank->state[2], in->z, out->z, n);
+  out->timestamps = in->timestamps;
+  out->n = n;
+}
@@ -0,0 +1,94 @@
+/* -----------------------------------------------------------------------------
+ * @file   biquad.h
+ * @brief  Q15 biquad (second-order IIR) cascades over x/y/z sample blocks
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Direct form I with a 64-bit accumulator (SMLAL on the Cortex-M4). The
+ * recursive part keeps BIQUAD_GUARD_BITS below the output LSB, so low corner
+ * frequencies (poles close to the unit circle) do not amplify the output
+ * rounding. Each stage rounds and saturates its output to int16. Coefficients are designed offline by
+ * tools/biquad_design.py into const tables (src/filter_coeffs.c) in the
+ * CMSIS q15 convention: the real coefficient is q / 2^(15 - post_shift), so
+ * |a1| up to 2 fits with post_shift 1. a1 and a2 are stored negated so the
+ * inner loop only accumulates. A block is filtered one stage at a time over
+ * all its samples, per axis, keeping the stage state in registers across
+ * the whole ACCEL_BLOCK_LEN run.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _BIQUAD_H_
+#define _BIQUAD_H_
+
+#include <stdint.h>
+
+#include "accel_decode.h"
+
+#define BIQUAD_MAX_STAGES  (4)
+#define BIQUAD_GUARD_BITS  (8)
+
+typedef struct
+{
+  int16_t b0;
+  int16_t b1;
+  int16_t b2;
+  int16_t a1;   // negated
+  int16_t a2;   // negated
+} biquad_coeffs;
+
+typedef struct
+{
+  const biquad_coeffs *stages;
+  uint16_t n_stages;
+  uint16_t post_shift;
+} biquad_design;
+
+typedef struct
+{
+  int16_t x1;
+  int16_t x2;
+  int32_t y1;   // outputs with BIQUAD_GUARD_BITS fraction bits
+  int32_t y2;
+} biquad_state;
+
+typedef struct
+{
+  const biquad_design *design;
+  biquad_state state[3][BIQUAD_MAX_STAGES]; // per axis, per stage
+} biquad_bank;
+
+
+/* @brief  Binds a design to a bank and clears the filter state
+ *
+ * @param  biquad_bank*, the bank
+ * @param  const biquad_design*, the cascade applied to all three axes
+ * @return -1 if the design has more than BIQUAD_MAX_STAGES stages or an
+ *         invalid post shift, 0 upon success
+ */
+int biquad_init(biquad_bank *bank, const biquad_design *design);
+
+
+/* @brief  Filters one axis through the cascade
+ *
+ * @param  const biquad_design*, the cascade
+ * @param  biquad_state*, n_stages states of this axis
+ * @param  const int16_t*, input samples
+ * @param  int16_t*, output samples, may be the input
+ * @param  uint32_t, number of samples
+ * @return None
+ */
+void biquad_process_axis(const biquad_design *design, biquad_state *state,
+                         const int16_t *in, int16_t *out, uint32_t n);
+
+
+/* @brief  Filters the x, y and z arrays of a block
+ *
+ * Copies n and the timestamps, mag2 of the output is not computed.
+ *
+ * @param  biquad_bank*, the bank
+ * @param  const accel_block*, input block
+ * @param  accel_block*, output block, may be the input
+ * @return None
+ */
+void biquad_process_block(biquad_bank *bank, const accel_block *in,
+                          accel_block *out);
+
+#endif // _BIQUAD_H_
@@ -0,0 +1,223 @@
+/* -----------------------------------------------------------------------------
+ * @file   blackbox.c
+ * @brief  Pre/post-event capture of raw samples around a fall trigger
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "blackbox.h"
+
+#define PRE_MASK        (BLACKBOX_PRE_SAMPLES - 1)
+#define MAX_SAMPLE_LEN  (9) // 3 axes, 17-bit zigzag deltas take 3 bytes
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+  put_u16(p, (uint16_t)v);
+  put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+  return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static uint32_t encode_sample(blackbox *bb, const accel_sample *s, uint8_t *dst)
+{
+  const int16_t v[3] = { s->x, s->y, s->z };
+  uint32_t len = 0;
+  for (int a=0; a<3; a++)
+  {
+    int32_t d = (int32_t)v[a] - bb->prev[a];
+    uint32_t z = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+    while (z >= 0x80)
+    {
+      dst[len++] = (uint8_t)(z | 0x80);
+      z >>= 7;
+    }
+    dst[len++] = (uint8_t)z;
+    bb->prev[a] = v[a];
+  }
+  return len;
+}
+
+// appends samples to the snapshot, finishes it once full or at the end of
+// the post window
+static void append(blackbox *bb, const accel_sample *s, uint32_t n)
+{
+  for (uint32_t i=0; i<n && bb->state == BLACKBOX_CAPTURING; i++)
+  {
+    if (bb->len + MAX_SAMPLE_LEN > BLACKBOX_MAX_LEN)
+    {
+      bb->snap[1] |= BLACKBOX_FLAG_TRUNCATED;
+      bb->state = BLACKBOX_READY;
+      break;
+    }
+    bb->len += encode_sample(bb, &s[i], &bb->snap[bb->len]);
+    bb->n_samples++;
+  }
+  put_u16(&bb->snap[2], bb->n_samples);
+}
+
+void blackbox_init(blackbox *bb)
+{
+  bb->pushed = 0;
+  bb->last_ms = 0;
+  bb->period_ms = 0;
+  bb->state = BLACKBOX_EMPTY;
+  bb->post_left = 0;
+  bb->n_samples = 0;
+  bb->len = 0;
+}
+
+void blackbox_push(blackbox *bb, const accel_sample *s, uint32_t n,
+                   uint32_t last_ms, uint32_t period_ms)
+{
+  if (n == 0) return;
+
+  if (bb->pushed > 0 && period_ms != bb->period_ms)
+  {
+    // one period per snapshot: a rate switch ends the post window early and
+    // restarts the pre-trigger history
+    if (bb->state == BLACKBOX_CAPTURING)
+    {
+      bb->snap[1] |= BLACKBOX_FLAG_RATE_SWITCH;
+      bb->state = BLACKBOX_READY;
+    }
+    bb->pushed = 0;
+  }
+
+  if (bb->state == BLACKBOX_CAPTURING)
+  {
+    uint32_t take = (n < bb->post_left) ? n : bb->post_left;
+    append(bb, s, take);
+    bb->post_left -= take;
+    if (bb->post_left == 0) bb->state = BLACKBOX_READY;
+  }
+
+  // steady state: one bulk copy, two at the wrap
+  if (n > BLACKBOX_PRE_SAMPLES)
+  {
+    s += n - BLACKBOX_PRE_SAMPLES;
+    bb->pushed += n - BLACKBOX_PRE_SAMPLES;
+    n = BLACKBOX_PRE_SAMPLES;
+  }
+  uint32_t pos = bb->pushed & PRE_MASK;
+  uint32_t first = BLACKBOX_PRE_SAMPLES - pos;
+  if (first > n) first = n;
+  memcpy(&bb->pre[pos], s, first * sizeof(accel_sample));
+  memcpy(&bb->pre[0], &s[first], (n - first) * sizeof(accel_sample));
+  bb->pushed += n;
+  bb->last_ms = last_ms;
+  bb->period_ms = period_ms;
+}
+
+void blackbox_freeze(blackbox *bb, uint32_t trigger_ms, uint16_t lsb_per_g)
+{
+  if (bb->state == BLACKBOX_CAPTURING) return;
+
+  // the ring may already hold samples from the trigger on, when it was
+  // pushed with the block the trigger was found in. Those open the post
+  // window, so n_pre only counts samples taken before the trigger
+  uint32_t n_avail = (bb->pushed < BLACKBOX_PRE_SAMPLES) ? bb->pushed
+                                                         : BLACKBOX_PRE_SAMPLES;
+  uint32_t n_after = 0;
+  if (n_avail > 0 && (int32_t)(bb->last_ms - trigger_ms) >= 0)
+  {
+    n_after = (bb->last_ms - trigger_ms) / bb->period_ms + 1;
+    if (n_after > n_avail) n_after = n_avail;
+  }
+  uint32_t n_pre = n_avail - n_after;
+  if (n_after > BLACKBOX_POST_SAMPLES) n_after = BLACKBOX_POST_SAMPLES;
+  uint32_t first_ms = trigger_ms;
+  if (n_avail > 0) first_ms = bb->last_ms - (n_avail - 1) * bb->period_ms;
+
+  uint8_t *h = bb->snap;
+  h[0] = BLACKBOX_VERSION;
+  h[1] = 0;
+  put_u16(&h[2], 0);
+  put_u16(&h[4], (uint16_t)n_pre);
+  put_u16(&h[6], (uint16_t)bb->period_ms);
+  put_u32(&h[8], first_ms);
+  put_u32(&h[12], trigger_ms);
+  put_u16(&h[16], lsb_per_g);
+  bb->len = BLACKBOX_HEADER_LEN;
+  bb->n_samples = 0;
+  bb->prev[0] = bb->prev[1] = bb->prev[2] = 0;
+  bb->state = BLACKBOX_CAPTURING;
+  bb->post_left = BLACKBOX_POST_SAMPLES - n_after;
+
+  // oldest first, in at most two runs around the wrap
+  uint32_t n = n_pre + n_after;
+  uint32_t start = (bb->pushed - n_avail) & PRE_MASK;
+  uint32_t run = BLACKBOX_PRE_SAMPLES - start;
+  if (run > n) run = n;
+  append(bb, &bb->pre[start], run);
+  append(bb, &bb->pre[0], n - run);
+  if (bb->post_left == 0) bb->state = BLACKBOX_READY;
+}
+
+void blackbox_set_flags(blackbox *bb, uint8_t flags)
+{
+  if (bb->state == BLACKBOX_EMPTY) return;
+  bb->snap[1] |= flags;
+}
+
+uint32_t blackbox_data(const blackbox *bb, const uint8_t **data)
+{
+  if (bb->state != BLACKBOX_READY) return 0;
+  *data = bb->snap;
+  return bb->len;
+}
+
+int blackbox_decode(const uint8_t *snap, uint32_t len, blackbox_header *hdr,
+                    accel_sample *out, uint32_t max_samples)
+{
+  if (len < BLACKBOX_HEADER_LEN || snap[0] != BLACKBOX_VERSION) return -1;
+  hdr->version = snap[0];
+  hdr->flags = snap[1];
+  hdr->n_samples = get_u16(&snap[2]);
+  hdr->n_pre = get_u16(&snap[4]);
+  hdr->period_ms = get_u16(&snap[6]);
+  hdr->first_ms = get_u32(&snap[8]);
+  hdr->trigger_ms = get_u32(&snap[12]);
+  hdr->lsb_per_g = get_u16(&snap[16]);
+
+  int32_t prev[3] = { 0, 0, 0 };
+  uint32_t p = BLACKBOX_HEADER_LEN;
+  uint32_t n = 0;
+  for (; n<hdr->n_samples && n<max_samples; n++)
+  {
+    int16_t v[3];
+    for (int a=0; a<3; a++)
+    {
+      uint32_t z = 0;
+      uint32_t shift = 0;
+      uint8_t b;
+      do
+      {
+        if (p >= len || shift > 28) return -1;
+        b = snap[p++];
+        z |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+      } while (b & 0x80);
+      int32_t d = (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+      prev[a] += d;
+      v[a] = (int16_t)prev[a];
+    }
+    out[n].x = v[0];
+    out[n].y = v[1];
+    out[n].z = v[2];
+  }
+  return (int)n;
+}
@@ -0,0 +1,152 @@
+/* -----------------------------------------------------------------------------
+ * @file   blackbox.h
+ * @brief  Pre/post-event capture of raw samples around a fall trigger
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * The last BLACKBOX_PRE_SAMPLES raw samples are kept in a ring with one bulk
+ * copy per processed span and no other steady state work. A trigger freezes
+ * the ring into a compact snapshot and the next BLACKBOX_POST_SAMPLES are
+ * appended to it, after which it is ready for offload.
+ *
+ * Snapshot layout, little endian:
+ *   0  uint8   BLACKBOX_VERSION
+ *   1  uint8   flags, BLACKBOX_FLAG_*
+ *   2  uint16  samples encoded
+ *   4  uint16  samples before the trigger
+ *   6  uint16  sample period, msec
+ *   8  uint32  time of the first sample, msec
+ *   12 uint32  time of the trigger, msec
+ *   16 uint16  LSB per g
+ *   18 samples, per axis x, y, z: zigzag varint of the difference to the
+ *      previous sample (the first to 0)
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _BLACKBOX_H_
+#define _BLACKBOX_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "accel_sample.h"
+#include "detector_config.h"
+
+#define BLACKBOX_PRE_SAMPLES  (256)  // ~2.5 sec at 100 Hz, power of two
+#define BLACKBOX_POST_SAMPLES DET_MS_TO_SAMPLES(2000)
+#define BLACKBOX_MAX_LEN      (2048) // snapshot bytes, ~3 bytes/sample typical
+#define BLACKBOX_HEADER_LEN   (18)
+#define BLACKBOX_VERSION      (1)
+
+#define BLACKBOX_FLAG_CONFIRMED (0x01) // the fall was confirmed
+#define BLACKBOX_FLAG_REJECTED  (0x02) // the trigger was rejected
+#define BLACKBOX_FLAG_TRUNCATED (0x04) // BLACKBOX_MAX_LEN reached
+#define BLACKBOX_FLAG_RATE_SWITCH (0x08) // post window cut by a rate switch
+
+#if (BLACKBOX_PRE_SAMPLES & (BLACKBOX_PRE_SAMPLES - 1)) != 0
+#error "BLACKBOX_PRE_SAMPLES must be a power of two"
+#endif
+
+typedef enum
+{
+  BLACKBOX_EMPTY = 0,
+  BLACKBOX_CAPTURING,
+  BLACKBOX_READY
+} blackbox_state;
+
+typedef struct
+{
+  uint8_t version;
+  uint8_t flags;
+  uint16_t n_samples;
+  uint16_t n_pre;
+  uint16_t period_ms;
+  uint32_t first_ms;
+  uint32_t trigger_ms;
+  uint16_t lsb_per_g;
+} blackbox_header;
+
+typedef struct
+{
+  accel_sample pre[BLACKBOX_PRE_SAMPLES];
+  uint32_t pushed;         // samples pushed since init
+  uint32_t last_ms;        // time of the newest sample
+  uint32_t period_ms;
+  blackbox_state state;
+  uint32_t post_left;
+  int16_t prev[3];         // encoder state
+  uint16_t n_samples;
+  uint32_t len;
+  uint8_t snap[BLACKBOX_MAX_LEN];
+} blackbox;
+
+
+/* @brief  Empties the ring and drops any snapshot
+ *
+ * @param  blackbox*, the recorder
+ * @return None
+ */
+void blackbox_init(blackbox *bb);
+
+
+/* @brief  Records a span of raw samples
+ *
+ * A span at a different period than the previous one restarts the
+ * pre-trigger history and finishes a capture in progress, so a snapshot
+ * never mixes rates.
+ *
+ * @param  blackbox*, the recorder
+ * @param  const accel_sample*, samples
+ * @param  uint32_t, number of samples
+ * @param  uint32_t, time of the newest sample in msec
+ * @param  uint32_t, sample period in msec
+ * @return None
+ */
+void blackbox_push(blackbox *bb, const accel_sample *s, uint32_t n,
+                   uint32_t last_ms, uint32_t period_ms);
+
+
+/* @brief  Freezes the ring into a new snapshot and starts the post window
+ *
+ * Replaces an older snapshot, ignored while a capture is in progress.
+ * Samples already pushed from the trigger time on are the start of the post
+ * window, so the freeze may follow the push of the triggering block.
+ *
+ * @param  blackbox*, the recorder
+ * @param  uint32_t, time of the trigger in msec
+ * @param  uint16_t, LSB per g of the samples
+ * @return None
+ */
+void blackbox_freeze(blackbox *bb, uint32_t trigger_ms, uint16_t lsb_per_g);
+
+
+/* @brief  Labels the snapshot with the detector's verdict
+ *
+ * @param  blackbox*, the recorder
+ * @param  uint8_t, BLACKBOX_FLAG_CONFIRMED or BLACKBOX_FLAG_REJECTED
+ * @return None
+ */
+void blackbox_set_flags(blackbox *bb, uint8_t flags);
+
+
+/* @brief  Returns the finished snapshot
+ *
+ * @param  const blackbox*, the recorder
+ * @param  const uint8_t**, set to the snapshot bytes
+ * @return uint32_t, snapshot length, 0 unless BLACKBOX_READY
+ */
+uint32_t blackbox_data(const blackbox *bb, const uint8_t **data);
+
+
+/* @brief  Decodes a snapshot
+ *
+ * @param  const uint8_t*, snapshot bytes
+ * @param  uint32_t, snapshot length
+ * @param  blackbox_header*, decoded header
+ * @param  accel_sample*, decoded samples
+ * @param  uint32_t, room in the sample buffer
+ * @return -1 on a malformed snapshot, else the number of samples decoded
+ */
+int blackbox_decode(const uint8_t *snap, uint32_t len, blackbox_header *hdr,
+                    accel_sample *out, uint32_t max_samples);
+
+#endif // _BLACKBOX_H_
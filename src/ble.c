@@ -11,43 +11,106 @@ typedef struct {
   uint8_t conn_handle;
   bool is_connected;
   bool is_indication_inflight;
+  unsigned int inflight_characteristic;
+  bool is_stream_enabled;
+  bool is_raw_enabled;
+  uint8_t phy;               // 1M or 2M
+  uint16_t txsize;           // data channel PDU payload, from DLE
+  uint16_t interval;         // 1.25 msec units
+  uint32_t raw_tick_ms;
+  uint16_t mtu;
+  uint16_t blackbox_offset; // snapshot offset selected by the client
 } ble_context;
 
-enum characteristic_type {
-  CHR_FREEFALL = 0x01,
-  CHR_ACTIVITY = 0x02,
-  CHR_DOUBLETAP = 0x03
-};
-
 typedef struct {
   uint8_t buf[2];
   unsigned int characteristic;
   bool is_indication_enabled;
-  bool is_indication_pending;
-  enum characteristic_type type;
+  evq_type type;             // queue type, also the priority
 } characteristic_context;
 
 static ble_context ble_ctx;
 static characteristic_context freefall_ctx;
 static characteristic_context activity_ctx;
 static characteristic_context doubletap_ctx;
+static characteristic_context *const contexts[EVQ_NUM_TYPES] = {
+  [EVQ_TAP] = &doubletap_ctx,
+  [EVQ_ACTIVITY] = &activity_ctx,
+  [EVQ_FALL] = &freefall_ctx
+};
+static event_queue indication_queue;
+static event_stream stream;
+static sl_sleeptimer_timer_handle_t stream_timer;
+static raw_stream raw;
+static conn_policy policy;
+static accel_sample *drain_buf;
+static uint32_t drain_start_ms;
 
 static uint8_t advertising_set_handle = 0xff;
+static sampling_context sampling_ctx;
+static thresh_tuner tuner;
+static activity_context activity_agg;
+static alarm_context alarm;
+static sl_sleeptimer_timer_handle_t alarm_timer;
+static fall_beacon beacon;
+static sl_sleeptimer_timer_handle_t beacon_timer;
+
+static void read_blackbox(uint8_t connection, uint16_t offset)
+{
+  const uint8_t *data = NULL;
+  uint32_t len = pipeline_blackbox_data(&data);
+  uint32_t start = (uint32_t)ble_ctx.blackbox_offset + offset;
+  uint32_t n = 0;
+
+  // one page is at most 512 bytes (ATT limit), one response at most MTU-1
+  if (offset < 512 && start < len)
+  {
+    n = len - start;
+    if (n > 512u - offset) n = 512u - offset;
+    if (n > (uint32_t)ble_ctx.mtu - 1) n = ble_ctx.mtu - 1;
+  }
+
+  uint16_t sent;
+  sl_status_t sc = sl_bt_gatt_server_send_user_read_response(
+      connection, gattdb_blackbox_data, 0, n, (n > 0) ? &data[start] : NULL,
+      &sent);
+  if (sc != SL_STATUS_OK)
+  {
+    LOG("Error sl_bt_gatt_server_send_user_read_response, sc=0x%x", sc);
+  }
+}
 
 static void send_pending_indication();
 static void write_and_send_indication(characteristic_context* ctx);
+static void update_stream(uint32_t now);
+static void send_raw_packets();
+static void update_conn_policy(conn_input in);
+static void update_sampling(sampling_input in);
+static void init_thresholds();
+static void update_thresholds();
+static void update_activity();
+static void run_alarm(alarm_input in, uint32_t event_ms);
+static void update_alarm_link();
+static void apply_beacon();
+static uint8_t load_beacon_seq();
+static void read_blackbox(uint8_t connection, uint16_t offset);
 
 static void init_characteristics()
 {
   memset(freefall_ctx.buf, 0x0, 2);
   freefall_ctx.characteristic = gattdb_fall_status;
   freefall_ctx.is_indication_enabled = false;
-  freefall_ctx.type = CHR_FREEFALL;
+  freefall_ctx.type = EVQ_FALL;
 
   memset(activity_ctx.buf, 0x0, 2);
   activity_ctx.characteristic = gattdb_activity_status;
   activity_ctx.is_indication_enabled = false;
-  activity_ctx.type = CHR_ACTIVITY;
+  activity_ctx.type = EVQ_ACTIVITY;
+
+  memset(doubletap_ctx.buf, 0x0, 2);
+  doubletap_ctx.characteristic = gattdb_doubletap_status;
+  doubletap_ctx.is_indication_enabled = false;
+  doubletap_ctx.type = EVQ_TAP;
 }
 
 void handle_ble_event(sl_bt_msg_t *evt)
@@ -65,7 +128,16 @@ void handle_ble_event(sl_bt_msg_t *evt)
   
       ble_ctx.is_connected = false;
       ble_ctx.is_indication_inflight = false;
+      ble_ctx.is_stream_enabled = false;
+      ble_ctx.is_raw_enabled = false;
       init_characteristics();
+      evq_init(&indication_queue);
+      evs_init(&stream, 0);
+      sampling_init(&sampling_ctx, letimer0_get_uptime_msec());
+      init_thresholds();
+      activity_init(&activity_agg, 0, letimer0_get_uptime_msec());
+      alarm_init(&alarm);
+      fall_beacon_init(&beacon, load_beacon_seq());
 
       sc = sl_bt_system_get_identity_address(&(ble_ctx.local_addr), &addr_type);
       if (sc != SL_STATUS_OK)
@@ -73,6 +145,15 @@ void handle_ble_event(sl_bt_msg_t *evt)
         LOG("Error sl_bt_system_get_identity_address");
       }
 
+      // full notifications for the raw stream, the client is asked for the
+      // MTU exchange on connect
+      uint16_t max_mtu;
+      sc = sl_bt_gatt_server_set_max_mtu(RAW_PACKET_LEN + 3, &max_mtu);
+      if (sc != SL_STATUS_OK)
+      {
+        LOG("Error sl_bt_gatt_server_set_max_mtu, sc=0x%x", sc);
+      }
+
       sc = sl_bt_gatt_server_write_attribute_value(gattdb_system_id,
                                                    0,
                                                    sizeof(system_id),
@@ -89,28 +170,8 @@ void handle_ble_event(sl_bt_msg_t *evt)
         LOG("Error sl_advertiser_create_set");
       }
 
-      // Set advertising interval to 100ms.
-      sc = sl_bt_advertiser_set_timing(
-          advertising_set_handle,
-          160, // min. adv. interval (milliseconds * 1.6)
-          160, // max. adv. interval (milliseconds * 1.6)
-          0,   // adv. duration
-          0);  // max. num. adv. events
-      if (sc != SL_STATUS_OK)
-      {
-        LOG("Error sl_advertiser_set_timing");
-      }
-
-      // Start general advertising and enable connections.
-      sc = sl_bt_advertiser_start(
-                                  advertising_set_handle,
-                                  sl_bt_advertiser_general_discoverable,
-                                  sl_bt_advertiser_connectable_scannable
-                                  );
-      if (sc != SL_STATUS_OK)
-      {
-        LOG("Error sl_bt_advertiser_start");
-      }
+      // Start general advertising at 100ms and enable connections.
+      apply_beacon();
 
       break;
     }
@@ -120,29 +181,58 @@ void handle_ble_event(sl_bt_msg_t *evt)
       LOG("Connection opened");
       ble_ctx.conn_handle = evt->data.evt_connection_opened.connection;
       ble_ctx.is_connected = true;
-      sc = sl_bt_advertiser_stop(advertising_set_handle);
-      if (sc != SL_STATUS_OK)
-      {
-        LOG("Error sl_bt_advertiser_stop, sc=0x%x", sc);
-      }
+      ble_ctx.mtu = 23;
+      ble_ctx.blackbox_offset = 0;
+      ble_ctx.is_stream_enabled = false;
+      ble_ctx.is_raw_enabled = false;
+      ble_ctx.phy = 1;
+      ble_ctx.txsize = 27;
+      ble_ctx.interval = 36;
+      evs_init(&stream, 0);
+      // stops advertising, unless a fall alert is being broadcast
+      apply_beacon();
 
-      sc = sl_bt_connection_set_parameters(
-                         ble_ctx.conn_handle,
-                         36,      // min interval, time = val*1.25 ms
-                         510,     // max interval, time = val*1.25 ms
-                         2,       // latency
-                         600,     // timeout - must be larger than (1+latency)*2*max_interval
-                         0x0,
-                         0xff
-                         );
+      // the idle profile is requested once the initial parameters are
+      // reported, see conn_policy.h
+      update_conn_policy(CONN_IN_OPENED);
 
+      // 2M roughly halves the airtime of the raw stream. Data length
+      // extension needs no request, the stack negotiates the longest PDUs
+      // both sides support and reports them in sl_bt_evt_connection_parameters
+      sc = sl_bt_connection_set_preferred_phy(ble_ctx.conn_handle,
+                                              0x02,   // prefer 2M
+                                              0xff);  // accept any
       if (sc != SL_STATUS_OK)
       {
-        LOG("Error sl_bt_connection_set_parameters, sc=0x%x", sc);
+        LOG("Error sl_bt_connection_set_preferred_phy, sc=0x%x", sc);
       }
       break;
     }
 
+    case sl_bt_evt_connection_parameters_id:
+    {
+      ble_ctx.interval = evt->data.evt_connection_parameters.interval;
+      ble_ctx.txsize = evt->data.evt_connection_parameters.txsize;
+      raw_set_link(&raw, ble_ctx.phy, ble_ctx.txsize, ble_ctx.interval);
+      conn_policy_negotiated(&policy, ble_ctx.interval,
+                             evt->data.evt_connection_parameters.latency,
+                             evt->data.evt_connection_parameters.timeout,
+                             letimer0_get_uptime_msec());
+      update_conn_policy(CONN_IN_TICK);
+      LOG("Connection interval %u, latency %u, txsize %u",
+          ble_ctx.interval, evt->data.evt_connection_parameters.latency,
+          ble_ctx.txsize);
+      break;
+    }
+
+    case sl_bt_evt_connection_phy_status_id:
+    {
+      ble_ctx.phy = evt->data.evt_connection_phy_status.phy;
+      raw_set_link(&raw, ble_ctx.phy, ble_ctx.txsize, ble_ctx.interval);
+      LOG("PHY %u", ble_ctx.phy);
+      break;
+    }
+
     case sl_bt_evt_connection_closed_id:
     {
       LOG("Connection closed");
@@ -151,19 +241,24 @@ void handle_ble_event(sl_bt_msg_t *evt)
       freefall_ctx.is_indication_enabled = false;
       activity_ctx.is_indication_enabled = false;
       doubletap_ctx.is_indication_enabled = false;
-      freefall_ctx.is_indication_pending = false;
-      activity_ctx.is_indication_pending = false;
-      doubletap_ctx.is_indication_pending = false;
+      ble_ctx.is_stream_enabled = false;
+      ble_ctx.is_raw_enabled = false;
+      sl_sleeptimer_stop_timer(&stream_timer);
+      update_alarm_link();
+      LOG("Indication queue: high water %lu, %lu overflows",
+          (unsigned long)indication_queue.high_water,
+          (unsigned long)indication_queue.overflows);
+      LOG("Event stream: %lu records in %lu batches, %lu dropped",
+          (unsigned long)stream.records, (unsigned long)stream.batches,
+          (unsigned long)stream.dropped);
+      LOG("Connection policy: %lu requests, %lu accepted, %lu rejected, "
+          "%lu lapsed, %lu rate limited", (unsigned long)policy.requests,
+          (unsigned long)policy.accepted, (unsigned long)policy.rejected,
+          (unsigned long)policy.lapsed, (unsigned long)policy.rate_limited);
+      evq_clear(&indication_queue);
 
       // Restart advertising after client has disconnected.
-      sc = sl_bt_advertiser_start(
-                                  advertising_set_handle,
-                                  sl_bt_advertiser_general_discoverable,
-                                  sl_bt_advertiser_connectable_scannable);
-      if (sc != SL_STATUS_OK)
-      {
-        LOG("Error sl_bt_advertiser_start");
-      }
+      apply_beacon();
       break;
     }
 
@@ -189,6 +284,27 @@ void handle_ble_event(sl_bt_msg_t *evt)
             case gattdb_doubletap_status:
               doubletap_ctx.is_indication_enabled = true;
               break;
+            case gattdb_event_stream:
+              ble_ctx.is_stream_enabled = true;
+              break;
+          }
+        }
+        if (evt->data.evt_gatt_server_characteristic_status.client_config_flags
+            == gatt_notification &&
+            evt->data.evt_gatt_server_characteristic_status.characteristic
+            == gattdb_raw_stream)
+        {
+          // notifications turned on, the capture profile is held meanwhile
+          raw_init(&raw, 0);
+          raw_set_link(&raw, ble_ctx.phy, ble_ctx.txsize, ble_ctx.interval);
+          ble_ctx.raw_tick_ms = letimer0_get_uptime_msec();
+          ble_ctx.is_raw_enabled = true;
+          update_sampling(SAMPLING_IN_ACTIVITY);
+          update_conn_policy(CONN_IN_BULK);
+          if (ble_ctx.mtu < RAW_PACKET_LEN + 3)
+          {
+            LOG("Raw stream waits for ATT_MTU %u, now %u", RAW_PACKET_LEN + 3,
+                ble_ctx.mtu);
           }
         }
         if (evt->data.evt_gatt_server_characteristic_status.client_config_flags 
@@ -199,33 +315,130 @@ void handle_ble_event(sl_bt_msg_t *evt)
           {
             case gattdb_fall_status:
               freefall_ctx.is_indication_enabled = false;
-              freefall_ctx.is_indication_pending = false;
+              evq_remove_type(&indication_queue, freefall_ctx.type);
               break;
             case gattdb_activity_status:
               activity_ctx.is_indication_enabled = false;
-              activity_ctx.is_indication_pending = false;
+              evq_remove_type(&indication_queue, activity_ctx.type);
               break;
             case gattdb_doubletap_status:
               doubletap_ctx.is_indication_enabled = false;
-              doubletap_ctx.is_indication_pending = false;
+              evq_remove_type(&indication_queue, doubletap_ctx.type);
+              break;
+            case gattdb_event_stream:
+              ble_ctx.is_stream_enabled = false;
+              sl_sleeptimer_stop_timer(&stream_timer);
+              evs_init(&stream, 0);
+              evs_set_mtu(&stream, ble_ctx.mtu);
+              break;
+            case gattdb_raw_stream:
+              ble_ctx.is_raw_enabled = false;
+              LOG("Raw stream: %lu samples in %lu packets, %lu dropped, "
+                  "%lu refused", (unsigned long)raw.samples,
+                  (unsigned long)raw.packets, (unsigned long)raw.dropped,
+                  (unsigned long)raw.refused);
               break;
           }
         }
+        update_alarm_link();
       }
       else if (evt->data.evt_gatt_server_characteristic_status.status_flags 
           == sl_bt_gatt_server_confirmation)
       {
         // indication has been received
+        uint32_t now = letimer0_get_uptime_msec();
         ble_ctx.is_indication_inflight = false;
+        switch (evt->data.evt_gatt_server_characteristic_status.characteristic)
+        {
+          case gattdb_fall_status:
+            run_alarm(ALARM_IN_DELIVERED, now);
+            break;
+          case gattdb_event_stream:
+          {
+            bool had_fall = stream.is_ready &&
+                            (stream.ready.types & (1u << EVQ_FALL));
+            evs_consume(&stream, now);
+            if (had_fall) run_alarm(ALARM_IN_DELIVERED, now);
+            update_stream(now);
+            break;
+          }
+        }
         send_pending_indication();
       }
       break;
     }
 
+    case sl_bt_evt_gatt_mtu_exchanged_id:
+    {
+      ble_ctx.mtu = evt->data.evt_gatt_mtu_exchanged.mtu;
+      evs_set_mtu(&stream, ble_ctx.mtu);
+      break;
+    }
+
+    case sl_bt_evt_gatt_server_attribute_value_id:
+    {
+      // the client acknowledges the alarm by writing 0 to the fall status
+      uint8array *v = &evt->data.evt_gatt_server_attribute_value.value;
+      if (evt->data.evt_gatt_server_attribute_value.attribute
+          == gattdb_fall_status && v->len == 1 && v->data[0] == ALARM_VALUE_NONE)
+      {
+        run_alarm(ALARM_IN_RESET, letimer0_get_uptime_msec());
+      }
+      break;
+    }
+
+    case sl_bt_evt_gatt_server_user_read_request_id:
+    {
+      if (evt->data.evt_gatt_server_user_read_request.characteristic
+          == gattdb_blackbox_data)
+      {
+        update_conn_policy(CONN_IN_BULK);
+        read_blackbox(evt->data.evt_gatt_server_user_read_request.connection,
+                      evt->data.evt_gatt_server_user_read_request.offset);
+      }
+      break;
+    }
+
+    case sl_bt_evt_gatt_server_user_write_request_id:
+    {
+      // selects where the next reads of the snapshot start, the attribute
+      // value is capped at 512 bytes so larger snapshots are read in pages
+      if (evt->data.evt_gatt_server_user_write_request.characteristic
+          == gattdb_blackbox_data)
+      {
+        uint8array *v = &evt->data.evt_gatt_server_user_write_request.value;
+        uint8_t att_err = 0;
+        if (v->len == 2)
+        {
+          ble_ctx.blackbox_offset = (uint16_t)(v->data[0] | (v->data[1] << 8));
+        }
+        else
+        {
+          att_err = 0x0d; // invalid attribute value length
+        }
+        sc = sl_bt_gatt_server_send_user_write_response(
+            evt->data.evt_gatt_server_user_write_request.connection,
+            gattdb_blackbox_data,
+            att_err);
+        if (sc != SL_STATUS_OK)
+        {
+          LOG("Error sl_bt_gatt_server_send_user_write_response, sc=0x%x", sc);
+        }
+      }
+      break;
+    }
+
     case sl_bt_evt_gatt_server_indication_timeout_id:
     {
       //LOG("Indication timeout");
       ble_ctx.is_indication_inflight = false;
+      if (ble_ctx.inflight_characteristic == gattdb_event_stream)
+      {
+        // the batch is given up, the next one may still get through
+        uint32_t now = letimer0_get_uptime_msec();
+        evs_consume(&stream, now);
+        update_stream(now);
+      }
       send_pending_indication();
       break;
     }
@@ -234,41 +447,128 @@ void handle_ble_event(sl_bt_msg_t *evt)
     {
       LOG("External signal");
       uint32_t signals = evt->data.evt_system_external_signal.extsignals;
+      if (signals & evt_accel_GPIO_INT2)
+      {
+        // fast path: INT2 only carries watermark/overrun/data ready, all of
+        // which clear by reading the data, so drain without reading
+        // INT_SOURCE (that would also clear the INT1 events). The transfers
+        // complete in the background via evt_spi_xfer_done and land directly
+        // in the sample ring
+        uint32_t span = pipeline_drain_span(&drain_buf);
+        if (span > ACCEL_FIFO_DEPTH) span = ACCEL_FIFO_DEPTH;
+        if (span > 0)
+        {
+          // FIFO_STATUS is read right away, the newest entry it counts is
+          // stamped with this time
+          drain_start_ms = letimer0_get_uptime_msec();
+          if (accel_fifo_drain_async(drain_buf, span) != 0 &&
+              !accel_fifo_is_draining())
+          {
+            // the transport refused the transfer, retry on the next pass. A
+            // drain already running re-checks INT2 when it finishes
+            LOG("Error: accel_fifo_drain_async() failed");
+            sl_bt_external_signal(evt_accel_GPIO_INT2);
+          }
+        }
+        else
+        {
+          // ring full, retry once the main loop has consumed some samples
+          sl_bt_external_signal(evt_accel_GPIO_INT2);
+        }
+      }
       if (signals & evt_accel_GPIO_INT1)
       {
-        uint8_t source = 0;
-        accel_determine_interrupt_source(&source);
+        // slow path: classify the semantic events, dated by the INT1 edge.
+        // Handled ahead of evt_alarm_timer so a tap that raced the grace
+        // deadline is seen first
+        accel_int_snapshot snap;
+        accel_snapshot(&snap);
+        uint8_t source = snap.int_source;
+        if (snap.is_asleep)
+        {
+          LOG("Error: sensor asleep, sample times assume the BW_RATE period");
+        }
         if (source & INT_FREE_FALL)
         {
+          // only a trigger, the pipeline confirms with impact, stillness
+          // and orientation and signals evt_fall_confirmed
           LOG("Freefall detected");
-          // set flags as index 0, value as index 1
-          freefall_ctx.buf[0] = 0x0; // setup the flags
-          freefall_ctx.buf[1] = 0x1;
-          write_and_send_indication(&freefall_ctx);
+          pipeline_fall_trigger(snap.int_ms);
+          // the detector only runs on capture rate samples
+          update_sampling(SAMPLING_IN_ACTIVITY);
+          update_conn_policy(CONN_IN_FALL_CANDIDATE);
         }
         if (source & INT_ACTIVITY)
         {
           LOG("Activity detected");
-          // set flags as index 0, value as index 1
-          activity_ctx.buf[0] = 0x0; // setup the flags
-          activity_ctx.buf[1] = 0x1;
-          write_and_send_indication(&activity_ctx);
+          activity_edge(&activity_agg, true, snap.int_ms);
+          update_sampling(SAMPLING_IN_ACTIVITY);
+          thresh_tuner_on_interrupt(&tuner);
+          pipeline_set_still(false);
         }
         if (source & INT_INACTIVITY)
         {
           LOG("Inactivity detected");
-          // set flags as index 0, value as index 1
-          activity_ctx.buf[0] = 0x0; // setup the flags
-          activity_ctx.buf[1] = 0x0;
-          write_and_send_indication(&activity_ctx);
+          activity_edge(&activity_agg, false, snap.int_ms);
+          update_sampling(SAMPLING_IN_INACTIVITY);
+          thresh_tuner_on_interrupt(&tuner);
+          pipeline_set_still(true);
         }
         if (source & INT_DOUBLE_TAP)
         {
-          LOG("Doubletap detected");
+          LOG("Doubletap detected, axes 0x%x", snap.tap_axes);
           // set flags as index 0, value as index 1
           doubletap_ctx.buf[0] = 0x0; // setup the flags
           doubletap_ctx.buf[1] = 0x1;
           write_and_send_indication(&doubletap_ctx);
+          run_alarm(ALARM_IN_DOUBLE_TAP, snap.int_ms);
+        }
+      }
+      if (signals & evt_fall_confirmed)
+      {
+        LOG("Fall confirmed");
+        run_alarm(ALARM_IN_FALL, pipeline_last_fall()->trigger_ms);
+      }
+      if (signals & evt_alarm_timer)
+      {
+        run_alarm(ALARM_IN_TIMER, letimer0_get_uptime_msec());
+      }
+      if (signals & evt_beacon_timer)
+      {
+        if (fall_beacon_step(&beacon, letimer0_get_uptime_msec()))
+        {
+          apply_beacon();
+        }
+      }
+      if (signals & evt_stream_deadline)
+      {
+        update_stream(letimer0_get_uptime_msec());
+      }
+      if (signals & evt_spi_xfer_done)
+      {
+        int n = 0;
+        if (accel_fifo_drain_step(&n))
+        {
+          if (ble_ctx.is_raw_enabled && n > 0)
+          {
+            // copied before the commit hands the span to the main loop
+            raw_push(&raw, drain_buf, (uint32_t)n);
+            send_raw_packets();
+          }
+          pipeline_commit(n, drain_start_ms);
+          update_sampling(SAMPLING_IN_NONE);
+          update_thresholds();
+          update_activity();
+          // an alarm in progress or a running stream keeps the fast profile
+          update_conn_policy(alarm_is_link_reserved(&alarm)
+                             ? CONN_IN_FALL_CANDIDATE
+                             : ble_ctx.is_raw_enabled ? CONN_IN_BULK
+                                                      : CONN_IN_TICK);
+          if (accel_is_int2_asserted())
+          {
+            // still above the watermark (partial drain), no new edge will come
+            sl_bt_external_signal(evt_accel_GPIO_INT2);
+          }
         }
       }
       break; 
@@ -281,65 +581,460 @@ void handle_ble_event(sl_bt_msg_t *evt)
 
 } // handle_ble_event();
 
-static void send_pending_indication()
+static void update_sampling(sampling_input in)
 {
-  if (freefall_ctx.is_indication_pending == true)
+  // the raw stream is for datasets at the detector's rate, streaming counts
+  // as activity so the monitor profile never interleaves
+  if (ble_ctx.is_raw_enabled) in = SAMPLING_IN_ACTIVITY;
+  uint32_t now = letimer0_get_uptime_msec();
+  if (sampling_step(&sampling_ctx, in, now))
   {
-    write_and_send_indication(&freefall_ctx);
-    freefall_ctx.is_indication_pending = false;
+    accel_update_register(ADXL343_BW_RATE, sampling_bw_rate(sampling_ctx.mode));
+    pipeline_set_rate(sampling_period_ms(sampling_ctx.mode), now);
+    LOG("Sampling %s, monitor %lu ms, capture %lu ms",
+        (sampling_ctx.mode == SAMPLING_CAPTURE) ? "capture" : "monitor",
+        (unsigned long)sampling_time_in_mode(&sampling_ctx, SAMPLING_MONITOR),
+        (unsigned long)sampling_time_in_mode(&sampling_ctx, SAMPLING_CAPTURE));
+  }
+}
+
+static void init_thresholds()
+{
+  accel_profile p;
+  if (accel_get_profile(&p) != 0) p = *accel_default_profile();
+  tuner_thresholds start = { p.thresh_act, p.thresh_inact, p.time_inact };
+  thresh_tuner_init(&tuner, &start, ACCEL_LSB_PER_G,
+                    letimer0_get_uptime_msec());
+}
+
+static void update_thresholds()
+{
+  // the quietest full window of the period bounds the thresholds from below
+  const feature_engine *fe = pipeline_features();
+  if (fe->axis[0].count == FEAT_WINDOW)
+  {
+    uint16_t p2p = 0;
+    for (int a=0; a<3; a++)
+    {
+      feature_values v;
+      feature_get(&fe->axis[a], &v);
+      if (v.p2p > p2p) p2p = v.p2p;
+    }
+    thresh_tuner_observe(&tuner, p2p);
+  }
+
+  if (thresh_tuner_step(&tuner, letimer0_get_uptime_msec()))
+  {
+    // THRESH_ACT..TIME_INACT are adjacent, the diff is one short burst
+    accel_profile p;
+    if (accel_get_profile(&p) != 0) return;
+    p.thresh_act = tuner.current.thresh_act;
+    p.thresh_inact = tuner.current.thresh_inact;
+    p.time_inact = tuner.current.time_inact;
+    if (accel_apply_profile(&p) != 0)
+    {
+      LOG("Error accel_apply_profile");
+    }
+    LOG("Thresholds act %u inact %u time %u, %lu interrupts/h",
+        tuner.current.thresh_act, tuner.current.thresh_inact,
+        tuner.current.time_inact, (unsigned long)(tuner.rate_q4 >> 4));
   }
-  else if (activity_ctx.is_indication_pending == true)
+}
+
+static void update_activity()
+{
+  // summaries only, edges are aggregated in activity_agg
+  uint8_t value;
+  if (activity_poll(&activity_agg, letimer0_get_uptime_msec(), &value))
   {
+    // set flags as index 0, value as index 1
+    activity_ctx.buf[0] = 0x0; // setup the flags
+    activity_ctx.buf[1] = value;
     write_and_send_indication(&activity_ctx);
-    activity_ctx.is_indication_pending = false;
   }
-  else if (doubletap_ctx.is_indication_pending == true)
+}
+
+static void alarm_timer_expired(sl_sleeptimer_timer_handle_t *handle,
+                                void *data)
+{
+  (void)handle;
+  (void)data;
+  sl_bt_external_signal(evt_alarm_timer);
+}
+
+static void beacon_timer_expired(sl_sleeptimer_timer_handle_t *handle,
+                                 void *data)
+{
+  (void)handle;
+  (void)data;
+  sl_bt_external_signal(evt_beacon_timer);
+}
+
+static void run_alarm(alarm_input in, uint32_t event_ms)
+{
+  alarm_state prev = alarm.state;
+  bool was_measured = alarm.is_measured;
+  uint32_t act = alarm_step(&alarm, in, event_ms, letimer0_get_uptime_msec());
+
+  if (act & (ALARM_ACT_STOP_TIMER | ALARM_ACT_START_TIMER))
   {
-    write_and_send_indication(&doubletap_ctx);
-    doubletap_ctx.is_indication_pending = false;
+    sl_sleeptimer_stop_timer(&alarm_timer);
+  }
+  if (act & ALARM_ACT_START_TIMER)
+  {
+    sl_status_t sc = sl_sleeptimer_start_timer_ms(&alarm_timer, alarm.timer_ms,
+                                                  alarm_timer_expired, NULL,
+                                                  0, 0);
+    if (sc != SL_STATUS_OK)
+    {
+      LOG("Error sl_sleeptimer_start_timer_ms, sc=0x%x", (unsigned int)sc);
+    }
+  }
+  if (act & ALARM_ACT_SEND)
+  {
+    // set flags as index 0, value as index 1
+    freefall_ctx.buf[0] = 0x0; // setup the flags
+    freefall_ctx.buf[1] = ALARM_VALUE_FALL;
+    write_and_send_indication(&freefall_ctx);
+  }
+  if (alarm.is_measured && !was_measured)
+  {
+    LOG("Alarm latency %lu ms (%lu ms without a client), bound %lu ms",
+        (unsigned long)alarm.latency_ms, (unsigned long)alarm.offline_ms,
+        (unsigned long)ALARM_MAX_LATENCY_MS);
   }
 
+  if (alarm.state != prev)
+  {
+    LOG("Alarm %s -> %s", alarm_state_name(prev), alarm_state_name(alarm.state));
+    if (alarm.state == ALARM_CONFIRMED)
+    {
+      // also broadcast, the indication only reaches a subscribed client
+      uint32_t ms = fall_beacon_raise(&beacon, FALL_BEACON_STATUS_FALL,
+                                      alarm.capture_ms,
+                                      letimer0_get_uptime_msec());
+      // kept across resets, see load_beacon_seq()
+      sl_status_t sc = sl_bt_nvm_save(FALL_BEACON_NVM_KEY_SEQ, 1,
+                                      &beacon.payload.seq);
+      if (sc != SL_STATUS_OK)
+      {
+        LOG("Error sl_bt_nvm_save, sc=0x%x", (unsigned int)sc);
+      }
+      sl_sleeptimer_stop_timer(&beacon_timer);
+      sc = sl_sleeptimer_start_timer_ms(&beacon_timer, ms,
+                                        beacon_timer_expired, NULL, 0, 0);
+      if (sc != SL_STATUS_OK)
+      {
+        LOG("Error sl_sleeptimer_start_timer_ms, sc=0x%x", (unsigned int)sc);
+      }
+      apply_beacon();
+    }
+    else if (alarm.state != ALARM_GRACE && fall_beacon_clear(&beacon))
+    {
+      // delivered, acknowledged or cancelled
+      sl_sleeptimer_stop_timer(&beacon_timer);
+      apply_beacon();
+    }
+    if (!alarm_is_link_reserved(&alarm))
+    {
+      // indications held back during the alarm
+      send_pending_indication();
+    }
+  }
 }
 
-static void write_and_send_indication(characteristic_context* ctx)
+static void update_alarm_link()
+{
+  // the alarm reaches a client through the fall status or the event stream
+  bool is_up = ble_ctx.is_connected &&
+               (freefall_ctx.is_indication_enabled || ble_ctx.is_stream_enabled);
+  if (is_up != alarm.is_link_up)
+  {
+    run_alarm(is_up ? ALARM_IN_LINK_UP : ALARM_IN_LINK_DOWN,
+              letimer0_get_uptime_msec());
+  }
+}
+
+static void apply_beacon()
 {
   unsigned int sc;
-  if (ble_ctx.is_connected 
-      && !ble_ctx.is_indication_inflight
-      && ctx->is_indication_enabled)
-  {
-    // write the attribute value to local gattdb
-    sc = sl_bt_gatt_server_write_attribute_value(
-                                        ctx->characteristic,
-                                        0,                    // val offset
-                                        1,                    // val len
-                                        &ctx->buf[1]
-                                        );
-    if (sc != SL_STATUS_OK) 
+  uint16_t interval = fall_beacon_interval(&beacon);
+
+  // the set is reprogrammed from scratch, it may or may not be running
+  sl_bt_advertiser_stop(advertising_set_handle);
+  sc = sl_bt_advertiser_set_timing(advertising_set_handle,
+                                   interval, // min. adv. interval (ms * 1.6)
+                                   interval, // max. adv. interval (ms * 1.6)
+                                   0,        // adv. duration
+                                   0);       // max. num. adv. events
+  if (sc != SL_STATUS_OK)
+  {
+    LOG("Error sl_bt_advertiser_set_timing, sc=0x%x", sc);
+  }
+
+  if (beacon.state == FALL_BEACON_OFF)
+  {
+    // only one connection, nothing to advertise while connected
+    if (ble_ctx.is_connected) return;
+    sc = sl_bt_advertiser_start(advertising_set_handle,
+                                sl_bt_advertiser_general_discoverable,
+                                sl_bt_advertiser_connectable_scannable);
+    if (sc != SL_STATUS_OK)
     {
-      LOG("Error sl_bt_gatt_server_write_attribute_value, sc=0x%x", sc);
+      LOG("Error sl_bt_advertiser_start, sc=0x%x", sc);
     }
+    return;
+  }
 
-    // send the indication
-    sc = sl_bt_gatt_server_send_indication(
-                              ble_ctx.conn_handle,  // connection handle
-                              ctx->characteristic,   // the characteristic
-                              2,                    // len
-                              &ctx->buf[0]           // data to transmit
-                              );
-    if (sc != SL_STATUS_OK) 
-    {
-      LOG("Error sl_bt_gatt_server_send_indication, sc=0x%x", sc);
-    } 
-    else
+  uint8_t adv[FALL_BEACON_ADV_LEN];
+  uint32_t len = fall_beacon_encode(&beacon.payload, adv);
+  sc = sl_bt_advertiser_set_data(advertising_set_handle, 0, len, adv);
+  if (sc != SL_STATUS_OK)
+  {
+    LOG("Error sl_bt_advertiser_set_data, sc=0x%x", sc);
+  }
+
+  // the device name moves to the scan response so apps still find it
+  uint8_t scan_rsp[31];
+  size_t name_len = 0;
+  sc = sl_bt_gatt_server_read_attribute_value(gattdb_device_name, 0,
+                                              sizeof(scan_rsp) - 2, &name_len,
+                                              &scan_rsp[2]);
+  if (sc == SL_STATUS_OK)
+  {
+    scan_rsp[0] = (uint8_t)(name_len + 1);
+    scan_rsp[1] = 0x09; // complete local name
+    sc = sl_bt_advertiser_set_data(advertising_set_handle, 1, name_len + 2,
+                                   scan_rsp);
+  }
+  if (sc != SL_STATUS_OK)
+  {
+    LOG("Error setting the scan response, sc=0x%x", sc);
+  }
+
+  // a connected peripheral may still advertise, but not be connectable
+  sc = sl_bt_advertiser_start(advertising_set_handle,
+                              sl_bt_advertiser_user_data,
+                              ble_ctx.is_connected
+                                ? sl_bt_advertiser_non_connectable
+                                : sl_bt_advertiser_connectable_scannable);
+  if (sc != SL_STATUS_OK)
+  {
+    LOG("Error sl_bt_advertiser_start, sc=0x%x", sc);
+  }
+  LOG("Fall beacon seq %u, state %u, interval %u", beacon.payload.seq,
+      beacon.state, interval);
+}
+
+static uint8_t load_beacon_seq()
+{
+  // a scanner that saw the last alert before a reset would drop a repeat of
+  // its sequence number as a duplicate. Without a saved one, e.g. on first
+  // boot, a random start makes that unlikely
+  uint8_t seq = 0;
+  size_t len = 0;
+  sl_status_t sc = sl_bt_nvm_load(FALL_BEACON_NVM_KEY_SEQ, 1, &len, &seq);
+  if (sc == SL_STATUS_OK && len == 1) return seq;
+
+  sc = sl_bt_system_get_random_data(1, 1, &len, &seq);
+  if (sc != SL_STATUS_OK || len != 1)
+  {
+    LOG("Error sl_bt_system_get_random_data, sc=0x%x", (unsigned int)sc);
+    return 0;
+  }
+  return seq;
+}
+
+static bool is_stream_fall_pending()
+{
+  return (stream.is_ready && (stream.ready.types & (1u << EVQ_FALL))) ||
+         (stream.open.len > 0 && (stream.open.types & (1u << EVQ_FALL)));
+}
+
+static void stream_timer_expired(sl_sleeptimer_timer_handle_t *handle,
+                                 void *data)
+{
+  (void)handle;
+  (void)data;
+  sl_bt_external_signal(evt_stream_deadline);
+}
+
+static void update_stream(uint32_t now)
+{
+  // a fall does not wait for the batch to fill
+  if (is_stream_fall_pending()) evs_flush(&stream);
+  evs_poll(&stream, now);
+
+  // an overdue batch behind a busy slot leaves on the next confirmation
+  sl_sleeptimer_stop_timer(&stream_timer);
+  uint32_t ms = evs_time_to_deadline(&stream, now);
+  if (ms != EVS_NO_DEADLINE && ms > 0)
+  {
+    sl_status_t sc = sl_sleeptimer_start_timer_ms(&stream_timer, ms,
+                                                  stream_timer_expired, NULL,
+                                                  0, 0);
+    if (sc != SL_STATUS_OK)
     {
-      ble_ctx.is_indication_inflight = true;
+      LOG("Error sl_sleeptimer_start_timer_ms, sc=0x%x", (unsigned int)sc);
     }
+  }
+  send_pending_indication();
+}
+
+static void send_stream_batch()
+{
+  const uint8_t *data = NULL;
+  uint32_t len = evs_ready(&stream, &data);
+  unsigned int sc = sl_bt_gatt_server_send_indication(ble_ctx.conn_handle,
+                                                      gattdb_event_stream,
+                                                      len, data);
+  if (sc != SL_STATUS_OK)
+  {
+    LOG("Error sl_bt_gatt_server_send_indication, sc=0x%x", sc);
+  }
+  else
+  {
+    ble_ctx.is_indication_inflight = true;
+    ble_ctx.inflight_characteristic = gattdb_event_stream;
+  }
+}
+
+static void send_pending_indication()
+{
+  unsigned int sc;
+  evq_event e;
+  if (!ble_ctx.is_connected || ble_ctx.is_indication_inflight) return;
+
+  // keep the link free for the alarm, falls outrank everything queued on
+  // either path
+  bool is_reserved = alarm_is_link_reserved(&alarm);
+  bool has_event = evq_peek(&indication_queue, &e);
+  if (!(has_event && e.type == EVQ_FALL) && stream.is_ready &&
+      (!is_reserved || is_stream_fall_pending()))
+  {
+    send_stream_batch();
+    return;
+  }
+  if (!has_event) return;
+  if (e.type != EVQ_FALL && is_reserved) return;
+  evq_pop(&indication_queue, NULL);
+
+  characteristic_context *ctx = contexts[e.type];
+  // set flags as index 0, value as index 1
+  ctx->buf[0] = 0x0;
+  ctx->buf[1] = e.value;
+
+  // write the attribute value to local gattdb
+  sc = sl_bt_gatt_server_write_attribute_value(
+                                      ctx->characteristic,
+                                      0,                    // val offset
+                                      1,                    // val len
+                                      &ctx->buf[1]
+                                      );
+  if (sc != SL_STATUS_OK) 
+  {
+    LOG("Error sl_bt_gatt_server_write_attribute_value, sc=0x%x", sc);
+  }
+
+  // send the indication
+  sc = sl_bt_gatt_server_send_indication(
+                            ble_ctx.conn_handle,  // connection handle
+                            ctx->characteristic,   // the characteristic
+                            2,                    // len
+                            &ctx->buf[0]           // data to transmit
+                            );
+  if (sc != SL_STATUS_OK) 
+  {
+    LOG("Error sl_bt_gatt_server_send_indication, sc=0x%x", sc);
   } 
-  else if (ble_ctx.is_connected && ble_ctx.is_indication_inflight)
+  else
   {
-    // set a flag reminding us to send indication upon indication timeout 
-    // or on indication confirmation
-    ctx->is_indication_pending = true;
+    ble_ctx.is_indication_inflight = true;
+    ble_ctx.inflight_characteristic = ctx->characteristic;
+  }
+}
+
+static void write_and_send_indication(characteristic_context* ctx)
+{
+  // queued while another indication is in flight, sent upon confirmation
+  // or indication timeout. The event stream carries the same events batched,
+  // a client may subscribe to either or both
+  uint32_t now = letimer0_get_uptime_msec();
+  if (!ble_ctx.is_connected) return;
+  if (ble_ctx.is_stream_enabled &&
+      !evs_add(&stream, (uint8_t)ctx->type, ctx->buf[1], now))
+  {
+    LOG("Event stream full, dropped type %d", (int)ctx->type);
+  }
+  if (ctx->is_indication_enabled &&
+      !evq_push(&indication_queue, ctx->type, ctx->buf[1], now))
+  {
+    LOG("Indication queue full, dropped type %d", (int)ctx->type);
+  }
+  if (ble_ctx.is_stream_enabled)
+  {
+    update_stream(now); // also sends
+  }
+  else
+  {
+    send_pending_indication();
+  }
+}
+
+static void update_conn_policy(conn_input in)
+{
+  if (!ble_ctx.is_connected) return;
+  if (!conn_policy_step(&policy, in, letimer0_get_uptime_msec())) return;
+
+  const conn_params *p = conn_profile_params(policy.requested);
+  unsigned int sc = sl_bt_connection_set_parameters(ble_ctx.conn_handle,
+                                                    p->min_interval,
+                                                    p->max_interval,
+                                                    p->latency,
+                                                    p->timeout,
+                                                    0x0,
+                                                    0xff);
+  if (sc != SL_STATUS_OK)
+  {
+    LOG("Error sl_bt_connection_set_parameters, sc=0x%x", sc);
+  }
+  LOG("Connection profile %s",
+      (policy.requested == CONN_PROFILE_FAST) ? "fast" : "idle");
+}
+
+static void send_raw_packets()
+{
+  // credits instead of confirmations, the loop stops when they run out or
+  // the stack's TX buffers are full
+  uint32_t now = letimer0_get_uptime_msec();
+  raw_tick(&raw, now - ble_ctx.raw_tick_ms);
+  ble_ctx.raw_tick_ms = now;
+
+  // packets fill an ATT_MTU 247 notification, they wait for the exchange
+  if (ble_ctx.mtu < RAW_PACKET_LEN + 3) return;
+
+  const uint8_t *data;
+  uint32_t len;
+  while ((len = raw_peek(&raw, &data)) > 0)
+  {
+    sl_status_t sc = sl_bt_gatt_server_send_notification(ble_ctx.conn_handle,
+                                                         gattdb_raw_stream,
+                                                         len, data);
+    if (sc == SL_STATUS_OK)
+    {
+      raw_sent(&raw);
+    }
+    else if (sc == SL_STATUS_NO_MORE_RESOURCE)
+    {
+      raw_refused(&raw);
+      break;
+    }
+    else
+    {
+      LOG("Error sl_bt_gatt_server_send_notification, sc=0x%x",
+          (unsigned int)sc);
+      raw_refused(&raw);
+      break;
+    }
   }
 }
@@ -10,10 +10,22 @@
 #include <em_common.h>
 #include <sl_bluetooth.h>
 #include <gatt_db.h>
+#include <sl_sleeptimer.h>
 
 #include "log.h"
 #include "events.h"
+#include "activity.h"
+#include "alarm.h"
+#include "conn_policy.h"
 #include "adxl343.h"
+#include "event_queue.h"
+#include "event_stream.h"
+#include "fall_beacon.h"
+#include "pipeline.h"
+#include "raw_stream.h"
+#include "sampling.h"
+#include "thresh_tuner.h"
+#include "timers.h"
 
 void handle_ble_event(sl_bt_msg_t *evt);
 
@@ -0,0 +1,78 @@
+/* -----------------------------------------------------------------------------
+ * @file   calibration.c
+ * @brief  Zero-g offset calibration for the ADXL343 OFSX/OFSY/OFSZ registers
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include "calibration.h"
+
+// rounds a/b to the nearest integer, halves away from zero, b > 0
+static int32_t round_div(int32_t a, int32_t b)
+{
+  return (a >= 0) ? (a + b/2) / b : -((-a + b/2) / b);
+}
+
+void calibration_reset(calibration_context *ctx)
+{
+  for (int i=0; i<3; i++)
+  {
+    ctx->sum[i] = 0;
+    ctx->min[i] = INT16_MAX;
+    ctx->max[i] = INT16_MIN;
+  }
+  ctx->n = 0;
+}
+
+bool calibration_add(calibration_context *ctx, const int16_t *x,
+                     const int16_t *y, const int16_t *z, uint32_t n)
+{
+  const int16_t *axes[3] = { x, y, z };
+  for (uint32_t k=0; k<n && ctx->n<CAL_WINDOW_SAMPLES; k++, ctx->n++)
+  {
+    for (int i=0; i<3; i++)
+    {
+      int16_t v = axes[i][k];
+      ctx->sum[i] += v;
+      if (v < ctx->min[i]) ctx->min[i] = v;
+      if (v > ctx->max[i]) ctx->max[i] = v;
+    }
+  }
+  return ctx->n >= CAL_WINDOW_SAMPLES;
+}
+
+int calibration_compute(const calibration_context *ctx, const int8_t *current,
+                        int8_t *offsets)
+{
+  if (ctx->n == 0 || ctx->n < CAL_WINDOW_SAMPLES) return -1;
+
+  // gravity axis: largest mean magnitude
+  int g = 0;
+  for (int i=1; i<3; i++)
+  {
+    if (abs(ctx->sum[i]) > abs(ctx->sum[g])) g = i;
+  }
+
+  for (int i=0; i<3; i++)
+  {
+    if (ctx->max[i] - ctx->min[i] > CAL_STILL_P2P_LSB) return -1;
+  }
+
+  for (int i=0; i<3; i++)
+  {
+    int32_t expected = 0;
+    if (i == g) expected = (ctx->sum[i] >= 0) ? ACCEL_LSB_PER_G : -ACCEL_LSB_PER_G;
+
+    // mean error in 15.6 mg offset steps, computed on the sum to keep the
+    // precision at any data scale
+    int32_t err_sum = ctx->sum[i] - expected*(int32_t)ctx->n;
+    int32_t step = round_div(err_sum*ACCEL_OFS_PER_G,
+                             ACCEL_LSB_PER_G*(int32_t)ctx->n);
+
+    int32_t ofs = current[i] - step;
+    if (ofs > INT8_MAX) ofs = INT8_MAX;
+    if (ofs < INT8_MIN) ofs = INT8_MIN;
+    offsets[i] = (int8_t)ofs;
+  }
+  return 0;
+}
@@ -0,0 +1,70 @@
+/* -----------------------------------------------------------------------------
+ * @file   calibration.h
+ * @brief  Zero-g offset calibration for the ADXL343 OFSX/OFSY/OFSZ registers
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Averages a window of samples taken while the wearer is still and converts
+ * the residual error into offset register values, so the sensor delivers
+ * corrected data without any per-sample work on the MCU. Pure math, no
+ * hardware access.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _CALIBRATION_H_
+#define _CALIBRATION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "accel_config.h"
+
+#define CAL_WINDOW_SAMPLES    (128) // ~5 sec at the 25 Hz monitor rate
+#define CAL_STILL_P2P_LSB     ACCEL_MG_TO_LSB(80) // max peak-to-peak per axis
+
+typedef struct
+{
+  int32_t sum[3];
+  int16_t min[3];
+  int16_t max[3];
+  uint32_t n;
+} calibration_context;
+
+
+/* @brief  Clears the accumulated window
+ *
+ * @param  calibration_context*, the window
+ * @return None
+ */
+void calibration_reset(calibration_context *ctx);
+
+
+/* @brief  Accumulates samples until the window is full
+ *
+ * Samples beyond CAL_WINDOW_SAMPLES are ignored.
+ *
+ * @param  calibration_context*, the window
+ * @param  const int16_t*, x samples
+ * @param  const int16_t*, y samples
+ * @param  const int16_t*, z samples
+ * @param  uint32_t, number of samples
+ * @return true once the window is full
+ */
+bool calibration_add(calibration_context *ctx, const int16_t *x,
+                     const int16_t *y, const int16_t *z, uint32_t n);
+
+
+/* @brief  Computes new offset register values from a full window
+ *
+ * The axis with the largest mean magnitude is taken to carry gravity and is
+ * referenced to +/-1 g, the others to 0 g. The mean error is rounded to the
+ * nearest 15.6 mg offset step, added to the offsets the data was taken with
+ * and trimmed to the int8 register range.
+ *
+ * @param  const calibration_context*, a full window
+ * @param  const int8_t*, OFSX..OFSZ active while the window was captured
+ * @param  int8_t*, resulting OFSX..OFSZ
+ * @return -1 if the window is incomplete or not still, 0 upon success
+ */
+int calibration_compute(const calibration_context *ctx, const int8_t *current,
+                        int8_t *offsets);
+
+#endif // _CALIBRATION_H_
@@ -0,0 +1,126 @@
+/* -----------------------------------------------------------------------------
+ * @file   conn_policy.c
+ * @brief  Connection parameter policy: a slow, high latency profile while
+ *         idle, a fast one around fall candidates and bulk transfers
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "conn_policy.h"
+
+// the timeout must exceed (1 + latency) * 2 * max_interval
+static const conn_params profiles[CONN_NUM_PROFILES] = {
+  // 500..650 msec, wakes at least every 3.25 sec when idle, 8 sec timeout
+  [CONN_PROFILE_IDLE] = { 400, 520, 4, 800 },
+  // 15..30 msec, every event, 2 sec timeout
+  [CONN_PROFILE_FAST] = { 12, 24, 0, 200 }
+};
+
+const conn_params *conn_profile_params(conn_profile p)
+{
+  return &profiles[p];
+}
+
+static conn_profile classify(uint16_t interval)
+{
+  return (interval <= profiles[CONN_PROFILE_FAST].max_interval)
+         ? CONN_PROFILE_FAST : CONN_PROFILE_IDLE;
+}
+
+void conn_policy_init(conn_policy *cp, uint32_t now_ms)
+{
+  cp->target = CONN_PROFILE_IDLE;
+  cp->requested = CONN_PROFILE_IDLE;
+  cp->has_requested = false;
+  cp->is_pending = false;
+  cp->requested_ms = now_ms;
+  cp->last_demand_ms = now_ms;
+  cp->interval = 0;
+  cp->latency = 0;
+  cp->timeout = 0;
+  cp->negotiated_ms = now_ms;
+  for (int p=0; p<CONN_NUM_PROFILES; p++) cp->time_in_profile_ms[p] = 0;
+  cp->requests = 0;
+  cp->rate_limited = 0;
+  cp->accepted = 0;
+  cp->rejected = 0;
+  cp->lapsed = 0;
+}
+
+bool conn_policy_step(conn_policy *cp, conn_input in, uint32_t now_ms)
+{
+  switch (in)
+  {
+    case CONN_IN_OPENED:
+      conn_policy_init(cp, now_ms);
+      break;
+    case CONN_IN_FALL_CANDIDATE:
+    case CONN_IN_BULK:
+      cp->last_demand_ms = now_ms;
+      cp->target = CONN_PROFILE_FAST;
+      break;
+    case CONN_IN_TICK:
+      if (cp->target == CONN_PROFILE_FAST &&
+          now_ms - cp->last_demand_ms >= CONN_QUIET_MS)
+      {
+        cp->target = CONN_PROFILE_IDLE;
+      }
+      break;
+  }
+
+  // the initial parameters are reported right after the connection opens,
+  // a request made before could not be told apart from them
+  if (cp->interval == 0) return false;
+
+  if (cp->is_pending)
+  {
+    if (now_ms - cp->requested_ms < CONN_PENDING_MS) return false;
+    // the central never answered, ask again
+    cp->is_pending = false;
+    cp->has_requested = false;
+    cp->lapsed++;
+  }
+  if (cp->has_requested && cp->target == cp->requested) return false;
+
+  // a fall may not wait, everything else is spaced out
+  if (cp->has_requested && in != CONN_IN_FALL_CANDIDATE &&
+      now_ms - cp->requested_ms < CONN_MIN_UPDATE_GAP_MS)
+  {
+    cp->rate_limited++;
+    return false;
+  }
+
+  cp->requested = cp->target;
+  cp->has_requested = true;
+  cp->is_pending = true;
+  cp->requested_ms = now_ms;
+  cp->requests++;
+  return true;
+}
+
+void conn_policy_negotiated(conn_policy *cp, uint16_t interval,
+                            uint16_t latency, uint16_t timeout,
+                            uint32_t now_ms)
+{
+  if (cp->interval != 0)
+  {
+    uint32_t dt = now_ms - cp->negotiated_ms;
+    cp->time_in_profile_ms[classify(cp->interval)] += dt;
+  }
+  cp->interval = interval;
+  cp->latency = latency;
+  cp->timeout = timeout;
+  cp->negotiated_ms = now_ms;
+
+  // also reported when the central changes the parameters on its own
+  if (!cp->is_pending) return;
+  cp->is_pending = false;
+  const conn_params *p = &profiles[cp->requested];
+  if (interval >= p->min_interval && interval <= p->max_interval)
+  {
+    cp->accepted++;
+  }
+  else
+  {
+    cp->rejected++;
+  }
+}
@@ -0,0 +1,125 @@
+/* -----------------------------------------------------------------------------
+ * @file   conn_policy.h
+ * @brief  Connection parameter policy: a slow, high latency profile while
+ *         idle, a fast one around fall candidates and bulk transfers
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ *   IDLE --fall candidate / bulk--> FAST --CONN_QUIET_MS without demand--> IDLE
+ *
+ * The idle profile lets the peripheral skip connection events while it has
+ * nothing to send, which is nearly all the time. A fall candidate (the
+ * free-fall trigger) is raised before the detector's verdict and the grace
+ * window that precede the alarm, so the fast interval is in place by the
+ * time the alarm is indicated. Bulk transfers (blackbox reads, raw
+ * streaming) need the short interval for throughput and keep asking for it
+ * while they run.
+ *
+ * Updates are rate limited: apart from a fall candidate, a new request is
+ * made at most every CONN_MIN_UPDATE_GAP_MS, and none while the previous
+ * one is waiting for the central. The central has the final word, the
+ * negotiated parameters are recorded as reported and compared against the
+ * request. Like sampling.c this is a pure state machine, the caller sends
+ * the request when told to.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _CONN_POLICY_H_
+#define _CONN_POLICY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CONN_QUIET_MS           (10000) // back to idle this long after demand
+#define CONN_MIN_UPDATE_GAP_MS  (5000)  // between requests, except falls
+#define CONN_PENDING_MS         (5000)  // a request unanswered this long lapses
+
+typedef enum
+{
+  CONN_PROFILE_IDLE = 0,
+  CONN_PROFILE_FAST,
+  CONN_NUM_PROFILES
+} conn_profile;
+
+typedef enum
+{
+  CONN_IN_TICK,            // periodic update
+  CONN_IN_OPENED,          // the connection was opened
+  CONN_IN_FALL_CANDIDATE,  // a fall is being evaluated or alarmed
+  CONN_IN_BULK             // a bulk transfer started or is running
+} conn_input;
+
+typedef struct
+{
+  uint16_t min_interval;   // 1.25 msec units
+  uint16_t max_interval;   // 1.25 msec units
+  uint16_t latency;        // connection events the peripheral may skip
+  uint16_t timeout;        // supervision timeout, 10 msec units
+} conn_params;
+
+typedef struct
+{
+  conn_profile target;     // what the policy wants
+  conn_profile requested;  // what was last asked of the central
+  bool has_requested;
+  bool is_pending;         // waiting for the central's answer
+  uint32_t requested_ms;
+  uint32_t last_demand_ms;
+
+  // as negotiated, 0 until reported
+  uint16_t interval;
+  uint16_t latency;
+  uint16_t timeout;
+  uint32_t negotiated_ms;
+  uint32_t time_in_profile_ms[CONN_NUM_PROFILES]; // by negotiated interval
+
+  uint32_t requests;
+  uint32_t rate_limited;   // steps that wanted a request but had to wait
+  uint32_t accepted;       // answered within the requested range
+  uint32_t rejected;       // answered outside it
+  uint32_t lapsed;         // not answered within CONN_PENDING_MS
+} conn_policy;
+
+
+/* @brief  Returns the parameters of a profile
+ *
+ * @param  conn_profile, the profile
+ * @return const conn_params*, the parameters
+ */
+const conn_params *conn_profile_params(conn_profile p);
+
+
+/* @brief  Resets the policy, nothing requested yet
+ *
+ * @param  conn_policy*, the policy
+ * @param  uint32_t, current time in msec
+ * @return None
+ */
+void conn_policy_init(conn_policy *cp, uint32_t now_ms);
+
+
+/* @brief  Advances the policy
+ *
+ * Nothing is requested before the connection's initial parameters have
+ * been recorded with conn_policy_negotiated().
+ *
+ * @param  conn_policy*, the policy
+ * @param  conn_input, the event being processed
+ * @param  uint32_t, current time in msec
+ * @return true if the caller must request conn_profile_params(cp->requested)
+ */
+bool conn_policy_step(conn_policy *cp, conn_input in, uint32_t now_ms);
+
+
+/* @brief  Records the parameters the central settled on
+ *
+ * @param  conn_policy*, the policy
+ * @param  uint16_t, interval in 1.25 msec units
+ * @param  uint16_t, peripheral latency
+ * @param  uint16_t, supervision timeout in 10 msec units
+ * @param  uint32_t, current time in msec
+ * @return None
+ */
+void conn_policy_negotiated(conn_policy *cp, uint16_t interval,
+                            uint16_t latency, uint16_t timeout,
+                            uint32_t now_ms);
+
+#endif // _CONN_POLICY_H_
@@ -0,0 +1,49 @@
+/* -----------------------------------------------------------------------------
+ * @file   cycles.h
+ * @brief  CPU cycle counter for profiling processing stages
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Uses the Cortex-M DWT cycle counter on target. Host builds read 0, so the
+ * pure modules using it still compile and run off target.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _CYCLES_H_
+#define _CYCLES_H_
+
+#include <stdint.h>
+
+#if defined(__arm__)
+  #include "em_device.h" // CMSIS core, DWT cycle counter
+  #define CYCLES_HAS_DWT (1)
+#else
+  #define CYCLES_HAS_DWT (0)
+#endif
+
+/* @brief  Enables the cycle counter, safe to call more than once
+ *
+ * @param  None
+ * @return None
+ */
+static inline void cycles_init()
+{
+#if CYCLES_HAS_DWT
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+/* @brief  Returns the free running cycle count, differences are wrap safe
+ *
+ * @param  None
+ * @return uint32_t, cycles (0 off target)
+ */
+static inline uint32_t cycles_now()
+{
+#if CYCLES_HAS_DWT
+  return DWT->CYCCNT;
+#else
+  return 0;
+#endif
+}
+
+#endif // _CYCLES_H_
@@ -0,0 +1,75 @@
+/* -----------------------------------------------------------------------------
+ * @file   detector_config.h
+ * @brief  Build-time preset of the detection chain: output data rate, range,
+ *         window lengths and filter coefficients
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Select a preset with -DDETECTOR_PRESET=<n>. Each preset is one row of the
+ * table below, everything downstream (the BW_RATE register, the sample
+ * period, the feature window, the gravity low-pass coefficients and, through
+ * accel_config.h, every threshold in LSB or LSB^2) derives from it with
+ * preprocessor arithmetic. No code checks the configuration at run time:
+ * windows are powers of two so ring indexing is a mask and window averages
+ * are constant divisions the compiler turns into shifts, and the low-pass
+ * filters are shifts chosen per rate so the time constant stays the same.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _DETECTOR_CONFIG_H_
+#define _DETECTOR_CONFIG_H_
+
+#define DETECTOR_PRESET_100HZ_16G  (0) // default, full impact headroom
+#define DETECTOR_PRESET_50HZ_8G    (1)
+#define DETECTOR_PRESET_25HZ_4G    (2) // lowest power, impacts may clip
+
+#ifndef DETECTOR_PRESET
+#define DETECTOR_PRESET  DETECTOR_PRESET_100HZ_16G
+#endif
+
+/* ============================================================================
+ *       PRESET TABLE
+ *
+ * RATE_HZ        output data rate
+ * BW_RATE_CODE   BW_RATE rate bits for RATE_HZ
+ * RANGE_G        g-range, see accel_config.h
+ * WINDOW_LOG2    feature window, ~1.3 sec
+ * GRAVITY_SHIFT  fall detector gravity reference, tau ~160 ms
+ * POSTURE_SHIFT  posture gravity estimate, tau ~80 ms
+ * ===========================================================================*/
+#if DETECTOR_PRESET == DETECTOR_PRESET_100HZ_16G
+#define DET_RATE_HZ        (100)
+#define DET_BW_RATE_CODE   (0x0A)
+#define DET_RANGE_G        (16)
+#define DET_WINDOW_LOG2    (7)
+#define DET_GRAVITY_SHIFT  (4)
+#define DET_POSTURE_SHIFT  (3)
+#elif DETECTOR_PRESET == DETECTOR_PRESET_50HZ_8G
+#define DET_RATE_HZ        (50)
+#define DET_BW_RATE_CODE   (0x09)
+#define DET_RANGE_G        (8)
+#define DET_WINDOW_LOG2    (6)
+#define DET_GRAVITY_SHIFT  (3)
+#define DET_POSTURE_SHIFT  (2)
+#elif DETECTOR_PRESET == DETECTOR_PRESET_25HZ_4G
+#define DET_RATE_HZ        (25)
+#define DET_BW_RATE_CODE   (0x08)
+#define DET_RANGE_G        (4)
+#define DET_WINDOW_LOG2    (5)
+#define DET_GRAVITY_SHIFT  (2)
+#define DET_POSTURE_SHIFT  (1)
+#else
+#error "unknown DETECTOR_PRESET"
+#endif
+
+/* ============================================================================
+ *       DERIVED
+ * ===========================================================================*/
+#define DET_PERIOD_MS          (1000 / DET_RATE_HZ)
+#define DET_WINDOW             (1 << DET_WINDOW_LOG2)
+#define DET_WINDOW_MASK        (DET_WINDOW - 1)
+#define DET_MS_TO_SAMPLES(ms)  (((ms) * DET_RATE_HZ + 500) / 1000)
+
+#if 1000 % DET_RATE_HZ != 0
+#error "DET_RATE_HZ must divide 1000, timestamps are whole msec"
+#endif
+
+#endif // _DETECTOR_CONFIG_H_
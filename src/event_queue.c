@@ -0,0 +1,134 @@
+/* -----------------------------------------------------------------------------
+ * @file   event_queue.c
+ * @brief  Bounded priority queue of timestamped events waiting for the radio
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "event_queue.h"
+
+static const bool is_state_type[EVQ_NUM_TYPES] = {
+  [EVQ_TAP] = false,
+  [EVQ_ACTIVITY] = true,
+  [EVQ_FALL] = true
+};
+
+// true if a leaves the queue before b
+static inline bool is_before(const evq_event *a, const evq_event *b)
+{
+  if (a->type != b->type) return a->type > b->type;
+  return (int32_t)(a->seq - b->seq) < 0;
+}
+
+// the queue is a small unordered array, a linear scan beats keeping a heap
+// at this capacity
+static int find_next(const event_queue *q)
+{
+  if (q->n == 0) return -1;
+  uint32_t best = 0;
+  for (uint32_t i=1; i<q->n; i++)
+  {
+    if (is_before(&q->e[i], &q->e[best])) best = i;
+  }
+  return (int)best;
+}
+
+// eviction victim: the lowest priority, the oldest within it
+static int find_victim(const event_queue *q)
+{
+  if (q->n == 0) return -1;
+  uint32_t victim = 0;
+  for (uint32_t i=1; i<q->n; i++)
+  {
+    const evq_event *e = &q->e[i];
+    const evq_event *v = &q->e[victim];
+    if (e->type < v->type ||
+        (e->type == v->type && (int32_t)(e->seq - v->seq) < 0))
+    {
+      victim = i;
+    }
+  }
+  return (int)victim;
+}
+
+static void remove_at(event_queue *q, uint32_t i)
+{
+  q->e[i] = q->e[--q->n];
+}
+
+void evq_init(event_queue *q)
+{
+  memset(q, 0x0, sizeof(*q));
+}
+
+void evq_clear(event_queue *q)
+{
+  q->n = 0;
+}
+
+bool evq_push(event_queue *q, evq_type type, uint8_t value, uint32_t time_ms)
+{
+  if (type >= EVQ_NUM_TYPES) return false;
+
+  if (is_state_type[type])
+  {
+    for (uint32_t i=0; i<q->n; i++)
+    {
+      if (q->e[i].type == type)
+      {
+        q->e[i].value = value;
+        q->e[i].time_ms = time_ms;
+        q->merged[type]++;
+        return true;
+      }
+    }
+  }
+
+  if (q->n == EVQ_CAPACITY)
+  {
+    q->overflows++;
+    // the lowest priority is the same or higher: the new event loses
+    int victim = find_victim(q);
+    if (q->e[victim].type >= type)
+    {
+      q->dropped[type]++;
+      return false;
+    }
+    q->dropped[q->e[victim].type]++;
+    remove_at(q, (uint32_t)victim);
+  }
+
+  evq_event *e = &q->e[q->n++];
+  e->type = type;
+  e->value = value;
+  e->time_ms = time_ms;
+  e->seq = q->seq++;
+  if (q->n > q->high_water) q->high_water = q->n;
+  return true;
+}
+
+bool evq_peek(const event_queue *q, evq_event *out)
+{
+  int i = find_next(q);
+  if (i < 0) return false;
+  *out = q->e[i];
+  return true;
+}
+
+bool evq_pop(event_queue *q, evq_event *out)
+{
+  int i = find_next(q);
+  if (i < 0) return false;
+  if (out != NULL) *out = q->e[i];
+  remove_at(q, (uint32_t)i);
+  return true;
+}
+
+void evq_remove_type(event_queue *q, evq_type type)
+{
+  for (uint32_t i=0; i<q->n; )
+  {
+    if (q->e[i].type == type) remove_at(q, i);
+    else i++;
+  }
+}
@@ -0,0 +1,109 @@
+/* -----------------------------------------------------------------------------
+ * @file   event_queue.h
+ * @brief  Bounded priority queue of timestamped events waiting for the radio
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Only one indication can be in flight per connection, everything raised
+ * meanwhile waits here. Falls outrank activity, which outranks taps, and
+ * events of equal priority leave in arrival order. Types that carry a state
+ * (fall status, activity) merge: a newer value replaces a queued one of the
+ * same type and keeps its place, since the client only needs the latest
+ * state. Taps are distinct gestures and do not merge.
+ *
+ * Capacity is fixed and nothing is allocated. When full, a new event evicts
+ * the oldest event of the lowest priority below its own, otherwise it is
+ * dropped; both are counted per type.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _EVENT_QUEUE_H_
+#define _EVENT_QUEUE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define EVQ_CAPACITY  (8)
+
+// the value is the priority
+typedef enum
+{
+  EVQ_TAP = 0,
+  EVQ_ACTIVITY,
+  EVQ_FALL,
+  EVQ_NUM_TYPES
+} evq_type;
+
+typedef struct
+{
+  evq_type type;
+  uint8_t value;
+  uint32_t time_ms;  // when the event was raised, the latest for merged ones
+  uint32_t seq;      // arrival order
+} evq_event;
+
+typedef struct
+{
+  evq_event e[EVQ_CAPACITY];
+  uint32_t n;
+  uint32_t seq;
+  uint32_t high_water;
+  uint32_t merged[EVQ_NUM_TYPES];
+  uint32_t dropped[EVQ_NUM_TYPES]; // evicted or refused
+  uint32_t overflows;              // pushes that found the queue full
+} event_queue;
+
+
+/* @brief  Empties the queue and clears the counters
+ *
+ * @param  event_queue*, the queue
+ * @return None
+ */
+void evq_init(event_queue *q);
+
+
+/* @brief  Empties the queue, the counters are kept
+ *
+ * @param  event_queue*, the queue
+ * @return None
+ */
+void evq_clear(event_queue *q);
+
+
+/* @brief  Queues an event
+ *
+ * @param  event_queue*, the queue
+ * @param  evq_type, type, also the priority
+ * @param  uint8_t, value to send
+ * @param  uint32_t, time the event was raised in msec
+ * @return false if the event was dropped, true if queued or merged
+ */
+bool evq_push(event_queue *q, evq_type type, uint8_t value, uint32_t time_ms);
+
+
+/* @brief  Returns the next event without removing it
+ *
+ * @param  const event_queue*, the queue
+ * @param  evq_event*, the highest priority, oldest event
+ * @return false if the queue is empty
+ */
+bool evq_peek(const event_queue *q, evq_event *out);
+
+
+/* @brief  Removes and returns the next event
+ *
+ * @param  event_queue*, the queue
+ * @param  evq_event*, the highest priority, oldest event, may be NULL
+ * @return false if the queue is empty
+ */
+bool evq_pop(event_queue *q, evq_event *out);
+
+
+/* @brief  Drops the queued events of one type, e.g. when the client turns
+ *         its indications off
+ *
+ * @param  event_queue*, the queue
+ * @param  evq_type, the type
+ * @return None
+ */
+void evq_remove_type(event_queue *q, evq_type type);
+
+#endif // _EVENT_QUEUE_H_
@@ -0,0 +1,160 @@
+/* -----------------------------------------------------------------------------
+ * @file   event_stream.c
+ * @brief  Packs timestamped events into batches for the event stream
+ *         characteristic
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "event_stream.h"
+
+#define MAX_DELTA_MS  (0xFFFF)
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+  put_u16(p, (uint16_t)v);
+  put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+  return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static inline bool is_full(const event_stream *s)
+{
+  return s->open.len > 0 &&
+         (uint32_t)s->open.len + EVS_RECORD_LEN > s->max_len;
+}
+
+static bool close_open(event_stream *s)
+{
+  if (s->is_ready || s->open.len == 0) return false;
+  s->ready = s->open;
+  s->is_ready = true;
+  s->open.len = 0;
+  s->batches++;
+  s->seq++;
+  return true;
+}
+
+void evs_init(event_stream *s, uint32_t deadline_ms)
+{
+  s->open.len = 0;
+  s->ready.len = 0;
+  s->is_ready = false;
+  s->max_len = EVS_MIN_MTU - 3;
+  s->deadline_ms = (deadline_ms > 0) ? deadline_ms : EVS_DEFAULT_DEADLINE_MS;
+  s->seq = 0;
+  s->records = 0;
+  s->batches = 0;
+  s->dropped = 0;
+}
+
+void evs_set_mtu(event_stream *s, uint16_t mtu)
+{
+  uint32_t len = (mtu > EVS_MIN_MTU) ? (uint32_t)mtu - 3 : EVS_MIN_MTU - 3;
+  s->max_len = (len > EVS_MAX_LEN) ? EVS_MAX_LEN : (uint16_t)len;
+}
+
+bool evs_add(event_stream *s, uint8_t type, uint8_t value, uint32_t time_ms)
+{
+  evs_batch *b = &s->open;
+
+  // a record that does not fit, or whose delta does not, starts a new batch
+  if (b->len > 0 && (is_full(s) || time_ms - b->last_ms > MAX_DELTA_MS))
+  {
+    if (!close_open(s))
+    {
+      s->dropped++;
+      return false;
+    }
+  }
+
+  if (b->len == 0)
+  {
+    b->buf[0] = s->seq;
+    put_u32(&b->buf[1], time_ms);
+    b->len = EVS_HEADER_LEN;
+    b->n_records = 0;
+    b->first_ms = time_ms;
+    b->last_ms = time_ms;
+    b->types = 0;
+  }
+
+  uint8_t *r = &b->buf[b->len];
+  r[0] = type;
+  put_u16(&r[1], (uint16_t)(time_ms - b->last_ms));
+  r[3] = value;
+  b->len += EVS_RECORD_LEN;
+  b->n_records++;
+  b->last_ms = time_ms;
+  b->types |= 1u << (type & 31);
+  s->records++;
+
+  // close eagerly so a full batch need not wait for the next record
+  if (is_full(s)) close_open(s);
+  return true;
+}
+
+bool evs_flush(event_stream *s)
+{
+  return close_open(s);
+}
+
+void evs_poll(event_stream *s, uint32_t now_ms)
+{
+  if (is_full(s) || evs_time_to_deadline(s, now_ms) == 0) close_open(s);
+}
+
+uint32_t evs_time_to_deadline(const event_stream *s, uint32_t now_ms)
+{
+  if (s->open.len == 0) return EVS_NO_DEADLINE;
+  uint32_t age = now_ms - s->open.first_ms;
+  return (age >= s->deadline_ms) ? 0 : s->deadline_ms - age;
+}
+
+uint32_t evs_ready(const event_stream *s, const uint8_t **data)
+{
+  if (!s->is_ready) return 0;
+  *data = s->ready.buf;
+  return s->ready.len;
+}
+
+void evs_consume(event_stream *s, uint32_t now_ms)
+{
+  s->is_ready = false;
+  evs_poll(s, now_ms);
+}
+
+bool evs_decode(const uint8_t *batch, uint32_t len, uint32_t index,
+                uint8_t *type, uint8_t *value, uint32_t *time_ms)
+{
+  if (len < EVS_HEADER_LEN || (len - EVS_HEADER_LEN) % EVS_RECORD_LEN != 0)
+  {
+    return false;
+  }
+  if (index >= (len - EVS_HEADER_LEN) / EVS_RECORD_LEN) return false;
+
+  uint32_t t = get_u32(&batch[1]);
+  const uint8_t *r = &batch[EVS_HEADER_LEN];
+  for (uint32_t i=0; i<=index; i++, r+=EVS_RECORD_LEN)
+  {
+    t += get_u16(&r[1]);
+  }
+  r -= EVS_RECORD_LEN;
+  *type = r[0];
+  *value = r[3];
+  *time_ms = t;
+  return true;
+}
@@ -0,0 +1,150 @@
+/* -----------------------------------------------------------------------------
+ * @file   event_stream.h
+ * @brief  Packs timestamped events into batches for the event stream
+ *         characteristic
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * The legacy status characteristics cost one indication and one confirmation
+ * per event. The event stream carries many events per indication: records
+ * are appended to an open batch until the next one would not fit the ATT MTU
+ * or the oldest record has waited EVS_DEFAULT_DEADLINE_MS, then the batch is
+ * closed and waits in a single ready slot for the radio. A batch that must
+ * close while the slot is taken keeps filling, and records that find both
+ * full are dropped and counted.
+ *
+ * Batch layout, little endian, at most ATT_MTU - 3 bytes:
+ *   0  uint8   sequence number, increments per batch
+ *   1  uint32  time of the first record, msec
+ *   5  records of EVS_RECORD_LEN bytes:
+ *        0  uint8   type, defined by the caller
+ *        1  uint16  msec since the previous record, 0 for the first
+ *        3  uint8   value
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _EVENT_STREAM_H_
+#define _EVENT_STREAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define EVS_HEADER_LEN          (5)
+#define EVS_RECORD_LEN          (4)
+#define EVS_MAX_LEN             (244)  // ATT_MTU 247 - 3
+#define EVS_MIN_MTU             (23)
+#define EVS_DEFAULT_DEADLINE_MS (1000)
+#define EVS_NO_DEADLINE         (UINT32_MAX)
+
+typedef struct
+{
+  uint8_t buf[EVS_MAX_LEN];
+  uint16_t len;           // 0 if empty
+  uint16_t n_records;
+  uint32_t first_ms;
+  uint32_t last_ms;
+  uint32_t types;         // bit per record type present
+} evs_batch;
+
+typedef struct
+{
+  evs_batch open;
+  evs_batch ready;
+  bool is_ready;
+  uint16_t max_len;       // ATT_MTU - 3, capped at EVS_MAX_LEN
+  uint32_t deadline_ms;
+  uint8_t seq;
+  uint32_t records;
+  uint32_t batches;
+  uint32_t dropped;
+} event_stream;
+
+
+/* @brief  Empties both batches and clears the counters, the MTU is the
+ *         minimum until evs_set_mtu
+ *
+ * @param  event_stream*, the stream
+ * @param  uint32_t, flush deadline in msec, 0 for EVS_DEFAULT_DEADLINE_MS
+ * @return None
+ */
+void evs_init(event_stream *s, uint32_t deadline_ms);
+
+
+/* @brief  Sets the negotiated ATT MTU, takes effect from the next batch
+ *
+ * @param  event_stream*, the stream
+ * @param  uint16_t, ATT MTU in bytes
+ * @return None
+ */
+void evs_set_mtu(event_stream *s, uint16_t mtu);
+
+
+/* @brief  Appends a record to the open batch, closing it if full
+ *
+ * @param  event_stream*, the stream
+ * @param  uint8_t, record type, below 32
+ * @param  uint8_t, value
+ * @param  uint32_t, time of the event in msec, not older than the previous
+ * @return false if the record was dropped
+ */
+bool evs_add(event_stream *s, uint8_t type, uint8_t value, uint32_t time_ms);
+
+
+/* @brief  Closes the open batch now, e.g. after an urgent record
+ *
+ * @param  event_stream*, the stream
+ * @return false if the ready slot is taken or nothing is open
+ */
+bool evs_flush(event_stream *s);
+
+
+/* @brief  Closes the open batch if full or past its deadline
+ *
+ * @param  event_stream*, the stream
+ * @param  uint32_t, current time in msec
+ * @return None
+ */
+void evs_poll(event_stream *s, uint32_t now_ms);
+
+
+/* @brief  Returns the msec until the open batch is due
+ *
+ * @param  const event_stream*, the stream
+ * @param  uint32_t, current time in msec
+ * @return 0 if overdue, EVS_NO_DEADLINE if nothing is open
+ */
+uint32_t evs_time_to_deadline(const event_stream *s, uint32_t now_ms);
+
+
+/* @brief  Returns the batch waiting for the radio
+ *
+ * @param  const event_stream*, the stream
+ * @param  const uint8_t**, set to the batch bytes
+ * @return uint32_t, batch length, 0 if none is ready
+ */
+uint32_t evs_ready(const event_stream *s, const uint8_t **data);
+
+
+/* @brief  Frees the ready slot once the batch was delivered or given up
+ *
+ * @param  event_stream*, the stream
+ * @param  uint32_t, current time in msec, a full or due open batch moves
+ *         into the slot
+ * @return None
+ */
+void evs_consume(event_stream *s, uint32_t now_ms);
+
+
+/* @brief  Decodes one record of a batch
+ *
+ * @param  const uint8_t*, batch bytes
+ * @param  uint32_t, batch length
+ * @param  uint32_t, record index
+ * @param  uint8_t*, type
+ * @param  uint8_t*, value
+ * @param  uint32_t*, time in msec, rebuilt from the header and the deltas
+ * @return false if the index is past the last record or the batch is
+ *         malformed
+ */
+bool evs_decode(const uint8_t *batch, uint32_t len, uint32_t index,
+                uint8_t *type, uint8_t *value, uint32_t *time_ms);
+
+#endif // _EVENT_STREAM_H_
@@ -10,8 +10,14 @@
 typedef enum uint32_t {
   evt_none                 = 0x0,
   evt_accel_GPIO_INT1      = 0x1,
+  evt_spi_xfer_done        = 0x2,
+  evt_accel_GPIO_INT2      = 0x4,
+  evt_fall_confirmed       = 0x8,
   evt_letimer0_UF          = 0x10,
-  evt_letimer0_COMP1       = 0x20
+  evt_letimer0_COMP1       = 0x20,
+  evt_alarm_timer          = 0x40,
+  evt_stream_deadline      = 0x80,
+  evt_beacon_timer         = 0x100
 } event_t;
 
 #endif // _EVENTS_H_
@@ -0,0 +1,100 @@
+/* -----------------------------------------------------------------------------
+ * @file   fall_beacon.c
+ * @brief  Connectionless fall alert: manufacturer data on the advertising
+ *         set, burst at a fast interval after a fall
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "fall_beacon.h"
+
+#define AD_TYPE_FLAGS         (0x01)
+#define AD_TYPE_MANUFACTURER  (0xFF)
+#define AD_FLAGS_LE_GENERAL   (0x06) // LE general discoverable, no BR/EDR
+#define MANUFACTURER_LEN      (8)    // type, company id, version, alert
+
+void fall_beacon_init(fall_beacon *fb, uint8_t seq)
+{
+  fb->state = FALL_BEACON_OFF;
+  fb->payload.status = FALL_BEACON_STATUS_NONE;
+  fb->payload.seq = seq;
+  fb->payload.time_s = 0;
+  fb->burst_end_ms = 0;
+  fb->raised = 0;
+}
+
+uint32_t fall_beacon_raise(fall_beacon *fb, uint8_t status, uint32_t event_ms,
+                           uint32_t now_ms)
+{
+  fb->state = FALL_BEACON_BURST;
+  fb->payload.status = status;
+  fb->payload.seq++;
+  fb->payload.time_s = (uint16_t)(event_ms / 1000);
+  fb->burst_end_ms = now_ms + FALL_BEACON_BURST_MS;
+  fb->raised++;
+  return FALL_BEACON_BURST_MS;
+}
+
+bool fall_beacon_step(fall_beacon *fb, uint32_t now_ms)
+{
+  if (fb->state != FALL_BEACON_BURST) return false;
+  if ((int32_t)(now_ms - fb->burst_end_ms) < 0) return false;
+  fb->state = FALL_BEACON_HOLD;
+  return true;
+}
+
+bool fall_beacon_clear(fall_beacon *fb)
+{
+  if (fb->state == FALL_BEACON_OFF) return false;
+  fb->state = FALL_BEACON_OFF;
+  fb->payload.status = FALL_BEACON_STATUS_NONE;
+  return true;
+}
+
+uint16_t fall_beacon_interval(const fall_beacon *fb)
+{
+  return (fb->state == FALL_BEACON_BURST) ? FALL_BEACON_BURST_INTERVAL
+                                          : FALL_BEACON_NORMAL_INTERVAL;
+}
+
+uint32_t fall_beacon_encode(const fall_beacon_payload *p, uint8_t *adv)
+{
+  uint8_t *a = adv;
+  *a++ = 2;
+  *a++ = AD_TYPE_FLAGS;
+  *a++ = AD_FLAGS_LE_GENERAL;
+
+  *a++ = MANUFACTURER_LEN;
+  *a++ = AD_TYPE_MANUFACTURER;
+  *a++ = (uint8_t)FALL_BEACON_COMPANY_ID;
+  *a++ = (uint8_t)(FALL_BEACON_COMPANY_ID >> 8);
+  *a++ = FALL_BEACON_VERSION;
+  *a++ = p->status;
+  *a++ = p->seq;
+  *a++ = (uint8_t)p->time_s;
+  *a++ = (uint8_t)(p->time_s >> 8);
+  return (uint32_t)(a - adv);
+}
+
+bool fall_beacon_decode(const uint8_t *adv, uint32_t len,
+                        fall_beacon_payload *p)
+{
+  uint32_t i = 0;
+  while (i < len)
+  {
+    uint32_t ad_len = adv[i];
+    if (ad_len == 0) break;                // early end of significant part
+    if (i + 1 + ad_len > len) return false;
+    const uint8_t *ad = &adv[i + 1];
+    if (ad[0] == AD_TYPE_MANUFACTURER && ad_len >= MANUFACTURER_LEN &&
+        (ad[1] | (ad[2] << 8)) == FALL_BEACON_COMPANY_ID &&
+        ad[3] == FALL_BEACON_VERSION)
+    {
+      p->status = ad[4];
+      p->seq = ad[5];
+      p->time_s = (uint16_t)(ad[6] | (ad[7] << 8));
+      return true;
+    }
+    i += 1 + ad_len;
+  }
+  return false;
+}
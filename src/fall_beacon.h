@@ -0,0 +1,140 @@
+/* -----------------------------------------------------------------------------
+ * @file   fall_beacon.h
+ * @brief  Connectionless fall alert: manufacturer data on the advertising
+ *         set, burst at a fast interval after a fall
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ *   OFF --raise--> BURST --FALL_BEACON_BURST_MS--> HOLD
+ *    ^                |                              |
+ *    +------------- clear ---------------------------+
+ *
+ * A confirmed alarm is broadcast in the advertising data so any scanning
+ * gateway picks it up without connecting. For FALL_BEACON_BURST_MS the set
+ * advertises every FALL_BEACON_BURST_INTERVAL, then falls back to the normal
+ * interval and keeps the alert in the data until it is cleared (delivered to
+ * or acknowledged by a client). Each raise takes a new sequence number,
+ * scanners de-duplicate on the device address and the sequence number, so
+ * the caller carries the last one across resets (FALL_BEACON_NVM_KEY_SEQ).
+ * Like sampling.c the state machine and the encoder are pure, the caller
+ * programs the advertiser and runs the burst timer.
+ *
+ * Advertising data, legacy PDU:
+ *   0  AD flags, LE general discoverable, BR/EDR not supported
+ *   3  AD manufacturer specific data:
+ *        0  uint8   length, type 0xFF
+ *        2  uint16  FALL_BEACON_COMPANY_ID, little endian
+ *        4  uint8   FALL_BEACON_VERSION
+ *        5  uint8   status, FALL_BEACON_STATUS_*
+ *        6  uint8   sequence number
+ *        7  uint16  uptime of the fall in sec, modulo 2^16, little endian
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _FALL_BEACON_H_
+#define _FALL_BEACON_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FALL_BEACON_COMPANY_ID       (0xFFFF) // reserved for testing
+#define FALL_BEACON_VERSION          (1)
+#define FALL_BEACON_ADV_LEN          (12)
+#define FALL_BEACON_BURST_MS         (30000)
+#define FALL_BEACON_BURST_INTERVAL   (32)  // 20 msec, the legacy minimum
+#define FALL_BEACON_NORMAL_INTERVAL  (160) // 100 msec, as before the alarm
+
+// persistent store key for the last sequence number, next to the offsets
+#define FALL_BEACON_NVM_KEY_SEQ      (0x4001)
+
+#define FALL_BEACON_STATUS_NONE      (0x00)
+#define FALL_BEACON_STATUS_FALL      (0x01)
+
+typedef enum
+{
+  FALL_BEACON_OFF = 0,
+  FALL_BEACON_BURST,
+  FALL_BEACON_HOLD
+} fall_beacon_state;
+
+typedef struct
+{
+  uint8_t status;
+  uint8_t seq;
+  uint16_t time_s;
+} fall_beacon_payload;
+
+typedef struct
+{
+  fall_beacon_state state;
+  fall_beacon_payload payload;
+  uint32_t burst_end_ms;
+  uint32_t raised;
+} fall_beacon;
+
+
+/* @brief  Resets the beacon to OFF
+ *
+ * @param  fall_beacon*, the beacon
+ * @param  uint8_t, sequence number of the last alert, the next raise takes
+ *         the one after it
+ * @return None
+ */
+void fall_beacon_init(fall_beacon *fb, uint8_t seq);
+
+
+/* @brief  Starts broadcasting an alert under a new sequence number
+ *
+ * @param  fall_beacon*, the beacon
+ * @param  uint8_t, FALL_BEACON_STATUS_*
+ * @param  uint32_t, time of the fall in msec
+ * @param  uint32_t, current time in msec
+ * @return uint32_t, msec until the burst ends, for the caller's timer
+ */
+uint32_t fall_beacon_raise(fall_beacon *fb, uint8_t status, uint32_t event_ms,
+                           uint32_t now_ms);
+
+
+/* @brief  Ends the burst once due
+ *
+ * @param  fall_beacon*, the beacon
+ * @param  uint32_t, current time in msec
+ * @return true if the state changed and the advertiser must be updated
+ */
+bool fall_beacon_step(fall_beacon *fb, uint32_t now_ms);
+
+
+/* @brief  Stops broadcasting the alert
+ *
+ * @param  fall_beacon*, the beacon
+ * @return true if the state changed and the advertiser must be updated
+ */
+bool fall_beacon_clear(fall_beacon *fb);
+
+
+/* @brief  Returns the advertising interval for the current state
+ *
+ * @param  const fall_beacon*, the beacon
+ * @return uint16_t, interval in 0.625 msec units
+ */
+uint16_t fall_beacon_interval(const fall_beacon *fb);
+
+
+/* @brief  Encodes the advertising data
+ *
+ * @param  const fall_beacon_payload*, the alert
+ * @param  uint8_t*, FALL_BEACON_ADV_LEN bytes
+ * @return uint32_t, bytes written
+ */
+uint32_t fall_beacon_encode(const fall_beacon_payload *p, uint8_t *adv);
+
+
+/* @brief  Finds and decodes the alert in advertising data, for scanners
+ *
+ * @param  const uint8_t*, advertising data, any AD structures
+ * @param  uint32_t, length
+ * @param  fall_beacon_payload*, the alert
+ * @return false if there is no well formed alert of this version
+ */
+bool fall_beacon_decode(const uint8_t *adv, uint32_t len,
+                        fall_beacon_payload *p);
+
+#endif // _FALL_BEACON_H_
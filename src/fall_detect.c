@@ -0,0 +1,275 @@
+/* -----------------------------------------------------------------------------
+ * @file   fall_detect.c
+ * @brief  Multi-stage fixed-point fall detector run on sample blocks
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include <string.h>
+#include "cycles.h"
+#include "fall_detect.h"
+
+// gravity low-pass divisor, a power of two per the detector preset
+#define GRAVITY_DIV (1 << DET_GRAVITY_SHIFT)
+
+// true once time t has reached the deadline, wrap safe
+static inline bool is_reached(uint32_t t, uint32_t deadline)
+{
+  return (int32_t)(t - deadline) >= 0;
+}
+
+static uint32_t isqrt64(uint64_t v)
+{
+  uint64_t root = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > v) bit >>= 2;
+  while (bit != 0)
+  {
+    if (v >= root + bit)
+    {
+      v -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
+
+static void start_trigger(fall_detector *fd, uint32_t t0)
+{
+  fd->event.trigger_ms = t0;
+  fd->event.impact_ms = t0;
+  fd->event.decided_ms = t0;
+  fd->event.peak_lsb2 = 0;
+  fd->event.cos_q15 = 0;
+  fd->event.failed = FD_STAGE_TRIGGER;
+  for (int i=0; i<3; i++) fd->fall_ref_q4[i] = fd->ref_q4[i];
+  fd->is_trigger_pending = false;
+  fd->is_lowg = false;
+  fd->stage = FD_STAGE_IMPACT;
+  fd->deadline_ms = t0 + FD_IMPACT_WINDOW_MS;
+}
+
+static void decide(fall_detector *fd, uint32_t t, fall_verdict v,
+                   fall_verdict *verdict)
+{
+  fd->event.decided_ms = t;
+  if (v == FALL_REJECTED) fd->event.failed = fd->stage;
+  fd->stage = FD_STAGE_TRIGGER;
+  if (*verdict == FALL_NONE) *verdict = v;
+}
+
+// stage 0: track gravity, look for a low-g run or a pending trigger
+static uint32_t stage_trigger(fall_detector *fd, const accel_block *blk,
+                              uint32_t i)
+{
+  for (; i<blk->n; i++)
+  {
+    uint32_t t = blk->timestamps[i];
+    if (fd->is_trigger_pending && is_reached(t, fd->pending_ms))
+    {
+      start_trigger(fd, fd->pending_ms);
+      return i;
+    }
+
+    if (blk->mag2[i] < FD_FREEFALL_LSB2)
+    {
+      if (!fd->is_lowg)
+      {
+        fd->is_lowg = true;
+        fd->lowg_start_ms = t;
+      }
+      else if (is_reached(t, fd->lowg_start_ms + FD_FREEFALL_MS))
+      {
+        start_trigger(fd, fd->lowg_start_ms);
+        return i+1;
+      }
+    }
+    else
+    {
+      // gravity reference low-pass, free-fall samples excluded
+      fd->is_lowg = false;
+      fd->ref_q4[0] += ((int32_t)blk->x[i]*16 - fd->ref_q4[0]) / GRAVITY_DIV;
+      fd->ref_q4[1] += ((int32_t)blk->y[i]*16 - fd->ref_q4[1]) / GRAVITY_DIV;
+      fd->ref_q4[2] += ((int32_t)blk->z[i]*16 - fd->ref_q4[2]) / GRAVITY_DIV;
+    }
+  }
+  return i;
+}
+
+// stage 1: peak magnitude within the impact window
+static uint32_t stage_impact(fall_detector *fd, const accel_block *blk,
+                             uint32_t i, fall_verdict *verdict)
+{
+  for (; i<blk->n; i++)
+  {
+    uint32_t t = blk->timestamps[i];
+    if (is_reached(t, fd->deadline_ms))
+    {
+      if (fd->event.peak_lsb2 < FD_IMPACT_LSB2)
+      {
+        decide(fd, t, FALL_REJECTED, verdict);
+        return i;
+      }
+      fd->still_sum[0] = fd->still_sum[1] = fd->still_sum[2] = 0;
+      fd->still_n = 0;
+      fd->still_out = 0;
+      fd->stage = FD_STAGE_STILLNESS;
+      fd->deadline_ms = fd->event.impact_ms + FD_SETTLE_MS + FD_STILL_MS;
+      return i;
+    }
+    if (blk->mag2[i] > fd->event.peak_lsb2)
+    {
+      fd->event.peak_lsb2 = blk->mag2[i];
+      fd->event.impact_ms = t;
+    }
+  }
+  return i;
+}
+
+// stage 2: magnitude near 1 g after the bounce has settled
+static uint32_t stage_stillness(fall_detector *fd, const accel_block *blk,
+                                uint32_t i, fall_verdict *verdict)
+{
+  uint32_t still_start = fd->deadline_ms - FD_STILL_MS;
+  for (; i<blk->n; i++)
+  {
+    uint32_t t = blk->timestamps[i];
+    if (is_reached(t, fd->deadline_ms))
+    {
+      // tolerate 1 in 8 samples outside the band, e.g. breathing or a twitch
+      if (fd->still_n == 0 || fd->still_out*8 > fd->still_n)
+      {
+        decide(fd, t, FALL_REJECTED, verdict);
+      }
+      else
+      {
+        fd->stage = FD_STAGE_ORIENTATION;
+      }
+      return i;
+    }
+    if (!is_reached(t, still_start)) continue;
+
+    uint32_t m = blk->mag2[i];
+    if (m < FD_STILL_LO_LSB2 || m > FD_STILL_HI_LSB2) fd->still_out++;
+    fd->still_sum[0] += blk->x[i];
+    fd->still_sum[1] += blk->y[i];
+    fd->still_sum[2] += blk->z[i];
+    fd->still_n++;
+  }
+  return i;
+}
+
+// stage 3: angle between gravity before the fall and while lying still
+static void stage_orientation(fall_detector *fd, uint32_t t,
+                              fall_verdict *verdict)
+{
+  int64_t dot = 0;
+  uint64_t a2 = 0;
+  uint64_t b2 = 0;
+  for (int k=0; k<3; k++)
+  {
+    int64_t a = fd->fall_ref_q4[k];
+    int64_t b = (int64_t)fd->still_sum[k] * 16 / (int32_t)fd->still_n;
+    dot += a*b;
+    a2 += (uint64_t)(a*a);
+    b2 += (uint64_t)(b*b);
+  }
+
+  uint64_t norm = (uint64_t)isqrt64(a2) * isqrt64(b2);
+  int32_t cos_q15 = 0; // no reference yet: cannot rule a change out
+  if (norm != 0)
+  {
+    int64_t c = (dot * 32768) / (int64_t)norm;
+    if (c > INT16_MAX) c = INT16_MAX;
+    if (c < INT16_MIN) c = INT16_MIN;
+    cos_q15 = (int32_t)c;
+  }
+  fd->event.cos_q15 = (int16_t)cos_q15;
+
+  decide(fd, t, (cos_q15 < FD_ORIENT_COS_Q15) ? FALL_CONFIRMED : FALL_REJECTED,
+         verdict);
+}
+
+void fall_detect_init(fall_detector *fd)
+{
+  fd->stage = FD_STAGE_TRIGGER;
+  fd->deadline_ms = 0;
+  fd->lowg_start_ms = 0;
+  fd->is_lowg = false;
+  fd->is_trigger_pending = false;
+  fd->pending_ms = 0;
+  for (int i=0; i<3; i++)
+  {
+    fd->ref_q4[i] = 0;
+    fd->fall_ref_q4[i] = 0;
+    fd->still_sum[i] = 0;
+  }
+  fd->still_n = 0;
+  fd->still_out = 0;
+  memset(&fd->event, 0, sizeof(fd->event));
+  memset(&fd->stats, 0, sizeof(fd->stats));
+
+  cycles_init();
+}
+
+void fall_detect_trigger(fall_detector *fd, uint32_t now_ms)
+{
+  // a trigger while confirming is the same fall
+  if (fd->stage != FD_STAGE_TRIGGER) return;
+  fd->is_trigger_pending = true;
+  fd->pending_ms = now_ms;
+}
+
+fall_verdict fall_detect_process(fall_detector *fd, const accel_block *blk)
+{
+  fall_verdict verdict = FALL_NONE;
+  uint32_t i = 0;
+
+  while (i < blk->n)
+  {
+    fall_stage stage = fd->stage;
+    uint32_t start = cycles_now();
+    uint32_t next = i;
+
+    switch (stage)
+    {
+      case FD_STAGE_TRIGGER:
+        next = stage_trigger(fd, blk, i);
+        break;
+      case FD_STAGE_IMPACT:
+        next = stage_impact(fd, blk, i, &verdict);
+        break;
+      case FD_STAGE_STILLNESS:
+        next = stage_stillness(fd, blk, i, &verdict);
+        break;
+      case FD_STAGE_ORIENTATION:
+        stage_orientation(fd, blk->timestamps[i], &verdict);
+        break;
+      default:
+        fd->stage = FD_STAGE_TRIGGER;
+        break;
+    }
+
+    uint32_t elapsed = cycles_now() - start;
+    fd->stats.cycles[stage] += elapsed;
+    if (elapsed > fd->stats.max_cycles[stage]) fd->stats.max_cycles[stage] = elapsed;
+    fd->stats.samples[stage] += next - i;
+    i = next;
+  }
+  return verdict;
+}
+
+const fall_event *fall_detect_last_event(const fall_detector *fd)
+{
+  return &fd->event;
+}
+
+const fall_detect_stats *fall_detect_get_stats(const fall_detector *fd)
+{
+  return &fd->stats;
+}
@@ -0,0 +1,144 @@
+/* -----------------------------------------------------------------------------
+ * @file   fall_detect.h
+ * @brief  Multi-stage fixed-point fall detector run on sample blocks
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * A free-fall (from the INT_FREE_FALL interrupt or a low-g run in the stream)
+ * only arms the detector. A fall is confirmed when it is followed by:
+ *   1. an impact, a signal vector magnitude peak within FD_IMPACT_WINDOW_MS
+ *   2. stillness, the magnitude stays near 1 g for FD_STILL_MS after settling
+ *   3. an orientation change, gravity during stillness is at least
+ *      FD_ORIENT_MIN_DEG away from gravity before the free-fall
+ * Magnitudes are compared squared (x^2 + y^2 + z^2 in LSB^2) so no sqrt is
+ * needed per sample, the angle test is a Q15 cosine. Pure integer code, no
+ * hardware access apart from the optional DWT cycle counter on target.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _FALL_DETECT_H_
+#define _FALL_DETECT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "accel_config.h"
+#include "accel_decode.h"
+
+// stage parameters in physical units
+#define FD_FREEFALL_MG        (400)  // low-g below this counts as free-fall
+#define FD_FREEFALL_MS        (100)  // minimum low-g run in the stream
+#define FD_IMPACT_MG          (2500) // impact peak above this
+#define FD_IMPACT_WINDOW_MS   (1000) // impact must follow the trigger within
+#define FD_SETTLE_MS          (1000) // bounce after the impact, ignored
+#define FD_STILL_MS           (2000) // stillness observation window
+#define FD_STILL_BAND_MG      (250)  // allowed deviation from 1 g when still
+#define FD_ORIENT_COS_Q15     (23170) // cos(45 deg), FD_ORIENT_MIN_DEG
+#define FD_ORIENT_MIN_DEG     (45)
+
+// squared thresholds on the sample scale, folded at compile time
+#define FD_FREEFALL_LSB2      ACCEL_MG_TO_LSB2(FD_FREEFALL_MG)
+#define FD_IMPACT_LSB2        ACCEL_MG_TO_LSB2(FD_IMPACT_MG)
+#define FD_STILL_LO_LSB2      ACCEL_MG_TO_LSB2(1000 - FD_STILL_BAND_MG)
+#define FD_STILL_HI_LSB2      ACCEL_MG_TO_LSB2(1000 + FD_STILL_BAND_MG)
+
+#if FD_IMPACT_MG >= ACCEL_RANGE_G * 1000
+#error "impact threshold is beyond the selected range"
+#endif
+
+typedef enum
+{
+  FD_STAGE_TRIGGER = 0,
+  FD_STAGE_IMPACT,
+  FD_STAGE_STILLNESS,
+  FD_STAGE_ORIENTATION,
+  FD_NUM_STAGES
+} fall_stage;
+
+typedef enum
+{
+  FALL_NONE = 0,      // nothing decided in this block
+  FALL_CONFIRMED,     // all stages passed
+  FALL_REJECTED       // a trigger failed a confirmation stage
+} fall_verdict;
+
+// outcome of the last trigger
+typedef struct
+{
+  uint32_t trigger_ms;  // start of the free-fall
+  uint32_t impact_ms;   // time of the impact peak
+  uint32_t decided_ms;  // time of the verdict
+  uint32_t peak_lsb2;   // impact peak magnitude, squared
+  int16_t  cos_q15;     // cosine of the orientation change
+  fall_stage failed;    // stage that rejected, valid for FALL_REJECTED
+} fall_event;
+
+// per-stage cost, cycles are only counted on target (DWT)
+typedef struct
+{
+  uint32_t cycles[FD_NUM_STAGES];
+  uint32_t max_cycles[FD_NUM_STAGES]; // worst single stage call
+  uint32_t samples[FD_NUM_STAGES];
+} fall_detect_stats;
+
+typedef struct
+{
+  fall_stage stage;
+  uint32_t deadline_ms;      // end of the current stage's window
+  uint32_t lowg_start_ms;    // start of the current low-g run
+  bool is_lowg;
+  bool is_trigger_pending;   // trigger from the interrupt, not yet reached
+  uint32_t pending_ms;
+  int32_t ref_q4[3];         // low-pass gravity before the trigger, LSB Q4
+  int32_t fall_ref_q4[3];    // ref_q4 frozen at the trigger
+  int32_t still_sum[3];
+  uint32_t still_n;
+  uint32_t still_out;        // samples outside the 1 g band
+  fall_event event;
+  fall_detect_stats stats;
+} fall_detector;
+
+
+/* @brief  Resets the detector and enables the cycle counter on target
+ *
+ * @param  fall_detector*, the detector
+ * @return None
+ */
+void fall_detect_init(fall_detector *fd);
+
+
+/* @brief  Arms the detector from the free-fall interrupt
+ *
+ * Samples are processed after the FIFO drain, so the trigger takes effect
+ * once the stream reaches the given time.
+ *
+ * @param  fall_detector*, the detector
+ * @param  uint32_t, time of the interrupt in msec
+ * @return None
+ */
+void fall_detect_trigger(fall_detector *fd, uint32_t now_ms);
+
+
+/* @brief  Runs the stages over a block of samples
+ *
+ * @param  fall_detector*, the detector
+ * @param  const accel_block*, decoded samples with mag2 and timestamps
+ * @return fall_verdict, the first verdict reached in this block
+ */
+fall_verdict fall_detect_process(fall_detector *fd, const accel_block *blk);
+
+
+/* @brief  Returns the outcome of the last trigger
+ *
+ * @param  const fall_detector*, the detector
+ * @return const fall_event*
+ */
+const fall_event *fall_detect_last_event(const fall_detector *fd);
+
+
+/* @brief  Returns the per-stage timing counters
+ *
+ * @param  const fall_detector*, the detector
+ * @return const fall_detect_stats*
+ */
+const fall_detect_stats *fall_detect_get_stats(const fall_detector *fd);
+
+#endif // _FALL_DETECT_H_
@@ -0,0 +1,58 @@
+/* -----------------------------------------------------------------------------
+ * @file   fall_model.c
+ * @brief  int8 model tables, generated by tools/nn_convert.py
+ *         from tools/fall_model.json, do not edit
+ * ----------------------------------------------------------------------------*/
+
+#include "fall_model.h"
+
+static const int8_t layer0_weights[36] = {
+  -127, 0, 0, 127, 0, 0, 127, 0, 0, -127, 0, 0, 0, -127, 0, 0,
+  127, 0, 0, 127, 0, 0, -127, 0, 0, 0, -127, 0, 0, 127, 0, 0,
+  127, 0, 0, -127
+};
+
+static const int32_t layer0_bias[6] = {
+  0, 0, 0, 0, 0, 0
+};
+
+static const int8_t layer1_weights[186] = {
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
+  127, 127, 127, 127, 127, 127, 127, 127, 127, 127
+};
+
+static const int32_t layer1_bias[1] = {
+  0
+};
+
+static const int8_t layer2_weights[2] = {
+  0, 127
+};
+
+static const int32_t layer2_bias[2] = {
+  6096, 0
+};
+
+static const nn_layer layers[] = {
+  { NN_CONV1D, 32, 3, 31, 6, 2, 1, true, layer0_weights, layer0_bias, 1082196484, 6 },
+  { NN_CONV1D, 31, 6, 1, 1, 31, 1, true, layer1_weights, layer1_bias, 1082196484, 8 },
+  { NN_DENSE, 1, 1, 1, 2, 0, 0, false, layer2_weights, layer2_bias, 1082196484, 6 },
+};
+
+const nn_model fall_model = {
+  .layers = layers,
+  .n_layers = 3,
+  .in_size = 96,
+  .out_size = 2,
+  .scratch_size = FALL_MODEL_SCRATCH_SIZE
+};
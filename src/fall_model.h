@@ -0,0 +1,26 @@
+/* -----------------------------------------------------------------------------
+ * @file   fall_model.h
+ * @brief  int8 model tables, generated by tools/nn_convert.py
+ *         from tools/fall_model.json, do not edit
+ * ----------------------------------------------------------------------------*/
+
+#ifndef _FALL_MODEL_H_
+#define _FALL_MODEL_H_
+
+#include "nn.h"
+
+#define FALL_MODEL_IN_LEN        (32)
+#define FALL_MODEL_IN_CH         (3)
+#define FALL_MODEL_IN_STEPS      (16) // input steps per unit, 1/in_scale
+#define FALL_MODEL_SCRATCH_SIZE  (372)
+
+typedef enum
+{
+  FALL_MODEL_CLASS_ADL = 0,
+  FALL_MODEL_CLASS_FALL = 1,
+  FALL_MODEL_NUM_CLASSES
+} fall_model_class;
+
+extern const nn_model fall_model;
+
+#endif // _FALL_MODEL_H_
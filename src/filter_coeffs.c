@@ -0,0 +1,57 @@
+/* -----------------------------------------------------------------------------
+ * @file   filter_coeffs.c
+ * @brief  Biquad cascades for the detector preset, generated by
+ *         tools/biquad_design.py, do not edit
+ * ----------------------------------------------------------------------------*/
+
+#include "detector_config.h"
+#include "filter_coeffs.h"
+
+#if DETECTOR_PRESET == 0 // 100 Hz
+
+static const biquad_coeffs filter_gravity_hp_stages[] = {
+  { 16024, -32048, 16024, 32040, -15672 }, // hp 0.5 Hz
+};
+
+static const biquad_coeffs filter_impact_bp_stages[] = {
+  { 14339, -28678, 14339, 28422, -12550 }, // hp 3 Hz
+  { 2148, 4296, 2148, 12252, -4460 }, // lp 15 Hz
+};
+
+#elif DETECTOR_PRESET == 1 // 50 Hz
+
+static const biquad_coeffs filter_gravity_hp_stages[] = {
+  { 15672, -31344, 15672, 31313, -14991 }, // hp 0.5 Hz
+};
+
+static const biquad_coeffs filter_impact_bp_stages[] = {
+  { 12544, -25087, 12544, 24174, -9616 }, // hp 3 Hz
+  { 6412, 12823, 6412, -6054, -3208 }, // lp 15 Hz
+};
+
+#elif DETECTOR_PRESET == 2 // 25 Hz
+
+static const biquad_coeffs filter_gravity_hp_stages[] = {
+  { 14991, -29982, 14991, 29863, -13716 }, // hp 0.5 Hz
+};
+
+static const biquad_coeffs filter_impact_bp_stages[] = {
+  { 9544, -19088, 9544, 16096, -5696 }, // hp 3 Hz
+  { 10468, 20937, 10468, -18727, -6763 }, // lp 10 Hz
+};
+
+#else
+#error "no filter coefficients for DETECTOR_PRESET"
+#endif
+
+const biquad_design filter_gravity_hp = {
+  .stages = filter_gravity_hp_stages,
+  .n_stages = 1,
+  .post_shift = 1
+};
+
+const biquad_design filter_impact_bp = {
+  .stages = filter_impact_bp_stages,
+  .n_stages = 2,
+  .post_shift = 1
+};
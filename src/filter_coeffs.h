@@ -0,0 +1,15 @@
+/* -----------------------------------------------------------------------------
+ * @file   filter_coeffs.h
+ * @brief  Biquad cascades for the detector preset, generated by
+ *         tools/biquad_design.py, do not edit
+ * ----------------------------------------------------------------------------*/
+
+#ifndef _FILTER_COEFFS_H_
+#define _FILTER_COEFFS_H_
+
+#include "biquad.h"
+
+extern const biquad_design filter_gravity_hp; // gravity removal, 0.5 Hz high-pass
+extern const biquad_design filter_impact_bp; // impact band, 3 Hz high-pass and 15 Hz low-pass
+
+#endif // _FILTER_COEFFS_H_
@@ -0,0 +1,122 @@
+/* -----------------------------------------------------------------------------
+ * @file   nn.c
+ * @brief  Minimal int8 inference runtime: dense and 1-D convolution layers
+ *         with fused ReLU, and argmax
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "nn.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+  #include "em_device.h" // CMSIS core, SIMD intrinsics
+  #define NN_DSP (1)
+#else
+  #define NN_DSP (0)
+#endif
+
+int32_t nn_dot_q7_ref(const int8_t *a, const int8_t *b, uint32_t n)
+{
+  int32_t acc = 0;
+  for (uint32_t i=0; i<n; i++) acc += (int32_t)a[i] * b[i];
+  return acc;
+}
+
+int32_t nn_dot_q7(const int8_t *a, const int8_t *b, uint32_t n)
+{
+#if NN_DSP
+  int32_t acc = 0;
+  uint32_t i = 0;
+  for (; i+4<=n; i+=4)
+  {
+    uint32_t wa;
+    uint32_t wb;
+    memcpy(&wa, &a[i], 4); // unaligned word loads are fine on the M4
+    memcpy(&wb, &b[i], 4);
+    // bytes 0,2 and 1,3 sign extended to halfword pairs, then two dual MACs
+    uint32_t a02 = __SXTB16(wa);
+    uint32_t a13 = __SXTB16(__ROR(wa, 8));
+    uint32_t b02 = __SXTB16(wb);
+    uint32_t b13 = __SXTB16(__ROR(wb, 8));
+    acc = (int32_t)__SMLAD(a02, b02, (uint32_t)acc);
+    acc = (int32_t)__SMLAD(a13, b13, (uint32_t)acc);
+  }
+  for (; i<n; i++) acc += (int32_t)a[i] * b[i];
+  return acc;
+#else
+  return nn_dot_q7_ref(a, b, n);
+#endif
+}
+
+// acc * mult / 2^(31 + shift), rounded, saturated to int8
+static inline int8_t requantize(int32_t acc, int32_t mult, int32_t shift,
+                                bool relu)
+{
+  int32_t total = 31 + shift;
+  int64_t prod = (int64_t)acc * mult;
+  int32_t v = (int32_t)((prod + ((int64_t)1 << (total - 1))) >> total);
+  if (v > INT8_MAX) v = INT8_MAX;
+  if (v < (relu ? 0 : INT8_MIN)) v = relu ? 0 : INT8_MIN;
+  return (int8_t)v;
+}
+
+static void run_layer(const nn_layer *l, const int8_t *in, int8_t *out)
+{
+  // a dense layer is a convolution whose kernel spans the whole input
+  uint32_t window = (l->type == NN_DENSE) ? (uint32_t)l->in_len * l->in_ch
+                                          : (uint32_t)l->kernel * l->in_ch;
+  uint32_t step = (l->type == NN_DENSE) ? 0 : (uint32_t)l->stride * l->in_ch;
+
+  for (uint32_t t=0; t<l->out_len; t++)
+  {
+    const int8_t *x = &in[t * step];
+    const int8_t *w = l->weights;
+    for (uint32_t o=0; o<l->out_ch; o++, w+=window)
+    {
+      int32_t acc = l->bias[o] + nn_dot_q7(x, w, window);
+      *out++ = requantize(acc, l->mult, l->shift, l->relu);
+    }
+  }
+}
+
+int nn_run(const nn_model *model, const int8_t *input, int8_t *scratch,
+           size_t scratch_len, const int8_t **output)
+{
+  if (scratch_len < model->scratch_size) return -1;
+
+  size_t half = model->scratch_size / 2;
+  const int8_t *in = input;
+  uint32_t in_size = model->in_size;
+
+  for (uint32_t i=0; i<model->n_layers; i++)
+  {
+    const nn_layer *l = &model->layers[i];
+    uint32_t need = (uint32_t)l->in_len * l->in_ch;
+    uint32_t produced = (uint32_t)l->out_len * l->out_ch;
+    if (need != in_size || produced > half) return -1;
+    if (l->type == NN_CONV1D &&
+        (uint32_t)(l->out_len - 1) * l->stride + l->kernel > l->in_len)
+    {
+      return -1;
+    }
+
+    int8_t *out = &scratch[(i & 1) * half];
+    run_layer(l, in, out);
+    in = out;
+    in_size = produced;
+  }
+
+  if (in_size != model->out_size) return -1;
+  *output = in;
+  return 0;
+}
+
+uint32_t nn_argmax(const int8_t *v, uint32_t n)
+{
+  uint32_t best = 0;
+  for (uint32_t i=1; i<n; i++)
+  {
+    if (v[i] > v[best]) best = i;
+  }
+  return best;
+}
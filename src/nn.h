@@ -0,0 +1,97 @@
+/* -----------------------------------------------------------------------------
+ * @file   nn.h
+ * @brief  Minimal int8 inference runtime: dense and 1-D convolution layers
+ *         with fused ReLU, and argmax
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Activations and weights are symmetric int8 (zero point 0), biases int32 at
+ * the accumulator scale. Each layer requantizes its int32 accumulators with a
+ * Q31 multiplier and a right shift. Models are const tables in flash,
+ * generated by tools/nn_convert.py. Activations are channels-last, so a
+ * convolution window is one contiguous run of kernel * in_ch bytes and every
+ * layer reduces to int8 dot products. On the Cortex-M4 the dot product uses
+ * SXTB16/SMLAD (four MACs per pair of instructions), elsewhere a portable C
+ * loop with identical results.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _NN_H_
+#define _NN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+  NN_DENSE = 0,
+  NN_CONV1D
+} nn_layer_type;
+
+typedef struct
+{
+  nn_layer_type type;
+  uint16_t in_len;      // time steps in (1 for dense)
+  uint16_t in_ch;       // channels in (features for dense)
+  uint16_t out_len;     // time steps out (1 for dense)
+  uint16_t out_ch;      // channels out (units for dense)
+  uint16_t kernel;      // conv only
+  uint16_t stride;      // conv only
+  bool relu;            // fused ReLU on the output
+  const int8_t *weights;   // [out_ch][kernel * in_ch]
+  const int32_t *bias;     // [out_ch]
+  int32_t mult;         // requantization multiplier, Q31
+  int32_t shift;        // requantization right shift, applied after mult
+} nn_layer;
+
+typedef struct
+{
+  const nn_layer *layers;
+  uint16_t n_layers;
+  uint16_t in_size;     // input bytes
+  uint16_t out_size;    // output bytes
+  uint16_t scratch_size; // bytes of scratch nn_run() needs
+} nn_model;
+
+
+/* @brief  Runs a model
+ *
+ * Intermediate activations ping-pong between two halves of the scratch
+ * buffer, the input buffer is only read.
+ *
+ * @param  const nn_model*, the model
+ * @param  const int8_t*, in_size input bytes
+ * @param  int8_t*, scratch buffer
+ * @param  size_t, scratch buffer length, at least scratch_size
+ * @param  const int8_t**, set to the out_size output bytes in scratch
+ * @return -1 if scratch is too small or a layer does not chain, 0 upon success
+ */
+int nn_run(const nn_model *model, const int8_t *input, int8_t *scratch,
+           size_t scratch_len, const int8_t **output);
+
+
+/* @brief  Returns the index of the largest value, the first on ties
+ *
+ * @param  const int8_t*, values
+ * @param  uint32_t, number of values
+ * @return uint32_t, index
+ */
+uint32_t nn_argmax(const int8_t *v, uint32_t n);
+
+
+/* @brief  int8 dot product, SIMD on the Cortex-M4
+ *
+ * @param  const int8_t*, a, no alignment requirement
+ * @param  const int8_t*, b, no alignment requirement
+ * @param  uint32_t, length
+ * @return int32_t, sum of a[i] * b[i]
+ */
+int32_t nn_dot_q7(const int8_t *a, const int8_t *b, uint32_t n);
+
+
+/* @brief  Portable reference of nn_dot_q7()
+ *
+ * Same parameters and result as nn_dot_q7().
+ */
+int32_t nn_dot_q7_ref(const int8_t *a, const int8_t *b, uint32_t n);
+
+#endif // _NN_H_
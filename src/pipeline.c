@@ -0,0 +1,352 @@
+/* -----------------------------------------------------------------------------
+ * @file   pipeline.c
+ * @brief  Sample pipeline between acquisition (FIFO drains) and processing
+ *         (main loop)
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "pipeline.h"
+
+// rate switches not yet passed by the consumer, producer and consumer both
+// run in the main loop so the history needs no synchronization
+#define RATE_HISTORY_LEN (4)
+
+typedef struct
+{
+  uint32_t first_ms;  // BW_RATE write, later samples are at this period
+  uint32_t period_ms;
+} rate_segment;
+
+typedef enum
+{
+  CAL_IDLE,
+  CAL_ARMED,
+  CAL_RUNNING,
+} calibration_state;
+
+static sample_ring accel_ring;
+static accel_block block;
+static uint32_t *drain_timestamps;
+static uint32_t processed;
+static rate_segment rates[RATE_HISTORY_LEN]; // oldest first
+static uint32_t n_rates;
+static calibration_state cal_state;
+static calibration_context cal_ctx;
+static fall_detector detector;
+static feature_engine features;
+static posture_context posture;
+static blackbox recorder;
+static posture_class posture_before_fall;
+static biquad_bank impact_filter;
+static accel_block impact_band;
+static uint32_t impact_band_peak; // largest band-passed magnitude^2 since trigger
+
+// classifier input, the latest FALL_MODEL_IN_LEN samples, channels-last
+static int8_t nn_input[FALL_MODEL_IN_LEN * FALL_MODEL_IN_CH];
+static int8_t nn_scratch[FALL_MODEL_SCRATCH_SIZE];
+static uint32_t nn_fall_ms;
+static bool is_nn_fall_seen;
+
+static void calibration_stage(const accel_block *blk);
+static void fall_stage_report(fall_verdict verdict);
+static void classifier_window(const accel_block *blk);
+static void classifier_stage(const accel_block *blk);
+static void impact_band_stage(bool is_new_event);
+static void detection_stages();
+static uint32_t period_at(uint32_t t_ms);
+static uint32_t block_period(const uint32_t *timestamps, uint32_t *n);
+
+void pipeline_init()
+{
+  sample_ring_init(&accel_ring);
+  drain_timestamps = NULL;
+  processed = 0;
+  // accel_init() programs the detector's rate
+  rates[0].first_ms = 0;
+  rates[0].period_ms = DET_PERIOD_MS;
+  n_rates = 1;
+  cal_state = CAL_IDLE;
+  fall_detect_init(&detector);
+  features_init(&features);
+  posture_init(&posture);
+  blackbox_init(&recorder);
+  posture_before_fall = POSTURE_UNKNOWN;
+  biquad_init(&impact_filter, &filter_impact_bp);
+  impact_band_peak = 0;
+  memset(nn_input, 0, sizeof(nn_input));
+  is_nn_fall_seen = false;
+}
+
+uint32_t pipeline_blackbox_data(const uint8_t **data)
+{
+  return blackbox_data(&recorder, data);
+}
+
+const feature_engine *pipeline_features()
+{
+  return &features;
+}
+
+const fall_event *pipeline_last_fall()
+{
+  return fall_detect_last_event(&detector);
+}
+
+void pipeline_fall_trigger(uint32_t now_ms)
+{
+  fall_detect_trigger(&detector, now_ms);
+}
+
+void pipeline_request_calibration()
+{
+  cal_state = CAL_ARMED;
+}
+
+void pipeline_set_still(bool is_still)
+{
+  if (is_still && cal_state == CAL_ARMED)
+  {
+    calibration_reset(&cal_ctx);
+    cal_state = CAL_RUNNING;
+  }
+  else if (!is_still && cal_state == CAL_RUNNING)
+  {
+    LOG("calibration: movement, window discarded");
+    cal_state = CAL_ARMED;
+  }
+}
+
+uint32_t pipeline_drain_span(accel_sample **buf)
+{
+  return sample_ring_write_span(&accel_ring, buf, &drain_timestamps);
+}
+
+void pipeline_set_rate(uint32_t period_ms, uint32_t switch_ms)
+{
+  if (rates[n_rates-1].period_ms == period_ms) return;
+  if (n_rates == RATE_HISTORY_LEN)
+  {
+    memmove(&rates[0], &rates[1], (RATE_HISTORY_LEN-1) * sizeof(rates[0]));
+    n_rates--;
+  }
+  rates[n_rates].first_ms = switch_ms;
+  rates[n_rates].period_ms = period_ms;
+  n_rates++;
+}
+
+void pipeline_commit(uint32_t n, uint32_t drain_ms)
+{
+  if (n == 0 || drain_timestamps == NULL) return;
+  uint32_t t = drain_ms;
+  for (uint32_t i=n; i>0; i--)
+  {
+    drain_timestamps[i-1] = t;
+    t -= period_at(t);
+  }
+  sample_ring_commit(&accel_ring, n);
+  drain_timestamps = NULL;
+}
+
+void pipeline_process()
+{
+  const accel_sample *samples;
+  const uint32_t *timestamps;
+  uint32_t n;
+
+  while ((n = sample_ring_read_span(&accel_ring, &samples, &timestamps)) > 0)
+  {
+    if (n > ACCEL_BLOCK_LEN) n = ACCEL_BLOCK_LEN;
+    uint32_t period = block_period(timestamps, &n);
+
+    // accel_sample is the raw little endian DATAX0..DATAZ1 layout, so the
+    // ring contents are decoded in place
+    accel_decode_batch((const uint8_t *)samples, n,
+                       block.x, block.y, block.z, block.mag2);
+    block.timestamps = timestamps;
+    block.n = n;
+
+    blackbox_push(&recorder, samples, n, timestamps[n-1], period);
+
+    // the filters, windows and thresholds are designed for DET_RATE_HZ.
+    // Monitor blocks are skipped, their state carries over the gap: monitor
+    // only follows a still capture hold, so it has settled at rest
+    if (period == DET_PERIOD_MS) detection_stages();
+    if (cal_state == CAL_RUNNING) calibration_stage(&block);
+
+    processed += n;
+    sample_ring_release(&accel_ring, n);
+  }
+}
+
+static void detection_stages()
+{
+  // processing stages consume the block here, timestamps stay valid until
+  // the entries are released
+  features_push_block(&features, &block);
+  classifier_window(&block);
+  posture_class prev_posture = posture.posture;
+  posture_update(&posture, &block);
+  biquad_process_block(&impact_filter, &block, &impact_band);
+
+  fall_stage prev_stage = detector.stage;
+  fall_verdict verdict = fall_detect_process(&detector, &block);
+  if (prev_stage == FD_STAGE_TRIGGER && detector.stage != FD_STAGE_TRIGGER)
+  {
+    // triggered in this block, keep the posture from before the event and
+    // freeze the recent samples for offload
+    posture_before_fall = prev_posture;
+    blackbox_freeze(&recorder, detector.event.trigger_ms, ACCEL_LSB_PER_G);
+  }
+  if (detector.stage != FD_STAGE_TRIGGER || verdict != FALL_NONE)
+  {
+    // the classifier only gives a second opinion on an armed detector, so it
+    // runs from the trigger to the verdict and not on every block
+    impact_band_stage(prev_stage == FD_STAGE_TRIGGER);
+    classifier_stage(&block);
+  }
+  if (verdict != FALL_NONE) fall_stage_report(verdict);
+}
+
+// period of a sample taken at t_ms. The first sample at a new rate comes
+// one period after the BW_RATE write, so a sample stamped at the switch
+// itself is the last one at the old rate
+static uint32_t period_at(uint32_t t_ms)
+{
+  for (uint32_t r=n_rates-1; r>0; r--)
+  {
+    if ((int32_t)(t_ms - rates[r].first_ms) > 0) return rates[r].period_ms;
+  }
+  return rates[0].period_ms;
+}
+
+// period of the oldest queued sample, cuts n at the next rate switch and
+// forgets the switches the consumer has passed
+static uint32_t block_period(const uint32_t *timestamps, uint32_t *n)
+{
+  while (n_rates > 1 && (int32_t)(timestamps[0] - rates[1].first_ms) > 0)
+  {
+    memmove(&rates[0], &rates[1], (n_rates-1) * sizeof(rates[0]));
+    n_rates--;
+  }
+  if (n_rates > 1)
+  {
+    for (uint32_t i=1; i<*n; i++)
+    {
+      if ((int32_t)(timestamps[i] - rates[1].first_ms) > 0)
+      {
+        *n = i;
+        break;
+      }
+    }
+  }
+  return rates[0].period_ms;
+}
+
+static void calibration_stage(const accel_block *blk)
+{
+  if (!calibration_add(&cal_ctx, blk->x, blk->y, blk->z, blk->n)) return;
+
+  int8_t current[3];
+  int8_t offsets[3];
+  accel_get_offsets(current);
+  if (calibration_compute(&cal_ctx, current, offsets) != 0)
+  {
+    LOG("calibration: window not still, retrying");
+    calibration_reset(&cal_ctx);
+    return;
+  }
+
+  LOG("calibration: offsets %d %d %d", offsets[0], offsets[1], offsets[2]);
+  cal_state = CAL_IDLE;
+  if (accel_set_offsets(offsets) == 0)
+  {
+    accel_offsets_save(offsets);
+  }
+}
+
+static void fall_stage_report(fall_verdict verdict)
+{
+  const fall_event *e = fall_detect_last_event(&detector);
+  const fall_detect_stats *st = fall_detect_get_stats(&detector);
+
+  if (verdict == FALL_CONFIRMED)
+  {
+    sl_bt_external_signal(evt_fall_confirmed);
+  }
+  blackbox_set_flags(&recorder, (verdict == FALL_CONFIRMED) ?
+                     BLACKBOX_FLAG_CONFIRMED : BLACKBOX_FLAG_REJECTED);
+  // second opinion only, the classifier does not gate the alarm
+  bool is_nn_agreed = is_nn_fall_seen &&
+                      (int32_t)(nn_fall_ms - e->trigger_ms) >= 0 &&
+                      (int32_t)(e->decided_ms - nn_fall_ms) >= 0;
+  LOG("fall: %s at stage %d, impact %lu ms after trigger, cos %d, latency %lu ms",
+      (verdict == FALL_CONFIRMED) ? "confirmed" : "rejected",
+      (verdict == FALL_CONFIRMED) ? FD_NUM_STAGES : (int)e->failed,
+      (unsigned long)(e->impact_ms - e->trigger_ms), e->cos_q15,
+      (unsigned long)(e->decided_ms - e->trigger_ms));
+  LOG("fall: classifier %s", is_nn_agreed ? "flagged a fall" : "saw no fall");
+  LOG("fall: impact band peak %lu LSB^2", (unsigned long)impact_band_peak);
+  LOG("fall: posture %s -> %s, tilt %d cdeg, posture update %lu cycles max",
+      posture_name(posture_before_fall), posture_name(posture.posture),
+      posture.tilt_cdeg, (unsigned long)posture.max_cycles);
+  for (int s=0; s<FD_NUM_STAGES; s++)
+  {
+    LOG("fall: stage %d, %lu samples, %lu cycles, worst call %lu cycles", s,
+        (unsigned long)st->samples[s], (unsigned long)st->cycles[s],
+        (unsigned long)st->max_cycles[s]);
+  }
+}
+
+// peak of the gravity-free 3-15 Hz band during the event, logged with the
+// verdict as a measure of how hard the impact was
+static void impact_band_stage(bool is_new_event)
+{
+  if (is_new_event) impact_band_peak = 0;
+  for (uint32_t i=0; i<impact_band.n; i++)
+  {
+    int32_t x = impact_band.x[i];
+    int32_t y = impact_band.y[i];
+    int32_t z = impact_band.z[i];
+    uint32_t m2 = (uint32_t)(x*x) + (uint32_t)(y*y) + (uint32_t)(z*z);
+    if (m2 > impact_band_peak) impact_band_peak = m2;
+  }
+}
+
+// keeps the latest samples at the model's input scale, on every block so the
+// window is full when the detector arms
+static void classifier_window(const accel_block *blk)
+{
+  const uint32_t ch = FALL_MODEL_IN_CH;
+  uint32_t n = blk->n;
+  if (n > FALL_MODEL_IN_LEN) n = FALL_MODEL_IN_LEN;
+
+  // slide the window and append the block
+  memmove(nn_input, &nn_input[n*ch], (FALL_MODEL_IN_LEN - n)*ch);
+  int8_t *dst = &nn_input[(FALL_MODEL_IN_LEN - n)*ch];
+  uint32_t first = blk->n - n;
+  for (uint32_t i=0; i<n; i++)
+  {
+    const int16_t v[3] = { blk->x[first+i], blk->y[first+i], blk->z[first+i] };
+    for (uint32_t a=0; a<ch; a++)
+    {
+      int32_t q = (int32_t)v[a] * FALL_MODEL_IN_STEPS / ACCEL_LSB_PER_G;
+      if (q > INT8_MAX) q = INT8_MAX;
+      if (q < INT8_MIN) q = INT8_MIN;
+      *dst++ = (int8_t)q;
+    }
+  }
+}
+
+static void classifier_stage(const accel_block *blk)
+{
+  const int8_t *out;
+  if (nn_run(&fall_model, nn_input, nn_scratch, sizeof(nn_scratch), &out) != 0)
+  {
+    return;
+  }
+  if (nn_argmax(out, FALL_MODEL_NUM_CLASSES) == FALL_MODEL_CLASS_FALL)
+  {
+    nn_fall_ms = blk->timestamps[blk->n - 1];
+    is_nn_fall_seen = true;
+  }
+}
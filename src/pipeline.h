@@ -0,0 +1,140 @@
+/* -----------------------------------------------------------------------------
+ * @file   pipeline.h
+ * @brief  Sample pipeline between acquisition (FIFO drains) and processing
+ *         (main loop)
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "accel_decode.h"
+#include "accel_features.h"
+#include "accel_sample.h"
+#include "adxl343.h"
+#include "biquad.h"
+#include "blackbox.h"
+#include "calibration.h"
+#include "fall_detect.h"
+#include "fall_model.h"
+#include "filter_coeffs.h"
+#include "nn.h"
+#include "posture.h"
+#include "ring.h"
+
+
+/* @brief  Empties the sample ring
+ *
+ * @param  None
+ * @return None
+ */
+void pipeline_init();
+
+
+/* @brief  Producer: returns where the next FIFO drain should land
+ *
+ * The drain writes straight into the ring, no intermediate copy.
+ *
+ * @param  accel_sample**, set to the first free slot
+ * @return uint32_t, contiguous free slots (0 if the ring is full)
+ */
+uint32_t pipeline_drain_span(accel_sample **buf);
+
+
+/* @brief  Producer: records an output data rate switch
+ *
+ * Called when BW_RATE is written. Samples produced after switch_ms are
+ * back-dated with the new period, the ones still queued in the sensor FIFO
+ * keep the old one.
+ *
+ * @param  uint32_t, sample period in msec from now on
+ * @param  uint32_t, time of the BW_RATE write in msec
+ * @return None
+ */
+void pipeline_set_rate(uint32_t period_ms, uint32_t switch_ms);
+
+
+/* @brief  Producer: publishes n drained samples
+ *
+ * The newest sample is stamped drain_ms, the time the drain read
+ * FIFO_STATUS. Older ones are back-dated by the period they were sampled
+ * at, across any rate switch recorded with pipeline_set_rate().
+ *
+ * @param  uint32_t, samples written into the drain span
+ * @param  uint32_t, time the drain started in msec
+ * @return None
+ */
+void pipeline_commit(uint32_t n, uint32_t drain_ms);
+
+
+/* @brief  Consumer: processes everything queued in the ring
+ *
+ * Called from app_process_action(), i.e. once per main loop pass. Blocks
+ * are cut at rate switches. The detection stages (features, classifier,
+ * posture, filters, fall detector) are tuned for DET_RATE_HZ and only see
+ * samples taken at that rate; the black box and calibration take every
+ * block. The classifier only runs while the fall detector is armed.
+ *
+ * @param  None
+ * @return None
+ */
+void pipeline_process();
+
+
+
+/* @brief  Returns the sliding-window features of the processed stream
+ *
+ * @param  None
+ * @return const feature_engine*, x/y/z channels, updated per block
+ */
+const feature_engine *pipeline_features();
+
+
+/* @brief  Returns the last verdict of the fall detector
+ *
+ * @param  None
+ * @return const fall_event*, trigger_ms is the capture time of the free-fall
+ */
+const fall_event *pipeline_last_fall();
+
+
+/* @brief  Returns the black-box snapshot of the last fall trigger
+ *
+ * @param  const uint8_t**, set to the snapshot bytes
+ * @return uint32_t, snapshot length, 0 while none is complete
+ */
+uint32_t pipeline_blackbox_data(const uint8_t **data);
+
+
+/* @brief  Arms the fall detector from the free-fall interrupt
+ *
+ * A confirmed fall is reported with the evt_fall_confirmed external signal.
+ *
+ * @param  uint32_t, time of the interrupt in msec
+ * @return None
+ */
+void pipeline_fall_trigger(uint32_t now_ms);
+
+
+/* @brief  Arms offset calibration, it runs on the next still period
+ *
+ * @param  None
+ * @return None
+ */
+void pipeline_request_calibration();
+
+
+/* @brief  Reports whether the wearer is still (inactivity) or moving
+ *
+ * An armed calibration starts collecting when still. Movement aborts a
+ * window in progress and re-arms it.
+ *
+ * @param  bool, true on inactivity, false on activity
+ * @return None
+ */
+void pipeline_set_still(bool is_still);
+
+#endif // _PIPELINE_H_
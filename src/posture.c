@@ -0,0 +1,170 @@
+/* -----------------------------------------------------------------------------
+ * @file   posture.c
+ * @brief  Fixed-point tilt and posture estimation from low-passed gravity
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include "cycles.h"
+#include "posture.h"
+
+#define CORDIC_ITERATIONS (16)
+#define CORDIC_GAIN_Q15   (19898) // 1/1.64676, 16 iterations
+
+// atan(2^-i) in centidegrees Q8
+static const int32_t cordic_atan[CORDIC_ITERATIONS] = {
+  1152000, 680065, 359328, 182400, 91554, 45822, 22916, 11459,
+  5730, 2865, 1432, 716, 358, 179, 90, 45
+};
+
+static inline uint32_t abs32(int32_t v)
+{
+  return (v < 0) ? -(uint32_t)v : (uint32_t)v;
+}
+
+int32_t posture_atan2(int32_t y, int32_t x, uint32_t *mag)
+{
+  uint32_t m = abs32(x) | abs32(y);
+  if (m == 0)
+  {
+    if (mag != NULL) *mag = 0;
+    return 0;
+  }
+
+  // scale up to ~2^29 for precision, the gain of 1.65 still fits, or down
+  // for inputs beyond that
+  int32_t up = __builtin_clz(m) - 3;
+  int64_t xs = x;
+  int64_t ys = y;
+  if (up >= 0)
+  {
+    xs *= (int64_t)1 << up;
+    ys *= (int64_t)1 << up;
+  }
+  else
+  {
+    xs >>= -up;
+    ys >>= -up;
+  }
+
+  // rotate into the right half plane
+  int32_t offset = 0;
+  if (xs < 0)
+  {
+    offset = (ys >= 0) ? 18000*256 : -18000*256;
+    xs = -xs;
+    ys = -ys;
+  }
+
+  int32_t cx = (int32_t)xs;
+  int32_t cy = (int32_t)ys;
+  int32_t z = 0;
+  for (int i=0; i<CORDIC_ITERATIONS; i++)
+  {
+    int32_t dx = cy >> i;
+    int32_t dy = cx >> i;
+    if (cy > 0)
+    {
+      cx += dx;
+      cy -= dy;
+      z += cordic_atan[i];
+    }
+    else
+    {
+      cx -= dx;
+      cy += dy;
+      z -= cordic_atan[i];
+    }
+  }
+
+  if (mag != NULL)
+  {
+    int64_t r = ((int64_t)cx * CORDIC_GAIN_Q15 + (1 << 14)) >> 15;
+    *mag = (up >= 0) ? (uint32_t)((r + ((int64_t)1 << up >> 1)) >> up)
+                     : (uint32_t)(r << -up);
+  }
+
+  int32_t angle = offset + z;
+  int32_t cdeg = (angle >= 0) ? (angle + 128) / 256 : -((-angle + 128) / 256);
+  // wrap after rounding, the residual of the last iteration must not flip
+  // y == 0, x < 0 from +180 to -180 deg
+  if (cdeg > 18000) cdeg -= 36000;
+  if (cdeg < -18000) cdeg += 36000;
+  return cdeg;
+}
+
+void posture_init(posture_context *pc)
+{
+  for (int i=0; i<3; i++) pc->g_q4[i] = 0;
+  pc->n = 0;
+  pc->pitch_cdeg = 0;
+  pc->roll_cdeg = 0;
+  pc->tilt_cdeg = 0;
+  pc->posture = POSTURE_UNKNOWN;
+  pc->cycles = 0;
+  pc->max_cycles = 0;
+  cycles_init();
+}
+
+static posture_class classify(int32_t tilt, posture_class prev)
+{
+  if (tilt < POSTURE_UPRIGHT_CDEG) return POSTURE_UPRIGHT;
+  if (tilt > POSTURE_INVERTED_CDEG) return POSTURE_INVERTED;
+  if (tilt > POSTURE_LYING_CDEG && tilt < 18000 - POSTURE_LYING_CDEG)
+  {
+    return POSTURE_LYING;
+  }
+  return prev;
+}
+
+posture_class posture_update(posture_context *pc, const accel_block *blk)
+{
+  uint32_t start = cycles_now();
+  const int16_t *axes[3] = { blk->x, blk->y, blk->z };
+
+  for (int a=0; a<3; a++)
+  {
+    int32_t g = pc->g_q4[a];
+    // the first sample seeds the filter
+    uint32_t i = 0;
+    if (pc->n == 0 && blk->n > 0) g = (int32_t)axes[a][i++] * 16;
+    for (; i<blk->n; i++)
+    {
+      g += ((int32_t)axes[a][i]*16 - g) >> POSTURE_LPF_SHIFT;
+    }
+    pc->g_q4[a] = g;
+  }
+  pc->n += blk->n;
+  if (pc->n == 0) return pc->posture;
+
+  int32_t gx = pc->g_q4[0];
+  int32_t gy = pc->g_q4[1];
+  int32_t gz = pc->g_q4[2];
+  uint32_t yz;
+  pc->roll_cdeg = (int16_t)posture_atan2(gy, gz, &yz);
+  pc->pitch_cdeg = (int16_t)posture_atan2(-gx, (int32_t)yz, NULL);
+
+  // tilt of the up axis away from vertical, from the up component and the
+  // magnitude of the other two
+  int32_t up = pc->g_q4[POSTURE_UP_AXIS];
+  uint32_t side;
+  posture_atan2(pc->g_q4[(POSTURE_UP_AXIS + 1) % 3],
+                pc->g_q4[(POSTURE_UP_AXIS + 2) % 3], &side);
+  pc->tilt_cdeg = (int16_t)posture_atan2((int32_t)side, up, NULL);
+  pc->posture = classify(pc->tilt_cdeg, pc->posture);
+
+  pc->cycles = cycles_now() - start;
+  if (pc->cycles > pc->max_cycles) pc->max_cycles = pc->cycles;
+  return pc->posture;
+}
+
+const char *posture_name(posture_class p)
+{
+  switch (p)
+  {
+    case POSTURE_UPRIGHT:  return "upright";
+    case POSTURE_LYING:    return "lying";
+    case POSTURE_INVERTED: return "inverted";
+    default:               return "unknown";
+  }
+}
@@ -0,0 +1,90 @@
+/* -----------------------------------------------------------------------------
+ * @file   posture.h
+ * @brief  Fixed-point tilt and posture estimation from low-passed gravity
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Angles come from a 16 iteration CORDIC in vectoring mode, which yields both
+ * atan2 and the vector magnitude with shifts and adds only. Angles are in
+ * centidegrees: atan2 is within 0.01 deg, pitch/roll/tilt within 0.02 deg
+ * over the full sphere against double precision. The filter runs per sample,
+ * the angles and class once per block, so the per-sample cost is a constant
+ * three adds and shifts.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _POSTURE_H_
+#define _POSTURE_H_
+
+#include <stdint.h>
+
+#include "accel_decode.h"
+#include "detector_config.h"
+
+// device axis pointing up when the wearer stands, 0/1/2 = x/y/z
+#ifndef POSTURE_UP_AXIS
+#define POSTURE_UP_AXIS       (2)
+#endif
+
+#define POSTURE_LPF_SHIFT     DET_POSTURE_SHIFT // gravity low-pass, per rate
+#define POSTURE_UPRIGHT_CDEG  (3000) // tilt below 30 deg
+#define POSTURE_LYING_CDEG    (6000) // tilt between 60 and 120 deg
+#define POSTURE_INVERTED_CDEG (15000) // tilt above 150 deg
+
+typedef enum
+{
+  POSTURE_UNKNOWN = 0, // in between classes, or not enough samples
+  POSTURE_UPRIGHT,
+  POSTURE_LYING,
+  POSTURE_INVERTED
+} posture_class;
+
+typedef struct
+{
+  int32_t g_q4[3];      // low-passed x/y/z, LSB Q4
+  uint32_t n;           // samples filtered
+  int16_t pitch_cdeg;   // rotation about y, -9000..9000
+  int16_t roll_cdeg;    // rotation about x, -18000..18000
+  int16_t tilt_cdeg;    // angle between the up axis and vertical, 0..18000
+  posture_class posture;
+  uint32_t cycles;      // cost of the last posture_update() call
+  uint32_t max_cycles;
+} posture_context;
+
+
+/* @brief  Resets the estimator
+ *
+ * @param  posture_context*, the estimator
+ * @return None
+ */
+void posture_init(posture_context *pc);
+
+
+/* @brief  Filters a block and updates the angles and the class
+ *
+ * The class has hysteresis, a tilt between two class bands keeps the
+ * previous class.
+ *
+ * @param  posture_context*, the estimator
+ * @param  const accel_block*, decoded samples
+ * @return posture_class, the current class
+ */
+posture_class posture_update(posture_context *pc, const accel_block *blk);
+
+
+/* @brief  Integer atan2 and magnitude, CORDIC vectoring mode
+ *
+ * @param  int32_t, y
+ * @param  int32_t, x
+ * @param  uint32_t*, sqrt(x^2 + y^2) to within 0.2%, NULL to skip
+ * @return int32_t, angle in centidegrees, -18000..18000, 0 for (0, 0)
+ */
+int32_t posture_atan2(int32_t y, int32_t x, uint32_t *mag);
+
+
+/* @brief  Returns a printable name for a posture class
+ *
+ * @param  posture_class, the class
+ * @return const char*
+ */
+const char *posture_name(posture_class p);
+
+#endif // _POSTURE_H_
@@ -0,0 +1,159 @@
+/* -----------------------------------------------------------------------------
+ * @file   raw_stream.c
+ * @brief  Packs raw samples into notification sized packets for dataset
+ *         collection, with credit based flow control towards the stack
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "raw_stream.h"
+
+#define QUEUE_MASK         (RAW_QUEUE_PACKETS - 1)
+#define SAMPLE_LEN         (6)
+#define L2CAP_ATT_LEN      (7)       // L2CAP header 4, opcode and handle 3
+#define T_IFS_US           (150)
+#define EVENT_GUARD_US     (1250)    // end of each connection event left unused
+#define MAX_US_PER_PACKET  (1000000)
+
+#if RAW_HEADER_LEN + RAW_SAMPLES_PER_PACKET * SAMPLE_LEN != RAW_PACKET_LEN
+#error "raw packets must be filled exactly"
+#endif
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+// airtime of one notification as data PDUs, each acknowledged by an empty PDU
+static uint32_t packet_airtime_us(uint8_t phy, uint16_t txsize)
+{
+  // preamble, access address, header and CRC
+  uint32_t overhead = (phy == 2) ? 11 : 10;
+  uint32_t us_per_byte = (phy == 2) ? 4 : 8;
+  uint32_t len = RAW_PACKET_LEN + L2CAP_ATT_LEN;
+  uint32_t pdus = (len + txsize - 1) / txsize;
+  uint32_t data_us = (len + pdus * overhead) * us_per_byte;
+  uint32_t ack_us = pdus * (overhead * us_per_byte + 2 * T_IFS_US);
+  return data_us + ack_us;
+}
+
+static void start_packet(raw_stream *rs)
+{
+  uint8_t *p = rs->pkt[rs->head & QUEUE_MASK];
+  put_u16(&p[0], rs->seq);
+  put_u16(&p[2], (rs->drop_run > 0xFFFF) ? 0xFFFF : (uint16_t)rs->drop_run);
+  rs->drop_run = 0;
+}
+
+void raw_init(raw_stream *rs, uint32_t max_credits)
+{
+  rs->head = 0;
+  rs->tail = 0;
+  rs->fill = 0;
+  rs->seq = 0;
+  rs->drop_run = 0;
+  rs->max_credits = (max_credits > 0) ? max_credits : RAW_DEFAULT_CREDITS;
+  rs->in_stack = 0;
+  rs->drain_us = 0;
+  rs->samples = 0;
+  rs->packets = 0;
+  rs->dropped = 0;
+  rs->refused = 0;
+  raw_set_link(rs, 1, 27, 6);
+}
+
+void raw_set_link(raw_stream *rs, uint8_t phy, uint16_t txsize,
+                  uint16_t interval)
+{
+  if (txsize < 27) txsize = 27;
+  if (txsize > 251) txsize = 251;
+  uint32_t interval_us = (uint32_t)interval * 1250;
+  if (interval_us <= EVENT_GUARD_US) interval_us = EVENT_GUARD_US + 1250;
+
+  // scaled up for the part of each interval no packets are sent in
+  uint64_t us = (uint64_t)packet_airtime_us(phy, txsize) * interval_us /
+                (interval_us - EVENT_GUARD_US);
+  rs->us_model = (uint32_t)us;
+  rs->us_per_packet = rs->us_model;
+}
+
+void raw_push(raw_stream *rs, const accel_sample *s, uint32_t n)
+{
+  while (n > 0)
+  {
+    if (rs->head - rs->tail == RAW_QUEUE_PACKETS)
+    {
+      // no packet to fill, every queued one is waiting for a credit
+      rs->drop_run += n;
+      rs->dropped += n;
+      return;
+    }
+    if (rs->fill == 0) start_packet(rs);
+
+    uint32_t take = RAW_SAMPLES_PER_PACKET - rs->fill;
+    if (take > n) take = n;
+    uint8_t *dst = &rs->pkt[rs->head & QUEUE_MASK][RAW_HEADER_LEN +
+                                                   rs->fill * SAMPLE_LEN];
+    memcpy(dst, s, take * SAMPLE_LEN); // accel_sample is the raw layout
+    rs->fill += take;
+    rs->samples += take;
+    s += take;
+    n -= take;
+
+    if (rs->fill == RAW_SAMPLES_PER_PACKET)
+    {
+      rs->head++;
+      rs->seq++;
+      rs->fill = 0;
+    }
+  }
+}
+
+void raw_tick(raw_stream *rs, uint32_t elapsed_ms)
+{
+  if (rs->in_stack == 0) return; // an idle link banks no credits
+
+  uint64_t us = (uint64_t)rs->drain_us + (uint64_t)elapsed_ms * 1000;
+  uint64_t done = us / rs->us_per_packet;
+  if (done >= rs->in_stack)
+  {
+    rs->in_stack = 0;
+    rs->drain_us = 0;
+  }
+  else
+  {
+    rs->in_stack -= (uint32_t)done;
+    rs->drain_us = (uint32_t)(us - done * rs->us_per_packet);
+  }
+}
+
+uint32_t raw_peek(const raw_stream *rs, const uint8_t **data)
+{
+  if (rs->head == rs->tail || rs->in_stack >= rs->max_credits) return 0;
+  *data = rs->pkt[rs->tail & QUEUE_MASK];
+  return RAW_PACKET_LEN;
+}
+
+void raw_sent(raw_stream *rs)
+{
+  if (rs->head == rs->tail) return;
+  rs->tail++;
+  rs->in_stack++;
+  rs->packets++;
+  // the estimate creeps back towards the model while the stack accepts
+  rs->us_per_packet -= (rs->us_per_packet - rs->us_model) / 32;
+}
+
+void raw_refused(raw_stream *rs)
+{
+  rs->in_stack = rs->max_credits;
+  rs->drain_us = 0;
+  rs->refused++;
+  // the link is slower than modelled, e.g. the central caps the packets per
+  // connection event
+  if (rs->us_per_packet < MAX_US_PER_PACKET)
+  {
+    rs->us_per_packet += rs->us_per_packet / 4;
+  }
+}
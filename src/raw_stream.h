@@ -0,0 +1,134 @@
+/* -----------------------------------------------------------------------------
+ * @file   raw_stream.h
+ * @brief  Packs raw samples into notification sized packets for dataset
+ *         collection, with credit based flow control towards the stack
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Drained FIFO samples are copied into fixed RAW_PACKET_LEN packets that
+ * fill one notification at ATT_MTU 247. Full packets wait in a small queue.
+ * Notifications get no confirmation, so the only backpressure is the stack
+ * refusing a packet once its TX buffers are full. Rather than hammer the
+ * stack until it refuses, every packet handed over takes a credit. Credits
+ * come back at the rate the link is estimated to drain, from the PHY, the
+ * negotiated data length and the connection interval. A refusal means the
+ * estimate was optimistic: it takes all credits back and slows the estimate,
+ * which creeps back towards the model while the stack accepts packets.
+ * Samples that find the queue full are dropped and the count is carried in
+ * the next packet.
+ *
+ * Packet layout, little endian:
+ *   0  uint16  sequence number, increments per packet
+ *   2  uint16  samples dropped right before this packet, saturating
+ *   4  RAW_SAMPLES_PER_PACKET samples of x, y, z int16 as in
+ *      DATAX0..DATAZ1
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _RAW_STREAM_H_
+#define _RAW_STREAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "accel_sample.h"
+
+#define RAW_PACKET_LEN          (244) // ATT_MTU 247 - 3
+#define RAW_HEADER_LEN          (4)
+#define RAW_SAMPLES_PER_PACKET  ((RAW_PACKET_LEN - RAW_HEADER_LEN) / 6)
+#define RAW_QUEUE_PACKETS       (8)   // power of two
+#define RAW_DEFAULT_CREDITS     (4)   // notifications in the stack at once
+
+#if (RAW_QUEUE_PACKETS & (RAW_QUEUE_PACKETS - 1)) != 0
+#error "RAW_QUEUE_PACKETS must be a power of two"
+#endif
+
+typedef struct
+{
+  uint8_t pkt[RAW_QUEUE_PACKETS][RAW_PACKET_LEN];
+  uint32_t head;           // packet being filled
+  uint32_t tail;           // oldest full packet
+  uint32_t fill;           // samples in the packet being filled
+  uint16_t seq;
+  uint32_t drop_run;       // samples dropped since the last packet started
+
+  uint32_t max_credits;
+  uint32_t in_stack;       // notifications believed queued in the stack
+  uint32_t us_model;       // link drain time per notification, modelled
+  uint32_t us_per_packet;  // the same, adapted to refusals
+  uint32_t drain_us;       // drain time not yet turned into credits
+
+  uint32_t samples;
+  uint32_t packets;
+  uint32_t dropped;
+  uint32_t refused;        // sends the stack turned down
+} raw_stream;
+
+
+/* @brief  Empties the queue, returns all credits and clears the counters
+ *
+ * The drain estimate is for a 1M PHY, 27 byte PDUs and a 7.5 msec
+ * interval until raw_set_link.
+ *
+ * @param  raw_stream*, the stream
+ * @param  uint32_t, credits, 0 for RAW_DEFAULT_CREDITS
+ * @return None
+ */
+void raw_init(raw_stream *rs, uint32_t max_credits);
+
+
+/* @brief  Updates the drain estimate from the negotiated link
+ *
+ * @param  raw_stream*, the stream
+ * @param  uint8_t, PHY, 1 for 1M, 2 for 2M
+ * @param  uint16_t, data channel PDU payload the controller sends, 27..251
+ * @param  uint16_t, connection interval in units of 1.25 msec
+ * @return None
+ */
+void raw_set_link(raw_stream *rs, uint8_t phy, uint16_t txsize,
+                  uint16_t interval);
+
+
+/* @brief  Appends drained samples, dropping what does not fit the queue
+ *
+ * @param  raw_stream*, the stream
+ * @param  const accel_sample*, samples
+ * @param  uint32_t, number of samples
+ * @return None
+ */
+void raw_push(raw_stream *rs, const accel_sample *s, uint32_t n);
+
+
+/* @brief  Returns credits for the time the link had to drain
+ *
+ * @param  raw_stream*, the stream
+ * @param  uint32_t, msec since the previous call
+ * @return None
+ */
+void raw_tick(raw_stream *rs, uint32_t elapsed_ms);
+
+
+/* @brief  Returns the next packet if one is full and a credit is available
+ *
+ * @param  const raw_stream*, the stream
+ * @param  const uint8_t**, set to the packet bytes
+ * @return uint32_t, RAW_PACKET_LEN, or 0 if nothing may be sent
+ */
+uint32_t raw_peek(const raw_stream *rs, const uint8_t **data);
+
+
+/* @brief  The stack accepted the packet from raw_peek, takes a credit
+ *
+ * @param  raw_stream*, the stream
+ * @return None
+ */
+void raw_sent(raw_stream *rs);
+
+
+/* @brief  The stack refused the packet from raw_peek, it stays queued and
+ *         all credits are taken until the link drains
+ *
+ * @param  raw_stream*, the stream
+ * @return None
+ */
+void raw_refused(raw_stream *rs);
+
+#endif // _RAW_STREAM_H_
@@ -0,0 +1,82 @@
+/* -----------------------------------------------------------------------------
+ * @file   ring.c
+ * @brief  Lock-free single-producer/single-consumer ring of timestamped
+ *         accelerometer samples
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "ring.h"
+
+void sample_ring_init(sample_ring *ring)
+{
+  ring->head = 0;
+  ring->tail = 0;
+  ring->drops = 0;
+}
+
+uint32_t sample_ring_count(sample_ring *ring)
+{
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  return head - tail;
+}
+
+uint32_t sample_ring_write_span(sample_ring *ring,
+                                accel_sample **samples,
+                                uint32_t **timestamps)
+{
+  // head is ours, tail needs acquire so freed slots are really free
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  uint32_t free = SAMPLE_RING_SIZE - (head - tail);
+  uint32_t to_end = SAMPLE_RING_SIZE - (head & SAMPLE_RING_MASK);
+
+  *samples = &ring->samples[head & SAMPLE_RING_MASK];
+  *timestamps = &ring->timestamps[head & SAMPLE_RING_MASK];
+  return (free < to_end) ? free : to_end;
+}
+
+void sample_ring_commit(sample_ring *ring, uint32_t n)
+{
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  // release: the entries must be visible before the new head
+  __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+}
+
+bool sample_ring_push(sample_ring *ring, const accel_sample *sample,
+                      uint32_t timestamp)
+{
+  accel_sample *s;
+  uint32_t *t;
+  if (sample_ring_write_span(ring, &s, &t) == 0)
+  {
+    ring->drops++;
+    return false;
+  }
+  *s = *sample;
+  *t = timestamp;
+  sample_ring_commit(ring, 1);
+  return true;
+}
+
+uint32_t sample_ring_read_span(sample_ring *ring,
+                               const accel_sample **samples,
+                               const uint32_t **timestamps)
+{
+  // tail is ours, head needs acquire so the entries are complete
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint32_t used = head - tail;
+  uint32_t to_end = SAMPLE_RING_SIZE - (tail & SAMPLE_RING_MASK);
+
+  *samples = &ring->samples[tail & SAMPLE_RING_MASK];
+  *timestamps = &ring->timestamps[tail & SAMPLE_RING_MASK];
+  return (used < to_end) ? used : to_end;
+}
+
+void sample_ring_release(sample_ring *ring, uint32_t n)
+{
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+  // release: we are done reading the entries before handing them back
+  __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+}
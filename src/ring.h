@@ -0,0 +1,113 @@
+/* -----------------------------------------------------------------------------
+ * @file   ring.h
+ * @brief  Lock-free single-producer/single-consumer ring of timestamped
+ *         accelerometer samples
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * The producer (FIFO drain completion) only ever writes head, the consumer
+ * (main loop processing) only ever writes tail. Both indices run freely and
+ * are published with release stores / read with acquire loads (GCC __atomic
+ * builtins, single LDR/STR plus barriers on the Cortex-M4), so no
+ * CORE_CRITICAL_SECTION is needed. Spans hand out contiguous regions of the
+ * backing arrays, so bulk producers and consumers work in place.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "accel_sample.h"
+
+#define SAMPLE_RING_SIZE  (256) // must be a power of two
+#define SAMPLE_RING_MASK  (SAMPLE_RING_SIZE - 1)
+
+#if (SAMPLE_RING_SIZE & SAMPLE_RING_MASK) != 0
+  #error "SAMPLE_RING_SIZE must be a power of two"
+#endif
+
+typedef struct
+{
+  accel_sample samples[SAMPLE_RING_SIZE];
+  uint32_t timestamps[SAMPLE_RING_SIZE];  // msec, monotonic
+  volatile uint32_t head;                 // next slot to write, producer owned
+  volatile uint32_t tail;                 // next slot to read, consumer owned
+  uint32_t drops;                         // samples refused while full
+} sample_ring;
+
+
+/* @brief  Empties the ring
+ *
+ * Not safe against a concurrent producer or consumer.
+ *
+ * @param  sample_ring*, the ring
+ * @return None
+ */
+void sample_ring_init(sample_ring *ring);
+
+
+/* @brief  Returns the number of samples available to the consumer
+ *
+ * @param  sample_ring*, the ring
+ * @return uint32_t, queued samples
+ */
+uint32_t sample_ring_count(sample_ring *ring);
+
+
+/* @brief  Producer: returns the largest contiguous free region
+ *
+ * The producer fills up to the returned count of entries in place and then
+ * publishes them with sample_ring_commit().
+ *
+ * @param  sample_ring*, the ring
+ * @param  accel_sample**, set to the first free sample slot
+ * @param  uint32_t**, set to the matching timestamp slot
+ * @return uint32_t, contiguous free entries (0 if full)
+ */
+uint32_t sample_ring_write_span(sample_ring *ring,
+                                accel_sample **samples,
+                                uint32_t **timestamps);
+
+
+/* @brief  Producer: publishes n entries filled through the write span
+ *
+ * @param  sample_ring*, the ring
+ * @param  uint32_t, number of entries to publish
+ * @return None
+ */
+void sample_ring_commit(sample_ring *ring, uint32_t n);
+
+
+/* @brief  Producer: copies one sample in, counting a drop if full
+ *
+ * @param  sample_ring*, the ring
+ * @param  const accel_sample*, the sample
+ * @param  uint32_t, timestamp in msec
+ * @return true if stored, false if the ring was full
+ */
+bool sample_ring_push(sample_ring *ring, const accel_sample *sample,
+                      uint32_t timestamp);
+
+
+/* @brief  Consumer: returns the largest contiguous filled region
+ *
+ * @param  sample_ring*, the ring
+ * @param  const accel_sample**, set to the oldest queued sample
+ * @param  const uint32_t**, set to the matching timestamp
+ * @return uint32_t, contiguous queued entries (0 if empty)
+ */
+uint32_t sample_ring_read_span(sample_ring *ring,
+                               const accel_sample **samples,
+                               const uint32_t **timestamps);
+
+
+/* @brief  Consumer: frees n entries obtained through the read span
+ *
+ * @param  sample_ring*, the ring
+ * @param  uint32_t, number of entries to release
+ * @return None
+ */
+void sample_ring_release(sample_ring *ring, uint32_t n);
+
+#endif // _RING_H_
@@ -0,0 +1,82 @@
+/* -----------------------------------------------------------------------------
+ * @file   sampling.c
+ * @brief  Adaptive sampling controller, switches the ADXL343 between a
+ *         low-power monitoring profile and a high-rate capture profile
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "sampling.h"
+
+static void sampling_enter(sampling_context *ctx, sampling_mode mode)
+{
+  ctx->mode = mode;
+  ctx->is_inactivity_pending = false;
+  ctx->switches++;
+}
+
+void sampling_init(sampling_context *ctx, uint32_t now_ms)
+{
+  memset(ctx, 0x0, sizeof(*ctx));
+  ctx->mode = SAMPLING_CAPTURE;
+  ctx->last_activity_ms = now_ms;
+  ctx->last_update_ms = now_ms;
+}
+
+bool sampling_step(sampling_context *ctx, sampling_input in, uint32_t now_ms)
+{
+  sampling_mode prev = ctx->mode;
+
+  // account the time since the previous step to the mode we were in
+  ctx->time_in_mode_ms[ctx->mode] += now_ms - ctx->last_update_ms;
+  ctx->last_update_ms = now_ms;
+
+  switch (in)
+  {
+    case SAMPLING_IN_ACTIVITY:
+      ctx->last_activity_ms = now_ms;
+      ctx->is_inactivity_pending = false;
+      if (ctx->mode != SAMPLING_CAPTURE)
+      {
+        sampling_enter(ctx, SAMPLING_CAPTURE);
+      }
+      break;
+
+    case SAMPLING_IN_INACTIVITY:
+      if (ctx->mode == SAMPLING_CAPTURE)
+      {
+        ctx->is_inactivity_pending = true;
+      }
+      break;
+
+    case SAMPLING_IN_NONE:
+    default:
+      break;
+  }
+
+  if (ctx->is_inactivity_pending
+      && now_ms - ctx->last_activity_ms >= SAMPLING_CAPTURE_HOLD_MS)
+  {
+    sampling_enter(ctx, SAMPLING_MONITOR);
+  }
+
+  return ctx->mode != prev;
+}
+
+uint8_t sampling_bw_rate(sampling_mode mode)
+{
+  return (mode == SAMPLING_MONITOR) ? SAMPLING_MONITOR_BW_RATE
+                                    : SAMPLING_CAPTURE_BW_RATE;
+}
+
+uint32_t sampling_period_ms(sampling_mode mode)
+{
+  return (mode == SAMPLING_MONITOR) ? SAMPLING_MONITOR_PERIOD_MS
+                                    : SAMPLING_CAPTURE_PERIOD_MS;
+}
+
+uint32_t sampling_time_in_mode(const sampling_context *ctx, sampling_mode mode)
+{
+  if (mode >= SAMPLING_NUM_MODES) return 0;
+  return ctx->time_in_mode_ms[mode];
+}
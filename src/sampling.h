@@ -0,0 +1,115 @@
+/* -----------------------------------------------------------------------------
+ * @file   sampling.h
+ * @brief  Adaptive sampling controller, switches the ADXL343 between a
+ *         low-power monitoring profile and a high-rate capture profile
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * The controller is a pure state machine driven by the sensor's activity and
+ * inactivity interrupts, it does not touch hardware and has no emlib
+ * dependencies. The caller applies sampling_bw_rate() when the mode changes.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _SAMPLING_H_
+#define _SAMPLING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "detector_config.h"
+
+// BW_RATE register map:
+// D7 | D6 | D5 | D4        | D3 | D2 | D1 | D0 |
+// 0  | 0  | 0  | LOW_POWER |      Rate         |
+#define BW_RATE_LOW_POWER     (0x10)
+#define BW_RATE_100_HZ        (0x0A)
+#define BW_RATE_25_HZ         (0x08)
+#define BW_RATE_12_5_HZ       (0x07)
+
+// the periods hold because the profile leaves AUTO_SLEEP off, the part
+// never drops to its 8 Hz sleep rate behind the controller's back
+#define SAMPLING_MONITOR_BW_RATE  (BW_RATE_LOW_POWER | BW_RATE_25_HZ)
+#define SAMPLING_CAPTURE_BW_RATE  (DET_BW_RATE_CODE)
+#define SAMPLING_MONITOR_PERIOD_MS  (40)
+#define SAMPLING_CAPTURE_PERIOD_MS  (DET_PERIOD_MS)
+
+// hysteresis: capture is held at least this long after the last activity,
+// so a wearer shifting in a chair does not toggle the profile back and forth
+#define SAMPLING_CAPTURE_HOLD_MS  (10000)
+
+typedef enum
+{
+  SAMPLING_MONITOR = 0,
+  SAMPLING_CAPTURE = 1,
+  SAMPLING_NUM_MODES
+} sampling_mode;
+
+typedef enum
+{
+  SAMPLING_IN_NONE,        // periodic update, e.g. on a FIFO watermark
+  SAMPLING_IN_ACTIVITY,    // INT_ACTIVITY fired
+  SAMPLING_IN_INACTIVITY   // INT_INACTIVITY fired
+} sampling_input;
+
+typedef struct
+{
+  sampling_mode mode;
+  bool is_inactivity_pending;
+  uint32_t last_activity_ms;
+  uint32_t last_update_ms;
+  uint32_t time_in_mode_ms[SAMPLING_NUM_MODES];
+  uint32_t switches;
+} sampling_context;
+
+
+/* @brief  Resets the controller into the capture profile
+ *
+ * Starting in capture is the safe choice after boot, the first inactivity
+ * interrupt drops to monitoring.
+ *
+ * @param  sampling_context*, controller state
+ * @param  uint32_t, current time in msec
+ * @return None
+ */
+void sampling_init(sampling_context *ctx, uint32_t now_ms);
+
+
+/* @brief  Advances the state machine
+ *
+ * Activity switches to capture immediately, so the switch latency is bounded
+ * by one event loop pass plus one BW_RATE write. Inactivity only drops to
+ * monitoring once SAMPLING_CAPTURE_HOLD_MS has passed since the last
+ * activity, otherwise it is held pending and taken on a later update.
+ *
+ * @param  sampling_context*, controller state
+ * @param  sampling_input, the event being processed
+ * @param  uint32_t, current time in msec
+ * @return true if the mode changed and the new BW_RATE must be applied
+ */
+bool sampling_step(sampling_context *ctx, sampling_input in, uint32_t now_ms);
+
+
+/* @brief  Returns the BW_RATE register value for a mode
+ *
+ * @param  sampling_mode, the mode
+ * @return uint8_t, BW_RATE value
+ */
+uint8_t sampling_bw_rate(sampling_mode mode);
+
+
+/* @brief  Returns the output data period of a mode
+ *
+ * @param  sampling_mode, the mode
+ * @return uint32_t, msec between samples
+ */
+uint32_t sampling_period_ms(sampling_mode mode);
+
+
+/* @brief  Returns the total time spent in a mode, up to the last step
+ *
+ * @param  const sampling_context*, controller state
+ * @param  sampling_mode, the mode
+ * @return uint32_t, time in msec
+ */
+uint32_t sampling_time_in_mode(const sampling_context *ctx, sampling_mode mode);
+
+#endif // _SAMPLING_H_
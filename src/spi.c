@@ -0,0 +1,185 @@
+/* -----------------------------------------------------------------------------
+ * @file   spi.c
+ * @brief  SPI transport for the accelerometer (USART1 master + LDMA)
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <em_core.h>
+#include <em_cmu.h>
+#include <em_gpio.h>
+#include <em_usart.h>
+#include <em_emu.h>
+#include <em_ldma.h>
+#include <sl_power_manager.h>
+#include <sl_bluetooth.h>
+
+#include "spi.h"
+#include "events.h"
+#include "log.h"
+
+#define ACCEL_CLK_PORT (gpioPortA)
+#define ACCEL_CLK_PIN  (0)
+#define ACCEL_CLK_LOC  (30)
+
+#define ACCEL_TX_PORT (gpioPortA)
+#define ACCEL_TX_PIN  (1)
+#define ACCEL_TX_LOC  (1)
+
+#define ACCEL_RX_PORT (gpioPortA)
+#define ACCEL_RX_PIN  (2)
+#define ACCEL_RX_LOC  (1)
+
+#define ACCEL_CS_PORT (gpioPortA)
+#define ACCEL_CS_PIN  (5)
+#define ACCEL_CS_LOC  (2)
+
+#define SPI_TX_CHANNEL (0)
+#define SPI_RX_CHANNEL (1)
+
+static int spi_transfer(const uint8_t *tx, uint8_t *rx, uint32_t nbytes);
+static int spi_transfer_async(const uint8_t *tx, uint8_t *rx, uint32_t nbytes);
+static bool spi_is_busy();
+static void spi_start(const uint8_t *tx, uint8_t *rx, uint32_t nbytes,
+                      bool is_signal);
+static void spi_wait_idle();
+static inline void spi_cs_high() { GPIO_PinOutSet(ACCEL_CS_PORT, ACCEL_CS_PIN); }
+static inline void spi_cs_low() { GPIO_PinOutClear(ACCEL_CS_PORT, ACCEL_CS_PIN); }
+
+const spi_bus spi_usart1_bus = {
+  .transfer = spi_transfer,
+  .transfer_async = spi_transfer_async,
+  .is_busy = spi_is_busy
+};
+
+// descriptors are read by the LDMA while the transfer runs, keep them static
+static LDMA_Descriptor_t tx_desc;
+static LDMA_Descriptor_t rx_desc;
+static const LDMA_TransferCfg_t tx_cfg =
+  LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_USART1_TXBL);
+static const LDMA_TransferCfg_t rx_cfg =
+  LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_USART1_RXDATAV);
+
+static volatile bool is_xfer_inflight = false;
+// only asynchronous transfers report completion to the event loop
+static volatile bool is_signal_wanted = false;
+
+void LDMA_IRQHandler()
+{
+  CORE_CRITICAL_SECTION(
+    uint32_t flags = LDMA_IntGetEnabled();
+    LDMA_IntClear(flags);
+    if (flags & ((1 << SPI_RX_CHANNEL) | LDMA_IF_ERROR))
+    {
+      // RX completes after the last byte has been clocked, safe to release CS
+      spi_cs_high();
+      is_xfer_inflight = false;
+      sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM1);
+      if (is_signal_wanted) sl_bt_external_signal(evt_spi_xfer_done);
+    }
+  );
+}
+
+void spi_init()
+{
+  // note: SPI is a part of the USART peripheral on the blue gecko
+  // Universal Synchronous Asynchronous Receiver Transmitter
+  // enable clocks for USART
+  CMU_ClockEnable(cmuClock_HFPER, true);
+  CMU_ClockEnable(cmuClock_USART1, true);
+  CMU_ClockEnable(cmuClock_GPIO, true);
+
+  // setup and configure GPIO's, note that CS pin will be under application control
+  GPIO_PinModeSet(ACCEL_CLK_PORT, ACCEL_CLK_PIN, gpioModePushPull, 0);
+  GPIO_PinModeSet(ACCEL_TX_PORT, ACCEL_TX_PIN, gpioModePushPull, 0);
+  GPIO_PinModeSet(ACCEL_RX_PORT, ACCEL_RX_PIN, gpioModeInput, 0);
+  GPIO_PinModeSet(ACCEL_CS_PORT, ACCEL_CS_PIN, gpioModePushPull, 1);
+
+  // initialize USART1 for synchronous master mode, MSB first, CPOL=1, CPHA=1
+  USART_Reset(USART1);
+  USART_InitSync_TypeDef usart_init = USART_INITSYNC_DEFAULT;
+  usart_init.master = true;
+  usart_init.clockMode = usartClockMode3; // CPOL=1, CPHA=1
+  usart_init.msbf = true; // MSB first
+  USART_InitSync(USART1, &usart_init);
+  USART_BaudrateSyncSet(USART1, 0, 4000000);
+
+  // enable I/O and set tx,rx,clk locations - ref. manual pg 646
+  USART1->ROUTELOC0 = (USART1->ROUTELOC0 & ~(_USART_ROUTELOC0_TXLOC_MASK
+                        | _USART_ROUTELOC0_RXLOC_MASK | _USART_ROUTELOC0_CLKLOC_MASK))
+                        | (ACCEL_TX_LOC << _USART_ROUTELOC0_TXLOC_SHIFT)
+                        | (ACCEL_RX_LOC << _USART_ROUTELOC0_RXLOC_SHIFT)
+                        | (ACCEL_CLK_LOC << _USART_ROUTELOC0_CLKLOC_SHIFT);
+  // enable routes
+  USART1->ROUTEPEN |=   USART_ROUTEPEN_CLKPEN
+                      | USART_ROUTEPEN_RXPEN
+                      | USART_ROUTEPEN_TXPEN;
+
+  USART_Enable(USART1, usartEnable);
+
+  // LDMA_Init() enables the LDMA clock and its NVIC line
+  LDMA_Init_t ldma_init = LDMA_INIT_DEFAULT;
+  LDMA_Init(&ldma_init);
+}
+
+static bool spi_is_busy()
+{
+  return is_xfer_inflight;
+}
+
+static int spi_transfer(const uint8_t *tx, uint8_t *rx, uint32_t nbytes)
+{
+  if (nbytes == 0 || nbytes > SPI_MAX_FRAME || tx == NULL || rx == NULL) return -1;
+
+  // never interleave with a frame the LDMA is still clocking out, then run
+  // this one through the LDMA too and sleep until it is done
+  spi_wait_idle();
+  spi_start(tx, rx, nbytes, false);
+  spi_wait_idle();
+  return 0;
+}
+
+static int spi_transfer_async(const uint8_t *tx, uint8_t *rx, uint32_t nbytes)
+{
+  if (nbytes == 0 || nbytes > SPI_MAX_FRAME || tx == NULL || rx == NULL) return -1;
+  if (spi_is_busy()) return -1;
+
+  spi_start(tx, rx, nbytes, true);
+  return 0;
+}
+
+static void spi_wait_idle()
+{
+  // EM1 keeps the HF clock for the USART/LDMA, the RX completion interrupt
+  // wakes the core. Interrupts stay masked between the check and the WFI so
+  // the completion cannot slip in before the core goes to sleep
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  while (is_xfer_inflight)
+  {
+    EMU_EnterEM1();
+    CORE_YIELD_CRITICAL(); // lets LDMA_IRQHandler run
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+static void spi_start(const uint8_t *tx, uint8_t *rx, uint32_t nbytes,
+                      bool is_signal)
+{
+  is_xfer_inflight = true;
+  is_signal_wanted = is_signal;
+  USART1->CMD = USART_CMD_CLEARTX | USART_CMD_CLEARRX;
+
+  // USART1 needs the HF clock, so hold EM1 until the RX channel completes
+  sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM1);
+
+  rx_desc = (LDMA_Descriptor_t)
+    LDMA_DESCRIPTOR_SINGLE_P2M_BYTE(&USART1->RXDATA, rx, nbytes);
+  tx_desc = (LDMA_Descriptor_t)
+    LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(tx, &USART1->TXDATA, nbytes);
+  tx_desc.xfer.doneIfs = 0; // only the RX channel reports completion
+
+  spi_cs_low();
+  // arm RX first so no received byte can be missed
+  LDMA_StartTransfer(SPI_RX_CHANNEL, &rx_cfg, &rx_desc);
+  LDMA_StartTransfer(SPI_TX_CHANNEL, &tx_cfg, &tx_desc);
+}
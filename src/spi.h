@@ -0,0 +1,54 @@
+/* -----------------------------------------------------------------------------
+ * @file   spi.h
+ * @brief  SPI transport for the accelerometer (USART1 master + LDMA)
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _SPI_H_
+#define _SPI_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SPI_MAX_FRAME   (64) // largest frame (command byte included), bytes
+
+/* Transport used by the accelerometer driver. Every transfer is a full-duplex
+ * frame clocked out with chip select held low for its whole length; tx[0] is
+ * the command byte. The target implementation below drives USART1 through
+ * LDMA, a host build can substitute an in-memory bus model.
+ */
+typedef struct
+{
+  // blocking transfer, waits for any asynchronous transfer to finish first;
+  // the caller sleeps in EM1 while the frame is clocked
+  int  (*transfer)(const uint8_t *tx, uint8_t *rx, uint32_t nbytes);
+  // starts a transfer and returns, completion raises evt_spi_xfer_done
+  int  (*transfer_async)(const uint8_t *tx, uint8_t *rx, uint32_t nbytes);
+  bool (*is_busy)();
+} spi_bus;
+
+extern const spi_bus spi_usart1_bus;
+
+
+/* @brief  Initializes USART1 as SPI master and the LDMA channels behind it
+ *
+ * Configures the clock, MOSI, MISO and chip select pins for the ADXL343, sets
+ * CPOL=1, CPHA=1, MSB first at 4 MHz.
+ *
+ * @param  None
+ * @return None
+ */
+void spi_init();
+
+
+/* @brief  LDMA interrupt service routine
+ *
+ * Releases chip select once the RX channel has received the last byte, lifts
+ * the EM1 requirement and signals evt_spi_xfer_done to the BLE event loop.
+ *
+ * @param  None
+ * @return None
+ */
+void LDMA_IRQHandler();
+
+#endif // _SPI_H_
@@ -0,0 +1,137 @@
+/* -----------------------------------------------------------------------------
+ * @file   thresh_tuner.c
+ * @brief  Adaptive activity/inactivity thresholds, retunes THRESH_ACT,
+ *         THRESH_INACT and TIME_INACT toward an interrupt budget
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "thresh_tuner.h"
+
+#define BUDGET_HIGH_Q4  ((TUNER_BUDGET_PER_HOUR * 3 / 2) << 4)
+#define BUDGET_LOW_Q4   ((TUNER_BUDGET_PER_HOUR / 2) << 4)
+
+static uint8_t clamp_u8(uint32_t v, uint32_t lo, uint32_t hi)
+{
+  if (v < lo) v = lo;
+  if (v > hi) v = hi;
+  return (uint8_t)v;
+}
+
+// smallest threshold above the quiet spread, in register units
+static uint32_t noise_floor(const thresh_tuner *t)
+{
+  if (t->quiet_p2p == UINT16_MAX) return 0;
+  uint32_t mg = ((uint32_t)t->quiet_p2p * 1000 + t->lsb_per_g / 2)
+                / t->lsb_per_g;
+  return ACCEL_MG_TO_THRESH(mg) + 1;
+}
+
+// inactivity follows activity at the default ratio
+static uint8_t inact_for(uint32_t act, uint32_t floor)
+{
+  uint32_t inact = (act * ACCEL_THRESH_INACT + ACCEL_THRESH_ACT / 2)
+                   / ACCEL_THRESH_ACT;
+  if (inact < floor) inact = floor;
+  return clamp_u8(inact, TUNER_INACT_MIN, TUNER_INACT_MAX);
+}
+
+void thresh_tuner_init(thresh_tuner *t, const tuner_thresholds *start,
+                       uint16_t lsb_per_g, uint32_t now_ms)
+{
+  t->current = *start;
+  t->period_start_ms = now_ms;
+  t->interrupts = 0;
+  t->rate_q4 = 0;
+  t->is_rate_valid = false;
+  t->hold = 0;
+  t->quiet_p2p = UINT16_MAX;
+  t->lsb_per_g = lsb_per_g;
+  t->retunes = 0;
+}
+
+void thresh_tuner_on_interrupt(thresh_tuner *t)
+{
+  t->interrupts++;
+}
+
+void thresh_tuner_observe(thresh_tuner *t, uint16_t p2p)
+{
+  if (p2p < t->quiet_p2p) t->quiet_p2p = p2p;
+}
+
+bool thresh_tuner_step(thresh_tuner *t, uint32_t now_ms)
+{
+  uint32_t elapsed = now_ms - t->period_start_ms;
+  if (elapsed < TUNER_PERIOD_MS) return false;
+
+  // interrupts per hour this period, Q4, then the moving average
+  uint32_t rate_q4 = (uint32_t)(((uint64_t)t->interrupts * 3600000UL << 4)
+                                / elapsed);
+  if (!t->is_rate_valid)
+  {
+    t->rate_q4 = rate_q4;
+    t->is_rate_valid = true;
+  }
+  else
+  {
+    t->rate_q4 = t->rate_q4 - (t->rate_q4 >> TUNER_EWMA_SHIFT)
+                 + (rate_q4 >> TUNER_EWMA_SHIFT);
+  }
+
+  t->period_start_ms = now_ms;
+  t->interrupts = 0;
+  uint32_t floor = noise_floor(t);
+  t->quiet_p2p = UINT16_MAX;
+  if (t->hold > 0)
+  {
+    t->hold--;
+    return false;
+  }
+
+  tuner_thresholds next = t->current;
+  uint32_t act = next.thresh_act;
+
+  if (t->rate_q4 > BUDGET_HIGH_Q4)
+  {
+    // about 12% per step, at least one LSB
+    if (act < TUNER_ACT_MAX)
+    {
+      act += (act >> 3) ? (act >> 3) : 1;
+    }
+    else
+    {
+      next.time_inact = clamp_u8((uint32_t)next.time_inact
+                                 + TUNER_TIME_INACT_STEP,
+                                 TUNER_TIME_INACT_MIN, TUNER_TIME_INACT_MAX);
+    }
+  }
+  else if (t->rate_q4 < BUDGET_LOW_Q4)
+  {
+    if (next.time_inact > TUNER_TIME_INACT_MIN)
+    {
+      next.time_inact = clamp_u8((next.time_inact > TUNER_TIME_INACT_STEP)
+                                 ? next.time_inact - TUNER_TIME_INACT_STEP : 0,
+                                 TUNER_TIME_INACT_MIN, TUNER_TIME_INACT_MAX);
+    }
+    else if (act > TUNER_ACT_MIN)
+    {
+      act -= ((act - 1) >> 3) ? ((act - 1) >> 3) : 1;
+    }
+  }
+
+  if (act < floor) act = floor;
+  next.thresh_act = clamp_u8(act, TUNER_ACT_MIN, TUNER_ACT_MAX);
+  next.thresh_inact = inact_for(next.thresh_act, floor);
+
+  if (next.thresh_act == t->current.thresh_act
+      && next.thresh_inact == t->current.thresh_inact
+      && next.time_inact == t->current.time_inact)
+  {
+    return false;
+  }
+
+  t->current = next;
+  t->hold = TUNER_HOLD_PERIODS;
+  t->retunes++;
+  return true;
+}
@@ -0,0 +1,112 @@
+/* -----------------------------------------------------------------------------
+ * @file   thresh_tuner.h
+ * @brief  Adaptive activity/inactivity thresholds, retunes THRESH_ACT,
+ *         THRESH_INACT and TIME_INACT toward an interrupt budget
+ * @author Jake Michael, jami1063@colorado.edu
+ *
+ * Activity and inactivity interrupts are counted over TUNER_PERIOD_MS and
+ * folded into a moving average of interrupts per hour. Above the budget the
+ * activity threshold is raised (the inactivity threshold follows at the
+ * default ratio), and once it is at its ceiling TIME_INACT is lengthened.
+ * Well below the budget the same steps are undone, TIME_INACT first, down to
+ * the defaults. Retunes are at least TUNER_HOLD_PERIODS apart so the average
+ * settles on the new thresholds before the next decision. The
+ * quietest signal seen during the period (feature peak-to-peak) is a floor
+ * for both thresholds, so sensor and body noise can never hold the part in
+ * the active state. Free-fall and tap detection are not touched.
+ *
+ * Like sampling.c this is a pure controller without hardware access, the
+ * caller writes the thresholds back when thresh_tuner_step() reports a
+ * change. THRESH_ACT..TIME_INACT are adjacent registers, so the profile diff
+ * is a single burst of at most three bytes.
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _THRESH_TUNER_H_
+#define _THRESH_TUNER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "accel_config.h"
+
+#define TUNER_PERIOD_MS          (15UL * 60 * 1000)
+#define TUNER_BUDGET_PER_HOUR    (30)  // activity + inactivity interrupts
+#define TUNER_EWMA_SHIFT         (2)   // 1/4 weight per period, ~1 hour
+#define TUNER_HOLD_PERIODS       (2)   // periods between retunes
+
+// safe bounds, register units. The defaults are the floor: tuning only ever
+// desensitizes, a quiet wearer keeps the factory behavior
+#define TUNER_ACT_MIN            ACCEL_THRESH_ACT
+#define TUNER_ACT_MAX            ACCEL_MG_TO_THRESH(1000)
+#define TUNER_INACT_MIN          ACCEL_THRESH_INACT
+#define TUNER_INACT_MAX          ACCEL_MG_TO_THRESH(1500)
+#define TUNER_TIME_INACT_MIN     ACCEL_TIME_INACT
+#define TUNER_TIME_INACT_MAX     ACCEL_MS_TO_TIME_INACT(120000)
+#define TUNER_TIME_INACT_STEP    ACCEL_MS_TO_TIME_INACT(10000)
+
+#if TUNER_ACT_MIN < 1 || TUNER_ACT_MAX > 255 || TUNER_INACT_MAX > 255 || \
+    TUNER_TIME_INACT_MAX > 255 || TUNER_TIME_INACT_MIN > TUNER_TIME_INACT_MAX
+#error "threshold tuner bounds do not fit the registers"
+#endif
+
+typedef struct
+{
+  uint8_t thresh_act;    // 62.5 mg/LSB
+  uint8_t thresh_inact;  // 62.5 mg/LSB
+  uint8_t time_inact;    // 1 sec/LSB
+} tuner_thresholds;
+
+typedef struct
+{
+  tuner_thresholds current;
+  uint32_t period_start_ms;
+  uint32_t interrupts;       // this period
+  uint32_t rate_q4;          // moving average, interrupts per hour, Q4
+  bool is_rate_valid;
+  uint32_t hold;             // periods left before the next retune
+  uint16_t quiet_p2p;        // smallest peak-to-peak this period, LSB
+  uint16_t lsb_per_g;
+  uint32_t retunes;
+} thresh_tuner;
+
+
+/* @brief  Starts the controller from the given thresholds
+ *
+ * @param  thresh_tuner*, controller state
+ * @param  const tuner_thresholds*, the thresholds currently programmed
+ * @param  uint16_t, LSB per g of the samples given to thresh_tuner_observe()
+ * @param  uint32_t, current time in msec
+ * @return None
+ */
+void thresh_tuner_init(thresh_tuner *t, const tuner_thresholds *start,
+                       uint16_t lsb_per_g, uint32_t now_ms);
+
+
+/* @brief  Counts one activity or inactivity interrupt
+ *
+ * @param  thresh_tuner*, controller state
+ * @return None
+ */
+void thresh_tuner_on_interrupt(thresh_tuner *t);
+
+
+/* @brief  Records the current signal spread
+ *
+ * @param  thresh_tuner*, controller state
+ * @param  uint16_t, peak-to-peak over the feature window, largest axis, LSB
+ * @return None
+ */
+void thresh_tuner_observe(thresh_tuner *t, uint16_t p2p);
+
+
+/* @brief  Closes the period once TUNER_PERIOD_MS has passed and retunes
+ *
+ * Cheap to call often, does nothing until the period is over.
+ *
+ * @param  thresh_tuner*, controller state
+ * @param  uint32_t, current time in msec
+ * @return true if t->current changed and must be written to the sensor
+ */
+bool thresh_tuner_step(thresh_tuner *t, uint32_t now_ms);
+
+#endif // _THRESH_TUNER_H_
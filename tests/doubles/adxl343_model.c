@@ -0,0 +1,258 @@
+/* -----------------------------------------------------------------------------
+ * @file   adxl343_model.c
+ * @brief  Register level model of the ADXL343 behind the SPI transport
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "adxl343_model.h"
+#include "accel_config.h"
+#include "adxl343.h"
+#include "em_gpio.h"
+#include "sl_bluetooth.h"
+
+adxl343_model_state adxl343_model;
+
+// registers the part accepts writes to
+static bool is_writable(uint8_t reg)
+{
+  return (reg >= ADXL343_THRESH_TAP && reg <= ADXL343_TAP_AXES) ||
+         (reg >= ADXL343_BW_RATE && reg <= ADXL343_INT_MAP) ||
+         reg == ADXL343_DATA_FORMAT || reg == ADXL343_FIFO_CTL;
+}
+
+static const accel_sample *head()
+{
+  adxl343_model_state *m = &adxl343_model;
+  return m->fifo_count ? &m->fifo[m->fifo_head] : &m->output;
+}
+
+// recomputes the data path sources and the pin levels
+static void update_interrupts()
+{
+  adxl343_model_state *m = &adxl343_model;
+  uint8_t src = m->regs[ADXL343_INT_SOURCE];
+  uint32_t watermark = m->regs[ADXL343_FIFO_CTL] & FIFO_SAMPLES_MASK;
+
+  src &= ~(INT_DATA_READY | INT_WATERMARK);
+  if (m->fifo_count > 0) src |= INT_DATA_READY;
+  if (watermark > 0 && m->fifo_count >= watermark) src |= INT_WATERMARK;
+  // OVERRUN stays set until the FIFO has room again
+  if (m->fifo_count < ADXL343_MODEL_FIFO) src &= ~INT_OVERRUN;
+  m->regs[ADXL343_INT_SOURCE] = src;
+  m->regs[ADXL343_FIFO_STATUS] = (uint8_t)m->fifo_count;
+
+  uint8_t active = src & m->regs[ADXL343_INT_ENABLE];
+  uint8_t map = m->regs[ADXL343_INT_MAP];
+  stub_gpio_set_level(ACCEL_INT1_PORT, ACCEL_INT1_PIN, (active & ~map) != 0);
+  stub_gpio_set_level(ACCEL_INT2_PORT, ACCEL_INT2_PIN, (active & map) != 0);
+}
+
+static uint8_t read_reg(uint8_t reg)
+{
+  const accel_sample *s = head();
+  switch (reg)
+  {
+    case ADXL343_DATAX0: return (uint8_t)(s->x & 0xFF);
+    case ADXL343_DATAX1: return (uint8_t)((uint16_t)s->x >> 8);
+    case ADXL343_DATAY0: return (uint8_t)(s->y & 0xFF);
+    case ADXL343_DATAY1: return (uint8_t)((uint16_t)s->y >> 8);
+    case ADXL343_DATAZ0: return (uint8_t)(s->z & 0xFF);
+    case ADXL343_DATAZ1: return (uint8_t)((uint16_t)s->z >> 8);
+    default:             return adxl343_model.regs[reg & ADDRESS_MASK];
+  }
+}
+
+static void execute(const uint8_t *tx, uint8_t *rx, uint32_t nbytes,
+                    bool is_async)
+{
+  adxl343_model_state *m = &adxl343_model;
+  uint8_t cmd = tx[0];
+  bool is_read = (cmd & READ_MASK) != 0;
+  bool is_multi = (cmd & MULTI_BYTE_MASK) != 0;
+  uint8_t addr = cmd & ADDRESS_MASK;
+  bool is_data_read = false;
+  bool is_source_read = false;
+
+  m->transactions++;
+  m->bytes += nbytes;
+  if (!is_read) m->writes++;
+  if (m->log_len < ADXL343_MODEL_LOG_LEN)
+  {
+    adxl343_model_xfer *x = &m->log[m->log_len++];
+    x->cmd = cmd;
+    x->nbytes = (uint8_t)nbytes;
+    x->is_async = is_async;
+  }
+
+  rx[0] = 0xFF; // SDO floats while the command byte is shifted in
+  for (uint32_t i=1; i<nbytes; i++)
+  {
+    uint8_t reg = (uint8_t)((is_multi ? addr + i - 1 : addr) & ADDRESS_MASK);
+    if (is_read)
+    {
+      rx[i] = read_reg(reg);
+      if (reg >= ADXL343_DATAX0 && reg <= ADXL343_DATAZ1) is_data_read = true;
+      if (reg == ADXL343_INT_SOURCE) is_source_read = true;
+    }
+    else
+    {
+      rx[i] = 0xFF;
+      if (is_writable(reg)) m->regs[reg] = tx[i];
+    }
+  }
+
+  // the FIFO pops once the transaction that read the data registers ends,
+  // reading INT_SOURCE clears the latched (semantic) sources
+  if (is_data_read && m->fifo_count > 0)
+  {
+    m->output = m->fifo[m->fifo_head];
+    m->fifo_head = (m->fifo_head + 1) % ADXL343_MODEL_FIFO;
+    m->fifo_count--;
+  }
+  if (is_source_read)
+  {
+    m->regs[ADXL343_INT_SOURCE] &= (INT_DATA_READY | INT_WATERMARK | INT_OVERRUN);
+  }
+  update_interrupts();
+}
+
+static int model_transfer(const uint8_t *tx, uint8_t *rx, uint32_t nbytes)
+{
+  // a blocking transfer waits for the asynchronous one in flight
+  if (adxl343_model.is_async_busy) adxl343_model_complete();
+  if (adxl343_model.fail_transfers > 0)
+  {
+    adxl343_model.fail_transfers--;
+    memset(rx, 0xA5, nbytes); // whatever was on the wire
+    return -1;
+  }
+  execute(tx, rx, nbytes, false);
+  return 0;
+}
+
+static int model_transfer_async(const uint8_t *tx, uint8_t *rx, uint32_t nbytes)
+{
+  if (adxl343_model.is_async_busy) return -1;
+  if (adxl343_model.fail_async > 0)
+  {
+    adxl343_model.fail_async--;
+    return -1;
+  }
+  adxl343_model.async_tx = tx;
+  adxl343_model.async_rx = rx;
+  adxl343_model.async_nbytes = nbytes;
+  adxl343_model.is_async_busy = true;
+  return 0;
+}
+
+static bool model_is_busy()
+{
+  return adxl343_model.is_async_busy;
+}
+
+// the driver binds to this transport by default
+const spi_bus spi_usart1_bus = {
+  .transfer = model_transfer,
+  .transfer_async = model_transfer_async,
+  .is_busy = model_is_busy
+};
+
+void adxl343_model_reset()
+{
+  stub_gpio_reset();
+  stub_bt_reset();
+  memset(&adxl343_model, 0x0, sizeof(adxl343_model));
+  adxl343_model.regs[ADXL343_DEVID] = 0xE5;
+  adxl343_model.regs[ADXL343_BW_RATE] = 0x0A;
+  adxl343_model.regs[ADXL343_INT_SOURCE] = 0x02;
+  update_interrupts();
+}
+
+void adxl343_model_clear_log()
+{
+  adxl343_model.transactions = 0;
+  adxl343_model.bytes = 0;
+  adxl343_model.writes = 0;
+  adxl343_model.log_len = 0;
+}
+
+void adxl343_model_produce(const accel_sample *s, uint32_t n)
+{
+  adxl343_model_state *m = &adxl343_model;
+  for (uint32_t i=0; i<n; i++)
+  {
+    if (m->fifo_count == ADXL343_MODEL_FIFO)
+    {
+      // stream mode, the oldest entry is replaced
+      m->fifo_head = (m->fifo_head + 1) % ADXL343_MODEL_FIFO;
+      m->fifo_count--;
+      m->regs[ADXL343_INT_SOURCE] |= INT_OVERRUN;
+      m->overruns++;
+    }
+    accel_sample v = s[i];
+    v.x += (int8_t)m->regs[ADXL343_OFSX] * ACCEL_LSB_PER_G / ACCEL_OFS_PER_G;
+    v.y += (int8_t)m->regs[ADXL343_OFSY] * ACCEL_LSB_PER_G / ACCEL_OFS_PER_G;
+    v.z += (int8_t)m->regs[ADXL343_OFSZ] * ACCEL_LSB_PER_G / ACCEL_OFS_PER_G;
+    m->fifo[(m->fifo_head + m->fifo_count) % ADXL343_MODEL_FIFO] = v;
+    m->fifo_count++;
+    update_interrupts();
+  }
+}
+
+void adxl343_model_latch(uint8_t sources, uint8_t act_tap_status)
+{
+  adxl343_model_state *m = &adxl343_model;
+  uint8_t auto_sleep = POWER_CTL_AUTO_SLEEP | POWER_CTL_LINK;
+  if ((m->regs[ADXL343_POWER_CTL] & auto_sleep) == auto_sleep)
+  {
+    if (sources & INT_INACTIVITY) m->is_asleep = true;
+    if (sources & INT_ACTIVITY) m->is_asleep = false;
+  }
+  else
+  {
+    m->is_asleep = false;
+  }
+  m->regs[ADXL343_INT_SOURCE] |= sources;
+  m->regs[ADXL343_ACT_TAP_STATUS] = act_tap_status & ~ACT_TAP_STATUS_ASLEEP;
+  if (m->is_asleep) m->regs[ADXL343_ACT_TAP_STATUS] |= ACT_TAP_STATUS_ASLEEP;
+  update_interrupts();
+}
+
+uint32_t adxl343_model_period_ms()
+{
+  const uint8_t *regs = adxl343_model.regs;
+  if (adxl343_model.is_asleep || (regs[ADXL343_POWER_CTL] & POWER_CTL_SLEEP))
+  {
+    return 1000 / (8 >> (regs[ADXL343_POWER_CTL] & POWER_CTL_WAKEUP_MASK));
+  }
+  // 100 Hz at rate code 0xA, doubling per code
+  uint32_t code = regs[ADXL343_BW_RATE] & 0x0F;
+  uint32_t period_us = (code <= 0xA) ? 10000u << (0xA - code)
+                                     : 10000u >> (code - 0xA);
+  return (period_us < 1000) ? 1 : period_us / 1000;
+}
+
+bool adxl343_model_complete()
+{
+  adxl343_model_state *m = &adxl343_model;
+  if (!m->is_async_busy) return false;
+  m->is_async_busy = false;
+  execute(m->async_tx, m->async_rx, m->async_nbytes, true);
+  sl_bt_external_signal(evt_spi_xfer_done);
+  return true;
+}
+
+uint32_t adxl343_model_reads_of(uint8_t reg)
+{
+  uint32_t count = 0;
+  for (uint32_t i=0; i<adxl343_model.log_len; i++)
+  {
+    const adxl343_model_xfer *x = &adxl343_model.log[i];
+    if ((x->cmd & READ_MASK) == 0) continue;
+    uint8_t first = x->cmd & ADDRESS_MASK;
+    uint8_t last = (x->cmd & MULTI_BYTE_MASK) ? first + x->nbytes - 2 : first;
+    if (reg >= first && reg <= last) count++;
+  }
+  return count;
+}
@@ -0,0 +1,125 @@
+/* -----------------------------------------------------------------------------
+ * @file   adxl343_model.h
+ * @brief  Register level model of the ADXL343 behind the SPI transport
+ *
+ *         The model stands in for spi_usart1_bus, so the real driver in
+ *         src/adxl343.c talks to it unchanged. It decodes the command byte
+ *         (read, multi-byte, address), keeps the register file, runs a 32
+ *         entry stream mode FIFO, latches INT_SOURCE and drives the INT1/INT2
+ *         pins of the GPIO stand-in according to INT_ENABLE and INT_MAP.
+ *         With AUTO_SLEEP and Link set in POWER_CTL, a latched inactivity
+ *         puts it to sleep at the Wakeup rate and activity wakes it, as the
+ *         part does.
+ *
+ *         Asynchronous transfers are held until the test calls
+ *         adxl343_model_complete(), which executes the transaction and raises
+ *         evt_spi_xfer_done like the LDMA handler does on target.
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _ADXL343_MODEL_H_
+#define _ADXL343_MODEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "accel_sample.h"
+#include "spi.h"
+
+#define ADXL343_MODEL_REGS      (64)
+#define ADXL343_MODEL_FIFO      (32)
+#define ADXL343_MODEL_LOG_LEN   (256)
+
+// one logged SPI transaction
+typedef struct
+{
+  uint8_t cmd;     // command byte, read/multi-byte/address
+  uint8_t nbytes;  // command byte included
+  bool is_async;
+} adxl343_model_xfer;
+
+typedef struct
+{
+  uint8_t regs[ADXL343_MODEL_REGS];
+  accel_sample fifo[ADXL343_MODEL_FIFO];
+  uint32_t fifo_head;
+  uint32_t fifo_count;
+  accel_sample output;    // data registers while the FIFO is empty
+  bool is_asleep;         // put to sleep by AUTO_SLEEP
+  uint32_t overruns;      // samples replaced before they were read
+
+  // bus counters, command bytes included
+  uint32_t transactions;
+  uint32_t bytes;
+  uint32_t writes;        // write transactions
+  adxl343_model_xfer log[ADXL343_MODEL_LOG_LEN];
+  uint32_t log_len;       // saturates at ADXL343_MODEL_LOG_LEN
+
+  // fault injection, each counter fails that many upcoming transfers
+  uint32_t fail_transfers;
+  uint32_t fail_async;
+
+  // pending asynchronous transfer
+  const uint8_t *async_tx;
+  uint8_t *async_rx;
+  uint32_t async_nbytes;
+  bool is_async_busy;
+} adxl343_model_state;
+
+extern adxl343_model_state adxl343_model;
+
+
+/* @brief  Powers the model up: reset register values, empty FIFO, pins low
+ *         and clears the GPIO and Bluetooth stand-ins
+ */
+void adxl343_model_reset();
+
+
+/* @brief  Clears the bus counters and the transaction log
+ */
+void adxl343_model_clear_log();
+
+
+/* @brief  Produces samples at the output, as the part does once per ODR tick
+ *
+ * OFSX..OFSZ are added to each sample as the part does, in 15.6 mg steps.
+ *
+ * @param  s, samples to produce, oldest first
+ * @param  n, number of samples
+ */
+void adxl343_model_produce(const accel_sample *s, uint32_t n);
+
+
+/* @brief  Latches semantic interrupt sources (tap, activity, free-fall ...)
+ *
+ * @param  sources, INT_SOURCE bits to latch
+ * @param  act_tap_status, value presented in ACT_TAP_STATUS
+ */
+void adxl343_model_latch(uint8_t sources, uint8_t act_tap_status);
+
+
+/* @brief  Returns the output data period the register settings give
+ *
+ * The BW_RATE rate code while awake, the POWER_CTL Wakeup rate (8, 4, 2 or
+ * 1 Hz) while asleep. Whole msec, exact up to 200 Hz.
+ *
+ * @return msec between samples
+ */
+uint32_t adxl343_model_period_ms();
+
+
+/* @brief  Finishes the pending asynchronous transfer
+ *
+ * @return true if a transfer was pending
+ */
+bool adxl343_model_complete();
+
+
+/* @brief  Counts logged transactions that touched a register
+ *
+ * @param  reg, register address
+ * @return number of transactions whose address range covers reg
+ */
+uint32_t adxl343_model_reads_of(uint8_t reg);
+
+#endif // _ADXL343_MODEL_H_
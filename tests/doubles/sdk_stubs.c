@@ -0,0 +1,145 @@
+/* -----------------------------------------------------------------------------
+ * @file   sdk_stubs.c
+ * @brief  RAM backed implementations of the SDK stand-ins in tests/stubs
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "em_core.h"
+#include "em_gpio.h"
+#include "sl_bluetooth.h"
+#include "timers.h"
+
+stub_gpio_state stub_gpio;
+stub_bt_state stub_bt;
+uint32_t stub_uptime_ms;
+
+uint32_t letimer0_get_uptime_msec()
+{
+  return stub_uptime_ms;
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq)
+{
+  (void)irq;
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq)
+{
+  stub_gpio.nvic_enabled |= (1u << irq);
+}
+
+void stub_gpio_reset()
+{
+  memset(&stub_gpio, 0x0, sizeof(stub_gpio));
+}
+
+void stub_gpio_set_level(GPIO_Port_TypeDef port, unsigned int pin, bool level)
+{
+  bool was = stub_gpio.level[port][pin];
+  stub_gpio.level[port][pin] = level;
+  if (was == level) return;
+
+  // on the EFR32 external interrupt n can only come from pin n
+  stub_gpio_extint *ext = &stub_gpio.extint[pin];
+  if (!ext->is_configured || ext->port != port) return;
+  if ((level && ext->rising_edge) || (!level && ext->falling_edge))
+  {
+    stub_gpio.iflag |= (1u << pin);
+  }
+}
+
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin,
+                     GPIO_Mode_TypeDef mode, unsigned int out)
+{
+  (void)out;
+  stub_gpio.mode[port][pin] = (uint8_t)mode;
+}
+
+unsigned int GPIO_PinInGet(GPIO_Port_TypeDef port, unsigned int pin)
+{
+  return stub_gpio.level[port][pin] ? 1 : 0;
+}
+
+void GPIO_ExtIntConfig(GPIO_Port_TypeDef port, unsigned int pin,
+                       unsigned int intNo, bool risingEdge, bool fallingEdge,
+                       bool enable)
+{
+  // the stand-in only models the fixed pin n -> interrupt n routing
+  stub_gpio_extint *ext = &stub_gpio.extint[intNo];
+  ext->is_configured = (pin == intNo);
+  ext->port = port;
+  ext->pin = pin;
+  ext->rising_edge = risingEdge;
+  ext->falling_edge = fallingEdge;
+  stub_gpio.iflag &= ~(1u << intNo);
+  if (enable) stub_gpio.ien |= (1u << intNo);
+  else stub_gpio.ien &= ~(1u << intNo);
+}
+
+uint32_t GPIO_IntGetEnabled()
+{
+  return stub_gpio.iflag & stub_gpio.ien;
+}
+
+void GPIO_IntClear(uint32_t flags)
+{
+  stub_gpio.iflag &= ~flags;
+}
+
+void GPIO_IntDisable(uint32_t flags)
+{
+  stub_gpio.ien &= ~flags;
+}
+
+void GPIO_IntEnable(uint32_t flags)
+{
+  stub_gpio.ien |= flags;
+}
+
+void stub_bt_reset()
+{
+  memset(&stub_bt, 0x0, sizeof(stub_bt));
+}
+
+sl_status_t sl_bt_external_signal(uint32_t signals)
+{
+  stub_bt.signals |= signals;
+  stub_bt.signal_calls++;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_nvm_save(uint16_t key, size_t value_len,
+                           const uint8_t *value)
+{
+  if (value_len > STUB_NVM_VALUE_LEN) return SL_STATUS_FAIL;
+  uint32_t i;
+  for (i=0; i<stub_bt.nvm_used; i++)
+  {
+    if (stub_bt.nvm[i].key == key) break;
+  }
+  if (i == stub_bt.nvm_used)
+  {
+    if (stub_bt.nvm_used == STUB_NVM_KEYS) return SL_STATUS_FAIL;
+    stub_bt.nvm_used++;
+  }
+  stub_bt.nvm[i].key = key;
+  stub_bt.nvm[i].len = value_len;
+  memcpy(stub_bt.nvm[i].value, value, value_len);
+  stub_bt.nvm_saves++;
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_nvm_load(uint16_t key, size_t max_value_size,
+                           size_t *value_len, uint8_t *value)
+{
+  for (uint32_t i=0; i<stub_bt.nvm_used; i++)
+  {
+    if (stub_bt.nvm[i].key != key) continue;
+    if (stub_bt.nvm[i].len > max_value_size) return SL_STATUS_FAIL;
+    memcpy(value, stub_bt.nvm[i].value, stub_bt.nvm[i].len);
+    *value_len = stub_bt.nvm[i].len;
+    return SL_STATUS_OK;
+  }
+  return SL_STATUS_NOT_FOUND;
+}
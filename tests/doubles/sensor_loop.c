@@ -0,0 +1,96 @@
+/* -----------------------------------------------------------------------------
+ * @file   sensor_loop.c
+ * @brief  Host event loop that runs the sensor model, driver and pipeline
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "sensor_loop.h"
+#include "adxl343.h"
+#include "adxl343_model.h"
+#include "detector_config.h"
+#include "pipeline.h"
+
+void sensor_loop_init(sensor_loop *l, sensor_loop_signal signal, void *arg)
+{
+  adxl343_model_reset();
+  accel_init(NULL);
+  pipeline_init();
+
+  l->now_ms = 0;
+  l->period_ms = DET_PERIOD_MS;
+  l->next_sample_ms = adxl343_model_period_ms();
+  l->signal = signal;
+  l->arg = arg;
+  l->drain_buf = NULL;
+  l->drain_start_ms = 0;
+  l->produced = 0;
+  l->misdated = 0;
+  l->committed = 0;
+  l->drains = 0;
+}
+
+void sensor_loop_set_rate(sensor_loop *l, uint8_t bw_rate, uint32_t period_ms)
+{
+  accel_update_register(ADXL343_BW_RATE, bw_rate);
+  pipeline_set_rate(period_ms, l->now_ms);
+  l->period_ms = period_ms;
+  l->next_sample_ms = l->now_ms + adxl343_model_period_ms();
+}
+
+// the external signal handler, INT2 and the drain completions
+static void service(sensor_loop *l)
+{
+  if (stub_bt.signals & evt_accel_GPIO_INT2)
+  {
+    stub_bt.signals &= ~evt_accel_GPIO_INT2;
+    uint32_t span = pipeline_drain_span(&l->drain_buf);
+    if (span > ACCEL_FIFO_DEPTH) span = ACCEL_FIFO_DEPTH;
+    if (span > 0)
+    {
+      l->drain_start_ms = l->now_ms;
+      if (accel_fifo_drain_async(l->drain_buf, span) != 0 &&
+          !accel_fifo_is_draining())
+      {
+        stub_bt.signals |= evt_accel_GPIO_INT2;
+      }
+    }
+    else
+    {
+      stub_bt.signals |= evt_accel_GPIO_INT2;
+    }
+  }
+
+  // a few us per frame, the whole drain completes within the tick
+  while (adxl343_model_complete())
+  {
+    stub_bt.signals &= ~evt_spi_xfer_done;
+    int n = 0;
+    if (accel_fifo_drain_step(&n))
+    {
+      pipeline_commit((uint32_t)n, l->drain_start_ms);
+      l->committed += (uint32_t)n;
+      l->drains++;
+      if (accel_is_int2_asserted()) stub_bt.signals |= evt_accel_GPIO_INT2;
+    }
+  }
+}
+
+void sensor_loop_run(sensor_loop *l, uint32_t until_ms)
+{
+  while ((int32_t)(until_ms - l->now_ms) > 0)
+  {
+    if (l->now_ms == l->next_sample_ms)
+    {
+      accel_sample s = l->signal(l->now_ms, l->arg);
+      adxl343_model_produce(&s, 1);
+      l->produced++;
+      uint32_t period = adxl343_model_period_ms();
+      if (period != l->period_ms) l->misdated++;
+      l->next_sample_ms += period;
+    }
+    GPIO_ODD_IRQHandler();
+    service(l);
+    pipeline_process();
+    l->now_ms++;
+  }
+}
@@ -0,0 +1,71 @@
+/* -----------------------------------------------------------------------------
+ * @file   sensor_loop.h
+ * @brief  Host event loop that runs the sensor model, driver and pipeline
+ *         together the way ble.c glues them on target
+ *
+ *         Time advances in 1 ms ticks. The model produces a sample whenever
+ *         the output period its registers give elapses (sleep included),
+ *         and samples produced at another period than the one the pipeline
+ *         back-dates with are counted as misdated. INT2 edges start an
+ *         asynchronous drain stamped with the drain start time, completions
+ *         are stepped and committed, and the pipeline runs once per tick
+ *         like app_process_action().
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _SENSOR_LOOP_H_
+#define _SENSOR_LOOP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "accel_sample.h"
+
+// the acceleration the wearer produces at time t
+typedef accel_sample (*sensor_loop_signal)(uint32_t t_ms, void *arg);
+
+typedef struct
+{
+  uint32_t now_ms;
+  uint32_t period_ms;       // output data period the pipeline was given
+  uint32_t next_sample_ms;
+  sensor_loop_signal signal;
+  void *arg;
+  accel_sample *drain_buf;
+  uint32_t drain_start_ms;
+  uint32_t produced;        // samples produced by the model
+  uint32_t misdated;        // produced at another period than period_ms
+  uint32_t committed;       // samples committed to the pipeline
+  uint32_t drains;
+} sensor_loop;
+
+
+/* @brief  Resets the model, brings up the driver and empties the pipeline
+ *
+ * @param  sensor_loop*, loop state
+ * @param  sensor_loop_signal, acceleration source
+ * @param  void*, passed to the source
+ * @return None
+ */
+void sensor_loop_init(sensor_loop *l, sensor_loop_signal signal, void *arg);
+
+
+/* @brief  Switches the output data rate as update_sampling() does
+ *
+ * @param  sensor_loop*, loop state
+ * @param  uint8_t, BW_RATE value
+ * @param  uint32_t, sample period in msec at that rate
+ * @return None
+ */
+void sensor_loop_set_rate(sensor_loop *l, uint8_t bw_rate, uint32_t period_ms);
+
+
+/* @brief  Runs the loop up to (not including) a time
+ *
+ * @param  sensor_loop*, loop state
+ * @param  uint32_t, time in msec to stop at
+ * @return None
+ */
+void sensor_loop_run(sensor_loop *l, uint32_t until_ms);
+
+#endif // _SENSOR_LOOP_H_
@@ -0,0 +1,12 @@
+/* -----------------------------------------------------------------------------
+ * @file   app_log.h
+ * @brief  Host stand-in for the SDK log component, LOG() goes to printf
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _APP_LOG_H_
+#define _APP_LOG_H_
+
+#include <stdio.h>
+
+#endif // _APP_LOG_H_
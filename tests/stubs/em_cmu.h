@@ -0,0 +1,12 @@
+/* -----------------------------------------------------------------------------
+ * @file   em_cmu.h
+ * @brief  Host stand-in for emlib CMU, nothing is used off target
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _EM_CMU_H_
+#define _EM_CMU_H_
+
+#include "em_device.h"
+
+#endif // _EM_CMU_H_
@@ -0,0 +1,17 @@
+/* -----------------------------------------------------------------------------
+ * @file   em_core.h
+ * @brief  Host stand-in for emlib CORE, critical sections are no-ops
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _EM_CORE_H_
+#define _EM_CORE_H_
+
+#include "em_device.h"
+
+#define CORE_DECLARE_IRQ_STATE
+#define CORE_ENTER_CRITICAL()
+#define CORE_EXIT_CRITICAL()
+#define CORE_CRITICAL_SECTION(yourcode) { yourcode }
+
+#endif // _EM_CORE_H_
@@ -0,0 +1,59 @@
+/* -----------------------------------------------------------------------------
+ * @file   em_device.h
+ * @brief  Host stand-in for the device header: IRQ numbers, NVIC calls and
+ *         a bit-exact emulation of the Cortex-M4 SIMD intrinsics, so the
+ *         DSP kernels can be built on host with -D__ARM_FEATURE_DSP=1
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _EM_DEVICE_H_
+#define _EM_DEVICE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef enum
+{
+  GPIO_EVEN_IRQn = 10,
+  GPIO_ODD_IRQn =  18
+} IRQn_Type;
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+void NVIC_EnableIRQ(IRQn_Type irq);
+
+static inline uint32_t __UNALIGNED_UINT32_READ(const void *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// dual 16x16 multiply, lo*lo + hi*hi, wraps like the instruction (Q flag
+// is not modelled)
+static inline uint32_t __SMUAD(uint32_t a, uint32_t b)
+{
+  int64_t lo = (int64_t)(int16_t)a * (int16_t)b;
+  int64_t hi = (int64_t)(int16_t)(a >> 16) * (int16_t)(b >> 16);
+  return (uint32_t)(lo + hi);
+}
+
+static inline uint32_t __SMLAD(uint32_t a, uint32_t b, uint32_t acc)
+{
+  return __SMUAD(a, b) + acc;
+}
+
+// sign-extends bytes 0 and 2 into the two halfwords
+static inline uint32_t __SXTB16(uint32_t v)
+{
+  return ((uint32_t)(uint16_t)(int16_t)(int8_t)v) |
+         ((uint32_t)(uint16_t)(int16_t)(int8_t)(v >> 16) << 16);
+}
+
+static inline uint32_t __ROR(uint32_t v, uint32_t n)
+{
+  n &= 31;
+  return n ? (v >> n) | (v << (32 - n)) : v;
+}
+
+#endif // _EM_DEVICE_H_
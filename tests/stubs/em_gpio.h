@@ -0,0 +1,75 @@
+/* -----------------------------------------------------------------------------
+ * @file   em_gpio.h
+ * @brief  Host stand-in for emlib GPIO
+ *
+ *         Pin levels and the external interrupt flags live in RAM. A sensor
+ *         model drives a pin with stub_gpio_set_level(), a rising edge on a
+ *         pin whose external interrupt is configured and enabled sets its
+ *         flag, and the test then calls the GPIO IRQ handler.
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _EM_GPIO_H_
+#define _EM_GPIO_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "em_device.h"
+
+typedef enum
+{
+  gpioPortA = 0,
+  gpioPortB = 1,
+  gpioPortC = 2,
+  gpioPortD = 3,
+  gpioPortE = 4,
+  gpioPortF = 5
+} GPIO_Port_TypeDef;
+
+typedef enum
+{
+  gpioModeDisabled = 0,
+  gpioModeInput =    1,
+  gpioModePushPull = 4
+} GPIO_Mode_TypeDef;
+
+#define STUB_GPIO_PORTS (6)
+#define STUB_GPIO_PINS  (16)
+
+// one external interrupt line as configured by GPIO_ExtIntConfig()
+typedef struct
+{
+  bool is_configured;
+  GPIO_Port_TypeDef port;
+  unsigned int pin;
+  bool rising_edge;
+  bool falling_edge;
+} stub_gpio_extint;
+
+typedef struct
+{
+  uint8_t mode[STUB_GPIO_PORTS][STUB_GPIO_PINS];
+  bool level[STUB_GPIO_PORTS][STUB_GPIO_PINS];
+  stub_gpio_extint extint[STUB_GPIO_PINS];
+  uint32_t ien;   // external interrupt enables
+  uint32_t iflag; // external interrupt flags
+  uint32_t nvic_enabled; // bit per IRQn_Type
+} stub_gpio_state;
+
+extern stub_gpio_state stub_gpio;
+
+void stub_gpio_reset();
+void stub_gpio_set_level(GPIO_Port_TypeDef port, unsigned int pin, bool level);
+
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin,
+                     GPIO_Mode_TypeDef mode, unsigned int out);
+unsigned int GPIO_PinInGet(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_ExtIntConfig(GPIO_Port_TypeDef port, unsigned int pin,
+                       unsigned int intNo, bool risingEdge, bool fallingEdge,
+                       bool enable);
+uint32_t GPIO_IntGetEnabled();
+void GPIO_IntClear(uint32_t flags);
+void GPIO_IntDisable(uint32_t flags);
+void GPIO_IntEnable(uint32_t flags);
+
+#endif // _EM_GPIO_H_
@@ -0,0 +1,18 @@
+/* -----------------------------------------------------------------------------
+ * @file   em_letimer.h
+ * @brief  Host stand-in for emlib LETIMER
+ *
+ *         There is no LETIMER0 off target. letimer0_get_uptime_msec()
+ *         returns stub_uptime_ms, which the test advances by hand.
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _EM_LETIMER_H_
+#define _EM_LETIMER_H_
+
+#include <stdint.h>
+#include "em_device.h"
+
+extern uint32_t stub_uptime_ms;
+
+#endif // _EM_LETIMER_H_
@@ -0,0 +1,12 @@
+/* -----------------------------------------------------------------------------
+ * @file   em_usart.h
+ * @brief  Host stand-in for emlib USART, nothing is used off target
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _EM_USART_H_
+#define _EM_USART_H_
+
+#include "em_device.h"
+
+#endif // _EM_USART_H_
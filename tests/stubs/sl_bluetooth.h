@@ -0,0 +1,49 @@
+/* -----------------------------------------------------------------------------
+ * @file   sl_bluetooth.h
+ * @brief  Host stand-in for the Bluetooth stack calls made by the drivers
+ *
+ *         External signals are OR'ed into stub_bt.signals for the test to
+ *         inspect and clear. The NVM keeps a handful of keys in RAM.
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _SL_BLUETOOTH_H_
+#define _SL_BLUETOOTH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t sl_status_t;
+
+#define SL_STATUS_OK        ((sl_status_t)0x0000)
+#define SL_STATUS_FAIL      ((sl_status_t)0x0001)
+#define SL_STATUS_NOT_FOUND ((sl_status_t)0x000E)
+
+#define STUB_NVM_KEYS      (8)
+#define STUB_NVM_VALUE_LEN (32)
+
+typedef struct
+{
+  uint32_t signals; // OR of every sl_bt_external_signal() since the last clear
+  uint32_t signal_calls;
+  struct
+  {
+    uint16_t key;
+    size_t len;
+    uint8_t value[STUB_NVM_VALUE_LEN];
+  } nvm[STUB_NVM_KEYS];
+  uint32_t nvm_used;
+  uint32_t nvm_saves;
+} stub_bt_state;
+
+extern stub_bt_state stub_bt;
+
+void stub_bt_reset();
+
+sl_status_t sl_bt_external_signal(uint32_t signals);
+sl_status_t sl_bt_nvm_save(uint16_t key, size_t value_len,
+                           const uint8_t *value);
+sl_status_t sl_bt_nvm_load(uint16_t key, size_t max_value_size,
+                           size_t *value_len, uint8_t *value);
+
+#endif // _SL_BLUETOOTH_H_
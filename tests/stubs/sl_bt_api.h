@@ -0,0 +1,12 @@
+/* -----------------------------------------------------------------------------
+ * @file   sl_bt_api.h
+ * @brief  Host stand-in for the BGAPI header, see sl_bluetooth.h
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _SL_BT_API_H_
+#define _SL_BT_API_H_
+
+#include "sl_bluetooth.h"
+
+#endif // _SL_BT_API_H_
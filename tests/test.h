@@ -0,0 +1,105 @@
+/* -----------------------------------------------------------------------------
+ * @file   test.h
+ * @brief  Minimal host test helpers
+ *
+ *         Each test is one executable: checks count failures without
+ *         stopping, test_summary() prints the tally and returns the exit
+ *         code for ctest.
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static int test_checks;
+static int test_failures;
+
+#define CHECK(cond) \
+  do { \
+    test_checks++; \
+    if (!(cond)) \
+    { \
+      test_failures++; \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+    } \
+  } while (0)
+
+#define CHECK_EQ(a, b) \
+  do { \
+    long long _a = (long long)(a); \
+    long long _b = (long long)(b); \
+    test_checks++; \
+    if (_a != _b) \
+    { \
+      test_failures++; \
+      printf("%s:%d: CHECK_EQ(%s, %s) failed, %lld != %lld\n", \
+             __FILE__, __LINE__, #a, #b, _a, _b); \
+    } \
+  } while (0)
+
+#define CHECK_NEAR(a, b, tol) \
+  do { \
+    double _a = (double)(a); \
+    double _b = (double)(b); \
+    test_checks++; \
+    if (_a - _b > (tol) || _b - _a > (tol)) \
+    { \
+      test_failures++; \
+      printf("%s:%d: CHECK_NEAR(%s, %s) failed, %g vs %g\n", \
+             __FILE__, __LINE__, #a, #b, _a, _b); \
+    } \
+  } while (0)
+
+// deterministic pseudo-random numbers, a 32 bit LCG. Each test seeds it
+// with test_seed() so its traces are the same on every run
+static uint32_t test_rng = 1;
+
+static inline void test_seed(uint32_t seed)
+{
+  test_rng = seed;
+}
+
+// 24 random bits, the LCG's low bits are poor and dropped
+static inline uint32_t test_rand()
+{
+  test_rng = test_rng * 1103515245u + 12345u;
+  return test_rng >> 8;
+}
+
+// uniform in lo..hi, both included
+static inline uint32_t test_rand_range(uint32_t lo, uint32_t hi)
+{
+  return lo + test_rand() % (hi - lo + 1);
+}
+
+// uniform in [0, 1)
+static inline double test_rand_unit()
+{
+  return test_rand() / 16777216.0;
+}
+
+// uniform in -amp..amp
+static inline int32_t test_rand_noise(int32_t amp)
+{
+  return (int32_t)(test_rand() % (uint32_t)(2 * amp + 1)) - amp;
+}
+
+// monotonic host time for the benchmark style tests
+static inline uint64_t test_now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline int test_summary(const char *name)
+{
+  printf("%s: %d checks, %d failed\n", name, test_checks, test_failures);
+  return test_failures ? 1 : 0;
+}
+
+#endif // _TEST_H_
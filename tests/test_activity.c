@@ -0,0 +1,199 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_activity.c
+ * @brief  Activity aggregator: debounce, per-minute duty cycle, cadence and
+ *         the indications per hour of a restless wearer, edges vs summaries
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "activity.h"
+
+#define HOUR_MS  (3600UL * 1000)
+
+// polls every 500 ms up to end, returns the number of summaries
+static uint32_t poll_until(activity_context *a, uint32_t *now, uint32_t end,
+                           uint8_t *last)
+{
+  uint32_t n = 0;
+  uint8_t v;
+  for (; *now < end; *now += 500)
+  {
+    if (activity_poll(a, *now, &v))
+    {
+      *last = v;
+      n++;
+    }
+  }
+  return n;
+}
+
+static void test_debounce()
+{
+  activity_context a;
+  uint32_t now = 0;
+  uint8_t v = 0xFF;
+  activity_init(&a, 0, now);
+  CHECK_EQ(a.cadence_ms, ACTIVITY_DEFAULT_CADENCE_MS);
+
+  // flapping faster than the debounce never changes the published state
+  for (int i=0; i<20; i++)
+  {
+    activity_edge(&a, (i & 1) == 0, now);
+    CHECK_EQ(poll_until(&a, &now, now + ACTIVITY_DEBOUNCE_MS - 1000, &v), 0);
+  }
+  CHECK(!a.is_published_active);
+  CHECK(!a.is_published);
+  CHECK_EQ(a.edges, 20);
+
+  // a held activity edge publishes once the debounce passed, right away
+  // for the first summary
+  activity_edge(&a, true, now);
+  uint32_t edge = now;
+  CHECK_EQ(poll_until(&a, &now, edge + ACTIVITY_DEBOUNCE_MS, &v), 0);
+  CHECK_EQ(poll_until(&a, &now, edge + ACTIVITY_DEBOUNCE_MS + 500, &v), 1);
+  CHECK(v & ACTIVITY_STATE_BIT);
+  CHECK(a.is_published_active);
+
+  // later changes wait for the cadence
+  activity_edge(&a, false, now);
+  CHECK_EQ(poll_until(&a, &now, a.publish_start_ms + a.cadence_ms, &v), 0);
+  CHECK(!a.is_published_active);
+  CHECK_EQ(poll_until(&a, &now, now + 1000, &v), 1);
+  CHECK_EQ(v & ACTIVITY_STATE_BIT, 0);
+
+  // the same summary again is not repeated
+  CHECK_EQ(poll_until(&a, &now, now + 3 * a.cadence_ms, &v), 0);
+  CHECK_EQ(a.published, 2);
+}
+
+static void test_duty()
+{
+  activity_context a;
+  uint32_t now = 1000;
+  activity_init(&a, 60000, now);
+  CHECK_EQ(activity_minute_duty(&a, 0), 0);
+
+  // 15 s active in the first minute, the whole second, none in the third
+  activity_edge(&a, true, now + 30000);
+  activity_edge(&a, false, now + 45000);
+  activity_edge(&a, true, now + 60000);
+  activity_edge(&a, false, now + 120000);
+  uint8_t v;
+  activity_poll(&a, now + 180000, &v);
+  CHECK_EQ(a.minutes, 3);
+  CHECK_EQ(activity_minute_duty(&a, 2), 25);
+  CHECK_EQ(activity_minute_duty(&a, 1), 100);
+  CHECK_EQ(activity_minute_duty(&a, 0), 0);
+  CHECK_EQ(activity_minute_duty(&a, 3), 0);
+
+  // only the last ACTIVITY_MINUTES are kept
+  activity_edge(&a, true, now + 180000);
+  activity_poll(&a, now + 180000 + ACTIVITY_MINUTES * ACTIVITY_MINUTE_MS, &v);
+  CHECK_EQ(a.minutes, 3 + ACTIVITY_MINUTES);
+  CHECK_EQ(activity_minute_duty(&a, 0), 100);
+  CHECK_EQ(activity_minute_duty(&a, ACTIVITY_MINUTES - 1), 100);
+  CHECK_EQ(activity_minute_duty(&a, ACTIVITY_MINUTES), 0);
+
+  // duty of the cadence interval in the summary, across the uptime wrap
+  now = UINT32_MAX - 20000;
+  activity_init(&a, 60000, now);
+  activity_edge(&a, true, now);
+  activity_edge(&a, false, now + 45000);
+  CHECK(!activity_poll(&a, now + 59999, &v));
+  CHECK(activity_poll(&a, now + 60000, &v));
+  CHECK_EQ(v, 75);
+
+  // a new cadence applies from the next summary
+  activity_set_cadence(&a, 10000);
+  CHECK_EQ(a.cadence_ms, 10000);
+  activity_edge(&a, true, now + 60000);
+  CHECK(activity_poll(&a, now + 70000, &v));
+  CHECK_EQ(v, 100 | ACTIVITY_STATE_BIT);
+  activity_set_cadence(&a, 0);
+  CHECK_EQ(a.cadence_ms, ACTIVITY_DEFAULT_CADENCE_MS);
+}
+
+/* A restless wearer for a day. Bouts of 5-60 s of movement, rests of 20-120 s
+ * between them, each bout raising an activity and an inactivity interrupt.
+ * Without the aggregator every edge was one indication.
+ */
+// an INT1 edge latched while the main loop was busy arrives dated before
+// the poll that ran in the meantime
+static void test_late_edge()
+{
+  activity_context a;
+  uint8_t v;
+  activity_init(&a, 0, 0);
+  activity_edge(&a, true, 1000);
+  activity_poll(&a, 60010, &v);
+  activity_edge(&a, false, 59990);
+  CHECK_EQ(a.minutes, 1);
+  CHECK_EQ(a.last_update_ms, 60010);
+  CHECK_EQ(a.minute_active_ms, 10);
+  CHECK_EQ(activity_minute_duty(&a, 0), 98);
+  CHECK(!a.is_active);
+
+  // nothing more is accounted active after it, across the wrap as well
+  activity_poll(&a, 180000, &v);
+  CHECK_EQ(a.minutes, 3);
+  CHECK_EQ(activity_minute_duty(&a, 0), 0);
+  CHECK_EQ(activity_minute_duty(&a, 1), 0);
+
+  activity_init(&a, 0, UINT32_MAX - 1000);
+  activity_edge(&a, true, UINT32_MAX - 500);
+  activity_poll(&a, 500, &v);
+  activity_edge(&a, false, UINT32_MAX - 100);
+  CHECK_EQ(a.minutes, 0);
+  CHECK_EQ(a.minute_active_ms, 1001);
+}
+
+static void test_replay()
+{
+  static const uint32_t cadences[] = {
+    60000, 5UL * 60 * 1000, 15UL * 60 * 1000
+  };
+  const uint32_t hours = 24;
+  for (uint32_t c=0; c<sizeof(cadences)/sizeof(cadences[0]); c++)
+  {
+    activity_context a;
+    activity_init(&a, cadences[c], 0);
+    test_seed(2);
+
+    uint32_t edges = 0, summaries = 0, next = 1000;
+    bool is_active = false;
+    uint8_t v;
+    for (uint32_t t=0; t<hours * HOUR_MS; t+=500)
+    {
+      if (t >= next)
+      {
+        is_active = !is_active;
+        activity_edge(&a, is_active, t);
+        edges++;
+        next = t + (is_active ? test_rand_range(5000, 60000)
+                              : test_rand_range(20000, 120000));
+      }
+      if (activity_poll(&a, t, &v)) summaries++;
+    }
+    printf("cadence %3lu s: %.1f indications/h as edges, %.1f as summaries\n",
+           (unsigned long)(cadences[c] / 1000), edges / (double)hours,
+           summaries / (double)hours);
+    CHECK_EQ(a.edges, edges);
+    CHECK(summaries <= hours * HOUR_MS / cadences[c] + 1);
+    // at a one minute cadence the duty differs almost every time, the
+    // reduction is checked from the default cadence up
+    if (cadences[c] >= ACTIVITY_DEFAULT_CADENCE_MS)
+    {
+      CHECK(summaries * 5 < edges);
+    }
+  }
+}
+
+int main()
+{
+  test_seed(2);
+  test_debounce();
+  test_duty();
+  test_late_edge();
+  test_replay();
+  return test_summary("test_activity");
+}
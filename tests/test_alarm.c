@@ -0,0 +1,259 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_alarm.c
+ * @brief  Fall alarm state machine: every transition, the grace deadline
+ *         against tap capture times, retries, the latency bound and the
+ *         time without a subscribed client
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "alarm.h"
+
+#define SEND_AND_RETRY  (ALARM_ACT_SEND | ALARM_ACT_START_TIMER)
+
+// a fresh alarm with a subscribed client
+static void start(alarm_context *a)
+{
+  alarm_init(a);
+  CHECK_EQ(alarm_step(a, ALARM_IN_LINK_UP, 0, 0), ALARM_ACT_NONE);
+  CHECK(a->is_link_up);
+}
+
+static void test_cancel()
+{
+  alarm_context a;
+  start(&a);
+  CHECK_EQ(a.state, ALARM_IDLE);
+  CHECK(!alarm_is_link_reserved(&a));
+
+  // nothing but a fall leaves IDLE
+  CHECK_EQ(alarm_step(&a, ALARM_IN_DOUBLE_TAP, 10, 10), ALARM_ACT_NONE);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_TIMER, 10, 10), ALARM_ACT_NONE);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_DELIVERED, 10, 10), ALARM_ACT_NONE);
+  CHECK_EQ(a.state, ALARM_IDLE);
+
+  CHECK_EQ(alarm_step(&a, ALARM_IN_FALL, 1000, 5000), ALARM_ACT_START_TIMER);
+  CHECK_EQ(a.state, ALARM_GRACE);
+  CHECK_EQ(a.timer_ms, ALARM_GRACE_MS);
+  CHECK_EQ(a.capture_ms, 1000);
+  CHECK_EQ(a.deadline_ms, 5000 + ALARM_GRACE_MS);
+  CHECK(alarm_is_link_reserved(&a));
+
+  // GRACE ignores delivery and a second fall
+  CHECK_EQ(alarm_step(&a, ALARM_IN_DELIVERED, 6000, 6000), ALARM_ACT_NONE);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_FALL, 6000, 6000), ALARM_ACT_NONE);
+  CHECK_EQ(a.capture_ms, 1000);
+
+  CHECK_EQ(alarm_step(&a, ALARM_IN_DOUBLE_TAP, 8000, 8000),
+           ALARM_ACT_STOP_TIMER);
+  CHECK_EQ(a.state, ALARM_CANCELLED);
+  CHECK_EQ(a.cancelled, 1);
+  CHECK(!alarm_is_link_reserved(&a));
+  CHECK_EQ(a.sends, 0);
+
+  // a stale expiry is ignored, a new fall starts over
+  CHECK_EQ(alarm_step(&a, ALARM_IN_TIMER, 15000, 15000), ALARM_ACT_NONE);
+  CHECK_EQ(a.state, ALARM_CANCELLED);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_FALL, 20000, 21000), ALARM_ACT_START_TIMER);
+  CHECK_EQ(a.state, ALARM_GRACE);
+}
+
+static void test_tap_deadline()
+{
+  alarm_context a;
+  start(&a);
+  alarm_step(&a, ALARM_IN_FALL, 1000, 2000);
+  uint32_t deadline = a.deadline_ms;
+
+  // captured on the deadline, handled after it, before the expiry
+  CHECK_EQ(alarm_step(&a, ALARM_IN_DOUBLE_TAP, deadline, deadline + 40),
+           ALARM_ACT_STOP_TIMER);
+  CHECK_EQ(a.state, ALARM_CANCELLED);
+
+  // captured after the deadline: ignored, the expiry confirms
+  alarm_step(&a, ALARM_IN_FALL, 1000, 2000);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_DOUBLE_TAP, deadline + 1, deadline + 1),
+           ALARM_ACT_NONE);
+  CHECK_EQ(a.state, ALARM_GRACE);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_TIMER, deadline, deadline + 2),
+           SEND_AND_RETRY);
+  CHECK_EQ(a.state, ALARM_CONFIRMED);
+
+  // once the expiry is handled the alarm is out, even an early tap is late
+  CHECK_EQ(alarm_step(&a, ALARM_IN_DOUBLE_TAP, deadline - 100, deadline + 5),
+           ALARM_ACT_NONE);
+  CHECK_EQ(a.state, ALARM_CONFIRMED);
+  CHECK_EQ(a.cancelled, 1);
+}
+
+static void test_confirm_and_deliver()
+{
+  alarm_context a;
+  start(&a);
+  alarm_step(&a, ALARM_IN_FALL, 20000, 24000);
+
+  // an early expiry rearms for the rest of the window
+  CHECK_EQ(alarm_step(&a, ALARM_IN_TIMER, 30000, 30000),
+           ALARM_ACT_START_TIMER);
+  CHECK_EQ(a.state, ALARM_GRACE);
+  CHECK_EQ(a.timer_ms, 4000);
+
+  CHECK_EQ(alarm_step(&a, ALARM_IN_TIMER, 34010, 34010), SEND_AND_RETRY);
+  CHECK_EQ(a.state, ALARM_CONFIRMED);
+  CHECK_EQ(a.timer_ms, ALARM_RETRY_MS);
+  CHECK_EQ(a.sends, 1);
+  CHECK_EQ(a.sent_ms, 34010);
+  CHECK(a.is_measured);
+  CHECK_EQ(a.latency_ms, 14010);
+  CHECK(alarm_is_link_reserved(&a));
+
+  // CONFIRMED resends until delivered, a new fall does not restart it
+  CHECK_EQ(alarm_step(&a, ALARM_IN_FALL, 34020, 34020), ALARM_ACT_NONE);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_TIMER, 39010, 39010), SEND_AND_RETRY);
+  CHECK_EQ(a.sends, 2);
+  CHECK_EQ(a.latency_ms, 14010);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_DELIVERED, 39100, 39100),
+           ALARM_ACT_STOP_TIMER);
+  CHECK_EQ(a.state, ALARM_ESCALATED);
+  CHECK_EQ(a.escalated, 1);
+  CHECK(!alarm_is_link_reserved(&a));
+
+  // ESCALATED takes a new fall
+  CHECK_EQ(alarm_step(&a, ALARM_IN_TIMER, 45000, 45000), ALARM_ACT_NONE);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_FALL, 50000, 52000), ALARM_ACT_START_TIMER);
+  CHECK_EQ(a.state, ALARM_GRACE);
+  CHECK_EQ(a.sends, 0);
+}
+
+static void test_reset()
+{
+  // from every state to IDLE, the timer stops where one runs
+  for (int s=ALARM_IDLE; s<ALARM_NUM_STATES; s++)
+  {
+    alarm_context a;
+    start(&a);
+    if (s != ALARM_IDLE) alarm_step(&a, ALARM_IN_FALL, 1, 2);
+    if (s == ALARM_CANCELLED) alarm_step(&a, ALARM_IN_DOUBLE_TAP, 3, 3);
+    if (s == ALARM_CONFIRMED || s == ALARM_ESCALATED)
+    {
+      alarm_step(&a, ALARM_IN_TIMER, 20000, 20000);
+    }
+    if (s == ALARM_ESCALATED) alarm_step(&a, ALARM_IN_DELIVERED, 1, 20001);
+    CHECK_EQ(a.state, s);
+
+    bool is_timed = (s == ALARM_GRACE || s == ALARM_CONFIRMED);
+    CHECK_EQ(alarm_step(&a, ALARM_IN_RESET, 0, 30000),
+             is_timed ? ALARM_ACT_STOP_TIMER : ALARM_ACT_NONE);
+    CHECK_EQ(a.state, ALARM_IDLE);
+  }
+  CHECK(alarm_state_name(ALARM_CONFIRMED)[0] == 'c');
+  CHECK(alarm_state_name(ALARM_NUM_STATES)[0] == '?');
+}
+
+static void test_latency_bound()
+{
+  // the worst case the bound is made of lands on it exactly
+  alarm_context a;
+  start(&a);
+  uint32_t cap = 100000;
+  uint32_t det = cap + ALARM_DETECT_MAX_MS + ALARM_PIPELINE_MAX_MS;
+  uint32_t out = det + ALARM_GRACE_MS + ALARM_DISPATCH_MS;
+  alarm_step(&a, ALARM_IN_FALL, cap, det);
+  alarm_step(&a, ALARM_IN_TIMER, out, out);
+  CHECK_EQ(a.latency_ms, ALARM_MAX_LATENCY_MS);
+  CHECK_EQ(a.late, 0);
+
+  // one more millisecond is late
+  start(&a);
+  alarm_step(&a, ALARM_IN_FALL, cap, det + 1);
+  alarm_step(&a, ALARM_IN_TIMER, out + 1, out + 1);
+  CHECK_EQ(a.late, 1);
+  CHECK_EQ(a.max_latency_ms, ALARM_MAX_LATENCY_MS + 1);
+
+  // across the uptime wrap
+  start(&a);
+  cap = UINT32_MAX - 3000;
+  alarm_step(&a, ALARM_IN_FALL, cap, cap + 2500);
+  alarm_step(&a, ALARM_IN_TIMER, 0, cap + 2500 + ALARM_GRACE_MS);
+  CHECK_EQ(a.state, ALARM_CONFIRMED);
+  CHECK_EQ(a.latency_ms, 2500 + ALARM_GRACE_MS);
+  printf("latency bound %u ms: detect %u, pipeline %u, grace %u, "
+         "dispatch %u\n", (unsigned)ALARM_MAX_LATENCY_MS,
+         (unsigned)ALARM_DETECT_MAX_MS, (unsigned)ALARM_PIPELINE_MAX_MS,
+         (unsigned)ALARM_GRACE_MS, (unsigned)ALARM_DISPATCH_MS);
+}
+
+static void test_no_client()
+{
+  alarm_context a;
+  alarm_init(&a);
+  CHECK(!a.is_link_up);
+
+  // confirmed with nobody subscribed: sent, but not measured
+  alarm_step(&a, ALARM_IN_FALL, 1000, 3000);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_TIMER, 13000, 13000), SEND_AND_RETRY);
+  CHECK_EQ(a.state, ALARM_CONFIRMED);
+  CHECK(!a.is_measured);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_TIMER, 18000, 18000), SEND_AND_RETRY);
+  CHECK(!a.is_measured);
+
+  // a client a minute later gets it right away, the wait is not latency
+  CHECK_EQ(alarm_step(&a, ALARM_IN_LINK_UP, 73000, 73000), SEND_AND_RETRY);
+  CHECK(a.is_measured);
+  CHECK_EQ(a.offline_ms, 73000 - 3000);
+  CHECK_EQ(a.latency_ms, 2000);
+  CHECK_EQ(a.late, 0);
+  CHECK_EQ(a.sends, 3);
+
+  // a client that leaves during the grace window and comes back after the
+  // expiry: only its absence is excluded
+  alarm_init(&a);
+  alarm_step(&a, ALARM_IN_LINK_UP, 0, 0);
+  alarm_step(&a, ALARM_IN_FALL, 1000, 3000);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_LINK_DOWN, 5000, 5000), ALARM_ACT_NONE);
+  alarm_step(&a, ALARM_IN_TIMER, 13000, 13000);
+  CHECK(!a.is_measured);
+  alarm_step(&a, ALARM_IN_LINK_UP, 20000, 20000);
+  CHECK_EQ(a.offline_ms, 15000);
+  CHECK_EQ(a.latency_ms, 20000 - 1000 - 15000);
+
+  // down and back up inside the window, the expiry measures
+  alarm_init(&a);
+  alarm_step(&a, ALARM_IN_LINK_UP, 0, 0);
+  alarm_step(&a, ALARM_IN_FALL, 1000, 3000);
+  alarm_step(&a, ALARM_IN_LINK_DOWN, 4000, 4000);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_LINK_UP, 6000, 6000), ALARM_ACT_NONE);
+  CHECK_EQ(a.state, ALARM_GRACE);
+  alarm_step(&a, ALARM_IN_TIMER, 13000, 13000);
+  CHECK(a.is_measured);
+  CHECK_EQ(a.latency_ms, 12000 - 2000);
+
+  // a client lost before the fall is counted from the verdict only
+  alarm_init(&a);
+  alarm_step(&a, ALARM_IN_LINK_UP, 0, 0);
+  alarm_step(&a, ALARM_IN_LINK_DOWN, 100, 100);
+  alarm_step(&a, ALARM_IN_FALL, 1000, 3000);
+  alarm_step(&a, ALARM_IN_TIMER, 13000, 13000);
+  alarm_step(&a, ALARM_IN_LINK_UP, 40000, 40000);
+  CHECK_EQ(a.offline_ms, 37000);
+  CHECK_EQ(a.latency_ms, 2000);
+
+  // repeated link reports change nothing, nor do they outside an alarm
+  CHECK_EQ(alarm_step(&a, ALARM_IN_LINK_UP, 41000, 41000), ALARM_ACT_NONE);
+  alarm_step(&a, ALARM_IN_DELIVERED, 42000, 42000);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_LINK_DOWN, 43000, 43000), ALARM_ACT_NONE);
+  CHECK_EQ(alarm_step(&a, ALARM_IN_LINK_UP, 44000, 44000), ALARM_ACT_NONE);
+  CHECK_EQ(a.state, ALARM_ESCALATED);
+  CHECK_EQ(a.latency_ms, 2000);
+}
+
+int main()
+{
+  test_cancel();
+  test_tap_deadline();
+  test_confirm_and_deliver();
+  test_reset();
+  test_latency_bound();
+  test_no_client();
+  return test_summary("test_alarm");
+}
@@ -0,0 +1,209 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_biquad.c
+ * @brief  Q15 biquad cascades of one preset, built with -DDETECTOR_PRESET=<n>,
+ *         against a double precision reference running the same quantized
+ *         coefficients, over a motion trace and full scale steps, and the
+ *         cost per sample per axis
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "biquad.h"
+#include "accel_config.h"
+#include "filter_coeffs.h"
+
+#define N          (1 << 14)
+#define PI         (3.14159265358979323846)
+
+// stated error of the fixed point cascade vs the reference, in output LSB
+#define MAX_ERR_LSB  (1.5)
+#define RMS_ERR_LSB  (0.5)
+
+static int16_t sig[N];
+static double ref_out[N];
+
+// gravity, sway, a tremor band, sensor noise and a short impact every ~3000
+static void make_signal()
+{
+  for (int i=0; i<N; i++)
+  {
+    double t = i / (double)DET_RATE_HZ;
+    double v = 256.0 + 60.0 * sin(2.0 * PI * 1.5 * t) +
+               30.0 * sin(2.0 * PI * 8.0 * t) + test_rand_noise(10) +
+               ((i % 3000) > 2900 ? 1500.0 : 0.0);
+    sig[i] = (int16_t)lround(v);
+  }
+}
+
+/* The cascade in doubles: y = (b0 x + b1 x1 + b2 x2 + a1 y1 + a2 y2) /
+ * 2^(15 - post_shift), with a1 and a2 negated as stored, and no rounding
+ * between stages. Using the quantized coefficients isolates the arithmetic
+ * error from the coefficient quantization.
+ */
+static void reference(const biquad_design *d, const int16_t *in, double *out,
+                      int n)
+{
+  double st[BIQUAD_MAX_STAGES][4] = { { 0 } };
+  double scale = (double)(1 << (15 - d->post_shift));
+  for (int i=0; i<n; i++)
+  {
+    double x = in[i];
+    for (int k=0; k<d->n_stages; k++)
+    {
+      const biquad_coeffs *c = &d->stages[k];
+      double y = (c->b0 * x + c->b1 * st[k][0] + c->b2 * st[k][1] +
+                  c->a1 * st[k][2] + c->a2 * st[k][3]) / scale;
+      st[k][1] = st[k][0];
+      st[k][0] = x;
+      st[k][3] = st[k][2];
+      st[k][2] = y;
+      x = y;
+    }
+    out[i] = x;
+  }
+}
+
+// runs n samples of in through the bank on all three axes, 32 at a time
+static void run_blocks(biquad_bank *bank, const int16_t *in, int16_t *out,
+                       int n)
+{
+  accel_block blk;
+  for (int i=0; i<n; i+=ACCEL_BLOCK_LEN)
+  {
+    uint32_t m = (uint32_t)(n - i);
+    if (m > ACCEL_BLOCK_LEN) m = ACCEL_BLOCK_LEN;
+    for (uint32_t k=0; k<m; k++)
+    {
+      blk.x[k] = in[i+k];
+      blk.y[k] = (int16_t)-in[i+k];
+      blk.z[k] = in[i+k];
+    }
+    blk.n = m;
+    blk.timestamps = NULL;
+    biquad_process_block(bank, &blk, &blk);
+    for (uint32_t k=0; k<m; k++)
+    {
+      out[i+k] = blk.x[k];
+      // the axes share the design, not the state
+      CHECK_EQ(blk.z[k], blk.x[k]);
+      CHECK(abs(blk.y[k] + blk.x[k]) <= 2);
+    }
+  }
+}
+
+static void test_accuracy(const char *name, const biquad_design *d)
+{
+  static int16_t out[N];
+  biquad_bank bank;
+  CHECK_EQ(biquad_init(&bank, d), 0);
+  run_blocks(&bank, sig, out, N);
+  reference(d, sig, ref_out, N);
+
+  double max_err = 0.0, sq = 0.0;
+  for (int i=0; i<N; i++)
+  {
+    double e = fabs(out[i] - ref_out[i]);
+    if (e > max_err) max_err = e;
+    sq += e * e;
+  }
+  double rms = sqrt(sq / N);
+  printf("preset %d %-10s %d stage(s): max |err| %.3f LSB, rms %.3f LSB\n",
+         DETECTOR_PRESET, name, d->n_stages, max_err, rms);
+  CHECK(max_err <= MAX_ERR_LSB);
+  CHECK(rms <= RMS_ERR_LSB);
+
+  // one axis call over the whole run matches the block by block result
+  static int16_t whole[N];
+  biquad_state st[BIQUAD_MAX_STAGES];
+  memset(st, 0, sizeof(st));
+  biquad_process_axis(d, st, sig, whole, N);
+  CHECK_EQ(memcmp(whole, out, sizeof(whole)), 0);
+}
+
+/* A settled step across the whole sensor range, which the high-pass
+ * overshoots up to about twice full scale. The cascade has the headroom to
+ * follow the reference through it without saturating.
+ */
+static void test_full_scale(const biquad_design *d, int16_t from, int16_t to)
+{
+  static int16_t in[4 * DET_RATE_HZ], out[4 * DET_RATE_HZ];
+  static double ref[4 * DET_RATE_HZ];
+  const int n = 4 * DET_RATE_HZ;
+  for (int i=0; i<n; i++)
+  {
+    in[i] = (i < 3 * DET_RATE_HZ) ? from : to;
+  }
+  biquad_state st[BIQUAD_MAX_STAGES];
+  memset(st, 0, sizeof(st));
+  biquad_process_axis(d, st, in, out, n);
+  reference(d, in, ref, n);
+
+  double max_err = 0.0, peak = 0.0;
+  for (int i=0; i<n; i++)
+  {
+    if (fabs(out[i] - ref[i]) > max_err) max_err = fabs(out[i] - ref[i]);
+    if (fabs(ref[i]) > peak) peak = fabs(ref[i]);
+  }
+  CHECK(peak > ACCEL_MAX_LSB / 2);
+  CHECK(max_err <= MAX_ERR_LSB);
+}
+
+static void test_init()
+{
+  biquad_bank bank;
+  biquad_design d = filter_impact_bp;
+  d.n_stages = BIQUAD_MAX_STAGES + 1;
+  CHECK_EQ(biquad_init(&bank, &d), -1);
+  d = filter_impact_bp;
+  d.post_shift = 15;
+  CHECK_EQ(biquad_init(&bank, &d), -1);
+
+  // init clears whatever state the bank held
+  CHECK_EQ(biquad_init(&bank, &filter_impact_bp), 0);
+  bank.state[2][0].y1 = 12345;
+  CHECK_EQ(biquad_init(&bank, &filter_impact_bp), 0);
+  CHECK_EQ(bank.state[2][0].y1, 0);
+}
+
+static void bench(const char *name, const biquad_design *d)
+{
+  biquad_bank bank;
+  accel_block blk;
+  biquad_init(&bank, d);
+  const int reps = 100;
+  uint64_t t0 = test_now_ns();
+  for (int r=0; r<reps; r++)
+  {
+    for (int i=0; i<N; i+=ACCEL_BLOCK_LEN)
+    {
+      memcpy(blk.x, &sig[i], sizeof(blk.x));
+      memcpy(blk.y, &sig[i], sizeof(blk.y));
+      memcpy(blk.z, &sig[i], sizeof(blk.z));
+      blk.n = ACCEL_BLOCK_LEN;
+      biquad_process_block(&bank, &blk, &blk);
+    }
+  }
+  double ns = (double)(test_now_ns() - t0) / ((double)reps * N * 3);
+  printf("  %-10s %.2f ns/sample/axis, %.2f per stage\n", name, ns,
+         ns / d->n_stages);
+  CHECK(ns > 0.0);
+}
+
+int main()
+{
+  test_seed(5);
+  make_signal();
+  test_init();
+  test_accuracy("gravity_hp", &filter_gravity_hp);
+  test_accuracy("impact_bp", &filter_impact_bp);
+  test_full_scale(&filter_gravity_hp, -ACCEL_MAX_LSB, ACCEL_MAX_LSB - 1);
+  test_full_scale(&filter_gravity_hp, ACCEL_MAX_LSB - 1, -ACCEL_MAX_LSB);
+  test_full_scale(&filter_impact_bp, -ACCEL_MAX_LSB, ACCEL_MAX_LSB - 1);
+  test_full_scale(&filter_impact_bp, ACCEL_MAX_LSB - 1, -ACCEL_MAX_LSB);
+  bench("gravity_hp", &filter_gravity_hp);
+  bench("impact_bp", &filter_impact_bp);
+  return test_summary("test_biquad");
+}
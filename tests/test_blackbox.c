@@ -0,0 +1,212 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_blackbox.c
+ * @brief  Black box: snapshot round trip, trigger split, truncation, rate
+ *         switches and malformed input
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "test.h"
+#include "blackbox.h"
+
+#define STREAM_LEN  (2000)
+#define PERIOD_MS   (10)
+
+static blackbox bb;
+static accel_sample stream[STREAM_LEN];
+static accel_sample out[BLACKBOX_PRE_SAMPLES + BLACKBOX_POST_SAMPLES + 64];
+
+// sample i is taken at i * PERIOD_MS
+static uint32_t push(uint32_t from, uint32_t to, uint32_t block)
+{
+  while (from < to)
+  {
+    uint32_t n = (to - from < block) ? to - from : block;
+    blackbox_push(&bb, &stream[from], n, (from + n - 1) * PERIOD_MS,
+                  PERIOD_MS);
+    from += n;
+  }
+  return from;
+}
+
+static int decode(blackbox_header *hdr)
+{
+  const uint8_t *data;
+  uint32_t len = blackbox_data(&bb, &data);
+  if (len == 0) return -1;
+  return blackbox_decode(data, len, hdr, out, sizeof(out)/sizeof(out[0]));
+}
+
+// decoded samples against the stream, sample k at hdr->first_ms + k*period
+static uint32_t mismatches(const blackbox_header *hdr, int n)
+{
+  uint32_t bad = 0;
+  for (int k=0; k<n; k++)
+  {
+    uint32_t i = (hdr->first_ms + (uint32_t)k * hdr->period_ms) / PERIOD_MS;
+    if (memcmp(&out[k], &stream[i], sizeof(accel_sample)) != 0) bad++;
+  }
+  return bad;
+}
+
+static void quiet_stream()
+{
+  for (uint32_t i=0; i<STREAM_LEN; i++)
+  {
+    stream[i].x = (int16_t)test_rand_noise(10);
+    stream[i].y = (int16_t)(200 + test_rand_noise(2));
+    stream[i].z = (int16_t)(-256 + test_rand_noise(1));
+  }
+}
+
+static void test_round_trip()
+{
+  quiet_stream();
+  const uint8_t *data;
+  blackbox_init(&bb);
+  CHECK_EQ(blackbox_data(&bb, &data), 0);
+
+  // frozen between blocks: the full ring before, the post window after
+  uint32_t n = push(0, 310, 31);
+  blackbox_freeze(&bb, n * PERIOD_MS, 256);
+  CHECK_EQ(bb.state, BLACKBOX_CAPTURING);
+  push(n, 700, 31);
+  blackbox_set_flags(&bb, BLACKBOX_FLAG_CONFIRMED);
+
+  blackbox_header hdr;
+  int got = decode(&hdr);
+  CHECK_EQ(got, BLACKBOX_PRE_SAMPLES + BLACKBOX_POST_SAMPLES);
+  CHECK_EQ(hdr.version, BLACKBOX_VERSION);
+  CHECK_EQ(hdr.flags, BLACKBOX_FLAG_CONFIRMED);
+  CHECK_EQ(hdr.n_samples, got);
+  CHECK_EQ(hdr.n_pre, BLACKBOX_PRE_SAMPLES);
+  CHECK_EQ(hdr.period_ms, PERIOD_MS);
+  CHECK_EQ(hdr.first_ms, (310 - BLACKBOX_PRE_SAMPLES) * PERIOD_MS);
+  CHECK_EQ(hdr.trigger_ms, 310 * PERIOD_MS);
+  CHECK_EQ(hdr.lsb_per_g, 256);
+  CHECK_EQ(mismatches(&hdr, got), 0);
+
+  uint32_t len = blackbox_data(&bb, &data);
+  printf("quiet snapshot: %lu samples in %lu bytes, %.2f bytes/sample\n",
+         (unsigned long)got, (unsigned long)len,
+         (double)(len - BLACKBOX_HEADER_LEN) / got);
+  // a byte per axis for small deltas, the first sample starts from 0
+  CHECK(len - BLACKBOX_HEADER_LEN <= (uint32_t)got * 3 + 3);
+}
+
+static void test_trigger_split()
+{
+  // the pipeline freezes after pushing the block the trigger was found in,
+  // the samples from the trigger on belong to the post window
+  quiet_stream();
+  for (uint32_t tail=0; tail<=32; tail+=8)
+  {
+    blackbox_init(&bb);
+    push(0, 320, 32);
+    uint32_t trigger = 320 - tail;
+    blackbox_freeze(&bb, trigger * PERIOD_MS, 256);
+    push(320, 800, 32);
+
+    blackbox_header hdr;
+    int got = decode(&hdr);
+    CHECK_EQ(hdr.n_pre, BLACKBOX_PRE_SAMPLES - tail);
+    CHECK_EQ(got, hdr.n_pre + BLACKBOX_POST_SAMPLES);
+    CHECK_EQ(hdr.first_ms + hdr.n_pre * hdr.period_ms, trigger * PERIOD_MS);
+    CHECK_EQ(mismatches(&hdr, got), 0);
+  }
+
+  // a trigger older than the whole ring leaves no pre-trigger samples
+  blackbox_init(&bb);
+  push(0, 300, 300);
+  blackbox_freeze(&bb, 0, 256);
+  blackbox_header hdr;
+  CHECK_EQ(bb.state, BLACKBOX_READY);
+  int got = decode(&hdr);
+  CHECK_EQ(hdr.n_pre, 0);
+  CHECK_EQ(got, BLACKBOX_POST_SAMPLES);
+  CHECK_EQ(mismatches(&hdr, got), 0);
+
+  // nothing pushed yet
+  blackbox_init(&bb);
+  blackbox_freeze(&bb, 500, 256);
+  push(0, BLACKBOX_POST_SAMPLES, 16);
+  got = decode(&hdr);
+  CHECK_EQ(hdr.n_pre, 0);
+  CHECK_EQ(hdr.first_ms, 500);
+  CHECK_EQ(got, BLACKBOX_POST_SAMPLES);
+}
+
+static void test_truncation()
+{
+  // full scale noise does not compress, the snapshot stops at the limit
+  for (uint32_t i=0; i<STREAM_LEN; i++)
+  {
+    stream[i].x = (int16_t)test_rand();
+    stream[i].y = (int16_t)test_rand();
+    stream[i].z = (int16_t)test_rand();
+  }
+  stream[300].x = INT16_MIN;
+  stream[301].x = INT16_MAX;
+  blackbox_init(&bb);
+  push(0, 310, 31);
+  blackbox_freeze(&bb, 310 * PERIOD_MS, 256);
+  push(310, 700, 31);
+
+  blackbox_header hdr;
+  int got = decode(&hdr);
+  const uint8_t *data;
+  uint32_t len = blackbox_data(&bb, &data);
+  CHECK(hdr.flags & BLACKBOX_FLAG_TRUNCATED);
+  CHECK(len <= BLACKBOX_MAX_LEN);
+  CHECK(got > 0 && got < BLACKBOX_PRE_SAMPLES + BLACKBOX_POST_SAMPLES);
+  CHECK_EQ(mismatches(&hdr, got), 0);
+
+  // malformed input
+  CHECK_EQ(blackbox_decode(data, BLACKBOX_HEADER_LEN - 1, &hdr, out, 8), -1);
+  CHECK_EQ(blackbox_decode(data, len - 1, &hdr, out,
+                           sizeof(out)/sizeof(out[0])), -1);
+  static uint8_t bad[BLACKBOX_MAX_LEN];
+  memcpy(bad, data, len);
+  bad[0] = BLACKBOX_VERSION + 1;
+  CHECK_EQ(blackbox_decode(bad, len, &hdr, out, 8), -1);
+  bad[0] = BLACKBOX_VERSION;
+  memset(&bad[BLACKBOX_HEADER_LEN], 0xFF, 8); // a varint that never ends
+  CHECK_EQ(blackbox_decode(bad, len, &hdr, out, 8), -1);
+  // a short output buffer only limits the count
+  CHECK_EQ(blackbox_decode(data, len, &hdr, out, 5), 5);
+}
+
+static void test_rate_switch()
+{
+  quiet_stream();
+  blackbox_init(&bb);
+  push(0, 310, 31);
+  blackbox_freeze(&bb, 310 * PERIOD_MS, 256);
+  push(310, 341, 31);
+  blackbox_push(&bb, stream, 8, 5000, 40);
+
+  blackbox_header hdr;
+  int got = decode(&hdr);
+  CHECK(hdr.flags & BLACKBOX_FLAG_RATE_SWITCH);
+  CHECK_EQ(got, BLACKBOX_PRE_SAMPLES + 31);
+  CHECK_EQ(mismatches(&hdr, got), 0);
+
+  // a freeze while capturing is ignored
+  blackbox_init(&bb);
+  push(0, 310, 31);
+  blackbox_freeze(&bb, 310 * PERIOD_MS, 256);
+  blackbox_freeze(&bb, 320 * PERIOD_MS, 256);
+  push(310, 700, 31);
+  got = decode(&hdr);
+  CHECK_EQ(hdr.trigger_ms, 310 * PERIOD_MS);
+}
+
+int main()
+{
+  test_seed(11);
+  test_round_trip();
+  test_trigger_split();
+  test_truncation();
+  test_rate_switch();
+  return test_summary("test_blackbox");
+}
@@ -0,0 +1,204 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_calibration.c
+ * @brief  Offset calibration: the averaging and rounding math, and the
+ *         closed loop through the pipeline, the sensor model and the store
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "test.h"
+#include "adxl343.h"
+#include "adxl343_model.h"
+#include "calibration.h"
+#include "pipeline.h"
+#include "sensor_loop.h"
+
+#define LSB_PER_OFS (ACCEL_LSB_PER_G / ACCEL_OFS_PER_G)
+
+// fills a window with a constant sample plus a small alternating ripple
+static int fill(calibration_context *ctx, int16_t x, int16_t y, int16_t z,
+                int16_t ripple)
+{
+  int16_t bx[16], by[16], bz[16];
+  bool is_full = false;
+  int blocks = 0;
+  calibration_reset(ctx);
+  while (!is_full)
+  {
+    for (int i=0; i<16; i++)
+    {
+      int16_t r = (i & 1) ? ripple : -ripple;
+      bx[i] = x + r;
+      by[i] = y - r;
+      bz[i] = z + r;
+    }
+    is_full = calibration_add(ctx, bx, by, bz, 16);
+    blocks++;
+  }
+  return blocks;
+}
+
+static void test_math()
+{
+  calibration_context ctx;
+  int8_t zero[3] = { 0, 0, 0 };
+  int8_t ofs[3];
+
+  // the window ends at CAL_WINDOW_SAMPLES, extra samples are dropped
+  CHECK_EQ(fill(&ctx, 0, 0, ACCEL_LSB_PER_G, 0), CAL_WINDOW_SAMPLES / 16);
+  CHECK_EQ(ctx.n, CAL_WINDOW_SAMPLES);
+  int16_t one = 100;
+  CHECK(calibration_add(&ctx, &one, &one, &one, 1));
+  CHECK_EQ(ctx.sum[0], 0);
+
+  // an ideal part keeps its offsets
+  int8_t cur[3] = { 3, -2, 1 };
+  CHECK_EQ(calibration_compute(&ctx, cur, ofs), 0);
+  CHECK_EQ(ofs[0], 3);
+  CHECK_EQ(ofs[1], -2);
+  CHECK_EQ(ofs[2], 1);
+
+  // whole offset steps are cancelled exactly, gravity on z
+  fill(&ctx, 5 * LSB_PER_OFS, -3 * LSB_PER_OFS,
+       ACCEL_LSB_PER_G + 2 * LSB_PER_OFS, 1);
+  CHECK_EQ(calibration_compute(&ctx, zero, ofs), 0);
+  CHECK_EQ(ofs[0], -5);
+  CHECK_EQ(ofs[1], 3);
+  CHECK_EQ(ofs[2], -2);
+
+  // gravity on -x, the sign of the gravity axis is kept
+  fill(&ctx, -ACCEL_LSB_PER_G - LSB_PER_OFS, 0, 0, 0);
+  CHECK_EQ(calibration_compute(&ctx, zero, ofs), 0);
+  CHECK_EQ(ofs[0], 1);
+  CHECK_EQ(ofs[1], 0);
+  CHECK_EQ(ofs[2], 0);
+
+  // rounding to the nearest step, halves away from zero, under half down
+  fill(&ctx, LSB_PER_OFS / 2, -(LSB_PER_OFS / 2), ACCEL_LSB_PER_G +
+       LSB_PER_OFS / 2 - 1, 0);
+  CHECK_EQ(calibration_compute(&ctx, zero, ofs), 0);
+  CHECK_EQ(ofs[0], -1);
+  CHECK_EQ(ofs[1], 1);
+  CHECK_EQ(ofs[2], 0);
+
+  // a mean error between samples still resolves, the sum keeps the fraction
+  calibration_reset(&ctx);
+  for (int k=0; k<CAL_WINDOW_SAMPLES; k++)
+  {
+    int16_t x = (int16_t)((k & 3) == 0 ? 3 * LSB_PER_OFS : 0); // mean 3/4 step
+    int16_t y = 0;
+    int16_t z = ACCEL_LSB_PER_G;
+    calibration_add(&ctx, &x, &y, &z, 1);
+  }
+  CHECK_EQ(calibration_compute(&ctx, zero, ofs), 0);
+  CHECK_EQ(ofs[0], -1);
+
+  // the result is trimmed to the register range
+  int8_t high[3] = { 120, -120, 0 };
+  fill(&ctx, -20 * LSB_PER_OFS, 20 * LSB_PER_OFS, ACCEL_LSB_PER_G, 0);
+  CHECK_EQ(calibration_compute(&ctx, high, ofs), 0);
+  CHECK_EQ(ofs[0], INT8_MAX);
+  CHECK_EQ(ofs[1], INT8_MIN);
+
+  // incomplete and moving windows are refused
+  calibration_reset(&ctx);
+  CHECK_EQ(calibration_compute(&ctx, zero, ofs), -1);
+  CHECK(!calibration_add(&ctx, &one, &one, &one, 1));
+  CHECK_EQ(calibration_compute(&ctx, zero, ofs), -1);
+  fill(&ctx, 0, 0, ACCEL_LSB_PER_G, CAL_STILL_P2P_LSB / 2 + 1);
+  CHECK_EQ(calibration_compute(&ctx, zero, ofs), -1);
+  fill(&ctx, 0, 0, ACCEL_LSB_PER_G, CAL_STILL_P2P_LSB / 2);
+  CHECK_EQ(calibration_compute(&ctx, zero, ofs), 0);
+}
+
+// lying flat with a zero-g error of roughly +60/-47/+35 mg, a little noise
+static const accel_sample bias = { 15, -12, 9 };
+
+static accel_sample flat(uint32_t t_ms, void *arg)
+{
+  (void)arg;
+  int16_t noise = (int16_t)((t_ms / DET_PERIOD_MS) % 3) - 1;
+  accel_sample s = { (int16_t)(bias.x + noise), bias.y,
+                     (int16_t)(ACCEL_LSB_PER_G + bias.z - noise) };
+  return s;
+}
+
+static void test_closed_loop()
+{
+  sensor_loop loop;
+  sensor_loop_init(&loop, flat, NULL);
+  pipeline_request_calibration();
+
+  // movement while armed does not start a window
+  pipeline_set_still(false);
+  sensor_loop_run(&loop, 2000);
+  CHECK_EQ(stub_bt.nvm_saves, 0);
+
+  // a window interrupted by movement is discarded
+  pipeline_set_still(true);
+  sensor_loop_run(&loop, 3000);
+  pipeline_set_still(false);
+  sensor_loop_run(&loop, 6000);
+  CHECK_EQ(stub_bt.nvm_saves, 0);
+
+  pipeline_set_still(true);
+  sensor_loop_run(&loop, 6000 + (CAL_WINDOW_SAMPLES + 64) * DET_PERIOD_MS);
+  CHECK_EQ(stub_bt.nvm_saves, 1);
+
+  // written in the sensor with one burst, the data is now corrected
+  int8_t ofs[3];
+  accel_get_offsets(ofs);
+  CHECK_EQ((int8_t)adxl343_model.regs[ADXL343_OFSX], ofs[0]);
+  CHECK_EQ((int8_t)adxl343_model.regs[ADXL343_OFSY], ofs[1]);
+  CHECK_EQ((int8_t)adxl343_model.regs[ADXL343_OFSZ], ofs[2]);
+  accel_sample out = flat(0, NULL);
+  adxl343_model_produce(&out, 1);
+  accel_sample *c = &adxl343_model.fifo[(adxl343_model.fifo_head +
+                                          adxl343_model.fifo_count - 1) %
+                                         ADXL343_MODEL_FIFO];
+  printf("bias %d %d %d LSB -> offsets %d %d %d -> residual %d %d %d LSB\n",
+         bias.x, bias.y, bias.z, ofs[0], ofs[1], ofs[2],
+         c->x, c->y, c->z - ACCEL_LSB_PER_G);
+  CHECK(c->x >= -LSB_PER_OFS/2 - 1 && c->x <= LSB_PER_OFS/2 + 1);
+  CHECK(c->y >= -LSB_PER_OFS/2 && c->y <= LSB_PER_OFS/2);
+  CHECK(c->z - ACCEL_LSB_PER_G >= -LSB_PER_OFS/2 - 1 &&
+        c->z - ACCEL_LSB_PER_G <= LSB_PER_OFS/2 + 1);
+
+  // persisted under the offsets key, and only once
+  int8_t stored[3];
+  CHECK_EQ(accel_offsets_load(stored), 0);
+  CHECK_EQ(memcmp(stored, ofs, 3), 0);
+  sensor_loop_run(&loop, loop.now_ms + 5000);
+  CHECK_EQ(stub_bt.nvm_saves, 1);
+
+  // next boot: the stored values ride in the batched init write as app_init
+  // folds them into the profile, at no extra transaction
+  adxl343_model_reset();
+  accel_init(NULL);
+  uint32_t plain = adxl343_model.transactions;
+  adxl343_model_reset();
+  sl_bt_nvm_save(ACCEL_NVM_KEY_OFFSETS, 3, (const uint8_t *)stored);
+  adxl343_model_clear_log();
+  accel_profile profile = *accel_default_profile();
+  int8_t loaded[3];
+  CHECK_EQ(accel_offsets_load(loaded), 0);
+  profile.ofsx = loaded[0];
+  profile.ofsy = loaded[1];
+  profile.ofsz = loaded[2];
+  CHECK_EQ(accel_init(&profile), 0);
+  CHECK_EQ(adxl343_model.transactions, plain);
+  CHECK_EQ((int8_t)adxl343_model.regs[ADXL343_OFSX], stored[0]);
+  CHECK_EQ((int8_t)adxl343_model.regs[ADXL343_OFSY], stored[1]);
+  CHECK_EQ((int8_t)adxl343_model.regs[ADXL343_OFSZ], stored[2]);
+
+  // nothing stored, nothing loaded
+  adxl343_model_reset();
+  CHECK_EQ(accel_offsets_load(loaded), -1);
+}
+
+int main()
+{
+  test_math();
+  test_closed_loop();
+  return test_summary("test_calibration");
+}
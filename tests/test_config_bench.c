@@ -0,0 +1,169 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_config_bench.c
+ * @brief  SPI cost of bring-up, per-register baseline against the batched init,
+ *         and the register diff on reconfiguration
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "adxl343.h"
+#include "adxl343_model.h"
+
+// writable registers in the order the original accel_init() touched them
+static const accel_register registers[] = {
+  ADXL343_INT_ENABLE, ADXL343_BW_RATE, ADXL343_THRESH_INACT,
+  ADXL343_TIME_INACT, ADXL343_THRESH_ACT, ADXL343_ACT_INACT_CTL,
+  ADXL343_THRESH_TAP, ADXL343_DUR, ADXL343_LATENT, ADXL343_WINDOW,
+  ADXL343_TAP_AXES, ADXL343_THRESH_FF, ADXL343_TIME_FF, ADXL343_OFSX,
+  ADXL343_OFSY, ADXL343_OFSZ, ADXL343_INT_MAP, ADXL343_DATA_FORMAT,
+  ADXL343_FIFO_CTL, ADXL343_INT_ENABLE, ADXL343_POWER_CTL
+};
+
+static void xfer(uint8_t cmd, const uint8_t *data, uint32_t n)
+{
+  uint8_t tx[SPI_MAX_FRAME];
+  uint8_t rx[SPI_MAX_FRAME];
+  tx[0] = cmd;
+  if (data != NULL) memcpy(&tx[1], data, n);
+  else memset(&tx[1], 0xFF, n);
+  spi_usart1_bus.transfer(tx, rx, n + 1);
+}
+
+// the pre-profile bring-up: device ID, 29 byte debug readback, one write per
+// register, then the INT_SOURCE read that clears pending events
+static void baseline_init(const uint8_t *regs)
+{
+  xfer(SINGLE_READ_CMD(ADXL343_DEVID), NULL, 1);
+  xfer(MULTI_READ_CMD(ADXL343_THRESH_TAP), NULL, 29);
+  uint8_t zero = 0;
+  xfer(SINGLE_WRITE_CMD(ADXL343_INT_ENABLE), &zero, 1);
+  for (uint32_t i=1; i<sizeof(registers)/sizeof(registers[0]); i++)
+  {
+    xfer(SINGLE_WRITE_CMD(registers[i]), &regs[registers[i]], 1);
+  }
+  xfer(SINGLE_READ_CMD(ADXL343_INT_SOURCE), NULL, 1);
+}
+
+// bus time at 4 MHz, 2 us/byte plus ~5 us of CS and setup per transaction
+static uint32_t bus_time_us()
+{
+  return adxl343_model.bytes * 2 + adxl343_model.transactions * 5;
+}
+
+static void test_boot()
+{
+  // baseline, the reference image is whatever the profile programs
+  adxl343_model_reset();
+  CHECK_EQ(accel_init(NULL), 0);
+  uint8_t regs[ADXL343_MODEL_REGS];
+  memcpy(regs, adxl343_model.regs, sizeof(regs));
+
+  adxl343_model_reset();
+  baseline_init(regs);
+  uint32_t base_xfers = adxl343_model.transactions;
+  uint32_t base_bytes = adxl343_model.bytes;
+  uint32_t base_us = bus_time_us();
+  CHECK_EQ(memcmp(&adxl343_model.regs[ADXL343_THRESH_TAP],
+                  &regs[ADXL343_THRESH_TAP],
+                  ADXL343_FIFO_CTL - ADXL343_THRESH_TAP + 1), 0);
+
+  adxl343_model_reset();
+  CHECK_EQ(accel_init(NULL), 0);
+  uint32_t new_xfers = adxl343_model.transactions;
+  uint32_t new_bytes = adxl343_model.bytes;
+  uint32_t new_us = bus_time_us();
+
+  printf("bring-up    per-register: %2u transactions, %3u bytes, ~%3u us\n",
+         (unsigned)base_xfers, (unsigned)base_bytes, (unsigned)base_us);
+  printf("bring-up    batched:      %2u transactions, %3u bytes, ~%3u us\n",
+         (unsigned)new_xfers, (unsigned)new_bytes, (unsigned)new_us);
+
+  // DEVID, standby, 4 blocks, 3 verify reads, INT_SOURCE
+  CHECK_EQ(new_xfers, 10);
+  CHECK(new_xfers * 2 < base_xfers);
+  CHECK(new_bytes < base_bytes);
+
+  // the driver's own counters agree with the wire
+  accel_bus_stats stats;
+  accel_get_bus_stats(&stats);
+  CHECK_EQ(stats.transactions, new_xfers);
+  CHECK_EQ(stats.bytes, new_bytes);
+}
+
+static void test_diff()
+{
+  accel_profile p;
+  CHECK_EQ(accel_get_profile(&p), 0);
+
+  // unchanged profile, nothing goes out
+  adxl343_model_clear_log();
+  CHECK_EQ(accel_apply_profile(&p), 0);
+  CHECK_EQ(adxl343_model.transactions, 0);
+  CHECK_EQ(accel_update_register(ADXL343_BW_RATE, p.bw_rate), 0);
+  CHECK_EQ(adxl343_model.transactions, 0);
+
+  // two changes in one block ride in one burst over the span between them
+  p.thresh_tap++;
+  p.window--;
+  adxl343_model_clear_log();
+  CHECK_EQ(accel_apply_profile(&p), 0);
+  CHECK_EQ(adxl343_model.transactions, 1);
+  CHECK_EQ(adxl343_model.log[0].cmd, MULTI_WRITE_CMD(ADXL343_THRESH_TAP));
+  CHECK_EQ(adxl343_model.bytes, 1 + ADXL343_WINDOW - ADXL343_THRESH_TAP + 1);
+  CHECK_EQ(adxl343_model.regs[ADXL343_THRESH_TAP], p.thresh_tap);
+  CHECK_EQ(adxl343_model.regs[ADXL343_WINDOW], p.window);
+
+  // changes in two blocks, one burst each
+  p.bw_rate ^= 0x10;
+  p.fifo_ctl = FIFO_MODE_STREAM | 16;
+  adxl343_model_clear_log();
+  CHECK_EQ(accel_apply_profile(&p), 0);
+  CHECK_EQ(adxl343_model.transactions, 2);
+  CHECK_EQ(adxl343_model.bytes, 4);
+  printf("reconfigure 2 blocks:     %2u transactions, %3u bytes\n",
+         (unsigned)adxl343_model.transactions, (unsigned)adxl343_model.bytes);
+
+  // offsets collapse to one 3 register burst
+  int8_t offsets[3] = { -3, 2, 5 };
+  adxl343_model_clear_log();
+  CHECK_EQ(accel_set_offsets(offsets), 0);
+  CHECK_EQ(adxl343_model.transactions, 1);
+  CHECK_EQ(adxl343_model.bytes, 4);
+  CHECK_EQ((int8_t)adxl343_model.regs[ADXL343_OFSZ], 5);
+
+  CHECK_EQ(accel_verify(), 0);
+  CHECK_EQ(accel_apply_profile(NULL), -1);
+}
+
+static void test_verify()
+{
+  // a readback after init leaves the FIFO and latched events alone
+  accel_sample s = { 1, 2, 3 };
+  adxl343_model_produce(&s, 1);
+  adxl343_model_latch(INT_FREE_FALL | INT_DOUBLE_TAP, 0x1);
+  uint32_t fifo = adxl343_model.fifo_count;
+  adxl343_model_clear_log();
+  CHECK_EQ(accel_verify(), 0);
+  CHECK_EQ(adxl343_model.transactions, 3);
+  CHECK_EQ(adxl343_model.fifo_count, fifo);
+  CHECK_EQ(adxl343_model_reads_of(ADXL343_INT_SOURCE), 0);
+  CHECK_EQ(adxl343_model_reads_of(ADXL343_DATAX0), 0);
+  CHECK_EQ(adxl343_model_reads_of(ADXL343_DATAZ1), 0);
+  CHECK_EQ(adxl343_model.regs[ADXL343_INT_SOURCE] &
+           (INT_FREE_FALL | INT_DOUBLE_TAP), INT_FREE_FALL | INT_DOUBLE_TAP);
+
+  // and still catches a register that drifted from the shadow
+  adxl343_model.regs[ADXL343_FIFO_CTL] ^= 0x1;
+  CHECK_EQ(accel_verify(), -1);
+  adxl343_model.regs[ADXL343_FIFO_CTL] ^= 0x1;
+  adxl343_model.regs[ADXL343_INT_MAP] ^= 0x4;
+  CHECK_EQ(accel_verify(), -1);
+}
+
+int main()
+{
+  test_boot();
+  test_diff();
+  test_verify();
+  return test_summary("test_config_bench");
+}
@@ -0,0 +1,192 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_conn_policy.c
+ * @brief  Connection parameter policy: the profiles, the transitions, rate
+ *         limiting and lapsed requests, the negotiated parameters, and a day
+ *         of a wearer split by profile
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "conn_policy.h"
+
+static void test_profiles()
+{
+  for (int p=0; p<CONN_NUM_PROFILES; p++)
+  {
+    const conn_params *c = conn_profile_params((conn_profile)p);
+    // Core spec ranges
+    CHECK(c->min_interval >= 6 && c->min_interval <= c->max_interval);
+    CHECK(c->max_interval <= 3200);
+    CHECK(c->latency <= 499);
+    CHECK(c->timeout >= 10 && c->timeout <= 3200);
+    // timeout in 10 ms over (1 + latency) * 2 * interval in 1.25 ms
+    CHECK((uint32_t)c->timeout * 8 >
+          (1u + c->latency) * 2u * c->max_interval);
+  }
+  const conn_params *idle = conn_profile_params(CONN_PROFILE_IDLE);
+  const conn_params *fast = conn_profile_params(CONN_PROFILE_FAST);
+  CHECK(fast->max_interval < idle->min_interval);
+  CHECK(idle->latency > 0);
+  CHECK_EQ(fast->latency, 0);
+}
+
+static void test_transitions()
+{
+  conn_policy cp;
+  uint32_t now = UINT32_MAX - 20000; // runs across the uptime wrap
+
+  // nothing is asked before the initial parameters are in
+  CHECK(!conn_policy_step(&cp, CONN_IN_OPENED, now));
+  CHECK(!conn_policy_step(&cp, CONN_IN_TICK, now + 100));
+  CHECK(!conn_policy_step(&cp, CONN_IN_FALL_CANDIDATE, now + 200));
+  CHECK_EQ(cp.requests, 0);
+
+  // then the idle profile, once
+  conn_policy_negotiated(&cp, 36, 0, 400, now + 50);
+  CHECK_EQ(cp.rejected + cp.accepted, 0);
+  CHECK(conn_policy_step(&cp, CONN_IN_TICK, now + 100));
+  CHECK_EQ(cp.requested, CONN_PROFILE_IDLE);
+  CHECK(cp.is_pending);
+  CHECK(!conn_policy_step(&cp, CONN_IN_TICK, now + 200));
+  conn_policy_negotiated(&cp, 480, 4, 800, now + 1000);
+  CHECK_EQ(cp.accepted, 1);
+  CHECK(!cp.is_pending);
+  CHECK(!conn_policy_step(&cp, CONN_IN_TICK, now + 2000));
+
+  // a fall candidate goes fast right away, inside the update gap
+  CHECK(conn_policy_step(&cp, CONN_IN_FALL_CANDIDATE, now + 2100));
+  CHECK_EQ(cp.requested, CONN_PROFILE_FAST);
+  CHECK_EQ(cp.rate_limited, 0);
+  conn_policy_negotiated(&cp, 24, 0, 200, now + 3000);
+  CHECK_EQ(cp.accepted, 2);
+
+  // demand keeps it fast, quiet brings it back after CONN_QUIET_MS
+  uint32_t demand = now + 9000;
+  CHECK(!conn_policy_step(&cp, CONN_IN_BULK, demand));
+  CHECK(!conn_policy_step(&cp, CONN_IN_TICK, demand + CONN_QUIET_MS - 1));
+  CHECK_EQ(cp.target, CONN_PROFILE_FAST);
+  CHECK(conn_policy_step(&cp, CONN_IN_TICK, demand + CONN_QUIET_MS));
+  CHECK_EQ(cp.requested, CONN_PROFILE_IDLE);
+  uint32_t idle_at = demand + CONN_QUIET_MS;
+  conn_policy_negotiated(&cp, 500, 4, 800, idle_at + 500);
+
+  // bulk right after waits for the gap, and is counted
+  CHECK(!conn_policy_step(&cp, CONN_IN_BULK, idle_at + 1000));
+  CHECK_EQ(cp.rate_limited, 1);
+  CHECK_EQ(cp.target, CONN_PROFILE_FAST);
+  CHECK(!conn_policy_step(&cp, CONN_IN_TICK,
+                          idle_at + CONN_MIN_UPDATE_GAP_MS - 1));
+  CHECK(conn_policy_step(&cp, CONN_IN_TICK, idle_at + CONN_MIN_UPDATE_GAP_MS));
+  CHECK_EQ(cp.requested, CONN_PROFILE_FAST);
+
+  // an unanswered request lapses and is asked again
+  uint32_t asked = idle_at + CONN_MIN_UPDATE_GAP_MS;
+  CHECK(!conn_policy_step(&cp, CONN_IN_BULK, asked + CONN_PENDING_MS - 1));
+  CHECK(conn_policy_step(&cp, CONN_IN_BULK, asked + CONN_PENDING_MS));
+  CHECK_EQ(cp.lapsed, 1);
+  CHECK_EQ(cp.requests, 5);
+
+  // an answer outside the range is recorded as rejected, and a change the
+  // central makes on its own counts as neither
+  conn_policy_negotiated(&cp, 60, 0, 400, asked + CONN_PENDING_MS + 100);
+  CHECK_EQ(cp.rejected, 1);
+  conn_policy_negotiated(&cp, 12, 0, 200, asked + CONN_PENDING_MS + 200);
+  CHECK_EQ(cp.rejected, 1);
+  CHECK_EQ(cp.accepted, 3);
+  CHECK_EQ(cp.interval, 12);
+  CHECK_EQ(cp.latency, 0);
+  CHECK_EQ(cp.timeout, 200);
+
+  // the time is split by the interval in force, the initial 45 ms is idle
+  uint32_t total = cp.time_in_profile_ms[CONN_PROFILE_IDLE] +
+                   cp.time_in_profile_ms[CONN_PROFILE_FAST];
+  CHECK_EQ(total, asked + CONN_PENDING_MS + 200 - (now + 50));
+  CHECK_EQ(cp.time_in_profile_ms[CONN_PROFILE_FAST],
+           (idle_at + 500) - (now + 3000));
+}
+
+/* A day connected to a phone: a fall candidate now and then, a blackbox
+ * read a few times a day, an hour of raw streaming, ticks every second.
+ * The central grants the request's upper interval 100-1500 ms later.
+ */
+static void test_day()
+{
+  conn_policy cp;
+  uint32_t now = 0, answer_at = 0, worst_fast_ms = 0, asked_fast = 0;
+  bool is_waiting = false;
+  conn_policy_step(&cp, CONN_IN_OPENED, now);
+  conn_policy_negotiated(&cp, 36, 0, 400, now);
+
+  const uint32_t day = 24UL * 3600 * 1000;
+  uint32_t next_candidate = test_rand_range(600000, 7200000);
+  uint32_t next_read = test_rand_range(3600000, 14400000), read_end = 0;
+  const uint32_t stream_start = 12UL * 3600 * 1000;
+  const uint32_t stream_end = stream_start + 3600UL * 1000;
+  for (now=0; now<day; now+=100)
+  {
+    conn_input in = CONN_IN_TICK;
+    if (now >= next_candidate)
+    {
+      in = CONN_IN_FALL_CANDIDATE;
+      next_candidate = now + test_rand_range(600000, 7200000);
+      if (cp.interval > conn_profile_params(CONN_PROFILE_FAST)->max_interval)
+      {
+        asked_fast = now;
+      }
+    }
+    else if (now >= next_read)
+    {
+      read_end = now + 20000;
+      next_read = now + test_rand_range(3600000, 14400000);
+    }
+    if (in == CONN_IN_TICK &&
+        (now < read_end || (now >= stream_start && now < stream_end)))
+    {
+      in = CONN_IN_BULK;
+    }
+    if (is_waiting && now >= answer_at)
+    {
+      const conn_params *p = conn_profile_params(cp.requested);
+      conn_policy_negotiated(&cp, p->max_interval, p->latency, p->timeout,
+                             now);
+      is_waiting = false;
+      if (cp.requested == CONN_PROFILE_FAST && asked_fast != 0)
+      {
+        if (now - asked_fast > worst_fast_ms) worst_fast_ms = now - asked_fast;
+        asked_fast = 0;
+      }
+    }
+    if (in == CONN_IN_TICK && (now % 1000) != 0) continue;
+
+    if (conn_policy_step(&cp, in, now))
+    {
+      is_waiting = true;
+      answer_at = now + test_rand_range(100, 1500);
+    }
+  }
+  conn_policy_negotiated(&cp, cp.interval, cp.latency, cp.timeout, now);
+
+  uint32_t idle = cp.time_in_profile_ms[CONN_PROFILE_IDLE];
+  uint32_t fast = cp.time_in_profile_ms[CONN_PROFILE_FAST];
+  printf("day: idle %.1f h, fast %.1f h, %u requests, %u rate limited, "
+         "fall candidate to fast interval worst %u ms\n", idle / 3600000.0,
+         fast / 3600000.0, (unsigned)cp.requests, (unsigned)cp.rate_limited,
+         (unsigned)worst_fast_ms);
+  CHECK_EQ(idle + fast, day);
+  CHECK(fast > 3600UL * 1000);         // the streaming hour at least
+  CHECK(fast < 3600UL * 1000 * 3 / 2);
+  CHECK_EQ(cp.rejected, 0);
+  CHECK_EQ(cp.lapsed, 0);
+  CHECK(worst_fast_ms <= 1500);
+  // about two requests per demand episode, nowhere near one per gap
+  CHECK(cp.requests < day / CONN_MIN_UPDATE_GAP_MS / 100);
+}
+
+int main()
+{
+  test_seed(6);
+  test_profiles();
+  test_transitions();
+  test_day();
+  return test_summary("test_conn_policy");
+}
@@ -0,0 +1,113 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_data_format.c
+ * @brief  Range/resolution table: DATA_FORMAT, sample scale and every
+ *         threshold register, built once per ACCEL_RANGE_G/ACCEL_FULL_RES
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "adxl343.h"
+#include "adxl343_model.h"
+
+typedef struct
+{
+  int range_g;
+  int is_full_res;
+  uint8_t data_format;
+  int lsb_per_g;
+  int act_lsb;       // ACCEL_MG_TO_LSB(250)
+  uint8_t thresh_tap;
+} range_row;
+
+static const range_row table[] = {
+  {  2, 0, 0x00, 256, 64, 30 },
+  {  4, 0, 0x01, 128, 32, 48 },
+  {  8, 0, 0x02,  64, 16, 48 },
+  { 16, 0, 0x03,  32,  8, 48 },
+  {  2, 1, 0x08, 256, 64, 30 },
+  {  4, 1, 0x09, 256, 64, 48 },
+  {  8, 1, 0x0A, 256, 64, 48 },
+  { 16, 1, 0x0B, 256, 64, 48 },
+};
+
+// the part's own register scales do not depend on the range
+typedef struct
+{
+  uint8_t reg;
+  uint8_t value;
+} reg_row;
+
+static const reg_row fixed[] = {
+  { ADXL343_DUR,          16 },  // 10 ms / 625 us
+  { ADXL343_LATENT,       16 },  // 20 ms / 1.25 ms
+  { ADXL343_WINDOW,       255 }, // 319 ms / 1.25 ms
+  { ADXL343_THRESH_ACT,   4 },   // 250 mg / 62.5 mg
+  { ADXL343_THRESH_INACT, 8 },   // 500 mg / 62.5 mg
+  { ADXL343_TIME_INACT,   20 },  // 20 s / 1 s
+  { ADXL343_THRESH_FF,    5 },   // 313 mg / 62.5 mg
+  { ADXL343_TIME_FF,      40 },  // 200 ms / 5 ms
+};
+
+// static initializers must be constant, so these all fold at build time
+static const uint8_t folded[] = {
+  ACCEL_DATA_FORMAT, ACCEL_THRESH_TAP, ACCEL_DUR, ACCEL_LATENT, ACCEL_WINDOW,
+  ACCEL_THRESH_ACT, ACCEL_THRESH_INACT, ACCEL_TIME_INACT, ACCEL_THRESH_FF,
+  ACCEL_TIME_FF,
+};
+static const int32_t folded_lsb[] = {
+  ACCEL_LSB_PER_G, ACCEL_MAX_LSB, ACCEL_MG_TO_LSB(250), ACCEL_MG_TO_LSB2(250),
+};
+
+static const range_row *find_row()
+{
+  for (uint32_t i=0; i<sizeof(table)/sizeof(table[0]); i++)
+  {
+    if (table[i].range_g == ACCEL_RANGE_G &&
+        table[i].is_full_res == ACCEL_FULL_RES) return &table[i];
+  }
+  return NULL;
+}
+
+static void test_constants(const range_row *row)
+{
+  CHECK_EQ(folded[0], row->data_format);
+  CHECK_EQ(folded[1], row->thresh_tap);
+  for (uint32_t i=0; i<sizeof(fixed)/sizeof(fixed[0]); i++)
+  {
+    CHECK_EQ(folded[2 + i], fixed[i].value);
+  }
+  CHECK_EQ(folded_lsb[0], row->lsb_per_g);
+  // full scale is +/-range in every mode
+  CHECK_EQ(folded_lsb[1], row->range_g * row->lsb_per_g);
+  CHECK_EQ(folded_lsb[2], row->act_lsb);
+  CHECK_EQ(folded_lsb[3], (int32_t)row->act_lsb * row->act_lsb);
+  CHECK_EQ(ACCEL_MG_TO_LSB(1000), row->lsb_per_g);
+  CHECK_EQ(ACCEL_OFS_PER_G, 64);
+}
+
+static void test_registers(const range_row *row)
+{
+  adxl343_model_reset();
+  CHECK_EQ(accel_init(NULL), 0);
+  const uint8_t *regs = adxl343_model.regs;
+  CHECK_EQ(regs[ADXL343_DATA_FORMAT], row->data_format);
+  CHECK_EQ(regs[ADXL343_THRESH_TAP], row->thresh_tap);
+  for (uint32_t i=0; i<sizeof(fixed)/sizeof(fixed[0]); i++)
+  {
+    CHECK_EQ(regs[fixed[i].reg], fixed[i].value);
+  }
+}
+
+int main()
+{
+  printf("ACCEL_RANGE_G %d, ACCEL_FULL_RES %d\n", ACCEL_RANGE_G,
+         ACCEL_FULL_RES);
+  const range_row *row = find_row();
+  CHECK(row != NULL);
+  if (row != NULL)
+  {
+    test_constants(row);
+    test_registers(row);
+  }
+  return test_summary("test_data_format");
+}
@@ -0,0 +1,145 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_decode.c
+ * @brief  Batch decoder: the DSP kernel (built against the intrinsic
+ *         emulation) against the portable reference, bit for bit, plus
+ *         cycles per sample for both where the DWT counter exists
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "accel_decode.h"
+#include "accel_sample.h"
+#include "cycles.h"
+
+#define MAX_N      (ACCEL_BLOCK_LEN + 1)
+#if CYCLES_HAS_DWT
+#define BENCH_RUNS (1000)   // well inside the 32 bit cycle counter
+#else
+#define BENCH_RUNS (200000)
+#endif
+
+static uint8_t raw[ACCEL_RAW_SAMPLE_LEN * MAX_N + 3];
+
+typedef struct
+{
+  int16_t x[MAX_N];
+  int16_t y[MAX_N];
+  int16_t z[MAX_N];
+  uint32_t mag2[MAX_N];
+} decoded;
+
+static int compare(uint32_t n, const decoded *a, const decoded *b)
+{
+  int errors = 0;
+  for (uint32_t i=0; i<n; i++)
+  {
+    if (a->x[i] != b->x[i] || a->y[i] != b->y[i] || a->z[i] != b->z[i] ||
+        a->mag2[i] != b->mag2[i]) errors++;
+  }
+  return errors;
+}
+
+static void test_bit_exact()
+{
+  decoded dsp;
+  decoded ref;
+  int errors = 0;
+
+  srand(7);
+  for (int run=0; run<2000; run++)
+  {
+    // random bytes with the axis extremes mixed in, every length including
+    // the odd tail, at every alignment of the source
+    for (uint32_t i=0; i<sizeof(raw); i++) raw[i] = (uint8_t)rand();
+    if (run % 4 == 0)
+    {
+      for (uint32_t i=0; i+1<sizeof(raw); i+=2)
+      {
+        raw[i] = (run & 8) ? 0x00 : 0xFF;
+        raw[i+1] = (run & 8) ? 0x80 : 0x7F;
+      }
+    }
+    uint32_t n = (uint32_t)run % (MAX_N + 1);
+    const uint8_t *src = &raw[run % 3];
+
+    memset(&dsp, 0x5A, sizeof(dsp));
+    memset(&ref, 0x5A, sizeof(ref));
+    accel_decode_batch(src, n, dsp.x, dsp.y, dsp.z, dsp.mag2);
+    accel_decode_batch_ref(src, n, ref.x, ref.y, ref.z, ref.mag2);
+    errors += compare(MAX_N, &dsp, &ref);
+
+    // without the magnitude
+    accel_decode_batch(src, n, dsp.x, dsp.y, dsp.z, NULL);
+    errors += compare(n, &dsp, &ref);
+  }
+  CHECK_EQ(errors, 0);
+
+  // worst case magnitude, all axes at -32768
+  memset(raw, 0, sizeof(raw));
+  for (uint32_t i=1; i<ACCEL_RAW_SAMPLE_LEN * 2; i+=2) raw[i] = 0x80;
+  accel_decode_batch(raw, 2, dsp.x, dsp.y, dsp.z, dsp.mag2);
+  CHECK_EQ(dsp.mag2[0], 3u * 32768u * 32768u);
+  CHECK_EQ(dsp.mag2[1], 3u * 32768u * 32768u);
+
+  // the raw register image and accel_sample share a layout
+  accel_sample s = { -2, 300, -32768 };
+  accel_decode_batch((const uint8_t *)&s, 1, dsp.x, dsp.y, dsp.z, NULL);
+  CHECK_EQ(dsp.x[0], -2);
+  CHECK_EQ(dsp.y[0], 300);
+  CHECK_EQ(dsp.z[0], -32768);
+}
+
+// per sample: DWT cycles on target, host nsec otherwise
+static double bench(bool is_ref)
+{
+  static decoded out;
+  volatile uint32_t sink = 0;
+  for (uint32_t i=0; i<sizeof(raw); i++) raw[i] = (uint8_t)(i * 37);
+  cycles_init();
+  uint32_t start_cycles = cycles_now();
+  uint64_t start = test_now_ns();
+  for (int r=0; r<BENCH_RUNS; r++)
+  {
+    raw[0] = (uint8_t)r;
+    if (is_ref)
+    {
+      accel_decode_batch_ref(raw, ACCEL_BLOCK_LEN, out.x, out.y, out.z, out.mag2);
+    }
+    else
+    {
+      accel_decode_batch(raw, ACCEL_BLOCK_LEN, out.x, out.y, out.z, out.mag2);
+    }
+    sink += out.mag2[r % ACCEL_BLOCK_LEN];
+  }
+  uint32_t cycles = cycles_now() - start_cycles;
+  uint64_t ns = test_now_ns() - start;
+  (void)sink;
+  double samples = (double)BENCH_RUNS * ACCEL_BLOCK_LEN;
+#if CYCLES_HAS_DWT
+  (void)ns;
+  return cycles / samples;
+#else
+  (void)cycles;
+  return ns / samples;
+#endif
+}
+
+int main()
+{
+  test_bit_exact();
+#if CYCLES_HAS_DWT
+  printf("decode + mag2, 32 sample blocks: reference %.1f cycles/sample, "
+         "DSP %.1f cycles/sample\n", bench(true), bench(false));
+#else
+  // no cycle counter here and the intrinsics are plain C, so this only
+  // checks the emulated path runs at a sane speed, it says nothing about
+  // Cortex-M cycles
+  printf("decode + mag2, 32 sample blocks, host emulation sanity check "
+         "only: reference %.2f ns/sample, DSP (emulated) %.2f ns/sample\n",
+         bench(true), bench(false));
+#endif
+  return test_summary("test_decode");
+}
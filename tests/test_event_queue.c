@@ -0,0 +1,265 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_event_queue.c
+ * @brief  Indication queue: priority and arrival order, merging, eviction and
+ *         the counters, then burst loads through a fake GATT layer that
+ *         confirms one indication at a time
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "event_queue.h"
+
+static void test_order()
+{
+  event_queue q;
+  evq_event e;
+  evq_init(&q);
+  CHECK(!evq_peek(&q, &e));
+  CHECK(!evq_pop(&q, &e));
+
+  // taps first, then activity, then a fall: the fall leaves first
+  CHECK(evq_push(&q, EVQ_TAP, 1, 10));
+  CHECK(evq_push(&q, EVQ_TAP, 2, 20));
+  CHECK(evq_push(&q, EVQ_ACTIVITY, 1, 30));
+  CHECK(evq_push(&q, EVQ_FALL, 1, 40));
+  CHECK(evq_push(&q, EVQ_TAP, 3, 50));
+  CHECK(!evq_push(&q, EVQ_NUM_TYPES, 0, 60));
+
+  CHECK(evq_peek(&q, &e));
+  CHECK_EQ(e.type, EVQ_FALL);
+  CHECK_EQ(q.n, 5);
+  static const evq_type types[] = {
+    EVQ_FALL, EVQ_ACTIVITY, EVQ_TAP, EVQ_TAP, EVQ_TAP
+  };
+  static const uint8_t values[] = { 1, 1, 1, 2, 3 };
+  for (int i=0; i<5; i++)
+  {
+    CHECK(evq_pop(&q, &e));
+    CHECK_EQ(e.type, types[i]);
+    CHECK_EQ(e.value, values[i]);
+  }
+  CHECK(!evq_pop(&q, NULL));
+
+  // arrival order holds across the sequence counter wrap
+  evq_init(&q);
+  q.seq = UINT32_MAX - 1;
+  for (uint8_t v=0; v<4; v++) evq_push(&q, EVQ_TAP, v, v);
+  for (uint8_t v=0; v<4; v++)
+  {
+    CHECK(evq_pop(&q, &e));
+    CHECK_EQ(e.value, v);
+  }
+}
+
+static void test_merge()
+{
+  event_queue q;
+  evq_event e;
+  evq_init(&q);
+
+  // a newer state replaces the queued one and keeps its place
+  evq_push(&q, EVQ_ACTIVITY, 1, 100);
+  evq_push(&q, EVQ_TAP, 1, 110);
+  evq_push(&q, EVQ_ACTIVITY, 0, 120);
+  evq_push(&q, EVQ_ACTIVITY, 1, 130);
+  evq_push(&q, EVQ_FALL, 1, 140);
+  evq_push(&q, EVQ_FALL, 2, 150);
+  CHECK_EQ(q.n, 3);
+  CHECK_EQ(q.merged[EVQ_ACTIVITY], 2);
+  CHECK_EQ(q.merged[EVQ_FALL], 1);
+  CHECK_EQ(q.merged[EVQ_TAP], 0);
+
+  CHECK(evq_pop(&q, &e));
+  CHECK_EQ(e.type, EVQ_FALL);
+  CHECK_EQ(e.value, 2);
+  CHECK_EQ(e.time_ms, 150);
+  CHECK(evq_pop(&q, &e));
+  CHECK_EQ(e.type, EVQ_ACTIVITY);
+  CHECK_EQ(e.value, 1);
+  CHECK_EQ(e.time_ms, 130);
+
+  // taps are distinct gestures
+  evq_push(&q, EVQ_TAP, 1, 160);
+  CHECK_EQ(q.n, 2);
+
+  // turning one type off leaves the others
+  evq_push(&q, EVQ_ACTIVITY, 0, 170);
+  evq_remove_type(&q, EVQ_TAP);
+  CHECK_EQ(q.n, 1);
+  CHECK(evq_peek(&q, &e));
+  CHECK_EQ(e.type, EVQ_ACTIVITY);
+
+  // clearing keeps the counters
+  evq_clear(&q);
+  CHECK_EQ(q.n, 0);
+  CHECK_EQ(q.merged[EVQ_ACTIVITY], 2);
+}
+
+static void test_overflow()
+{
+  event_queue q;
+  evq_event e;
+  evq_init(&q);
+  for (uint8_t v=0; v<EVQ_CAPACITY; v++)
+  {
+    CHECK(evq_push(&q, EVQ_TAP, v, v));
+  }
+  CHECK_EQ(q.high_water, EVQ_CAPACITY);
+
+  // an equal priority loses, a higher one evicts the oldest tap
+  CHECK(!evq_push(&q, EVQ_TAP, 100, 100));
+  CHECK_EQ(q.dropped[EVQ_TAP], 1);
+  CHECK(evq_push(&q, EVQ_ACTIVITY, 1, 101));
+  CHECK_EQ(q.dropped[EVQ_TAP], 2);
+  CHECK(evq_push(&q, EVQ_FALL, 1, 102));
+  CHECK_EQ(q.dropped[EVQ_TAP], 3);
+  CHECK_EQ(q.overflows, 3);
+  CHECK_EQ(q.n, EVQ_CAPACITY);
+
+  // the two oldest taps went
+  evq_pop(&q, NULL);
+  evq_pop(&q, NULL);
+  CHECK(evq_pop(&q, &e));
+  CHECK_EQ(e.value, 2);
+
+  // a full queue still takes new states, a merge needs no room
+  evq_init(&q);
+  evq_push(&q, EVQ_FALL, 1, 0);
+  for (uint8_t v=1; v<EVQ_CAPACITY; v++) evq_push(&q, EVQ_ACTIVITY, v, v);
+  CHECK_EQ(q.n, 2);
+  for (uint8_t v=0; q.n<EVQ_CAPACITY; v++) evq_push(&q, EVQ_TAP, v, v);
+  CHECK(evq_push(&q, EVQ_FALL, 2, 50));
+  CHECK_EQ(q.overflows, 0);
+  CHECK(evq_push(&q, EVQ_ACTIVITY, 9, 51));
+  CHECK_EQ(q.overflows, 0);
+  CHECK_EQ(q.dropped[EVQ_ACTIVITY], 0);
+}
+
+// the GATT layer: one indication in flight, confirmed a link delay later
+typedef struct
+{
+  bool is_inflight;
+  uint32_t confirm_ms;
+  uint32_t sent[EVQ_NUM_TYPES];
+  uint8_t last[EVQ_NUM_TYPES];
+  uint32_t worst_fall_ms;
+} fake_gatt;
+
+static void gatt_poll(fake_gatt *g, event_queue *q, uint32_t now)
+{
+  evq_event e;
+  if (g->is_inflight && now >= g->confirm_ms) g->is_inflight = false;
+  if (g->is_inflight || !evq_pop(q, &e)) return;
+  g->sent[e.type]++;
+  g->last[e.type] = e.value;
+  if (e.type == EVQ_FALL && now - e.time_ms > g->worst_fall_ms)
+  {
+    g->worst_fall_ms = now - e.time_ms;
+  }
+  g->is_inflight = true;
+  g->confirm_ms = now + test_rand_range(30, 150);
+}
+
+/* Bursts every few seconds: a dozen taps, activity flapping, and now and
+ * then a fall status change, all within a quarter second while the link
+ * confirms an indication every 30-150 ms. The previous one pending flag per
+ * characteristic is kept beside for comparison.
+ */
+static void test_bursts()
+{
+  event_queue q;
+  fake_gatt g = { 0 };
+  uint32_t pushed[EVQ_NUM_TYPES] = { 0 };
+  uint8_t last[EVQ_NUM_TYPES] = { 0 };
+  evq_init(&q);
+
+  // per characteristic flags: latest value kept, sent in fixed order
+  bool is_pending[EVQ_NUM_TYPES] = { false };
+  bool is_flag_inflight = false;
+  uint32_t flag_confirm_ms = 0, flag_sent[EVQ_NUM_TYPES] = { 0 };
+
+  uint32_t next_burst = 1000, burst_end = 0, fall_at = 0;
+  uint8_t fall = 0, active = 0;
+  const uint32_t end = 10UL * 60 * 1000;
+  for (uint32_t now=0; now<end + 5000; now++)
+  {
+    if (now >= next_burst && now < end)
+    {
+      burst_end = now + 250;
+      next_burst = now + test_rand_range(2000, 8000);
+      fall_at = (test_rand_range(0, 3) == 0) ? now + test_rand_range(1, 249)
+                                             : 0;
+    }
+    if (fall_at != 0 && now == fall_at)
+    {
+      fall = (uint8_t)(fall % 3 + 1);
+      evq_push(&q, EVQ_FALL, fall, now);
+      pushed[EVQ_FALL]++;
+      last[EVQ_FALL] = fall;
+      is_pending[EVQ_FALL] = true;
+    }
+    if (now < burst_end && (now % 20) == 0)
+    {
+      evq_type type = (test_rand_range(0, 2) == 0) ? EVQ_ACTIVITY : EVQ_TAP;
+      uint8_t v = (type == EVQ_ACTIVITY) ? (active ^= 1)
+                                         : (uint8_t)test_rand_range(1, 2);
+      evq_push(&q, type, v, now);
+      pushed[type]++;
+      last[type] = v;
+      is_pending[type] = true;
+    }
+
+    gatt_poll(&g, &q, now);
+
+    if (is_flag_inflight && now >= flag_confirm_ms) is_flag_inflight = false;
+    for (int t=0; t<EVQ_NUM_TYPES && !is_flag_inflight; t++)
+    {
+      if (!is_pending[t]) continue;
+      is_pending[t] = false;
+      flag_sent[t]++;
+      is_flag_inflight = true;
+      flag_confirm_ms = now + test_rand_range(30, 150);
+    }
+  }
+
+  printf("pushed  falls %u, activity %u, taps %u\n", (unsigned)pushed[EVQ_FALL],
+         (unsigned)pushed[EVQ_ACTIVITY], (unsigned)pushed[EVQ_TAP]);
+  printf("queue   sent %u/%u/%u, merged %u/%u, taps dropped %u, "
+         "overflows %u, worst fall wait %u ms\n", (unsigned)g.sent[EVQ_FALL],
+         (unsigned)g.sent[EVQ_ACTIVITY], (unsigned)g.sent[EVQ_TAP],
+         (unsigned)q.merged[EVQ_FALL], (unsigned)q.merged[EVQ_ACTIVITY],
+         (unsigned)q.dropped[EVQ_TAP], (unsigned)q.overflows,
+         (unsigned)g.worst_fall_ms);
+  printf("flags   sent %u/%u/%u\n", (unsigned)flag_sent[EVQ_FALL],
+         (unsigned)flag_sent[EVQ_ACTIVITY], (unsigned)flag_sent[EVQ_TAP]);
+
+  // everything pushed was sent, merged or dropped, and nothing is left
+  CHECK_EQ(q.n, 0);
+  for (int t=0; t<EVQ_NUM_TYPES; t++)
+  {
+    CHECK_EQ(pushed[t], g.sent[t] + q.merged[t] + q.dropped[t]);
+    CHECK_EQ(g.last[t], last[t]);
+  }
+
+  // falls are never dropped and wait at most for the indication in flight
+  CHECK(g.sent[EVQ_FALL] > 0);
+  CHECK_EQ(q.dropped[EVQ_FALL], 0);
+  CHECK_EQ(q.dropped[EVQ_ACTIVITY], 0);
+  CHECK(g.worst_fall_ms > 0);
+  CHECK(g.worst_fall_ms <= 150);
+
+  // the bursts do fill the queue, and it keeps more taps than the flag
+  CHECK_EQ(q.high_water, EVQ_CAPACITY);
+  CHECK(q.overflows > 0);
+  CHECK(g.sent[EVQ_TAP] > 2 * flag_sent[EVQ_TAP]);
+}
+
+int main()
+{
+  test_seed(3);
+  test_order();
+  test_merge();
+  test_overflow();
+  test_bursts();
+  return test_summary("test_event_queue");
+}
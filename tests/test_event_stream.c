@@ -0,0 +1,222 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_event_stream.c
+ * @brief  Event stream batches: the record encoding, records per indication
+ *         at the minimum and the largest MTU, and the flush deadline with the
+ *         ready slot free and taken
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "event_stream.h"
+
+static void test_encoding()
+{
+  event_stream s;
+  const uint8_t *p;
+  evs_init(&s, 0);
+  CHECK_EQ(s.deadline_ms, EVS_DEFAULT_DEADLINE_MS);
+  CHECK_EQ(evs_ready(&s, &p), 0);
+
+  // three records fill a minimum MTU batch, 5 + 3 * 4 of its 20 bytes
+  const uint32_t t0 = 0x12345678;
+  CHECK(evs_add(&s, 2, 0xA1, t0));
+  CHECK(evs_add(&s, 1, 0xB2, t0 + 0x0102));
+  CHECK_EQ(evs_ready(&s, &p), 0);
+  CHECK(evs_add(&s, 0, 0xC3, t0 + 0x0102 + 0xFFFF));
+  uint32_t len = evs_ready(&s, &p);
+  CHECK_EQ(len, EVS_HEADER_LEN + 3 * EVS_RECORD_LEN);
+
+  static const uint8_t expect[] = {
+    0x00, 0x78, 0x56, 0x34, 0x12,
+    0x02, 0x00, 0x00, 0xA1,
+    0x01, 0x02, 0x01, 0xB2,
+    0x00, 0xFF, 0xFF, 0xC3
+  };
+  for (uint32_t i=0; i<sizeof(expect); i++) CHECK_EQ(p[i], expect[i]);
+
+  uint8_t type, value;
+  uint32_t t;
+  CHECK(evs_decode(p, len, 2, &type, &value, &t));
+  CHECK_EQ(type, 0);
+  CHECK_EQ(value, 0xC3);
+  CHECK_EQ(t, t0 + 0x0102 + 0xFFFF);
+  CHECK(!evs_decode(p, len, 3, &type, &value, &t));
+  CHECK(!evs_decode(p, len - 1, 0, &type, &value, &t));
+  CHECK(!evs_decode(p, EVS_HEADER_LEN - 1, 0, &type, &value, &t));
+
+  // the next batch counts up and a longer gap than a delta starts a new one
+  evs_consume(&s, t0);
+  CHECK(evs_add(&s, 1, 1, t0 + 0x20000));
+  CHECK(evs_add(&s, 1, 2, t0 + 0x20000 + 0x10000));
+  CHECK(evs_ready(&s, &p) > 0);
+  CHECK_EQ(p[0], 1);
+  CHECK_EQ(s.ready.n_records, 1);
+  CHECK_EQ(s.open.n_records, 1);
+  CHECK_EQ(s.dropped, 0);
+
+  // the MTU is clamped to what the stack and the buffer allow
+  evs_set_mtu(&s, 10);
+  CHECK_EQ(s.max_len, EVS_MIN_MTU - 3);
+  evs_set_mtu(&s, 517);
+  CHECK_EQ(s.max_len, EVS_MAX_LEN);
+  evs_set_mtu(&s, 100);
+  CHECK_EQ(s.max_len, 97);
+}
+
+// records per indication and bytes per event for a long run of events
+static void test_density()
+{
+  static const uint16_t mtus[] = { 23, 65, 247 };
+  for (uint32_t m=0; m<sizeof(mtus)/sizeof(mtus[0]); m++)
+  {
+    event_stream s;
+    const uint8_t *p;
+    evs_init(&s, 0);
+    evs_set_mtu(&s, mtus[m]);
+
+    const uint32_t n = 1000;
+    uint32_t indications = 0, bytes = 0, decoded = 0, now = 0;
+    for (uint32_t i=0; i<n; i++)
+    {
+      now += test_rand_range(0, 50);
+      CHECK(evs_add(&s, (uint8_t)(i % 3), (uint8_t)i, now));
+      uint32_t len = evs_ready(&s, &p);
+      if (len == 0) continue;
+
+      // every record comes back in order with its time
+      uint8_t type, value;
+      uint32_t t;
+      for (uint32_t r=0; evs_decode(p, len, r, &type, &value, &t); r++)
+      {
+        CHECK_EQ(value, (uint8_t)decoded);
+        decoded++;
+      }
+      CHECK(len <= (uint32_t)mtus[m] - 3);
+      indications++;
+      bytes += len;
+      evs_consume(&s, now);
+    }
+    evs_flush(&s);
+    uint32_t len = evs_ready(&s, &p);
+    if (len > 0)
+    {
+      indications++;
+      bytes += len;
+      decoded += (len - EVS_HEADER_LEN) / EVS_RECORD_LEN;
+    }
+
+    uint32_t per_batch = ((uint32_t)mtus[m] - 3 - EVS_HEADER_LEN) /
+                         EVS_RECORD_LEN;
+    printf("MTU %3u: %2u records per indication, %u indications for %u "
+           "events, %.2f bytes per event\n", (unsigned)mtus[m],
+           (unsigned)per_batch, (unsigned)indications, (unsigned)n,
+           bytes / (double)n);
+    CHECK_EQ(decoded, n);
+    CHECK_EQ(s.records, n);
+    CHECK_EQ(indications, (n + per_batch - 1) / per_batch);
+    CHECK(bytes <= n * EVS_RECORD_LEN + indications * EVS_HEADER_LEN);
+  }
+}
+
+static void test_deadline()
+{
+  event_stream s;
+  const uint8_t *p;
+  evs_init(&s, 200);
+  CHECK_EQ(evs_time_to_deadline(&s, 0), EVS_NO_DEADLINE);
+
+  // the deadline runs from the first record, later ones do not extend it
+  const uint32_t t0 = UINT32_MAX - 100;
+  evs_add(&s, 0, 1, t0);
+  CHECK_EQ(evs_time_to_deadline(&s, t0), 200);
+  evs_add(&s, 0, 2, t0 + 150);
+  CHECK_EQ(evs_time_to_deadline(&s, t0 + 150), 50);
+  evs_poll(&s, t0 + 199);
+  CHECK_EQ(evs_ready(&s, &p), 0);
+  evs_poll(&s, t0 + 200);
+  CHECK_EQ(evs_ready(&s, &p), EVS_HEADER_LEN + 2 * EVS_RECORD_LEN);
+  CHECK_EQ(evs_time_to_deadline(&s, t0 + 200), EVS_NO_DEADLINE);
+
+  // while the slot is taken an overdue batch keeps filling, then drops
+  evs_add(&s, 0, 3, t0 + 300);
+  CHECK_EQ(evs_time_to_deadline(&s, t0 + 600), 0);
+  evs_poll(&s, t0 + 600);
+  CHECK_EQ(s.open.n_records, 1);
+  CHECK(evs_add(&s, 0, 4, t0 + 610));
+  CHECK(evs_add(&s, 0, 5, t0 + 620));
+  CHECK_EQ(s.open.len, EVS_HEADER_LEN + 3 * EVS_RECORD_LEN);
+  CHECK(!evs_add(&s, 0, 6, t0 + 630));
+  CHECK_EQ(s.dropped, 1);
+  CHECK(!evs_flush(&s));
+
+  // consuming the slot moves the due batch in at once
+  evs_consume(&s, t0 + 640);
+  CHECK_EQ(evs_ready(&s, &p), EVS_HEADER_LEN + 3 * EVS_RECORD_LEN);
+  CHECK_EQ(s.open.len, 0);
+
+  // a flush closes early, an empty one does nothing
+  evs_consume(&s, t0 + 650);
+  CHECK(!evs_flush(&s));
+  evs_add(&s, 0, 7, t0 + 660);
+  CHECK(evs_flush(&s));
+  CHECK_EQ(s.batches, 3);
+}
+
+/* Sparse events over an hour, polled every 10 ms as the deadline timer would,
+ * each batch delivered 30-150 ms after it is ready. No record waits for the
+ * radio past the deadline plus one delivery.
+ */
+static void test_latency()
+{
+  event_stream s;
+  const uint8_t *p;
+  evs_init(&s, 0);
+  evs_set_mtu(&s, 247);
+
+  uint32_t next = 500, delivered_at = 0, worst = 0, records = 0;
+  bool is_inflight = false;
+  for (uint32_t now=0; now<3600UL * 1000; now+=10)
+  {
+    if (now >= next)
+    {
+      evs_add(&s, 1, 0, now);
+      next = now + test_rand_range(10, 3000);
+    }
+    evs_poll(&s, now);
+    if (is_inflight && now >= delivered_at)
+    {
+      uint32_t len = evs_ready(&s, &p);
+      uint8_t type, value;
+      uint32_t t;
+      for (uint32_t r=0; evs_decode(p, len, r, &type, &value, &t); r++)
+      {
+        if (now - t > worst) worst = now - t;
+        records++;
+      }
+      evs_consume(&s, now);
+      is_inflight = false;
+    }
+    if (!is_inflight && evs_ready(&s, &p) > 0)
+    {
+      is_inflight = true;
+      delivered_at = now + test_rand_range(30, 150);
+    }
+  }
+  printf("deadline %u ms: %u records in %u batches, worst wait %u ms\n",
+         (unsigned)s.deadline_ms, (unsigned)records, (unsigned)s.batches,
+         (unsigned)worst);
+  CHECK_EQ(s.dropped, 0);
+  CHECK(records > 0);
+  CHECK(s.batches < records);
+  CHECK(worst <= s.deadline_ms + 150 + 10);
+}
+
+int main()
+{
+  test_seed(4);
+  test_encoding();
+  test_density();
+  test_deadline();
+  test_latency();
+  return test_summary("test_event_stream");
+}
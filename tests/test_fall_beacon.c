@@ -0,0 +1,236 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_fall_beacon.c
+ * @brief  Fall beacon: the advertising data encoder and decoder, the burst
+ *         state machine, and a stand-in scanner that de-duplicates on the
+ *         sequence number, across resets and at a few scan duty cycles
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "fall_beacon.h"
+
+// a gateway or phone, reports an alert once per sequence number
+typedef struct
+{
+  bool has_seq;
+  uint8_t last_seq;
+  uint32_t alerts;
+  uint32_t duplicates;
+} scanner;
+
+static bool scan(scanner *s, const uint8_t *adv, uint32_t len)
+{
+  fall_beacon_payload p;
+  if (!fall_beacon_decode(adv, len, &p)) return false;
+  if (p.status != FALL_BEACON_STATUS_FALL) return false;
+  if (s->has_seq && p.seq == s->last_seq)
+  {
+    s->duplicates++;
+    return false;
+  }
+  s->has_seq = true;
+  s->last_seq = p.seq;
+  s->alerts++;
+  return true;
+}
+
+static void test_encoding()
+{
+  fall_beacon_payload p = { FALL_BEACON_STATUS_FALL, 200, 54321 }, q;
+  uint8_t adv[31];
+  uint32_t n = fall_beacon_encode(&p, adv);
+  CHECK_EQ(n, FALL_BEACON_ADV_LEN);
+
+  static const uint8_t expect[FALL_BEACON_ADV_LEN] = {
+    0x02, 0x01, 0x06,
+    0x08, 0xFF, 0xFF, 0xFF, FALL_BEACON_VERSION, FALL_BEACON_STATUS_FALL,
+    200, 0x31, 0xD4
+  };
+  CHECK_EQ(memcmp(adv, expect, sizeof(expect)), 0);
+
+  CHECK(fall_beacon_decode(adv, n, &q));
+  CHECK_EQ(q.status, p.status);
+  CHECK_EQ(q.seq, 200);
+  CHECK_EQ(q.time_s, 54321);
+
+  // found behind other AD structures and another company's data
+  uint8_t mixed[31] = { 3, 0x03, 0x0F, 0x18, 5, 0xFF, 0x4C, 0x00, 1, 2 };
+  memcpy(&mixed[10], &adv[3], 9);
+  CHECK(fall_beacon_decode(mixed, 19, &q));
+  CHECK_EQ(q.seq, 200);
+
+  // truncated, foreign, another version, a length past the end, padding
+  uint8_t bad[FALL_BEACON_ADV_LEN];
+  CHECK(!fall_beacon_decode(adv, n - 1, &q));
+  memcpy(bad, adv, n);
+  bad[6] = 0x12;
+  CHECK(!fall_beacon_decode(bad, n, &q));
+  memcpy(bad, adv, n);
+  bad[7] = FALL_BEACON_VERSION + 1;
+  CHECK(!fall_beacon_decode(bad, n, &q));
+  memcpy(bad, adv, n);
+  bad[3] = 40;
+  CHECK(!fall_beacon_decode(bad, n, &q));
+  uint8_t zero[31] = { 0 };
+  CHECK(!fall_beacon_decode(zero, sizeof(zero), &q));
+}
+
+static void test_states()
+{
+  fall_beacon fb;
+  fall_beacon_init(&fb, 0);
+  CHECK_EQ(fb.state, FALL_BEACON_OFF);
+  CHECK_EQ(fall_beacon_interval(&fb), FALL_BEACON_NORMAL_INTERVAL);
+  CHECK(!fall_beacon_step(&fb, 1000));
+  CHECK(!fall_beacon_clear(&fb));
+
+  // a burst at the fast interval, then held at the normal one
+  CHECK_EQ(fall_beacon_raise(&fb, FALL_BEACON_STATUS_FALL, 5000, 6000),
+           FALL_BEACON_BURST_MS);
+  CHECK_EQ(fb.payload.seq, 1);
+  CHECK_EQ(fb.payload.time_s, 5);
+  CHECK_EQ(fall_beacon_interval(&fb), FALL_BEACON_BURST_INTERVAL);
+  CHECK(!fall_beacon_step(&fb, 6000 + FALL_BEACON_BURST_MS - 1));
+  CHECK(fall_beacon_step(&fb, 6000 + FALL_BEACON_BURST_MS));
+  CHECK_EQ(fb.state, FALL_BEACON_HOLD);
+  CHECK_EQ(fall_beacon_interval(&fb), FALL_BEACON_NORMAL_INTERVAL);
+  CHECK(!fall_beacon_step(&fb, 100000));
+
+  CHECK(fall_beacon_clear(&fb));
+  CHECK_EQ(fb.payload.status, FALL_BEACON_STATUS_NONE);
+  CHECK(!fall_beacon_clear(&fb));
+
+  // the burst end survives the uptime wrap, the time is modulo 2^16 sec
+  fall_beacon_raise(&fb, FALL_BEACON_STATUS_FALL, UINT32_MAX, UINT32_MAX);
+  CHECK_EQ(fb.payload.seq, 2);
+  CHECK_EQ(fb.payload.time_s, (uint16_t)(UINT32_MAX / 1000));
+  CHECK(!fall_beacon_step(&fb, FALL_BEACON_BURST_MS - 2));
+  CHECK(fall_beacon_step(&fb, FALL_BEACON_BURST_MS - 1));
+  CHECK_EQ(fb.raised, 2);
+
+  // the sequence continues from the one given, wrapping after 255
+  fall_beacon_init(&fb, 255);
+  CHECK_EQ(fb.raised, 0);
+  fall_beacon_raise(&fb, FALL_BEACON_STATUS_FALL, 0, 0);
+  CHECK_EQ(fb.payload.seq, 0);
+}
+
+/* One alarm per boot, a scanner listening throughout. Restarting the
+ * sequence at 0 every boot makes each alarm after the first a duplicate,
+ * carrying the last one over, as ble.c does through the NVM, does not.
+ */
+static void test_resets()
+{
+  scanner fresh = { 0 }, carried = { 0 };
+  uint8_t saved = 0;
+  uint8_t adv[FALL_BEACON_ADV_LEN];
+  for (int boot=0; boot<300; boot++)
+  {
+    fall_beacon fb;
+    fall_beacon_init(&fb, 0);
+    fall_beacon_raise(&fb, FALL_BEACON_STATUS_FALL, 1000, 1000);
+    uint32_t n = fall_beacon_encode(&fb.payload, adv);
+    for (int k=0; k<5; k++) scan(&fresh, adv, n);
+
+    fall_beacon_init(&fb, saved);
+    fall_beacon_raise(&fb, FALL_BEACON_STATUS_FALL, 1000, 1000);
+    saved = fb.payload.seq;
+    n = fall_beacon_encode(&fb.payload, adv);
+    for (int k=0; k<5; k++) scan(&carried, adv, n);
+  }
+  printf("300 boots with an alarm each: %u alerts from seq 0 at boot, "
+         "%u carried over\n", (unsigned)fresh.alerts,
+         (unsigned)carried.alerts);
+  CHECK_EQ(fresh.alerts, 1);
+  CHECK_EQ(carried.alerts, 300);
+  CHECK_EQ(carried.duplicates, 300 * 4);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* Time from the alarm to the scanner's first alert. The scanner listens for
+ * window msec of every period, 30% of advertising events are lost to
+ * collisions. Returns the 99th percentile, the misses over a minute are
+ * counted.
+ */
+static double detect(const char *name, bool is_burst, double window,
+                     double period, uint32_t *missed)
+{
+  enum { RUNS = 1000 };
+  static double lat[RUNS];
+  uint32_t alerts = 0, duplicates = 0;
+  *missed = 0;
+  for (int k=0; k<RUNS; k++)
+  {
+    fall_beacon fb;
+    fall_beacon_init(&fb, (uint8_t)k);
+    double t0 = 1000.0 + test_rand_unit() * 1000.0;
+    fall_beacon_raise(&fb, FALL_BEACON_STATUS_FALL, (uint32_t)t0,
+                      (uint32_t)t0);
+    if (!is_burst) fb.state = FALL_BEACON_HOLD;
+    uint8_t adv[FALL_BEACON_ADV_LEN];
+    uint32_t n = fall_beacon_encode(&fb.payload, adv);
+
+    scanner s = { 0 };
+    double phase = test_rand_unit() * period;
+    lat[k] = INFINITY;
+    // each advertising event is delayed by up to 10 ms, advDelay
+    for (double t=t0; t<t0 + 60000.0;
+         t+=fall_beacon_interval(&fb) * 0.625 + test_rand_unit() * 10.0)
+    {
+      fall_beacon_step(&fb, (uint32_t)t);
+      if (fmod(t + phase, period) < window && test_rand_unit() < 0.7 &&
+          scan(&s, adv, n) && isinf(lat[k]))
+      {
+        lat[k] = t - t0;
+      }
+    }
+    if (isinf(lat[k])) (*missed)++;
+    alerts += s.alerts;
+    duplicates += s.duplicates;
+  }
+  qsort(lat, RUNS, sizeof(lat[0]), cmp_double);
+  printf("%-30s median %5.0f ms, p99 %5.0f ms, missed %u, %u alerts, "
+         "%u duplicates dropped\n", name, lat[RUNS / 2], lat[RUNS * 99 / 100],
+         (unsigned)*missed, (unsigned)alerts, (unsigned)duplicates);
+  CHECK_EQ(alerts + *missed, RUNS);
+  return lat[RUNS * 99 / 100];
+}
+
+static void test_detection()
+{
+  uint32_t missed;
+  double burst, normal;
+
+  burst = detect("gateway 100% scan, burst", true, 100, 100, &missed);
+  CHECK_EQ(missed, 0);
+  normal = detect("gateway 100% scan, 100 ms", false, 100, 100, &missed);
+  CHECK(burst < normal);
+
+  burst = detect("phone 10% scan, burst", true, 10, 100, &missed);
+  CHECK_EQ(missed, 0);
+  normal = detect("phone 10% scan, 100 ms", false, 10, 100, &missed);
+  CHECK(burst < normal);
+
+  burst = detect("phone 1% scan, burst", true, 10, 1000, &missed);
+  CHECK_EQ(missed, 0);
+  normal = detect("phone 1% scan, 100 ms", false, 10, 1000, &missed);
+  CHECK(burst < normal);
+}
+
+int main()
+{
+  test_seed(3);
+  test_encoding();
+  test_states();
+  test_resets();
+  test_detection();
+  return test_summary("test_fall_beacon");
+}
@@ -0,0 +1,293 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_fall_detect.c
+ * @brief  Labelled trace replay for the fall detector: detection latency,
+ *         missed falls and false alarms, stream and interrupt triggered
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "fall_detect.h"
+
+#define G             ACCEL_LSB_PER_G
+#define TRACE_MAX     (12 * 60 * DET_RATE_HZ)
+#define LATENCY_MAX_MS (FD_IMPACT_WINDOW_MS + FD_SETTLE_MS + FD_STILL_MS + \
+                        ACCEL_BLOCK_LEN * DET_PERIOD_MS)
+
+typedef struct
+{
+  int16_t x[TRACE_MAX];
+  int16_t y[TRACE_MAX];
+  int16_t z[TRACE_MAX];
+  uint32_t t[TRACE_MAX];
+  uint32_t n;
+  uint32_t int_ms;        // INT_FREE_FALL of the first long enough low-g run
+  bool has_int;
+} trace;
+
+static trace tr;
+
+static void add(int x, int y, int z)
+{
+  if (tr.n == TRACE_MAX) return;
+  tr.x[tr.n] = (int16_t)x;
+  tr.y[tr.n] = (int16_t)y;
+  tr.z[tr.n] = (int16_t)z;
+  tr.t[tr.n] = tr.n * DET_PERIOD_MS;
+  tr.n++;
+}
+
+// resting with gravity along (gx, gy, gz) in g
+static void rest(int gx, int gy, int gz, uint32_t ms)
+{
+  for (uint32_t k=0; k<ms/DET_PERIOD_MS; k++)
+  {
+    add(gx*G + test_rand_noise(4), gy*G + test_rand_noise(4),
+        gz*G + test_rand_noise(4));
+  }
+}
+
+static void freefall(uint32_t ms)
+{
+  // the part interrupts once the run has lasted TIME_FF
+  if (!tr.has_int && ms >= ACCEL_FF_TIME_MS)
+  {
+    tr.int_ms = tr.n * DET_PERIOD_MS + ACCEL_FF_TIME_MS;
+    tr.has_int = true;
+  }
+  for (uint32_t k=0; k<ms/DET_PERIOD_MS; k++)
+  {
+    add(test_rand_noise(G/16), test_rand_noise(G/16), test_rand_noise(G/16));
+  }
+}
+
+// a triangular spike on one axis peaking at peak_g, then a damped bounce
+static void impact(int ax, int peak_g, int gx, int gy, int gz)
+{
+  static const int shape[] = { 30, 70, 100, 60, 20 };
+  for (int k=0; k<5; k++)
+  {
+    int v = peak_g * G * shape[k] / 100;
+    add(gx*G + (ax == 0 ? v : 0), gy*G + (ax == 1 ? v : 0),
+        gz*G + (ax == 2 ? v : 0));
+  }
+  for (int k=0; k<50; k++)
+  {
+    int b = (k & 1 ? 1 : -1) * G * (50 - k) / 100;
+    add(gx*G + b + test_rand_noise(8), gy*G + test_rand_noise(8),
+        gz*G - b + test_rand_noise(8));
+  }
+}
+
+// walking upright, +/-0.3 g vertical bounce at ~2 steps a second
+static void walk(uint32_t ms)
+{
+  for (uint32_t k=0; k<ms/DET_PERIOD_MS; k++)
+  {
+    int phase = (int)((k * DET_PERIOD_MS) % 500);
+    int bounce = (phase < 250 ? phase : 500 - phase) * 3 * G / 10 / 125 -
+                 3 * G / 10;
+    add(test_rand_noise(G/10), test_rand_noise(G/10), G + bounce);
+  }
+}
+
+static void begin()
+{
+  tr.n = 0;
+  tr.has_int = false;
+}
+
+typedef struct
+{
+  const char *name;
+  bool is_fall;
+  void (*build)();
+} scenario;
+
+static void fall_forward()
+{
+  rest(0, 0, 1, 3000); freefall(400); impact(0, 5, 1, 0, 0);
+  rest(1, 0, 0, 5000);
+}
+static void fall_backward()
+{
+  rest(0, 0, 1, 3000); freefall(300); impact(0, 4, -1, 0, 0);
+  rest(-1, 0, 0, 5000);
+}
+static void fall_sideways()
+{
+  walk(4000); freefall(350); impact(1, 6, 0, 1, 0); rest(0, 1, 0, 5000);
+}
+static void fall_from_bed()
+{
+  rest(0, 1, 0, 3000); freefall(250); impact(2, 4, 0, 0, -1);
+  rest(0, 0, -1, 5000);
+}
+static void device_drop()
+{
+  // slips off and lands flat the way it was held, no orientation change
+  rest(0, 0, 1, 3000); freefall(300); impact(2, 8, 0, 0, 1);
+  rest(0, 0, 1, 5000);
+}
+static void jump()
+{
+  walk(3000); freefall(250); impact(2, 3, 0, 0, 1); walk(5000);
+}
+static void stumble()
+{
+  // a short low-g dip and a soft landing on the feet
+  walk(3000); freefall(150); impact(2, 1, 0, 0, 1); walk(4000);
+}
+static void sit_down_hard()
+{
+  // a dip too short to trigger, a hard seat, then still and upright
+  rest(0, 0, 1, 3000); freefall(60); impact(2, 3, 0, 0, 1);
+  rest(0, 0, 1, 5000);
+}
+static void lie_down()
+{
+  rest(0, 0, 1, 3000);
+  for (int k=0; k<=100; k++) add(G*k/100, test_rand_noise(4), G*(100-k)/100);
+  rest(1, 0, 0, 5000);
+}
+static void daily_living()
+{
+  // ten minutes of walking, resting and lying down
+  for (int k=0; k<5; k++)
+  {
+    walk(60000); rest(0, 0, 1, 30000); rest(1, 0, 0, 30000);
+  }
+}
+
+static const scenario scenarios[] = {
+  { "fall forward",   true,  fall_forward },
+  { "fall backward",  true,  fall_backward },
+  { "fall sideways",  true,  fall_sideways },
+  { "fall from bed",  true,  fall_from_bed },
+  { "device drop",    false, device_drop },
+  { "jump",           false, jump },
+  { "stumble",        false, stumble },
+  { "sit down hard",  false, sit_down_hard },
+  { "lie down",       false, lie_down },
+  { "daily living",   false, daily_living },
+};
+
+typedef struct
+{
+  uint32_t confirmed;
+  uint32_t rejected;
+  uint32_t latency_ms;     // trigger to verdict of the first confirmation
+} replay_result;
+
+// loads the drain-sized block starting at sample s, returns its length
+static uint32_t load_block(accel_block *blk, uint32_t s)
+{
+  uint32_t n = (tr.n - s < ACCEL_BLOCK_LEN) ? tr.n - s : ACCEL_BLOCK_LEN;
+  for (uint32_t i=0; i<n; i++)
+  {
+    blk->x[i] = tr.x[s+i];
+    blk->y[i] = tr.y[s+i];
+    blk->z[i] = tr.z[s+i];
+    blk->mag2[i] = (uint32_t)(tr.x[s+i]*tr.x[s+i] + tr.y[s+i]*tr.y[s+i] +
+                              tr.z[s+i]*tr.z[s+i]);
+  }
+  blk->timestamps = &tr.t[s];
+  blk->n = n;
+  return n;
+}
+
+// replays the trace in drain-sized blocks, optionally armed by the interrupt
+static replay_result replay(bool is_interrupt)
+{
+  replay_result r = { 0, 0, 0 };
+  fall_detector fd;
+  accel_block blk;
+  fall_detect_init(&fd);
+
+  bool is_armed = false;
+  for (uint32_t s=0; s<tr.n; s+=ACCEL_BLOCK_LEN)
+  {
+    uint32_t n = load_block(&blk, s);
+
+    // the interrupt arrives with the drain that holds its time
+    if (is_interrupt && tr.has_int && !is_armed && tr.t[s+n-1] >= tr.int_ms)
+    {
+      fall_detect_trigger(&fd, tr.int_ms);
+      is_armed = true;
+    }
+
+    fall_verdict v = fall_detect_process(&fd, &blk);
+    const fall_event *e = fall_detect_last_event(&fd);
+    if (v == FALL_CONFIRMED && r.confirmed++ == 0)
+    {
+      r.latency_ms = e->decided_ms - e->trigger_ms;
+    }
+    if (v == FALL_REJECTED) r.rejected++;
+  }
+  return r;
+}
+
+static void test_replay(bool is_interrupt)
+{
+  uint32_t falls = 0, detected = 0, false_alarms = 0;
+  uint32_t worst_ms = 0, adl_ms = 0;
+
+  printf("%s trigger:\n", is_interrupt ? "interrupt" : "stream");
+  for (uint32_t k=0; k<sizeof(scenarios)/sizeof(scenarios[0]); k++)
+  {
+    begin();
+    scenarios[k].build();
+    replay_result r = replay(is_interrupt);
+    printf("  %-14s %-4s confirmed %lu rejected %lu latency %lu ms\n",
+           scenarios[k].name, scenarios[k].is_fall ? "fall" : "adl",
+           (unsigned long)r.confirmed, (unsigned long)r.rejected,
+           (unsigned long)r.latency_ms);
+    if (scenarios[k].is_fall)
+    {
+      falls++;
+      if (r.confirmed == 1) detected++;
+      if (r.latency_ms > worst_ms) worst_ms = r.latency_ms;
+      CHECK_EQ(r.confirmed, 1);
+    }
+    else
+    {
+      false_alarms += r.confirmed;
+      adl_ms += tr.n * DET_PERIOD_MS;
+      CHECK_EQ(r.confirmed, 0);
+    }
+  }
+  printf("  detected %lu/%lu, worst latency %lu ms, %lu false alarms in "
+         "%lu s of activity\n", (unsigned long)detected, (unsigned long)falls,
+         (unsigned long)worst_ms, (unsigned long)false_alarms,
+         (unsigned long)(adl_ms / 1000));
+  CHECK(worst_ms <= LATENCY_MAX_MS);
+}
+
+static void test_stats()
+{
+  // every sample is accounted to exactly one stage
+  begin();
+  fall_forward();
+  fall_detector fd;
+  accel_block blk;
+  fall_detect_init(&fd);
+  for (uint32_t s=0; s<tr.n; s+=ACCEL_BLOCK_LEN)
+  {
+    load_block(&blk, s);
+    fall_detect_process(&fd, &blk);
+  }
+  const fall_detect_stats *st = fall_detect_get_stats(&fd);
+  uint32_t total = 0;
+  for (int k=0; k<FD_NUM_STAGES; k++) total += st->samples[k];
+  CHECK_EQ(total, tr.n);
+  CHECK(st->samples[FD_STAGE_IMPACT] > 0);
+  CHECK(st->samples[FD_STAGE_STILLNESS] > 0);
+}
+
+int main()
+{
+  test_seed(1);
+  test_replay(false);
+  test_replay(true);
+  test_stats();
+  return test_summary("test_fall_detect");
+}
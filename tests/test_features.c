@@ -0,0 +1,181 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_features.c
+ * @brief  Sliding-window feature engine against a naive recompute:
+ *         bit-exact agreement and time per sample
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include "test.h"
+#include "accel_features.h"
+
+#define STREAM_LEN  (20000)
+
+static int16_t stream[STREAM_LEN];
+
+// the window ending at sample i, recomputed from scratch
+static void naive(const int16_t *s, uint32_t i, feature_values *out)
+{
+  uint32_t n = (i + 1 < FEAT_WINDOW) ? i + 1 : FEAT_WINDOW;
+  uint32_t first = i + 1 - n;
+  int64_t sum = 0, sum2 = 0;
+  uint64_t jerk = 0;
+  int16_t mn = INT16_MAX, mx = INT16_MIN;
+  for (uint32_t k=first; k<=i; k++)
+  {
+    sum += s[k];
+    sum2 += (int64_t)s[k] * s[k];
+    if (s[k] < mn) mn = s[k];
+    if (s[k] > mx) mx = s[k];
+    if (k > first) jerk += (uint64_t)abs(s[k] - s[k-1]);
+  }
+  out->mean_q4 = (int32_t)(sum * 16 / (int64_t)n);
+  out->var = (uint32_t)(((int64_t)n * sum2 - sum * sum) / ((int64_t)n * n));
+  out->min = mn;
+  out->max = mx;
+  out->p2p = (uint16_t)(mx - mn);
+  out->jerk_q4 = (n > 1) ? (uint32_t)(jerk * 16 / (n - 1)) : 0;
+}
+
+static uint32_t compare(const char *name)
+{
+  static feature_engine fe;
+  features_init(&fe);
+  feature_channel *ch = &fe.axis[0];
+
+  uint32_t mismatches = 0;
+  for (uint32_t i=0; i<STREAM_LEN; i++)
+  {
+    feature_push(ch, stream[i]);
+    feature_values got, want;
+    feature_get(ch, &got);
+    naive(stream, i, &want);
+    if (got.mean_q4 != want.mean_q4 || got.var != want.var ||
+        got.min != want.min || got.max != want.max ||
+        got.p2p != want.p2p || got.jerk_q4 != want.jerk_q4)
+    {
+      if (mismatches++ < 3)
+      {
+        printf("  %s: sample %lu differs\n", name, (unsigned long)i);
+      }
+    }
+  }
+  CHECK_EQ(ch->seq, STREAM_LEN);
+  CHECK_EQ(ch->count, FEAT_WINDOW);
+  return mismatches;
+}
+
+static void test_agreement()
+{
+  // full scale noise
+  for (uint32_t i=0; i<STREAM_LEN; i++)
+  {
+    stream[i] = (int16_t)test_rand_noise(ACCEL_MAX_LSB);
+  }
+  CHECK_EQ(compare("random"), 0);
+
+  // long monotonic runs, the worst case for the deques
+  for (uint32_t i=0; i<STREAM_LEN; i++)
+  {
+    int32_t p = (int32_t)(i % 1000);
+    stream[i] = (int16_t)((p < 500 ? p : 1000 - p) * ACCEL_MAX_LSB / 500);
+  }
+  CHECK_EQ(compare("ramps"), 0);
+
+  // repeated values, ties in the deques
+  for (uint32_t i=0; i<STREAM_LEN; i++)
+  {
+    stream[i] = (int16_t)(((i / 5) % 3) * ACCEL_LSB_PER_G - ACCEL_LSB_PER_G);
+  }
+  CHECK_EQ(compare("steps"), 0);
+
+  // rails at the range limits maximise the 32 bit sum of squares
+  for (uint32_t i=0; i<STREAM_LEN; i++)
+  {
+    stream[i] = (int16_t)((i & 1) ? ACCEL_MAX_LSB : -ACCEL_MAX_LSB);
+  }
+  CHECK_EQ(compare("rails"), 0);
+}
+
+static void test_block()
+{
+  // a block push matches pushing each axis sample by sample
+  for (uint32_t i=0; i<STREAM_LEN; i++)
+  {
+    stream[i] = (int16_t)test_rand_noise(ACCEL_MAX_LSB);
+  }
+  feature_engine by_block, by_sample;
+  features_init(&by_block);
+  features_init(&by_sample);
+  accel_block blk;
+  for (uint32_t s=0; s+ACCEL_BLOCK_LEN<=STREAM_LEN/3; s+=ACCEL_BLOCK_LEN)
+  {
+    for (uint32_t i=0; i<ACCEL_BLOCK_LEN; i++)
+    {
+      blk.x[i] = stream[3*(s+i)];
+      blk.y[i] = stream[3*(s+i) + 1];
+      blk.z[i] = stream[3*(s+i) + 2];
+      feature_push(&by_sample.axis[0], blk.x[i]);
+      feature_push(&by_sample.axis[1], blk.y[i]);
+      feature_push(&by_sample.axis[2], blk.z[i]);
+    }
+    blk.n = ACCEL_BLOCK_LEN;
+    features_push_block(&by_block, &blk);
+  }
+  for (int a=0; a<3; a++)
+  {
+    feature_values u, v;
+    feature_get(&by_block.axis[a], &u);
+    feature_get(&by_sample.axis[a], &v);
+    CHECK_EQ(u.mean_q4, v.mean_q4);
+    CHECK_EQ(u.var, v.var);
+    CHECK_EQ(u.p2p, v.p2p);
+    CHECK_EQ(u.jerk_q4, v.jerk_q4);
+  }
+}
+
+static void test_benchmark()
+{
+  for (uint32_t i=0; i<STREAM_LEN; i++)
+  {
+    stream[i] = (int16_t)test_rand_noise(ACCEL_MAX_LSB);
+  }
+  feature_engine fe;
+  features_init(&fe);
+  volatile uint32_t sink = 0;
+
+  uint64_t t0 = test_now_ns();
+  for (int r=0; r<50; r++)
+  {
+    for (uint32_t i=0; i<STREAM_LEN; i++)
+    {
+      feature_push(&fe.axis[0], stream[i]);
+      feature_values v;
+      feature_get(&fe.axis[0], &v);
+      sink += v.var;
+    }
+  }
+  double inc = (double)(test_now_ns() - t0) / (50.0 * STREAM_LEN);
+
+  t0 = test_now_ns();
+  for (uint32_t i=0; i<STREAM_LEN; i++)
+  {
+    feature_values v;
+    naive(stream, i, &v);
+    sink += v.var;
+  }
+  double rec = (double)(test_now_ns() - t0) / STREAM_LEN;
+
+  printf("window %d: incremental %.1f ns/sample, naive recompute %.1f "
+         "ns/sample\n", FEAT_WINDOW, inc, rec);
+  CHECK(inc < rec);
+}
+
+int main()
+{
+  test_seed(7);
+  test_agreement();
+  test_block();
+  test_benchmark();
+  return test_summary("test_features");
+}
@@ -0,0 +1,164 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_fifo_drain.c
+ * @brief  FIFO stream mode and watermark drain against the register model
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "adxl343.h"
+#include "adxl343_model.h"
+
+// sample n of a run, distinct on every axis so order errors show up
+static accel_sample make_sample(uint32_t n)
+{
+  accel_sample s = { (int16_t)n, (int16_t)(-(int32_t)n), (int16_t)(1000 + n) };
+  return s;
+}
+
+static void produce_run(uint32_t first, uint32_t n)
+{
+  for (uint32_t i=0; i<n; i++)
+  {
+    accel_sample s = make_sample(first + i);
+    adxl343_model_produce(&s, 1);
+  }
+}
+
+static int check_run(const accel_sample *buf, uint32_t first, uint32_t n)
+{
+  int errors = 0;
+  for (uint32_t i=0; i<n; i++)
+  {
+    accel_sample e = make_sample(first + i);
+    if (buf[i].x != e.x || buf[i].y != e.y || buf[i].z != e.z) errors++;
+  }
+  return errors;
+}
+
+// runs an asynchronous drain to completion, completing each transfer
+static int drain_async(accel_sample *buf, uint32_t max_samples)
+{
+  int count = -1;
+  if (accel_fifo_drain_async(buf, max_samples) != 0) return -1;
+  while (adxl343_model_complete())
+  {
+    if (accel_fifo_drain_step(&count)) break;
+  }
+  return count;
+}
+
+static void test_setup()
+{
+  adxl343_model_reset();
+  CHECK_EQ(accel_init(NULL), 0);
+
+  uint8_t fifo_ctl = adxl343_model.regs[ADXL343_FIFO_CTL];
+  CHECK_EQ(fifo_ctl & 0xC0, FIFO_MODE_STREAM);
+  CHECK_EQ(fifo_ctl & FIFO_SAMPLES_MASK, ACCEL_FIFO_WATERMARK);
+  CHECK(adxl343_model.regs[ADXL343_INT_ENABLE] & INT_WATERMARK);
+  CHECK(adxl343_model.regs[ADXL343_INT_MAP] & INT_WATERMARK);
+
+  CHECK_EQ(accel_fifo_init(0), -1);
+  CHECK_EQ(accel_fifo_init(32), -1);
+  CHECK_EQ(accel_fifo_init(16), 0);
+  CHECK_EQ(adxl343_model.regs[ADXL343_FIFO_CTL], FIFO_MODE_STREAM | 16);
+  CHECK_EQ(accel_fifo_init(ACCEL_FIFO_WATERMARK), 0);
+}
+
+static void test_watermark_blocking_drain()
+{
+  accel_sample buf[ACCEL_FIFO_DEPTH];
+  stub_bt.signals = 0;
+
+  produce_run(0, ACCEL_FIFO_WATERMARK - 1);
+  CHECK(!accel_is_int2_asserted());
+  produce_run(ACCEL_FIFO_WATERMARK - 1, 1);
+  CHECK(accel_is_int2_asserted());
+
+  GPIO_ODD_IRQHandler();
+  CHECK(stub_bt.signals & evt_accel_GPIO_INT2);
+  CHECK((stub_bt.signals & evt_accel_GPIO_INT1) == 0);
+
+  adxl343_model_clear_log();
+  int n = accel_fifo_drain(buf, ACCEL_FIFO_DEPTH);
+  CHECK_EQ(n, ACCEL_FIFO_WATERMARK);
+  CHECK_EQ(check_run(buf, 0, ACCEL_FIFO_WATERMARK), 0);
+  CHECK_EQ(adxl343_model.fifo_count, 0);
+  CHECK(!accel_is_int2_asserted());
+  // one FIFO_STATUS read, then one burst per entry
+  CHECK_EQ(adxl343_model.transactions, 1 + ACCEL_FIFO_WATERMARK);
+}
+
+static void test_async_drain_overrun()
+{
+  accel_sample buf[ACCEL_FIFO_DEPTH];
+
+  // stream mode keeps the newest 32 of 40
+  produce_run(100, 40);
+  CHECK_EQ(adxl343_model.overruns, 8);
+  int n = drain_async(buf, ACCEL_FIFO_DEPTH);
+  CHECK_EQ(n, ACCEL_FIFO_DEPTH);
+  CHECK_EQ(check_run(buf, 108, ACCEL_FIFO_DEPTH), 0);
+  CHECK_EQ(adxl343_model.fifo_count, 0);
+}
+
+static void test_drain_cap()
+{
+  accel_sample buf[ACCEL_FIFO_DEPTH];
+
+  // a short buffer takes the oldest entries, the rest stay queued in order
+  produce_run(200, 20);
+  CHECK_EQ(accel_fifo_drain(buf, 8), 8);
+  CHECK_EQ(check_run(buf, 200, 8), 0);
+  CHECK_EQ(adxl343_model.fifo_count, 12);
+  CHECK_EQ(drain_async(buf, ACCEL_FIFO_DEPTH), 12);
+  CHECK_EQ(check_run(buf, 208, 12), 0);
+
+  CHECK_EQ(accel_fifo_drain(NULL, 8), -1);
+  CHECK_EQ(accel_fifo_drain(buf, 0), -1);
+  CHECK_EQ(drain_async(buf, ACCEL_FIFO_DEPTH), 0);
+}
+
+// 10 s at 100 Hz, servicing each INT2 edge with a drain
+static void test_wakeup_rate()
+{
+  accel_sample buf[ACCEL_FIFO_DEPTH];
+  uint32_t produced = 0;
+  uint32_t received = 0;
+  uint32_t wakeups = 0;
+  int order_errors = 0;
+
+  // drop the edges left pending by the earlier cases
+  GPIO_IntClear(0xFFFFFFFF);
+  stub_bt.signals = 0;
+  for (uint32_t tick=0; tick<1000; tick++)
+  {
+    produce_run(produced++, 1);
+    GPIO_ODD_IRQHandler();
+    if (stub_bt.signals & evt_accel_GPIO_INT2)
+    {
+      stub_bt.signals &= ~evt_accel_GPIO_INT2;
+      wakeups++;
+      int n = drain_async(buf, ACCEL_FIFO_DEPTH);
+      order_errors += check_run(buf, received, (uint32_t)n);
+      received += (uint32_t)n;
+    }
+  }
+  received += (uint32_t)accel_fifo_drain(buf, ACCEL_FIFO_DEPTH);
+
+  printf("100 Hz for 10 s: %u watermark wakeups, %u samples\n",
+         (unsigned)wakeups, (unsigned)received);
+  CHECK_EQ(received, produced);
+  CHECK_EQ(order_errors, 0);
+  CHECK_EQ(wakeups, 1000 / ACCEL_FIFO_WATERMARK);
+}
+
+int main()
+{
+  test_setup();
+  test_watermark_blocking_drain();
+  test_async_drain_overrun();
+  test_drain_cap();
+  test_wakeup_rate();
+  return test_summary("test_fifo_drain");
+}
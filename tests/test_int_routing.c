@@ -0,0 +1,136 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_int_routing.c
+ * @brief  INT1/INT2 routing and dispatch through the GPIO/EXTI stand-in
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "adxl343.h"
+#include "adxl343_model.h"
+
+#define DATA_PATH   (INT_DATA_READY | INT_WATERMARK | INT_OVERRUN)
+#define SEMANTIC    (INT_SINGLE_TAP | INT_DOUBLE_TAP | INT_ACTIVITY | \
+                     INT_INACTIVITY | INT_FREE_FALL)
+
+static void fill_to_watermark()
+{
+  accel_sample s = { 0, 0, ACCEL_LSB_PER_G };
+  while (adxl343_model.fifo_count < ACCEL_FIFO_WATERMARK)
+  {
+    adxl343_model_produce(&s, 1);
+  }
+}
+
+static void test_configuration()
+{
+  adxl343_model_reset();
+  CHECK_EQ(accel_init(NULL), 0);
+
+  // sensor side: data path on INT2, semantic events on INT1
+  uint8_t map = adxl343_model.regs[ADXL343_INT_MAP];
+  CHECK_EQ(map & DATA_PATH, DATA_PATH);
+  CHECK_EQ(map & SEMANTIC, 0);
+
+  // MCU side: both pins inputs, rising edge, n -> n, both NVIC lines
+  const stub_gpio_extint *int1 = &stub_gpio.extint[ACCEL_INT1_PIN];
+  const stub_gpio_extint *int2 = &stub_gpio.extint[ACCEL_INT2_PIN];
+  CHECK_EQ(stub_gpio.mode[ACCEL_INT1_PORT][ACCEL_INT1_PIN], gpioModeInput);
+  CHECK_EQ(stub_gpio.mode[ACCEL_INT2_PORT][ACCEL_INT2_PIN], gpioModeInput);
+  CHECK(int1->is_configured && int1->rising_edge && !int1->falling_edge);
+  CHECK(int2->is_configured && int2->rising_edge && !int2->falling_edge);
+  CHECK(stub_gpio.ien & (1u << ACCEL_INT1_PIN));
+  CHECK(stub_gpio.ien & (1u << ACCEL_INT2_PIN));
+  CHECK(stub_gpio.nvic_enabled & (1u << GPIO_EVEN_IRQn));
+  CHECK(stub_gpio.nvic_enabled & (1u << GPIO_ODD_IRQn));
+  // INT1 is an even pin, INT2 an odd one, so each has its own handler
+  CHECK_EQ(ACCEL_INT1_PIN % 2, 0);
+  CHECK_EQ(ACCEL_INT2_PIN % 2, 1);
+}
+
+static void test_data_path()
+{
+  stub_bt.signals = 0;
+  fill_to_watermark();
+  CHECK(GPIO_PinInGet(ACCEL_INT2_PORT, ACCEL_INT2_PIN));
+  CHECK(!GPIO_PinInGet(ACCEL_INT1_PORT, ACCEL_INT1_PIN));
+
+  // the even handler ignores the odd flag, the odd one signals INT2 only
+  GPIO_EVEN_IRQHandler();
+  CHECK_EQ(stub_bt.signals, 0);
+  CHECK(stub_gpio.iflag & (1u << ACCEL_INT2_PIN));
+  GPIO_ODD_IRQHandler();
+  CHECK_EQ(stub_bt.signals, evt_accel_GPIO_INT2);
+  CHECK_EQ(stub_gpio.iflag, 0);
+
+  // draining releases INT2 without touching INT_SOURCE
+  accel_sample buf[ACCEL_FIFO_DEPTH];
+  adxl343_model_clear_log();
+  CHECK_EQ(accel_fifo_drain(buf, ACCEL_FIFO_DEPTH), ACCEL_FIFO_WATERMARK);
+  CHECK(!accel_is_int2_asserted());
+  CHECK_EQ(adxl343_model_reads_of(ADXL343_INT_SOURCE), 0);
+}
+
+static void test_semantic_path()
+{
+  stub_bt.signals = 0;
+  adxl343_model_latch(INT_FREE_FALL, 0x0);
+  CHECK(GPIO_PinInGet(ACCEL_INT1_PORT, ACCEL_INT1_PIN));
+  CHECK(!GPIO_PinInGet(ACCEL_INT2_PORT, ACCEL_INT2_PIN));
+
+  stub_uptime_ms = 1000;
+  GPIO_ODD_IRQHandler();
+  CHECK_EQ(stub_bt.signals, 0);
+  GPIO_EVEN_IRQHandler();
+  CHECK_EQ(stub_bt.signals, evt_accel_GPIO_INT1);
+
+  // the snapshot clears the source and INT1 drops, the event keeps the time
+  // of the edge however late the main loop gets to it
+  stub_uptime_ms = 1250;
+  accel_int_snapshot snap;
+  CHECK_EQ(accel_snapshot(&snap), 0);
+  CHECK(snap.int_source & INT_FREE_FALL);
+  CHECK_EQ(snap.int_ms, 1000);
+  CHECK(!GPIO_PinInGet(ACCEL_INT1_PORT, ACCEL_INT1_PIN));
+
+  // the next edge dates the next snapshot, INT2 leaves the time alone
+  adxl343_model_latch(INT_DOUBLE_TAP, AXIS_Z);
+  stub_uptime_ms = 2000;
+  GPIO_EVEN_IRQHandler();
+  stub_uptime_ms = 2100;
+  fill_to_watermark();
+  GPIO_ODD_IRQHandler();
+  stub_uptime_ms = 2600;
+  CHECK_EQ(accel_snapshot(&snap), 0);
+  CHECK(snap.int_source & INT_DOUBLE_TAP);
+  CHECK_EQ(snap.int_ms, 2000);
+  accel_sample buf[ACCEL_FIFO_DEPTH];
+  accel_fifo_drain(buf, ACCEL_FIFO_DEPTH);
+}
+
+static void test_both_and_foreign()
+{
+  // a watermark behind a pending tap still gets its own event
+  stub_bt.signals = 0;
+  adxl343_model_latch(INT_DOUBLE_TAP, AXIS_Z);
+  fill_to_watermark();
+  GPIO_ODD_IRQHandler();
+  GPIO_EVEN_IRQHandler();
+  CHECK_EQ(stub_bt.signals, evt_accel_GPIO_INT1 | evt_accel_GPIO_INT2);
+
+  // a foreign odd pin is cleared but raises nothing
+  stub_bt.signals = 0;
+  GPIO_ExtIntConfig(gpioPortF, 7, 7, true, false, true);
+  stub_gpio_set_level(gpioPortF, 7, true);
+  GPIO_ODD_IRQHandler();
+  CHECK_EQ(stub_bt.signals, 0);
+  CHECK_EQ(stub_gpio.iflag, 0);
+}
+
+int main()
+{
+  test_configuration();
+  test_data_path();
+  test_semantic_path();
+  test_both_and_foreign();
+  return test_summary("test_int_routing");
+}
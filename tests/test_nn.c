@@ -0,0 +1,255 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_nn.c
+ * @brief  int8 inference runtime: kernels against the reference, layers
+ *         against a direct evaluation, and for the flash model inference
+ *         time, peak scratch and accuracy on replayed windows. Built for the
+ *         portable path and for the SIMD path on the intrinsic emulation
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <string.h>
+#include "test.h"
+#include "accel_config.h"
+#include "fall_model.h"
+#include "nn.h"
+
+#define G_STEPS  FALL_MODEL_IN_STEPS // model input steps per g
+
+static void test_kernels()
+{
+  int8_t a[131], b[131];
+  for (int i=0; i<131; i++)
+  {
+    a[i] = (int8_t)(test_rand() >> 8);
+    b[i] = (int8_t)(test_rand() >> 8);
+  }
+  // every length and misalignment, the SIMD path works in words
+  int mismatches = 0;
+  for (uint32_t off=0; off<4; off++)
+  {
+    for (uint32_t n=0; n+off<=127; n++)
+    {
+      if (nn_dot_q7(&a[off], &b[3-off], n) !=
+          nn_dot_q7_ref(&a[off], &b[3-off], n)) mismatches++;
+    }
+  }
+  CHECK_EQ(mismatches, 0);
+
+  // the extremes, -128 * -128 in every lane
+  memset(a, 0x80, sizeof(a));
+  memset(b, 0x80, sizeof(b));
+  CHECK_EQ(nn_dot_q7(a, b, 131), 131 * 16384);
+  memset(b, 0x7F, sizeof(b));
+  CHECK_EQ(nn_dot_q7(a, b, 131), 131 * -128 * 127);
+
+  int8_t v[4] = { 3, 9, 9, -1 };
+  CHECK_EQ(nn_argmax(v, 4), 1);
+}
+
+// a small random conv -> dense model for the layer test
+#define T_LEN 8
+#define T_CH  2
+static int8_t conv_w[3][2 * T_CH];
+static int32_t conv_b[3];
+static int8_t dense_w[2][4 * 3];
+static int32_t dense_b[2];
+static nn_layer test_layers[2] = {
+  { NN_CONV1D, T_LEN, T_CH, 4, 3, 2, 2, true, &conv_w[0][0], conv_b,
+    1 << 30, 4 },
+  { NN_DENSE, 4, 3, 1, 2, 0, 0, false, &dense_w[0][0], dense_b,
+    1518500250, 6 }, // 1/sqrt(2) Q31
+};
+static const nn_model test_model = { test_layers, 2, T_LEN * T_CH, 2, 24 };
+
+// rounds acc * mult / 2^(31+shift) the long way, halves up
+static int32_t direct_requant(int64_t acc, int32_t mult, int32_t shift,
+                              bool relu)
+{
+  double v = (double)acc * (double)mult / (double)(1ull << (31 + shift));
+  int64_t r = (int64_t)floor(v + 0.5);
+  if (r > 127) r = 127;
+  if (r < (relu ? 0 : -128)) r = relu ? 0 : -128;
+  return (int32_t)r;
+}
+
+static void test_layers_direct()
+{
+  int mismatches = 0;
+  for (int trial=0; trial<200; trial++)
+  {
+    int8_t in[T_LEN * T_CH];
+    for (int i=0; i<T_LEN*T_CH; i++) in[i] = (int8_t)(test_rand() >> 8);
+    for (int o=0; o<3; o++)
+    {
+      for (int k=0; k<2*T_CH; k++) conv_w[o][k] = (int8_t)(test_rand() >> 8);
+      conv_b[o] = (int8_t)(test_rand() >> 8) * 64;
+    }
+    for (int o=0; o<2; o++)
+    {
+      for (int k=0; k<12; k++) dense_w[o][k] = (int8_t)(test_rand() >> 8);
+      dense_b[o] = (int8_t)(test_rand() >> 8) * 64;
+    }
+
+    // direct evaluation, time steps of stride 2 and kernel 2
+    int8_t hidden[4][3];
+    for (int t=0; t<4; t++)
+    {
+      for (int o=0; o<3; o++)
+      {
+        int64_t acc = conv_b[o];
+        for (int k=0; k<2; k++)
+        {
+          for (int c=0; c<T_CH; c++)
+          {
+            acc += in[(2*t + k)*T_CH + c] * conv_w[o][k*T_CH + c];
+          }
+        }
+        hidden[t][o] = (int8_t)direct_requant(acc, 1 << 30, 4, true);
+      }
+    }
+    int8_t want[2];
+    for (int o=0; o<2; o++)
+    {
+      int64_t acc = dense_b[o];
+      for (int k=0; k<12; k++) acc += hidden[k/3][k%3] * dense_w[o][k];
+      want[o] = (int8_t)direct_requant(acc, 1518500250, 6, false);
+    }
+
+    int8_t scratch[24];
+    const int8_t *out;
+    CHECK_EQ(nn_run(&test_model, in, scratch, sizeof(scratch), &out), 0);
+    if (out[0] != want[0] || out[1] != want[1]) mismatches++;
+  }
+  CHECK_EQ(mismatches, 0);
+
+  // too little scratch, and a layer that does not chain
+  int8_t in[T_LEN * T_CH] = { 0 };
+  int8_t scratch[24];
+  const int8_t *out;
+  CHECK_EQ(nn_run(&test_model, in, scratch, 23, &out), -1);
+  test_layers[1].in_ch = 2;
+  CHECK_EQ(nn_run(&test_model, in, scratch, sizeof(scratch), &out), -1);
+  test_layers[1].in_ch = 3;
+}
+
+// a FALL_MODEL_IN_LEN window: gravity on z, a walking bounce and optionally
+// an impact on x, in input steps
+static void make_window(int8_t *w, int walk_cg, int impact_g, int offset)
+{
+  for (int t=0; t<FALL_MODEL_IN_LEN; t++)
+  {
+    int phase = (t * 10 + offset) % 500;
+    int bounce = walk_cg * G_STEPS * ((phase < 250 ? phase : 500 - phase) -
+                                      125) / 12500;
+    w[t*3] = (int8_t)(((test_rand() >> 8) & 1) - (offset & 1));
+    w[t*3 + 1] = 0;
+    w[t*3 + 2] = (int8_t)(G_STEPS + bounce);
+  }
+  if (impact_g > 0)
+  {
+    static const int shape[] = { 30, 70, 100, 60, 20 };
+    int at = 8 + offset % 16;
+    for (int k=0; k<5; k++)
+    {
+      int v = impact_g * G_STEPS * shape[k] / 100;
+      w[(at + k)*3] = (int8_t)(v > 127 ? 127 : v);
+    }
+    // a damped bounce after it
+    for (int k=5; k<12 && at+k<FALL_MODEL_IN_LEN; k++)
+    {
+      w[(at + k)*3 + 2] = (int8_t)(G_STEPS + ((k & 1) ? 1 : -1) * G_STEPS *
+                                   (12 - k) / 12);
+    }
+  }
+}
+
+static void test_fall_model()
+{
+  static int8_t scratch[FALL_MODEL_SCRATCH_SIZE + 64];
+  int8_t w[FALL_MODEL_IN_LEN * FALL_MODEL_IN_CH];
+  const int8_t *out;
+
+  CHECK_EQ(fall_model.in_size, sizeof(w));
+  CHECK_EQ(fall_model.scratch_size, FALL_MODEL_SCRATCH_SIZE);
+
+  // peak scratch: the highest byte a run writes, over two poison patterns
+  make_window(w, 30, 5, 0);
+  uint32_t peak = 0;
+  for (int p=0; p<2; p++)
+  {
+    memset(scratch, p ? 0xA5 : 0x5A, sizeof(scratch));
+    CHECK_EQ(nn_run(&fall_model, w, scratch, FALL_MODEL_SCRATCH_SIZE, &out), 0);
+    for (uint32_t i=sizeof(scratch); i>0; i--)
+    {
+      if (scratch[i-1] != (int8_t)(p ? 0xA5 : 0x5A))
+      {
+        if (i > peak) peak = i;
+        break;
+      }
+    }
+  }
+  CHECK(peak <= FALL_MODEL_SCRATCH_SIZE);
+
+  // inference time
+  volatile uint32_t sink = 0;
+  uint64_t t0 = test_now_ns();
+  for (int r=0; r<20000; r++)
+  {
+    w[0] = (int8_t)r;
+    nn_run(&fall_model, w, scratch, sizeof(scratch), &out);
+    sink += (uint32_t)out[1];
+  }
+  double ns = (double)(test_now_ns() - t0) / 20000.0;
+
+  // accuracy on replayed windows: still and walking at several intensities,
+  // and impacts from 4 to 6 g at every position in the window. A 3 g landing
+  // stays under the reference model's 12 g jerk total
+  uint32_t correct = 0, total = 0, missed = 0, false_alarms = 0;
+  for (int offset=0; offset<32; offset++)
+  {
+    for (int walk=0; walk<=40; walk+=10)
+    {
+      make_window(w, walk, 0, offset * 17);
+      nn_run(&fall_model, w, scratch, sizeof(scratch), &out);
+      bool is_fall = nn_argmax(out, FALL_MODEL_NUM_CLASSES) ==
+                     FALL_MODEL_CLASS_FALL;
+      if (!is_fall) correct++;
+      else false_alarms++;
+      total++;
+    }
+    for (int g=4; g<=6; g++)
+    {
+      make_window(w, 20, g, offset);
+      nn_run(&fall_model, w, scratch, sizeof(scratch), &out);
+      bool is_fall = nn_argmax(out, FALL_MODEL_NUM_CLASSES) ==
+                     FALL_MODEL_CLASS_FALL;
+      if (is_fall) correct++;
+      else missed++;
+      total++;
+    }
+  }
+  printf("fall_model (%s): %.0f ns/inference, scratch %lu of %d bytes, "
+         "accuracy %lu/%lu (%lu missed, %lu false alarms)\n",
+#if defined(__ARM_FEATURE_DSP)
+         "simd",
+#else
+         "portable",
+#endif
+         ns, (unsigned long)peak, FALL_MODEL_SCRATCH_SIZE,
+         (unsigned long)correct, (unsigned long)total,
+         (unsigned long)missed, (unsigned long)false_alarms);
+  // the hand-set reference model separates these cleanly, a trained model
+  // replacing it has to as well
+  CHECK_EQ(false_alarms, 0);
+  CHECK_EQ(missed, 0);
+}
+
+int main()
+{
+  test_seed(3);
+  test_kernels();
+  test_layers_direct();
+  test_fall_model();
+  return test_summary("test_nn");
+}
@@ -0,0 +1,188 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_posture.c
+ * @brief  Posture estimator: CORDIC atan2/magnitude and pitch/roll/tilt
+ *         against double precision over the full sphere, classes with
+ *         hysteresis, and the cost per sample and per block
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <math.h>
+#include "test.h"
+#include "accel_config.h"
+#include "posture.h"
+
+#define DEG (3.14159265358979323846 / 180.0)
+
+// angle difference in centidegrees, wrapped to -18000..18000
+static double cdeg_err(double got_cdeg, double want_rad)
+{
+  double d = got_cdeg - want_rad / DEG * 100.0;
+  while (d > 18000.0) d -= 36000.0;
+  while (d < -18000.0) d += 36000.0;
+  return fabs(d);
+}
+
+static void test_atan2()
+{
+  static const int32_t radii[] = { 3, 100, 4096, 65536, 1 << 20, 1 << 24 };
+  double worst = 0.0, worst_mag = 0.0;
+  for (uint32_t r=0; r<sizeof(radii)/sizeof(radii[0]); r++)
+  {
+    for (int k=0; k<3600; k++)
+    {
+      double a = k * 0.1 * DEG;
+      int32_t x = (int32_t)lround(radii[r] * cos(a));
+      int32_t y = (int32_t)lround(radii[r] * sin(a));
+      if (x == 0 && y == 0) continue;
+      uint32_t mag;
+      int32_t got = posture_atan2(y, x, &mag);
+      double e = cdeg_err(got, atan2((double)y, (double)x));
+      double m = hypot((double)x, (double)y);
+      // small vectors are limited by the one LSB rounding of the magnitude
+      double em = (m > 1000.0) ? fabs(mag - m) / m : 0.0;
+      if (e > worst) worst = e;
+      if (em > worst_mag) worst_mag = em;
+      CHECK(got >= -18000 && got <= 18000);
+    }
+  }
+  printf("atan2: worst %.2f cdeg, magnitude worst %.4f%%\n", worst,
+         worst_mag * 100.0);
+  CHECK(worst <= 1.0);
+  CHECK(worst_mag <= 0.002);
+
+  uint32_t mag = 1;
+  CHECK_EQ(posture_atan2(0, 0, &mag), 0);
+  CHECK_EQ(mag, 0);
+  // +180 like atan2(), an exactly inverted device must not read -180 deg
+  CHECK_EQ(posture_atan2(0, -5, NULL), 18000);
+  CHECK_EQ(posture_atan2(0, -(1 << 24), NULL), 18000);
+  CHECK_EQ(posture_atan2(5, 0, NULL), 9000);
+  CHECK_EQ(posture_atan2(-5, 0, NULL), -9000);
+}
+
+// a block of a constant sample, the filter is seeded with it exactly
+static void hold(posture_context *pc, int16_t x, int16_t y, int16_t z,
+                 uint32_t n)
+{
+  accel_block blk;
+  for (uint32_t i=0; i<n; i++)
+  {
+    blk.x[i] = x;
+    blk.y[i] = y;
+    blk.z[i] = z;
+  }
+  blk.n = n;
+  posture_update(pc, &blk);
+}
+
+static void test_sphere()
+{
+  double worst_pitch = 0.0, worst_roll = 0.0, worst_tilt = 0.0;
+  const double g = ACCEL_LSB_PER_G;
+  for (int lat=-90; lat<=90; lat++)
+  {
+    for (int lon=-180; lon<180; lon++)
+    {
+      int16_t x = (int16_t)lround(g * sin(lat * DEG));
+      int16_t y = (int16_t)lround(g * cos(lat * DEG) * sin(lon * DEG));
+      int16_t z = (int16_t)lround(g * cos(lat * DEG) * cos(lon * DEG));
+      posture_context pc;
+      posture_init(&pc);
+      hold(&pc, x, y, z, 1);
+
+      double pitch = atan2(-(double)x, hypot((double)y, (double)z));
+      double ep = cdeg_err(pc.pitch_cdeg, pitch);
+      if (ep > worst_pitch) worst_pitch = ep;
+      // roll is undefined straight up or down the x axis
+      if (y != 0 || z != 0)
+      {
+        double er = cdeg_err(pc.roll_cdeg, atan2((double)y, (double)z));
+        if (er > worst_roll) worst_roll = er;
+      }
+      double v[3] = { x, y, z };
+      double up = v[POSTURE_UP_AXIS];
+      double tilt = acos(up / sqrt(x*(double)x + y*(double)y + z*(double)z));
+      double et = cdeg_err(pc.tilt_cdeg, tilt);
+      if (et > worst_tilt) worst_tilt = et;
+    }
+  }
+  printf("full sphere: worst pitch %.2f, roll %.2f, tilt %.2f cdeg\n",
+         worst_pitch, worst_roll, worst_tilt);
+  CHECK(worst_pitch <= 2.0);
+  CHECK(worst_roll <= 2.0);
+  CHECK(worst_tilt <= 2.0);
+}
+
+static void test_classes()
+{
+  const int16_t g = ACCEL_LSB_PER_G;
+  // 45 deg lies between upright and lying, the class is kept
+  const int16_t h = (int16_t)lround(g * sqrt(0.5));
+  posture_context pc;
+  posture_init(&pc);
+  CHECK_EQ(pc.posture, POSTURE_UNKNOWN);
+
+  hold(&pc, h, 0, h, 1);
+  CHECK_EQ(pc.posture, POSTURE_UNKNOWN);
+  posture_init(&pc);
+  hold(&pc, 0, 0, g, 1);
+  CHECK_EQ(pc.posture, POSTURE_UPRIGHT);
+  posture_init(&pc);
+  hold(&pc, 0, 0, g, 1);
+  hold(&pc, h, 0, h, 64);
+  CHECK_EQ(pc.posture, POSTURE_UPRIGHT);
+  hold(&pc, g, 0, 0, 64);
+  CHECK_EQ(pc.posture, POSTURE_LYING);
+  CHECK(pc.tilt_cdeg > 8900 && pc.tilt_cdeg < 9100);
+  hold(&pc, h, 0, h, 64);
+  CHECK_EQ(pc.posture, POSTURE_LYING);
+  hold(&pc, 0, 0, (int16_t)-g, 64);
+  CHECK_EQ(pc.posture, POSTURE_INVERTED);
+  posture_init(&pc);
+  hold(&pc, 0, 0, (int16_t)-g, 1);
+  CHECK_EQ(pc.tilt_cdeg, 18000);
+  CHECK_EQ(pc.posture, POSTURE_INVERTED);
+  hold(&pc, 0, g, 0, 64);
+  CHECK_EQ(pc.posture, POSTURE_LYING);
+  hold(&pc, 0, 0, g, 64);
+  CHECK_EQ(pc.posture, POSTURE_UPRIGHT);
+}
+
+static void test_cost()
+{
+  posture_context pc;
+  posture_init(&pc);
+  volatile int32_t sink = 0;
+  const int reps = 100000;
+
+  uint64_t t0 = test_now_ns();
+  for (int r=0; r<reps; r++)
+  {
+    hold(&pc, (int16_t)(r & 63), 0, ACCEL_LSB_PER_G, 1);
+    sink += pc.tilt_cdeg;
+  }
+  double one = (double)(test_now_ns() - t0) / reps;
+
+  t0 = test_now_ns();
+  for (int r=0; r<reps; r++)
+  {
+    hold(&pc, (int16_t)(r & 63), 0, ACCEL_LSB_PER_G, ACCEL_BLOCK_LEN);
+    sink += pc.tilt_cdeg;
+  }
+  double block = (double)(test_now_ns() - t0) / reps;
+
+  // the angles are paid once per block, a sample only adds the filter
+  double per_sample = (block - one) / (ACCEL_BLOCK_LEN - 1);
+  printf("posture_update: %.0f ns for 1 sample, %.0f ns for %d, %.1f ns per "
+         "extra sample\n", one, block, ACCEL_BLOCK_LEN, per_sample);
+  CHECK(block < one * 4);
+}
+
+int main()
+{
+  test_atan2();
+  test_sphere();
+  test_classes();
+  test_cost();
+  return test_summary("test_posture");
+}
@@ -0,0 +1,249 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_presets.c
+ * @brief  One detector preset, built with -DDETECTOR_PRESET=<n>: the derived
+ *         constants, the filter tables at the preset rate, a fall through
+ *         the chain and the cost of the chain per sample and per second
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <stdlib.h>
+#include "test.h"
+#include "accel_features.h"
+#include "biquad.h"
+#include "fall_detect.h"
+#include "filter_coeffs.h"
+#include "posture.h"
+
+#define G          ACCEL_LSB_PER_G
+#define TRACE_MAX  (60 * DET_RATE_HZ)
+#define PI         (3.14159265358979323846)
+
+static int16_t tx[TRACE_MAX], ty[TRACE_MAX], tz[TRACE_MAX];
+static uint32_t tt[TRACE_MAX];
+static uint32_t tn;
+
+static void add(int x, int y, int z)
+{
+  if (tn == TRACE_MAX) return;
+  tx[tn] = (int16_t)x;
+  ty[tn] = (int16_t)y;
+  tz[tn] = (int16_t)z;
+  tt[tn] = tn * DET_PERIOD_MS;
+  tn++;
+}
+
+static void rest(int gx, int gy, int gz, uint32_t ms)
+{
+  for (uint32_t k=0; k<ms/DET_PERIOD_MS; k++)
+  {
+    add(gx*G + test_rand_noise(4), gy*G + test_rand_noise(4),
+        gz*G + test_rand_noise(4));
+  }
+}
+
+static void walk(uint32_t ms)
+{
+  for (uint32_t k=0; k<ms/DET_PERIOD_MS; k++)
+  {
+    int phase = (int)((k * DET_PERIOD_MS) % 500);
+    int bounce = (phase < 250 ? phase : 500 - phase) * 3 * G / 10 / 125 -
+                 3 * G / 10;
+    add(test_rand_noise(G/10), test_rand_noise(G/10), G + bounce);
+  }
+}
+
+// upright, a free-fall, a 5 g impact on x, then lying on the side
+static void fall()
+{
+  rest(0, 0, 1, 3000);
+  for (uint32_t k=0; k<400/DET_PERIOD_MS; k++)
+  {
+    add(test_rand_noise(G/16), test_rand_noise(G/16), test_rand_noise(G/16));
+  }
+  static const int shape[] = { 30, 70, 100, 60, 20 };
+  for (int k=0; k<5; k++) add(G + 5 * G * shape[k] / 100, 0, 0);
+  rest(1, 0, 0, 5000);
+}
+
+static uint32_t load_block(accel_block *blk, uint32_t s)
+{
+  uint32_t n = (tn - s < ACCEL_BLOCK_LEN) ? tn - s : ACCEL_BLOCK_LEN;
+  for (uint32_t i=0; i<n; i++)
+  {
+    blk->x[i] = tx[s+i];
+    blk->y[i] = ty[s+i];
+    blk->z[i] = tz[s+i];
+    blk->mag2[i] = (uint32_t)(tx[s+i]*tx[s+i] + ty[s+i]*ty[s+i] +
+                              tz[s+i]*tz[s+i]);
+  }
+  blk->timestamps = &tt[s];
+  blk->n = n;
+  return n;
+}
+
+static void test_constants()
+{
+  printf("preset %d: %d Hz, +/-%d g, window %d (%d ms)\n", DETECTOR_PRESET,
+         DET_RATE_HZ, DET_RANGE_G, DET_WINDOW, DET_WINDOW * DET_PERIOD_MS);
+
+  // BW_RATE codes run 3200 Hz >> (0xF - code)
+  CHECK_EQ(3200 >> (0xF - DET_BW_RATE_CODE), DET_RATE_HZ);
+  CHECK_EQ(DET_PERIOD_MS * DET_RATE_HZ, 1000);
+  CHECK_EQ(ACCEL_RANGE_G, DET_RANGE_G);
+  CHECK_EQ(DET_WINDOW, 1 << DET_WINDOW_LOG2);
+  CHECK_EQ(DET_WINDOW & DET_WINDOW_MASK, 0);
+  CHECK_EQ(FEAT_WINDOW, DET_WINDOW);
+
+  // the feature window stays ~1.3 s whatever the rate
+  CHECK(DET_WINDOW * DET_PERIOD_MS >= 1250);
+  CHECK(DET_WINDOW * DET_PERIOD_MS <= 1300);
+  CHECK_EQ(DET_MS_TO_SAMPLES(1000), DET_RATE_HZ);
+
+  // squared thresholds folded on the preset's sample scale
+  CHECK_NEAR(sqrt((double)FD_IMPACT_LSB2), FD_IMPACT_MG * G / 1000.0, 1.0);
+  CHECK_NEAR(sqrt((double)FD_FREEFALL_LSB2), FD_FREEFALL_MG * G / 1000.0, 1.0);
+  CHECK(FD_IMPACT_MG < DET_RANGE_G * 1000);
+  CHECK(FD_STILL_LO_LSB2 < (uint32_t)G * G);
+  CHECK(FD_STILL_HI_LSB2 > (uint32_t)G * G);
+
+  // the low-pass shifts hold the time constant: tau = period * 2^shift
+  double tau_gravity = DET_PERIOD_MS * (double)(1 << DET_GRAVITY_SHIFT);
+  double tau_posture = DET_PERIOD_MS * (double)(1 << DET_POSTURE_SHIFT);
+  CHECK_NEAR(tau_gravity, 160.0, 1.0);
+  CHECK_NEAR(tau_posture, 80.0, 1.0);
+}
+
+// steady state gain of a cascade for a sine on z, peak out over peak in
+static double sine_gain(const biquad_design *design, double hz)
+{
+  biquad_bank bank;
+  CHECK_EQ(biquad_init(&bank, design), 0);
+  accel_block in, out;
+  double peak = 0.0;
+  uint32_t t = 0;
+  for (int b=0; b<40; b++)
+  {
+    for (uint32_t i=0; i<ACCEL_BLOCK_LEN; i++, t++)
+    {
+      in.x[i] = in.y[i] = 0;
+      double a = 2.0 * PI * hz * t / DET_RATE_HZ;
+      in.z[i] = (int16_t)lround(G / 2.0 * sin(a));
+    }
+    in.n = ACCEL_BLOCK_LEN;
+    biquad_process_block(&bank, &in, &out);
+    for (uint32_t i=0; b >= 20 && i<ACCEL_BLOCK_LEN; i++)
+    {
+      if (fabs((double)out.z[i]) > peak) peak = fabs((double)out.z[i]);
+    }
+  }
+  return peak / (G / 2.0);
+}
+
+static void test_filters()
+{
+  // gravity removal: one g held on z settles to nothing
+  biquad_bank bank;
+  accel_block in, out;
+  CHECK_EQ(biquad_init(&bank, &filter_gravity_hp), 0);
+  for (uint32_t i=0; i<ACCEL_BLOCK_LEN; i++)
+  {
+    in.x[i] = 0;
+    in.y[i] = 0;
+    in.z[i] = G;
+  }
+  in.n = ACCEL_BLOCK_LEN;
+  for (int b=0; b<10 * DET_RATE_HZ / ACCEL_BLOCK_LEN + 1; b++)
+  {
+    biquad_process_block(&bank, &in, &out);
+  }
+  CHECK(abs(out.z[ACCEL_BLOCK_LEN - 1]) <= G / 50);
+
+  // the impact band passes a 6 Hz swing and stops gravity and slow sway
+  double pass = sine_gain(&filter_impact_bp, 6.0);
+  double sway = sine_gain(&filter_impact_bp, 0.3);
+  double walk = sine_gain(&filter_gravity_hp, 2.0);
+  printf("  impact band gain 6 Hz %.2f, 0.3 Hz %.2f; gravity high-pass "
+         "2 Hz %.2f\n", pass, sway, walk);
+  CHECK(pass > 0.7 && pass < 1.3);
+  CHECK(sway < 0.1);
+  CHECK(walk > 0.9 && walk < 1.1);
+}
+
+static void test_detection()
+{
+  fall_detector fd;
+  accel_block blk;
+
+  tn = 0;
+  fall();
+  fall_detect_init(&fd);
+  uint32_t confirmed = 0;
+  for (uint32_t s=0; s<tn; s+=ACCEL_BLOCK_LEN)
+  {
+    load_block(&blk, s);
+    if (fall_detect_process(&fd, &blk) == FALL_CONFIRMED) confirmed++;
+  }
+  CHECK_EQ(confirmed, 1);
+
+  tn = 0;
+  walk(30000);
+  fall_detect_init(&fd);
+  confirmed = 0;
+  for (uint32_t s=0; s<tn; s+=ACCEL_BLOCK_LEN)
+  {
+    load_block(&blk, s);
+    if (fall_detect_process(&fd, &blk) == FALL_CONFIRMED) confirmed++;
+  }
+  CHECK_EQ(confirmed, 0);
+}
+
+// features, both filters, posture and the detector, block by block
+static void bench_chain()
+{
+  static feature_engine fe;
+  static biquad_bank gravity, impact;
+  static posture_context pc;
+  static fall_detector fd;
+  accel_block blk, filtered;
+  volatile uint32_t sink = 0;
+
+  tn = 0;
+  walk(60000);
+  features_init(&fe);
+  biquad_init(&gravity, &filter_gravity_hp);
+  biquad_init(&impact, &filter_impact_bp);
+  posture_init(&pc);
+  fall_detect_init(&fd);
+
+  const int reps = 20000 / DET_RATE_HZ;
+  uint32_t samples = 0;
+  uint64_t t0 = test_now_ns();
+  for (int r=0; r<reps; r++)
+  {
+    for (uint32_t s=0; s<tn; s+=ACCEL_BLOCK_LEN)
+    {
+      uint32_t n = load_block(&blk, s);
+      features_push_block(&fe, &blk);
+      biquad_process_block(&gravity, &blk, &filtered);
+      biquad_process_block(&impact, &blk, &filtered);
+      sink += posture_update(&pc, &blk);
+      sink += fall_detect_process(&fd, &blk);
+      samples += n;
+    }
+  }
+  double ns = (double)(test_now_ns() - t0) / samples;
+  printf("  chain %.1f ns/sample, %.1f us per second of signal\n", ns,
+         ns * DET_RATE_HZ / 1000.0);
+  CHECK(samples > 0);
+}
+
+int main()
+{
+  test_seed(9);
+  test_constants();
+  test_filters();
+  test_detection();
+  bench_chain();
+  return test_summary("test_presets");
+}
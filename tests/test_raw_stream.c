@@ -0,0 +1,276 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_raw_stream.c
+ * @brief  Raw stream packets and credits, then sustained samples per second
+ *         and drops against a stand-in for the stack's TX buffers and the
+ *         link draining them
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "raw_stream.h"
+
+static uint16_t get_u16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void fill(accel_sample *s, uint32_t n, uint32_t *next)
+{
+  for (uint32_t i=0; i<n; i++, (*next)++)
+  {
+    s[i].x = (int16_t)*next;
+    s[i].y = (int16_t)~*next;
+    s[i].z = (int16_t)(*next >> 16);
+  }
+}
+
+static void test_packets()
+{
+  raw_stream rs;
+  accel_sample s[RAW_SAMPLES_PER_PACKET * 2];
+  const uint8_t *p;
+  uint32_t next = 0;
+  raw_init(&rs, 2);
+  CHECK_EQ(rs.max_credits, 2);
+  CHECK_EQ(RAW_SAMPLES_PER_PACKET, 40);
+
+  // nothing to send until a packet is full
+  fill(s, RAW_SAMPLES_PER_PACKET - 1, &next);
+  raw_push(&rs, s, RAW_SAMPLES_PER_PACKET - 1);
+  CHECK_EQ(raw_peek(&rs, &p), 0);
+  fill(s, 1, &next);
+  raw_push(&rs, s, 1);
+  CHECK_EQ(raw_peek(&rs, &p), RAW_PACKET_LEN);
+
+  // header, then the samples in DATAX0..DATAZ1 order
+  CHECK_EQ(get_u16(&p[0]), 0);
+  CHECK_EQ(get_u16(&p[2]), 0);
+  for (uint32_t i=0; i<RAW_SAMPLES_PER_PACKET; i++)
+  {
+    const uint8_t *q = &p[RAW_HEADER_LEN + i * 6];
+    CHECK_EQ((int16_t)get_u16(&q[0]), (int16_t)i);
+    CHECK_EQ((int16_t)get_u16(&q[2]), (int16_t)~i);
+  }
+
+  // a credit per packet handed over, none left after two
+  fill(s, 2 * RAW_SAMPLES_PER_PACKET, &next);
+  raw_push(&rs, s, 2 * RAW_SAMPLES_PER_PACKET);
+  raw_sent(&rs);
+  CHECK(raw_peek(&rs, &p) > 0);
+  CHECK_EQ(get_u16(&p[0]), 1);
+  raw_sent(&rs);
+  CHECK_EQ(raw_peek(&rs, &p), 0);
+  CHECK_EQ(rs.in_stack, 2);
+
+  // credits come back as the link drains, not while it is idle
+  raw_tick(&rs, rs.us_per_packet / 1000 + 1);
+  CHECK_EQ(rs.in_stack, 1);
+  CHECK(raw_peek(&rs, &p) > 0);
+  raw_tick(&rs, 1000000);
+  CHECK_EQ(rs.in_stack, 0);
+  raw_tick(&rs, 1000000);
+  CHECK_EQ(rs.in_stack, 0);
+  CHECK_EQ(rs.drain_us, 0);
+
+  // a refusal takes every credit and slows the estimate
+  uint32_t us = rs.us_per_packet;
+  raw_refused(&rs);
+  CHECK_EQ(rs.in_stack, rs.max_credits);
+  CHECK_EQ(rs.refused, 1);
+  CHECK_EQ(rs.us_per_packet, us + us / 4);
+  CHECK_EQ(raw_peek(&rs, &p), 0);
+  raw_tick(&rs, 1000000);
+  CHECK(raw_peek(&rs, &p) > 0);
+  CHECK_EQ(get_u16(&p[0]), 2);
+  raw_sent(&rs);
+  CHECK(rs.us_per_packet < us + us / 4);
+  CHECK(rs.us_per_packet >= rs.us_model);
+
+  // samples that find the queue full are dropped and carried in the header
+  raw_init(&rs, 1);
+  next = 0;
+  for (int k=0; k<RAW_QUEUE_PACKETS; k++)
+  {
+    fill(s, RAW_SAMPLES_PER_PACKET, &next);
+    raw_push(&rs, s, RAW_SAMPLES_PER_PACKET);
+  }
+  raw_push(&rs, s, 25);
+  CHECK_EQ(rs.dropped, 25);
+  raw_sent(&rs);
+  fill(s, RAW_SAMPLES_PER_PACKET, &next);
+  raw_push(&rs, s, RAW_SAMPLES_PER_PACKET);
+  const uint8_t *last = rs.pkt[(rs.head - 1) & (RAW_QUEUE_PACKETS - 1)];
+  CHECK_EQ(get_u16(&last[0]), RAW_QUEUE_PACKETS);
+  CHECK_EQ(get_u16(&last[2]), 25);
+}
+
+static void test_link_model()
+{
+  raw_stream rs;
+  raw_init(&rs, 0);
+  CHECK_EQ(rs.max_credits, RAW_DEFAULT_CREDITS);
+  uint32_t slow = rs.us_model;
+
+  // data length extension and the 2M PHY each shorten the drain time
+  raw_set_link(&rs, 1, 251, 6);
+  uint32_t dle = rs.us_model;
+  raw_set_link(&rs, 2, 251, 6);
+  uint32_t fast = rs.us_model;
+  printf("drain per notification: 1M/27 %u us, 1M/251 %u us, 2M/251 %u us\n",
+         (unsigned)slow, (unsigned)dle, (unsigned)fast);
+  CHECK(dle < slow);
+  CHECK(fast < dle);
+  CHECK_EQ(rs.us_per_packet, rs.us_model);
+
+  // out of range sizes are clamped
+  raw_set_link(&rs, 2, 1000, 6);
+  CHECK_EQ(rs.us_model, fast);
+  raw_set_link(&rs, 1, 0, 6);
+  CHECK_EQ(rs.us_model, slow);
+}
+
+// the stack: TX buffers for a few notifications, the link takes up to
+// per_event of them each connection event
+typedef struct
+{
+  uint32_t buffered;
+  uint32_t capacity;
+  uint32_t delivered;
+  uint16_t expect_seq;
+  uint32_t seq_errors;
+  uint32_t dropped_in_headers;
+} stack_standin;
+
+static bool standin_send(stack_standin *st, const uint8_t *p)
+{
+  if (st->buffered == st->capacity) return false;
+  if (get_u16(&p[0]) != st->expect_seq) st->seq_errors++;
+  st->expect_seq++;
+  st->dropped_in_headers += get_u16(&p[2]);
+  st->buffered++;
+  return true;
+}
+
+typedef struct
+{
+  const char *name;
+  uint8_t phy;
+  uint16_t txsize;
+  uint16_t interval;        // 1.25 msec units
+  uint32_t per_event_x10;   // notifications the link takes per event, x10
+  uint32_t odr_hz;
+} link_case;
+
+/* A minute of FIFO drains of 16 samples at the output data rate, each
+ * followed by the send loop of ble.c. Returns the samples per second the
+ * link took.
+ */
+static double run_link(const link_case *c, raw_stream *rs, stack_standin *st)
+{
+  accel_sample s[16];
+  uint32_t next = 0;
+  raw_init(rs, 0);
+  raw_set_link(rs, c->phy, c->txsize, c->interval);
+  *st = (stack_standin){ .capacity = 6 };
+
+  const uint32_t end_us = 60UL * 1000000;
+  const uint32_t drain_us = 16UL * 1000000 / c->odr_hz;
+  const uint32_t event_us = c->interval * 1250UL;
+  uint32_t next_drain = drain_us, next_event = event_us, tick_us = 0;
+  uint32_t credit_x10 = 0;
+  for (uint32_t now=0; now<end_us; now+=250)
+  {
+    if (now >= next_event)
+    {
+      next_event += event_us;
+      credit_x10 += c->per_event_x10;
+      while (credit_x10 >= 10 && st->buffered > 0)
+      {
+        credit_x10 -= 10;
+        st->buffered--;
+        st->delivered++;
+      }
+      if (st->buffered == 0 && credit_x10 >= 10) credit_x10 %= 10;
+    }
+    if (now >= next_drain)
+    {
+      next_drain += drain_us;
+      fill(s, 16, &next);
+      raw_push(rs, s, 16);
+
+      raw_tick(rs, (now - tick_us) / 1000);
+      tick_us += (now - tick_us) / 1000 * 1000;
+      const uint8_t *p;
+      while (raw_peek(rs, &p) > 0)
+      {
+        if (!standin_send(st, p))
+        {
+          raw_refused(rs);
+          break;
+        }
+        raw_sent(rs);
+      }
+    }
+  }
+  return st->delivered * (double)RAW_SAMPLES_PER_PACKET / 60.0;
+}
+
+static void test_throughput()
+{
+  static const link_case cases[] = {
+    // airtime bound, under one notification per event in 27 byte PDUs
+    { "1M/27 7.5 ms", 1, 27, 6, 9, 3200 },
+    // DLE and 2M, four notifications per event
+    { "2M/251 7.5 ms", 2, 251, 6, 40, 3200 },
+    // a central capping the link at one notification per 30 ms event
+    { "2M/251 30 ms cap 1", 2, 251, 24, 10, 3200 },
+  };
+  for (uint32_t i=0; i<sizeof(cases)/sizeof(cases[0]); i++)
+  {
+    const link_case *c = &cases[i];
+    raw_stream rs;
+    stack_standin st;
+    double rate = run_link(c, &rs, &st);
+    double link = c->per_event_x10 / 10.0 * 1e6 / (c->interval * 1250.0) *
+                  RAW_SAMPLES_PER_PACKET;
+    printf("%-19s %4u Hz: %6.0f samples/s sustained (link %6.0f), "
+           "%u dropped, %u refused of %u sent\n", c->name,
+           (unsigned)c->odr_hz, rate, link, (unsigned)rs.dropped,
+           (unsigned)rs.refused, (unsigned)rs.packets);
+
+    // every sample is on its way, dropped, or still queued
+    uint32_t queued = (rs.head - rs.tail) * RAW_SAMPLES_PER_PACKET + rs.fill;
+    CHECK_EQ(rs.samples, rs.packets * RAW_SAMPLES_PER_PACKET + queued);
+    CHECK_EQ(st.seq_errors, 0);
+    uint32_t in_headers = st.dropped_in_headers + rs.drop_run;
+    uint32_t started = rs.head + (rs.fill > 0 ? 1 : 0);
+    for (uint32_t k=rs.tail; k!=started; k++)
+    {
+      in_headers += get_u16(&rs.pkt[k & (RAW_QUEUE_PACKETS - 1)][2]);
+    }
+    CHECK_EQ(in_headers, rs.dropped);
+
+    if (link > c->odr_hz * 1.25)
+    {
+      // headroom: the rate is kept up with and nothing is lost
+      CHECK_EQ(rs.dropped, 0);
+      CHECK(rate > c->odr_hz * 0.99);
+      CHECK(rs.refused * 20 < rs.packets);
+    }
+    else
+    {
+      // overloaded: the link stays busy and the excess is dropped
+      CHECK(rate > link * 0.95);
+      CHECK(rs.dropped > 0);
+      CHECK(rs.refused * 5 < rs.packets);
+    }
+  }
+}
+
+int main()
+{
+  test_packets();
+  test_link_model();
+  test_throughput();
+  return test_summary("test_raw_stream");
+}
@@ -0,0 +1,165 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_ring.c
+ * @brief  SPSC sample ring: span semantics, then a two thread stress run
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include <pthread.h>
+#include <sched.h>
+#include "test.h"
+#include "ring.h"
+
+#define STRESS_SAMPLES (2000000u)
+
+static sample_ring ring;
+
+static void fill(accel_sample *s, uint32_t *t, uint32_t seq)
+{
+  s->x = (int16_t)seq;
+  s->y = (int16_t)(seq >> 16);
+  s->z = (int16_t)~seq;
+  *t = seq;
+}
+
+static bool is_match(const accel_sample *s, uint32_t t, uint32_t seq)
+{
+  return t == seq && s->x == (int16_t)seq && s->y == (int16_t)(seq >> 16) &&
+         s->z == (int16_t)~seq;
+}
+
+static void test_spans()
+{
+  accel_sample *ws;
+  uint32_t *wt;
+  const accel_sample *rs;
+  const uint32_t *rt;
+
+  sample_ring_init(&ring);
+  CHECK_EQ(sample_ring_read_span(&ring, &rs, &rt), 0);
+  CHECK_EQ(sample_ring_write_span(&ring, &ws, &wt), SAMPLE_RING_SIZE);
+
+  // move the indices close to the end so the spans wrap
+  for (uint32_t i=0; i<SAMPLE_RING_SIZE - 10; i++)
+  {
+    CHECK(sample_ring_push(&ring, &(accel_sample){0, 0, 0}, i));
+  }
+  CHECK_EQ(sample_ring_read_span(&ring, &rs, &rt), SAMPLE_RING_SIZE - 10);
+  sample_ring_release(&ring, SAMPLE_RING_SIZE - 10);
+  CHECK_EQ(sample_ring_count(&ring), 0);
+
+  // the write span stops at the end of the arrays, not at the free count
+  CHECK_EQ(sample_ring_write_span(&ring, &ws, &wt), 10);
+  for (uint32_t i=0; i<10; i++) fill(&ws[i], &wt[i], i);
+  sample_ring_commit(&ring, 10);
+  CHECK_EQ(sample_ring_write_span(&ring, &ws, &wt), SAMPLE_RING_SIZE - 10);
+  CHECK(ws == &ring.samples[0]);
+  for (uint32_t i=0; i<20; i++) fill(&ws[i], &wt[i], 10 + i);
+  sample_ring_commit(&ring, 20);
+
+  // so does the read span, in place and in order
+  CHECK_EQ(sample_ring_count(&ring), 30);
+  CHECK_EQ(sample_ring_read_span(&ring, &rs, &rt), 10);
+  CHECK(is_match(&rs[9], rt[9], 9));
+  sample_ring_release(&ring, 10);
+  CHECK_EQ(sample_ring_read_span(&ring, &rs, &rt), 20);
+  CHECK(is_match(&rs[0], rt[0], 10));
+  sample_ring_release(&ring, 4);
+  CHECK_EQ(sample_ring_read_span(&ring, &rs, &rt), 16);
+  CHECK(is_match(&rs[0], rt[0], 14));
+  sample_ring_release(&ring, 16);
+
+  // full: pushes are refused and counted
+  sample_ring_init(&ring);
+  for (uint32_t i=0; i<SAMPLE_RING_SIZE; i++)
+  {
+    sample_ring_push(&ring, &(accel_sample){0, 0, 0}, i);
+  }
+  CHECK(!sample_ring_push(&ring, &(accel_sample){0, 0, 0}, 0));
+  CHECK_EQ(ring.drops, 1);
+  CHECK_EQ(sample_ring_write_span(&ring, &ws, &wt), 0);
+}
+
+// producer: drain sized bulk spans (1..32) mixed with single pushes
+static void *producer(void *arg)
+{
+  (void)arg;
+  uint32_t seq = 0;
+  uint32_t burst = 1;
+  while (seq < STRESS_SAMPLES)
+  {
+    burst = (burst * 7 + 3) % 32 + 1;
+    if (burst == 1)
+    {
+      accel_sample s;
+      uint32_t t;
+      fill(&s, &t, seq);
+      if (sample_ring_push(&ring, &s, t)) seq++;
+      else sched_yield();
+      continue;
+    }
+
+    accel_sample *ws;
+    uint32_t *wt;
+    uint32_t n = sample_ring_write_span(&ring, &ws, &wt);
+    if (n == 0)
+    {
+      sched_yield();
+      continue;
+    }
+    if (n > burst) n = burst;
+    if (n > STRESS_SAMPLES - seq) n = STRESS_SAMPLES - seq;
+    for (uint32_t i=0; i<n; i++) fill(&ws[i], &wt[i], seq + i);
+    sample_ring_commit(&ring, n);
+    seq += n;
+  }
+  return NULL;
+}
+
+static void test_two_threads()
+{
+  pthread_t thread;
+  uint32_t expected = 0;
+  uint32_t errors = 0;
+  uint32_t chunk = 1;
+
+  sample_ring_init(&ring);
+  uint64_t start = test_now_ns();
+  CHECK_EQ(pthread_create(&thread, NULL, producer, NULL), 0);
+
+  // consumer: partial releases of varying size
+  while (expected < STRESS_SAMPLES)
+  {
+    const accel_sample *rs;
+    const uint32_t *rt;
+    uint32_t n = sample_ring_read_span(&ring, &rs, &rt);
+    if (n == 0)
+    {
+      sched_yield();
+      continue;
+    }
+    chunk = (chunk * 5 + 1) % 48 + 1;
+    if (n > chunk) n = chunk;
+    for (uint32_t i=0; i<n; i++)
+    {
+      if (!is_match(&rs[i], rt[i], expected + i)) errors++;
+    }
+    sample_ring_release(&ring, n);
+    expected += n;
+  }
+  pthread_join(thread, NULL);
+  uint64_t elapsed = test_now_ns() - start;
+
+  printf("two threads: %u samples, %u out of order or torn, %.1f Msamples/s\n",
+         (unsigned)expected, (unsigned)errors,
+         expected * 1e3 / (double)elapsed);
+  CHECK_EQ(errors, 0);
+  CHECK_EQ(expected, STRESS_SAMPLES);
+  CHECK_EQ(sample_ring_count(&ring), 0);
+}
+
+int main()
+{
+  test_spans();
+  test_two_threads();
+  return test_summary("test_ring");
+}
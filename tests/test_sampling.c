@@ -0,0 +1,190 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_sampling.c
+ * @brief  Adaptive sampling: trace replay of the controller, and the
+ *         pipeline's timestamps and stage gating across rate switches,
+ *         and the sample period through the still periods
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "adxl343_model.h"
+#include "blackbox.h"
+#include "pipeline.h"
+#include "sampling.h"
+#include "sensor_loop.h"
+
+typedef struct
+{
+  uint32_t t_ms;
+  sampling_input in;
+} trace_event;
+
+#define MIN_MS  (60u * 1000u)
+#define HOUR_MS (60u * MIN_MS)
+
+// a morning: restless start, desk work, a walk, a nap, then pottering about
+static const trace_event day[] = {
+  { 0,                      SAMPLING_IN_NONE },
+  { 5 * MIN_MS,             SAMPLING_IN_INACTIVITY }, // still since boot
+  { 5 * MIN_MS + 4000,      SAMPLING_IN_ACTIVITY },   // shifts in the chair
+  { 5 * MIN_MS + 9000,      SAMPLING_IN_INACTIVITY }, // within the hold
+  { 5 * MIN_MS + 30000,     SAMPLING_IN_NONE },       // pending, taken here
+  { 50 * MIN_MS,            SAMPLING_IN_ACTIVITY },
+  { 50 * MIN_MS + 100,      SAMPLING_IN_NONE },
+  { 80 * MIN_MS,            SAMPLING_IN_INACTIVITY },
+  { 80 * MIN_MS + 20000,    SAMPLING_IN_NONE },
+  { 2 * HOUR_MS,            SAMPLING_IN_ACTIVITY },
+  { 2 * HOUR_MS + 60000,    SAMPLING_IN_INACTIVITY },
+  { 2 * HOUR_MS + 65000,    SAMPLING_IN_NONE },
+  { 3 * HOUR_MS,            SAMPLING_IN_NONE },
+};
+
+static void test_trace_replay()
+{
+  sampling_context ctx;
+  sampling_init(&ctx, 0);
+  CHECK_EQ(ctx.mode, SAMPLING_CAPTURE);
+
+  for (uint32_t i=0; i<sizeof(day)/sizeof(day[0]); i++)
+  {
+    sampling_mode before = ctx.mode;
+    bool is_switch = sampling_step(&ctx, day[i].in, day[i].t_ms);
+    CHECK_EQ(is_switch, ctx.mode != before);
+    // activity switches on the same step, no added latency
+    if (day[i].in == SAMPLING_IN_ACTIVITY) CHECK_EQ(ctx.mode, SAMPLING_CAPTURE);
+  }
+
+  uint32_t monitor = sampling_time_in_mode(&ctx, SAMPLING_MONITOR);
+  uint32_t capture = sampling_time_in_mode(&ctx, SAMPLING_CAPTURE);
+  printf("3 h trace: monitor %lu s, capture %lu s, %lu switches\n",
+         (unsigned long)(monitor / 1000), (unsigned long)(capture / 1000),
+         (unsigned long)ctx.switches);
+
+  CHECK_EQ(monitor + capture, 3 * HOUR_MS);
+  // capture: the first 5 min, 26 s around the chair shift (held through
+  // the inactivity 5 s after it), the 30 min walk and the last 60 s. An
+  // inactivity past the hold drops to monitor at once
+  CHECK_EQ(capture, 5 * MIN_MS + 26000 + 30 * MIN_MS + 60000);
+  CHECK_EQ(ctx.switches, 7);
+  CHECK_EQ(sampling_bw_rate(SAMPLING_MONITOR), SAMPLING_MONITOR_BW_RATE);
+  CHECK_EQ(sampling_period_ms(SAMPLING_CAPTURE), DET_PERIOD_MS);
+}
+
+// resting on the back, x carries a time code (a tenth of the time in msec,
+// 0..63 LSB) so every recorded sample can be matched to its true time
+static accel_sample resting(uint32_t t_ms, void *arg)
+{
+  (void)arg;
+  accel_sample s = { (int16_t)((t_ms / 10) & 0x3F), 0, ACCEL_LSB_PER_G };
+  return s;
+}
+
+static void test_rate_switches()
+{
+  sensor_loop loop;
+  sensor_loop_init(&loop, resting, NULL);
+
+  sensor_loop_run(&loop, 3000);
+  uint32_t capture_samples = loop.produced;
+  CHECK_EQ(pipeline_features()->axis[0].seq + adxl343_model.fifo_count,
+           capture_samples);
+
+  // monitor for a while, the detection stages see none of it
+  sensor_loop_set_rate(&loop, SAMPLING_MONITOR_BW_RATE,
+                       SAMPLING_MONITOR_PERIOD_MS);
+  CHECK_EQ(adxl343_model.regs[ADXL343_BW_RATE], SAMPLING_MONITOR_BW_RATE);
+  sensor_loop_run(&loop, 6015);
+  uint32_t seen = pipeline_features()->axis[0].seq;
+  CHECK(seen <= capture_samples);
+  CHECK(capture_samples - seen <= ACCEL_FIFO_WATERMARK);
+
+  // back to capture with monitor samples still queued in the FIFO, the
+  // drain that picks them up straddles the switch
+  uint32_t fifo_at_switch = adxl343_model.fifo_count;
+  CHECK(fifo_at_switch > 0);
+  sensor_loop_set_rate(&loop, SAMPLING_CAPTURE_BW_RATE, DET_PERIOD_MS);
+  uint32_t produced_at_switch = loop.produced;
+  sensor_loop_run(&loop, 7000);
+  pipeline_fall_trigger(7000);
+  sensor_loop_run(&loop, 10000);
+
+  const uint8_t *data;
+  uint32_t len = pipeline_blackbox_data(&data);
+  CHECK(len > 0);
+  if (len == 0) return;
+
+  static accel_sample out[BLACKBOX_PRE_SAMPLES + BLACKBOX_POST_SAMPLES];
+  blackbox_header hdr;
+  int n = blackbox_decode(data, len, &hdr, out, sizeof(out)/sizeof(out[0]));
+  CHECK(n > 0);
+  CHECK_EQ(hdr.period_ms, DET_PERIOD_MS);
+  // the pre-trigger history restarted at the switch back to capture
+  CHECK_EQ(hdr.first_ms, 6015 + DET_PERIOD_MS);
+  int mismatches = 0;
+  for (int i=0; i<n; i++)
+  {
+    uint32_t t = hdr.first_ms + (uint32_t)i * hdr.period_ms;
+    if (out[i].x != (int16_t)((t / 10) & 0x3F)) mismatches++;
+  }
+  CHECK_EQ(mismatches, 0);
+
+  // only capture rate samples reached the detection stages
+  uint32_t capture_after = loop.produced - produced_at_switch;
+  uint32_t processed = pipeline_features()->axis[0].seq - seen;
+  CHECK(processed <= capture_after + (capture_samples - seen));
+  CHECK(processed + ACCEL_FIFO_WATERMARK >= capture_after);
+  CHECK_EQ(loop.misdated, 0);
+}
+
+/* Still long enough for the inactivity interrupt and the drop to monitor.
+ * With the profile as programmed the part keeps the BW_RATE period the
+ * pipeline back-dates with; with AUTO_SLEEP it would be sampling at its
+ * 8 Hz sleep rate instead.
+ */
+static void test_no_sleep()
+{
+  sensor_loop loop;
+  sensor_loop_init(&loop, resting, NULL);
+  CHECK_EQ(adxl343_model.regs[ADXL343_POWER_CTL] & POWER_CTL_AUTO_SLEEP, 0);
+  sensor_loop_run(&loop, 1000);
+
+  adxl343_model_latch(INT_INACTIVITY, 0x0);
+  accel_int_snapshot snap;
+  CHECK_EQ(accel_snapshot(&snap), 0);
+  CHECK(!snap.is_asleep);
+  sensor_loop_set_rate(&loop, SAMPLING_MONITOR_BW_RATE,
+                       SAMPLING_MONITOR_PERIOD_MS);
+  uint32_t produced = loop.produced;
+  sensor_loop_run(&loop, 61000);
+  CHECK_EQ(adxl343_model_period_ms(), SAMPLING_MONITOR_PERIOD_MS);
+  CHECK(loop.produced - produced + 1 >= 60000 / SAMPLING_MONITOR_PERIOD_MS);
+  CHECK_EQ(loop.misdated, 0);
+
+  // the same minute with AUTO_SLEEP set: asleep at 8 Hz until activity
+  accel_update_register(ADXL343_POWER_CTL, POWER_CTL_LINK |
+                        POWER_CTL_AUTO_SLEEP | POWER_CTL_MEASURE);
+  adxl343_model_latch(INT_INACTIVITY, 0x0);
+  CHECK_EQ(accel_snapshot(&snap), 0);
+  CHECK(snap.is_asleep);
+  CHECK_EQ(adxl343_model_period_ms(), 125);
+  produced = loop.produced;
+  sensor_loop_run(&loop, 121000);
+  printf("monitor minute: %u samples awake, %u with AUTO_SLEEP, "
+         "%u of those misdated\n", 60000 / SAMPLING_MONITOR_PERIOD_MS,
+         (unsigned)(loop.produced - produced), (unsigned)loop.misdated);
+  CHECK(loop.produced - produced < 60000 / 125 + 2);
+  CHECK(loop.misdated > 0);
+
+  adxl343_model_latch(INT_ACTIVITY, 0x0);
+  CHECK_EQ(accel_snapshot(&snap), 0);
+  CHECK(!snap.is_asleep);
+  CHECK_EQ(adxl343_model_period_ms(), SAMPLING_MONITOR_PERIOD_MS);
+}
+
+int main()
+{
+  test_trace_replay();
+  test_rate_switches();
+  test_no_sleep();
+  return test_summary("test_sampling");
+}
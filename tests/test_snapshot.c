@@ -0,0 +1,82 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_snapshot.c
+ * @brief  Interrupt snapshot decoding and the burst behind it
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "adxl343.h"
+#include "adxl343_model.h"
+
+// canned ACT_TAP_STATUS..INT_SOURCE images and their expected decode
+static const struct
+{
+  uint8_t regs[ACCEL_SNAPSHOT_LEN];
+  uint8_t int_source;
+  uint8_t act_axes;
+  uint8_t tap_axes;
+  bool is_asleep;
+} images[] = {
+  // double tap on Z, awake
+  { { 0x01, 0x0A, 0x38, 0x3E, 0x83, 0xA3 }, 0xA3, 0x0, AXIS_Z, false },
+  // activity on X and Y
+  { { 0x60, 0x0A, 0x38, 0x3E, 0x83, 0x92 }, 0x92, AXIS_X | AXIS_Y, 0x0, false },
+  // inactivity, part has gone to sleep
+  { { 0x08, 0x0A, 0x38, 0x3E, 0x83, 0x08 }, 0x08, 0x0, 0x0, true },
+  // free-fall with everything else set, reserved bit 7 ignored
+  { { 0xFF, 0x0A, 0x38, 0x3E, 0x83, 0x04 }, 0x04,
+    AXIS_X | AXIS_Y | AXIS_Z, AXIS_X | AXIS_Y | AXIS_Z, true },
+};
+
+static void test_decode()
+{
+  for (uint32_t i=0; i<sizeof(images)/sizeof(images[0]); i++)
+  {
+    accel_int_snapshot snap;
+    accel_snapshot_decode(images[i].regs, &snap);
+    CHECK_EQ(snap.int_source, images[i].int_source);
+    CHECK_EQ(snap.act_axes, images[i].act_axes);
+    CHECK_EQ(snap.tap_axes, images[i].tap_axes);
+    CHECK_EQ(snap.is_asleep, images[i].is_asleep);
+  }
+}
+
+static void test_burst()
+{
+  accel_int_snapshot snap;
+
+  adxl343_model_reset();
+  CHECK_EQ(accel_init(NULL), 0);
+  for (int16_t i=0; i<10; i++)
+  {
+    accel_sample s = { i, i, i };
+    adxl343_model_produce(&s, 1);
+  }
+  adxl343_model_latch(INT_DOUBLE_TAP | INT_SINGLE_TAP, AXIS_Y);
+  CHECK(GPIO_PinInGet(ACCEL_INT1_PORT, ACCEL_INT1_PIN));
+
+  adxl343_model_clear_log();
+  CHECK_EQ(accel_snapshot(&snap), 0);
+  CHECK(snap.int_source & INT_DOUBLE_TAP);
+  CHECK_EQ(snap.tap_axes, AXIS_Y);
+
+  // one transaction, no data register touched, so the FIFO keeps every entry
+  CHECK_EQ(adxl343_model.transactions, 1);
+  CHECK_EQ(adxl343_model.bytes, 1 + ACCEL_SNAPSHOT_LEN);
+  CHECK_EQ(adxl343_model_reads_of(ADXL343_DATAX0), 0);
+  CHECK_EQ(adxl343_model.fifo_count, 10);
+
+  // the INT_SOURCE read cleared the latched events and released INT1
+  CHECK(!GPIO_PinInGet(ACCEL_INT1_PORT, ACCEL_INT1_PIN));
+  CHECK_EQ(accel_snapshot(&snap), 0);
+  CHECK((snap.int_source & (INT_DOUBLE_TAP | INT_SINGLE_TAP)) == 0);
+
+  CHECK_EQ(accel_snapshot(NULL), -1);
+}
+
+int main()
+{
+  test_decode();
+  test_burst();
+  return test_summary("test_snapshot");
+}
@@ -0,0 +1,153 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_spi_async.c
+ * @brief  Transfer sequencing of the asynchronous transport and its failures
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "adxl343.h"
+#include "adxl343_model.h"
+
+static void produce(uint32_t n, int16_t base)
+{
+  for (uint32_t i=0; i<n; i++)
+  {
+    accel_sample s = { (int16_t)(base + i), 0, 256 };
+    adxl343_model_produce(&s, 1);
+  }
+}
+
+static void test_sequencing()
+{
+  accel_sample buf[ACCEL_FIFO_DEPTH];
+  int count = -1;
+
+  adxl343_model_reset();
+  accel_init(NULL);
+  produce(5, 10);
+  adxl343_model_clear_log();
+  stub_bt.signals = 0;
+
+  CHECK_EQ(accel_fifo_drain_async(buf, ACCEL_FIFO_DEPTH), 0);
+  CHECK(accel_fifo_is_draining());
+  CHECK_EQ(accel_fifo_drain_async(buf, ACCEL_FIFO_DEPTH), -1); // one at a time
+  CHECK_EQ(adxl343_model.transactions, 0); // nothing runs until completion
+
+  // FIFO_STATUS first, then one DATAX0..FIFO_STATUS burst per entry
+  uint32_t steps = 0;
+  bool is_done = false;
+  while (!is_done && adxl343_model_complete())
+  {
+    CHECK(stub_bt.signals & evt_spi_xfer_done);
+    stub_bt.signals = 0;
+    is_done = accel_fifo_drain_step(&count);
+    steps++;
+  }
+  CHECK(is_done);
+  CHECK_EQ(steps, 6);
+  CHECK_EQ(count, 5);
+  CHECK(!accel_fifo_is_draining());
+  CHECK_EQ(adxl343_model.log[0].cmd, SINGLE_READ_CMD(ADXL343_FIFO_STATUS));
+  CHECK_EQ(adxl343_model.log[0].nbytes, 2);
+  for (uint32_t i=1; i<6; i++)
+  {
+    CHECK_EQ(adxl343_model.log[i].cmd, MULTI_READ_CMD(ADXL343_DATAX0));
+    CHECK_EQ(adxl343_model.log[i].nbytes, 9);
+    CHECK(adxl343_model.log[i].is_async);
+  }
+  for (int i=0; i<5; i++) CHECK_EQ(buf[i].x, 10 + i);
+
+  // a step without a drain running is a no-op
+  CHECK(!accel_fifo_drain_step(&count));
+}
+
+static void test_blocking_waits_for_async()
+{
+  accel_sample buf[ACCEL_FIFO_DEPTH];
+  int count = -1;
+
+  produce(3, 50);
+  adxl343_model_clear_log();
+  CHECK_EQ(accel_fifo_drain_async(buf, ACCEL_FIFO_DEPTH), 0);
+
+  // a register write issued mid-drain lands after the frame in flight
+  CHECK_EQ(accel_update_register(ADXL343_BW_RATE, 0x18), 0);
+  CHECK_EQ(adxl343_model.log_len, 2);
+  CHECK(adxl343_model.log[0].is_async);
+  CHECK_EQ(adxl343_model.log[1].cmd, SINGLE_WRITE_CMD(ADXL343_BW_RATE));
+  CHECK_EQ(adxl343_model.regs[ADXL343_BW_RATE], 0x18);
+
+  // the status transfer already completed, the drain carries on from it
+  while (!accel_fifo_drain_step(&count)) adxl343_model_complete();
+  CHECK_EQ(count, 3);
+  for (int i=0; i<3; i++) CHECK_EQ(buf[i].x, 50 + i);
+}
+
+static void test_async_failures()
+{
+  accel_sample buf[ACCEL_FIFO_DEPTH];
+  int count = -1;
+
+  // refused at start: nothing left running, the next attempt goes through
+  produce(6, 70);
+  adxl343_model.fail_async = 1;
+  CHECK_EQ(accel_fifo_drain_async(buf, ACCEL_FIFO_DEPTH), -1);
+  CHECK(!accel_fifo_is_draining());
+
+  // refused mid-drain: the drain ends with what it has, the rest stays queued
+  CHECK_EQ(accel_fifo_drain_async(buf, ACCEL_FIFO_DEPTH), 0);
+  adxl343_model_complete();
+  CHECK(!accel_fifo_drain_step(&count));
+  adxl343_model_complete();
+  adxl343_model.fail_async = 1;
+  CHECK(accel_fifo_drain_step(&count));
+  CHECK_EQ(count, 1);
+  CHECK(!accel_fifo_is_draining());
+  CHECK_EQ(buf[0].x, 70);
+  CHECK_EQ(adxl343_model.fifo_count, 5);
+
+  CHECK_EQ(accel_fifo_drain_async(buf, ACCEL_FIFO_DEPTH), 0);
+  while (adxl343_model_complete())
+  {
+    if (accel_fifo_drain_step(&count)) break;
+  }
+  CHECK_EQ(count, 5);
+  for (int i=0; i<5; i++) CHECK_EQ(buf[i].x, 71 + i);
+}
+
+static void test_blocking_failures()
+{
+  accel_sample buf[ACCEL_FIFO_DEPTH];
+  accel_int_snapshot snap;
+
+  // a failed read leaves the caller's buffer as it was
+  memset(&snap, 0x5A, sizeof(snap));
+  adxl343_model.fail_transfers = 1;
+  CHECK_EQ(accel_snapshot(&snap), -1);
+  CHECK_EQ(snap.int_source, 0x5A);
+  CHECK_EQ(snap.tap_axes, 0x5A);
+
+  // the verify burst covers the data registers, run it on an empty FIFO
+  adxl343_model.fail_transfers = 1;
+  CHECK_EQ(accel_verify(), -1);
+  CHECK_EQ(accel_verify(), 0);
+
+  produce(4, 90);
+  memset(buf, 0x5A, sizeof(buf));
+  adxl343_model.fail_transfers = 1;
+  CHECK_EQ(accel_fifo_drain(buf, ACCEL_FIFO_DEPTH), -1);
+  CHECK_EQ((uint16_t)buf[0].x, 0x5A5A);
+  CHECK_EQ(adxl343_model.fifo_count, 4);
+
+  CHECK_EQ(accel_fifo_drain(buf, ACCEL_FIFO_DEPTH), 4);
+  for (int i=0; i<4; i++) CHECK_EQ(buf[i].x, 90 + i);
+}
+
+int main()
+{
+  test_sequencing();
+  test_blocking_waits_for_async();
+  test_async_failures();
+  test_blocking_failures();
+  return test_summary("test_spi_async");
+}
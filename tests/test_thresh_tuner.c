@@ -0,0 +1,306 @@
+/* -----------------------------------------------------------------------------
+ * @file   test_thresh_tuner.c
+ * @brief  Threshold controller: step rules, bounds and noise floor, the
+ *         register write of a retune, and a week of synthetic day-traces
+ * @author Jake Michael, jami1063@colorado.edu
+ * ---------------------------------------------------------------------------*/
+
+#include "test.h"
+#include "adxl343.h"
+#include "adxl343_model.h"
+#include "thresh_tuner.h"
+
+#define HOUR_MS  (3600UL * 1000)
+#define DAY_MS   (24 * HOUR_MS)
+
+static const tuner_thresholds defaults = {
+  ACCEL_THRESH_ACT, ACCEL_THRESH_INACT, ACCEL_TIME_INACT
+};
+
+// one period with n interrupts, closes it
+static bool period(thresh_tuner *t, uint32_t *now, uint32_t n)
+{
+  for (uint32_t i=0; i<n; i++) thresh_tuner_on_interrupt(t);
+  *now += TUNER_PERIOD_MS;
+  return thresh_tuner_step(t, *now);
+}
+
+static bool in_bounds(const tuner_thresholds *c)
+{
+  return c->thresh_act >= TUNER_ACT_MIN && c->thresh_act <= TUNER_ACT_MAX
+      && c->thresh_inact >= TUNER_INACT_MIN
+      && c->thresh_inact <= TUNER_INACT_MAX
+      && c->time_inact >= TUNER_TIME_INACT_MIN
+      && c->time_inact <= TUNER_TIME_INACT_MAX;
+}
+
+static void test_steps()
+{
+  thresh_tuner t;
+  uint32_t now = 1000;
+  thresh_tuner_init(&t, &defaults, 256, now);
+
+  // nothing happens inside a period, however busy
+  for (int i=0; i<500; i++) thresh_tuner_on_interrupt(&t);
+  CHECK(!thresh_tuner_step(&t, now + TUNER_PERIOD_MS - 1));
+  CHECK_EQ(t.interrupts, 500);
+
+  // 500 in 15 min is 2000/h: one LSB up, inactivity at the default ratio
+  CHECK(thresh_tuner_step(&t, now + TUNER_PERIOD_MS));
+  now += TUNER_PERIOD_MS;
+  CHECK_EQ(t.rate_q4 >> 4, 2000);
+  CHECK_EQ(t.current.thresh_act, ACCEL_THRESH_ACT + 1);
+  CHECK_EQ(t.current.thresh_inact,
+           ((ACCEL_THRESH_ACT + 1) * ACCEL_THRESH_INACT + ACCEL_THRESH_ACT / 2)
+           / ACCEL_THRESH_ACT);
+  CHECK_EQ(t.current.time_inact, ACCEL_TIME_INACT);
+  CHECK_EQ(t.retunes, 1);
+
+  // held for TUNER_HOLD_PERIODS, then the next step
+  for (int i=0; i<TUNER_HOLD_PERIODS; i++) CHECK(!period(&t, &now, 500));
+  CHECK(period(&t, &now, 500));
+  CHECK_EQ(t.retunes, 2);
+
+  // up to the activity ceiling, then TIME_INACT in 10 s steps to its own
+  uint32_t periods = 0;
+  while (t.current.time_inact < TUNER_TIME_INACT_MAX && periods < 1000)
+  {
+    uint8_t act = t.current.thresh_act;
+    uint8_t time_inact = t.current.time_inact;
+    if (period(&t, &now, 500))
+    {
+      // never both at once
+      CHECK(act == TUNER_ACT_MAX || t.current.time_inact == time_inact);
+      CHECK(t.current.thresh_act == act || t.current.thresh_act > act);
+    }
+    CHECK(in_bounds(&t.current));
+    periods++;
+  }
+  CHECK_EQ(t.current.thresh_act, TUNER_ACT_MAX);
+  CHECK_EQ(t.current.time_inact, TUNER_TIME_INACT_MAX);
+  CHECK(t.current.thresh_inact <= TUNER_INACT_MAX);
+
+  // nowhere left to go
+  uint32_t retunes = t.retunes;
+  for (int i=0; i<10; i++) CHECK(!period(&t, &now, 500));
+  CHECK_EQ(t.retunes, retunes);
+
+  // inside the band nothing moves
+  while (t.rate_q4 >> 4 > TUNER_BUDGET_PER_HOUR) period(&t, &now, 7);
+  for (int i=0; i<20; i++) CHECK(!period(&t, &now, 7));
+
+  // quiet: TIME_INACT comes down first, then the thresholds, to the defaults
+  bool act_moved = false;
+  periods = 0;
+  while (periods < 1000)
+  {
+    uint8_t act = t.current.thresh_act;
+    if (period(&t, &now, 0))
+    {
+      if (t.current.thresh_act != act) act_moved = true;
+      if (act_moved) CHECK_EQ(t.current.time_inact, TUNER_TIME_INACT_MIN);
+    }
+    CHECK(in_bounds(&t.current));
+    periods++;
+  }
+  CHECK(act_moved);
+  CHECK_EQ(t.current.thresh_act, defaults.thresh_act);
+  CHECK_EQ(t.current.thresh_inact, defaults.thresh_inact);
+  CHECK_EQ(t.current.time_inact, defaults.time_inact);
+}
+
+static void test_noise_floor()
+{
+  thresh_tuner t;
+  uint32_t now = 0;
+  thresh_tuner_init(&t, &defaults, 256, now);
+
+  // 400 mg of spread at the quietest: both thresholds sit above it even
+  // with no interrupts at all
+  thresh_tuner_observe(&t, 2000);
+  thresh_tuner_observe(&t, 103);
+  thresh_tuner_observe(&t, 500);
+  CHECK(period(&t, &now, 0));
+  CHECK_EQ(t.current.thresh_act, ACCEL_MG_TO_THRESH(402) + 1);
+  CHECK(t.current.thresh_act * 62.5 > 400.0);
+  CHECK(t.current.thresh_inact * 62.5 > 400.0);
+
+  // the floor is per period, it lifts when the noise goes
+  for (int i=0; i<TUNER_HOLD_PERIODS; i++) CHECK(!period(&t, &now, 0));
+  for (int i=0; i<20; i++)
+  {
+    thresh_tuner_observe(&t, 10);
+    period(&t, &now, 0);
+  }
+  CHECK_EQ(t.current.thresh_act, defaults.thresh_act);
+
+  // a spread beyond the ceiling is clamped to it
+  thresh_tuner_init(&t, &defaults, 256, now);
+  thresh_tuner_observe(&t, 4 * 256);
+  CHECK(period(&t, &now, 0));
+  CHECK_EQ(t.current.thresh_act, TUNER_ACT_MAX);
+  CHECK(in_bounds(&t.current));
+
+  // the period is measured across the uptime wrap
+  now = UINT32_MAX - 1000;
+  thresh_tuner_init(&t, &defaults, 256, now);
+  for (int i=0; i<500; i++) thresh_tuner_on_interrupt(&t);
+  CHECK(!thresh_tuner_step(&t, now + 2000));
+  CHECK(thresh_tuner_step(&t, now + TUNER_PERIOD_MS));
+  CHECK_EQ(t.rate_q4 >> 4, 2000);
+}
+
+// a retune reaches the sensor as one burst over THRESH_ACT..TIME_INACT
+static void test_write_back()
+{
+  adxl343_model_reset();
+  CHECK_EQ(accel_init(NULL), 0);
+
+  thresh_tuner t;
+  uint32_t now = 0;
+  thresh_tuner_init(&t, &defaults, ACCEL_LSB_PER_G, now);
+  uint32_t worst_bytes = 0, writes = 0;
+  for (int i=0; i<200; i++)
+  {
+    if (!period(&t, &now, (i < 100) ? 500 : 0)) continue;
+    accel_profile p;
+    CHECK_EQ(accel_get_profile(&p), 0);
+    p.thresh_act = t.current.thresh_act;
+    p.thresh_inact = t.current.thresh_inact;
+    p.time_inact = t.current.time_inact;
+    adxl343_model_clear_log();
+    CHECK_EQ(accel_apply_profile(&p), 0);
+    CHECK_EQ(adxl343_model.transactions, 1);
+    uint8_t cmd = adxl343_model.log[0].cmd;
+    CHECK((cmd & READ_MASK) == 0);
+    CHECK((cmd & ADDRESS_MASK) >= ADXL343_THRESH_ACT);
+    CHECK((cmd & ADDRESS_MASK) + adxl343_model.bytes - 1
+          <= ADXL343_TIME_INACT + 1);
+    CHECK_EQ(adxl343_model.regs[ADXL343_THRESH_ACT], t.current.thresh_act);
+    CHECK_EQ(adxl343_model.regs[ADXL343_THRESH_INACT],
+             t.current.thresh_inact);
+    CHECK_EQ(adxl343_model.regs[ADXL343_TIME_INACT], t.current.time_inact);
+    if (adxl343_model.bytes > worst_bytes) worst_bytes = adxl343_model.bytes;
+    writes++;
+  }
+  printf("write back: %u retunes, worst %u bytes per write\n",
+         (unsigned)writes, (unsigned)worst_bytes);
+  CHECK(writes > 10);
+  CHECK(worst_bytes <= 1 + 3);
+}
+
+/* Synthetic wearer. Activity per hour of the day, 0 asleep, 9 busiest.
+ * Edges per hour at the default thresholds go with the square of the
+ * intensity and fall with the square of THRESH_ACT (fewer movements cross
+ * it) and linearly with TIME_INACT (fewer rests qualify). The quietest
+ * window grows a little while the wearer moves.
+ */
+static const uint8_t busy_day[24] = {
+  0, 0, 0, 0, 0, 0, 2, 6, 8, 6, 5, 5, 7, 5, 5, 6, 6, 8, 9, 6, 4, 3, 1, 0
+};
+
+static const uint8_t calm_day[24] = {
+  0, 0, 0, 0, 0, 0, 0, 1, 2, 1, 1, 1, 2, 1, 1, 1, 1, 2, 2, 1, 1, 0, 0, 0
+};
+
+typedef struct
+{
+  uint32_t tuned;       // interrupts with the controller
+  uint32_t fixed;       // the same wearer at the defaults
+  uint32_t retunes;
+  uint32_t min_gap_ms;  // shortest time between two retunes
+  bool bounded;
+  bool rested;          // back at the defaults at 05:00 every morning
+  uint32_t worst_day_hour;  // highest tuned hourly count after day one
+} day_trace;
+
+static void run_days(const uint8_t *profile, uint32_t days, uint16_t quiet,
+                     day_trace *out)
+{
+  thresh_tuner t;
+  thresh_tuner_init(&t, &defaults, 256, 0);
+  out->tuned = out->fixed = out->retunes = 0;
+  out->min_gap_ms = UINT32_MAX;
+  out->bounded = out->rested = true;
+  out->worst_day_hour = 0;
+
+  uint32_t last_retune = 0, hour_count = 0;
+  for (uint32_t ms=1000; ms<=days * DAY_MS; ms+=1000)
+  {
+    uint32_t hour = (ms / HOUR_MS) % 24;
+    double inten = profile[hour];
+    double base = inten * inten * 4.0 / 3600.0;
+    double act = 4.0 / t.current.thresh_act;
+    double p = base * act * act * 20.0 / t.current.time_inact;
+
+    if (test_rand_unit() < p)
+    {
+      thresh_tuner_on_interrupt(&t);
+      out->tuned++;
+      hour_count++;
+    }
+    if (test_rand_unit() < base) out->fixed++;
+    thresh_tuner_observe(&t, quiet + (inten > 0) * 2);
+
+    if (thresh_tuner_step(&t, ms))
+    {
+      if (out->retunes && ms - last_retune < out->min_gap_ms)
+      {
+        out->min_gap_ms = ms - last_retune;
+      }
+      last_retune = ms;
+      out->retunes++;
+    }
+    if (!in_bounds(&t.current)) out->bounded = false;
+
+    if (ms % HOUR_MS == 0)
+    {
+      if (ms > DAY_MS && hour_count > out->worst_day_hour)
+      {
+        out->worst_day_hour = hour_count;
+      }
+      hour_count = 0;
+      if (ms > DAY_MS && hour == 5
+          && (t.current.thresh_act != defaults.thresh_act
+              || t.current.thresh_inact != defaults.thresh_inact
+              || t.current.time_inact != defaults.time_inact))
+      {
+        out->rested = false;
+      }
+    }
+  }
+}
+
+static void test_day_traces()
+{
+  day_trace d;
+
+  // a busy wearer over a week: well under half the interrupts, the peak
+  // hour brought toward the budget, and a full relax every night
+  run_days(busy_day, 7, 3, &d);
+  printf("busy week:  %u interrupts tuned, %u fixed, %u retunes, "
+         "worst hour %u\n", (unsigned)d.tuned, (unsigned)d.fixed,
+         (unsigned)d.retunes, (unsigned)d.worst_day_hour);
+  CHECK(d.bounded);
+  CHECK(d.rested);
+  CHECK(d.tuned * 3 < d.fixed);
+  CHECK(d.worst_day_hour < 324 / 2);  // intensity 9 at the defaults
+  CHECK(d.min_gap_ms >= (TUNER_HOLD_PERIODS + 1) * TUNER_PERIOD_MS);
+
+  // a calm wearer stays inside the budget, nothing is ever retuned
+  run_days(calm_day, 7, 3, &d);
+  printf("calm week:  %u interrupts tuned, %u fixed, %u retunes\n",
+         (unsigned)d.tuned, (unsigned)d.fixed, (unsigned)d.retunes);
+  CHECK_EQ(d.retunes, 0);
+  CHECK(d.bounded);
+}
+
+int main()
+{
+  test_seed(5);
+  test_steps();
+  test_noise_floor();
+  test_write_back();
+  test_day_traces();
+  return test_summary("test_thresh_tuner");
+}
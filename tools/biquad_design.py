@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# @file   biquad_design.py
+# @brief  Designs the biquad cascades of src/biquad.c and writes them as
+#         const q15 tables, one set per detector preset
+# @author Jake Michael, jami1063@colorado.edu
+#
+# usage: tools/biquad_design.py src/filter_coeffs
+#        writes src/filter_coeffs.c and src/filter_coeffs.h
+#
+# Sections are RBJ cookbook high/low-pass biquads with Butterworth Q. Each
+# coefficient is normalized by a0, scaled by 2^(15 - post_shift) and a1, a2
+# are stored negated, matching biquad.h. PRESET_RATES must follow the preset
+# table in src/detector_config.h.
+# -----------------------------------------------------------------------------
+
+import math
+import sys
+
+PRESET_RATES = [100, 50, 25]   # DETECTOR_PRESET 0, 1, 2
+POST_SHIFT = 1
+BUTTERWORTH_Q = 1 / math.sqrt(2)
+
+# name, description, sections (type, corner Hz), a corner above 0.4 fs is
+# pulled down to 0.4 fs
+FILTERS = [
+    ("filter_gravity_hp", "gravity removal, 0.5 Hz high-pass",
+     [("hp", 0.5)]),
+    ("filter_impact_bp", "impact band, 3 Hz high-pass and 15 Hz low-pass",
+     [("hp", 3.0), ("lp", 15.0)]),
+]
+
+
+def rbj(kind, f0, fs):
+    w0 = 2 * math.pi * f0 / fs
+    cw, alpha = math.cos(w0), math.sin(w0) / (2 * BUTTERWORTH_Q)
+    if kind == "hp":
+        b = [(1 + cw) / 2, -(1 + cw), (1 + cw) / 2]
+    elif kind == "lp":
+        b = [(1 - cw) / 2, 1 - cw, (1 - cw) / 2]
+    else:
+        raise ValueError("unknown section type %s" % kind)
+    a0 = 1 + alpha
+    a = [-2 * cw / a0, (1 - alpha) / a0]
+    return [x / a0 for x in b], a
+
+
+def quantize(v):
+    q = int(round(v * (1 << (15 - POST_SHIFT))))
+    if q < -32768 or q > 32767:
+        raise ValueError("coefficient %g does not fit q15 >> %d"
+                         % (v, POST_SHIFT))
+    return q
+
+
+def design(sections, fs):
+    out = []
+    for kind, f0 in sections:
+        f0 = min(f0, 0.4 * fs)
+        b, a = rbj(kind, f0, fs)
+        out.append(([quantize(x) for x in b], [quantize(-x) for x in a],
+                    kind, f0))
+    return out
+
+
+def emit(base):
+    src = "tools/biquad_design.py"
+    h = []
+    h.append("/* " + "-" * 77)
+    h.append(" * @file   filter_coeffs.h")
+    h.append(" * @brief  Biquad cascades for the detector preset, generated by")
+    h.append(" *         %s, do not edit" % src)
+    h.append(" * " + "-" * 76 + "*/\n")
+    h.append("#ifndef _FILTER_COEFFS_H_\n#define _FILTER_COEFFS_H_\n")
+    h.append('#include "biquad.h"\n')
+    for name, desc, _ in FILTERS:
+        h.append("extern const biquad_design %s; // %s" % (name, desc))
+    h.append("\n#endif // _FILTER_COEFFS_H_")
+
+    c = []
+    c.append("/* " + "-" * 77)
+    c.append(" * @file   filter_coeffs.c")
+    c.append(" * @brief  Biquad cascades for the detector preset, generated by")
+    c.append(" *         %s, do not edit" % src)
+    c.append(" * " + "-" * 76 + "*/\n")
+    c.append('#include "detector_config.h"')
+    c.append('#include "filter_coeffs.h"\n')
+    for p, fs in enumerate(PRESET_RATES):
+        c.append("%s DETECTOR_PRESET == %d // %d Hz\n"
+                 % ("#if" if p == 0 else "#elif", p, fs))
+        for name, desc, sections in FILTERS:
+            c.append("static const biquad_coeffs %s_stages[] = {" % name)
+            for b, a, kind, f0 in design(sections, fs):
+                c.append("  { %d, %d, %d, %d, %d }, // %s %g Hz"
+                         % (b[0], b[1], b[2], a[0], a[1], kind, f0))
+            c.append("};\n")
+    c.append("#else")
+    c.append('#error "no filter coefficients for DETECTOR_PRESET"')
+    c.append("#endif\n")
+    for name, desc, sections in FILTERS:
+        c.append("const biquad_design %s = {" % name)
+        c.append("  .stages = %s_stages," % name)
+        c.append("  .n_stages = %d," % len(sections))
+        c.append("  .post_shift = %d" % POST_SHIFT)
+        c.append("};\n")
+
+    with open(base + ".h", "w") as f:
+        f.write("\n".join(h) + "\n")
+    with open(base + ".c", "w") as f:
+        f.write("\n".join(c).rstrip("\n") + "\n")
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write("usage: %s out_base\n" % sys.argv[0])
+        return 1
+    emit(sys.argv[1])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
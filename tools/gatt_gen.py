@@ -0,0 +1,337 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# @file   gatt_gen.py
+# @brief  Generates autogen/gatt_db.c and autogen/gatt_db.h from the GATT
+#         configuration in config/btconf, as the Simplicity Studio GATT
+#         configurator does for this project
+# @author Jake Michael, jami1063@colorado.edu
+#
+# usage: tools/gatt_gen.py config/btconf autogen
+#        reads gatt_configuration.btconf and the *.xml contributions next to
+#        it (ota_dfu.xml), writes gatt_db.c and gatt_db.h
+#
+# Only the subset of the format this project uses is supported: primary
+# services, characteristics with hex/utf-8/user values and Client
+# Characteristic Configuration descriptors. Anything else is an error rather
+# than a silently different database.
+#
+# Layout rules, matching the configurator output:
+#   - the Generic Attribute service comes first (with database hash and
+#     client supported features when gatt_caching is on), then the services
+#     of the .btconf, then those of the contributed .xml files
+#   - the 16-bit UUID table starts with 2800, 2801, 2803, then every other
+#     16-bit attribute type in order of use, the Generic Attribute service's
+#     own types last. Service UUIDs are values, not types, and are not listed
+#   - 128-bit attribute types are indexed 0x8000 | n, stored byte-reversed
+#   - value fields are named after their handle - 1 and emitted last first
+#   - gattdb_<id> in the header is the value handle of each characteristic
+# -----------------------------------------------------------------------------
+
+import os
+import sys
+import xml.etree.ElementTree as ET
+
+PRIMARY, SECONDARY, CHARACTERISTIC = "2800", "2801", "2803"
+CCCD = "2902"
+
+PROP_BITS = {
+    "read": 0x02,
+    "write_no_response": 0x04,
+    "write": 0x08,
+    "notify": 0x10,
+    "indicate": 0x20,
+}
+
+DT_CONST, DT_DYNAMIC, DT_CONFIG, DT_CHAR, DT_USER = 0x00, 0x01, 0x03, 0x05, 0x07
+
+# Generic Attribute service, as added for generic_attribute_service="true"
+GATT_SERVICE = """
+<service uuid="1801">
+  <characteristic id="service_changed_char" uuid="2A05">
+    <value length="4" type="hex"/>
+    <properties><indicate/></properties>
+    <descriptor uuid="2902"/>
+  </characteristic>
+  <characteristic id="database_hash" uuid="2B2A" caching="true">
+    <value length="16" type="hex"/>
+    <properties><read/></properties>
+  </characteristic>
+  <characteristic id="client_support_features" uuid="2B29" caching="true">
+    <value length="1" type="hex"/>
+    <properties><read/><write/></properties>
+  </characteristic>
+</service>
+"""
+
+
+def norm_uuid(u):
+    u = u.replace("-", "").lower()
+    if len(u) not in (4, 32):
+        raise ValueError("bad uuid %s" % u)
+    return u
+
+
+def uuid_bytes(u):
+    # little endian, as on air
+    return list(reversed(bytes.fromhex(u)))
+
+
+def properties(elem):
+    props = elem.find("properties")
+    bits = 0
+    if props is None:
+        return bits
+    for name, bit in PROP_BITS.items():
+        if props.find(name) is not None or props.get(name) == "true":
+            bits |= bit
+    unknown = [c.tag for c in props if c.tag not in PROP_BITS]
+    if unknown:
+        raise ValueError("unsupported properties %s" % unknown)
+    return bits
+
+
+def value_bytes(elem):
+    v = elem.find("value")
+    length = int(v.get("length", "0"))
+    kind = v.get("type", "hex")
+    text = (v.text or "").strip()
+    if kind == "hex":
+        data = list(bytes.fromhex(text))
+    elif kind == "utf-8":
+        data = list(text.encode("utf-8"))
+    elif kind == "user":
+        data = []
+    else:
+        raise ValueError("unsupported value type %s" % kind)
+    if v.get("variable_length", "false") == "true" and kind != "user":
+        raise ValueError("variable length values are not supported")
+    data = (data + [0] * length)[:length]
+    return kind, length, data
+
+
+class Database:
+    def __init__(self):
+        self.attrs = []    # dicts, handle = index + 1
+        self.uuid16 = [PRIMARY, SECONDARY, CHARACTERISTIC]
+        self.uuid128 = []
+        self.deferred16 = []
+        self.ids = []      # (id, handle)
+        self.num_ccfg = 0
+
+    def type_index(self, u, deferred=False):
+        if len(u) == 32:
+            if u not in self.uuid128:
+                self.uuid128.append(u)
+            return 0x8000 | self.uuid128.index(u)
+        if u in self.uuid16:
+            return self.uuid16.index(u)
+        if deferred:
+            if u not in self.deferred16:
+                self.deferred16.append(u)
+            return ("deferred", u)
+        self.uuid16.append(u)
+        return len(self.uuid16) - 1
+
+    def add(self, **a):
+        self.attrs.append(a)
+        return len(self.attrs)
+
+    def service(self, svc, deferred=False):
+        if svc.get("type", "primary") != "primary":
+            raise ValueError("only primary services are supported")
+        self.add(uuid=0, perm=0x801, dt=DT_CONST,
+                 const=uuid_bytes(norm_uuid(svc.get("uuid"))))
+        for ch in svc.findall("characteristic"):
+            self.characteristic(ch, deferred)
+        if svc.find("include") is not None:
+            raise ValueError("included services are not supported")
+
+    def characteristic(self, ch, deferred):
+        props = properties(ch)
+        u = norm_uuid(ch.get("uuid"))
+        kind, length, data = value_bytes(ch)
+        idx = self.type_index(u, deferred)
+        self.add(uuid=2, perm=0x801, dt=DT_CHAR, props=props, char_uuid=idx)
+
+        perm = 0x800
+        if props & PROP_BITS["read"]:
+            perm |= 0x001
+        if props & (PROP_BITS["write"] | PROP_BITS["write_no_response"]):
+            perm |= 0x002
+        if kind == "user":
+            handle = self.add(uuid=idx, perm=perm, dt=DT_USER)
+        elif ch.get("const") == "true":
+            handle = self.add(uuid=idx, perm=perm, dt=DT_CONST, const=data)
+        else:
+            handle = self.add(uuid=idx, perm=perm, dt=DT_DYNAMIC, props=props,
+                              data=data, max_len=length)
+        if ch.get("id"):
+            self.ids.append((ch.get("id"), handle))
+
+        for d in ch.findall("descriptor"):
+            if norm_uuid(d.get("uuid")) != CCCD:
+                raise ValueError("only CCCD descriptors are supported")
+            flags = 0
+            if props & PROP_BITS["notify"]:
+                flags |= 0x01
+            if props & PROP_BITS["indicate"]:
+                flags |= 0x02
+            self.add(uuid=self.type_index(CCCD, deferred), perm=0x803,
+                     dt=DT_CONFIG, flags=flags, ccfg=self.num_ccfg)
+            self.num_ccfg += 1
+
+    def resolve(self):
+        # the Generic Attribute service's own types go at the end of the table
+        for u in self.deferred16:
+            if u not in self.uuid16:
+                self.uuid16.append(u)
+        for a in self.attrs:
+            for k in ("uuid", "char_uuid"):
+                if isinstance(a.get(k), tuple):
+                    a[k] = self.uuid16.index(a[k][1])
+
+
+def hex_list(data):
+    return "".join("0x%02x, " % b for b in data)
+
+
+def emit_c(db):
+    out = []
+    out.append("/" + "*" * 68)
+    out.append(" * Autogenerated file, do not edit.")
+    out.append(" " + "*" * 67 + "/")
+    out.append("")
+    out.append("#include <stdint.h>")
+    out.append('#include "sli_bt_gattdb_def.h"')
+    out.append("")
+    out.append("#define GATT_HEADER(F) F")
+    out.append("#define GATT_DATA(F) F")
+    out.append("GATT_DATA(const uint16_t gattdb_uuidtable_16_map[]) =")
+    out.append("{")
+    for u in db.uuid16:
+        out.append("  0x%s," % u)
+    out.append("};")
+    out.append("")
+    out.append("GATT_DATA(const uint8_t gattdb_uuidtable_128_map[]) =")
+    out.append("{")
+    for u in db.uuid128:
+        out.append("  " + hex_list(uuid_bytes(u)))
+    out.append("};")
+
+    for handle in range(len(db.attrs), 0, -1):
+        a = db.attrs[handle - 1]
+        name = "gattdb_attribute_field_%d" % (handle - 1)
+        if a["dt"] == DT_CONST:
+            out.append("GATT_DATA(const sli_bt_gattdb_value_t %s) = {" % name)
+            out.append("  .len = %d," % len(a["const"]))
+            out.append("  .data = { %s}" % hex_list(a["const"]))
+            out.append("};")
+        elif a["dt"] == DT_DYNAMIC:
+            out.append("GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t %s) = {"
+                       % name)
+            out.append("  .properties = 0x%02x," % a["props"])
+            out.append("  .max_len = %d," % a["max_len"])
+            out.append("  .data = { %s}," % hex_list(a["data"]))
+            out.append("};")
+    out.append("")
+
+    out.append("GATT_DATA(const sli_bt_gattdb_attribute_t "
+               "gattdb_attributes_map[]) = {")
+    for handle, a in enumerate(db.attrs, 1):
+        line = ("  { .handle = 0x%02x, .uuid = 0x%04x, .permissions = 0x%03x, "
+                ".caps = 0xffff, .state = 0x00, .datatype = 0x%02x, "
+                % (handle, a["uuid"], a["perm"], a["dt"]))
+        field = "&gattdb_attribute_field_%d" % (handle - 1)
+        if a["dt"] == DT_CONST:
+            line += ".constdata = %s }," % field
+        elif a["dt"] == DT_DYNAMIC:
+            line += ".dynamicdata = %s }," % field
+        elif a["dt"] == DT_USER:
+            line += ".dynamicdata = NULL },"
+        elif a["dt"] == DT_CHAR:
+            line += (".characteristic = { .properties = 0x%02x, "
+                     ".char_uuid = 0x%04x } }," % (a["props"], a["char_uuid"]))
+        elif a["dt"] == DT_CONFIG:
+            line += (".configdata = { .flags = 0x%02x, "
+                     ".clientconfig_index = 0x%02x } }," % (a["flags"], a["ccfg"]))
+        out.append(line)
+    out.append("};")
+    out.append("")
+
+    out.append("GATT_HEADER(const sli_bt_gattdb_t gattdb) = {")
+    out.append("  .attributes = gattdb_attributes_map,")
+    out.append("  .attribute_table_size = %d," % len(db.attrs))
+    out.append("  .attribute_num = %d," % len(db.attrs))
+    out.append("  .uuid16 = gattdb_uuidtable_16_map,")
+    out.append("  .uuid16_table_size = %d," % len(db.uuid16))
+    out.append("  .uuid16_num = %d," % len(db.uuid16))
+    out.append("  .uuid128 = gattdb_uuidtable_128_map,")
+    out.append("  .uuid128_table_size = %d," % len(db.uuid128))
+    out.append("  .uuid128_num = %d," % len(db.uuid128))
+    out.append("  .num_ccfg = %d," % db.num_ccfg)
+    out.append("  .caps_mask = 0xffff,")
+    out.append("  .enabled_caps = 0xffff,")
+    out.append("};")
+    out.append("const sli_bt_gattdb_t *static_gattdb = &gattdb;")
+    return "\n".join(out) + "\n"
+
+
+def emit_h(db, prefix):
+    out = []
+    out.append("/" + "*" * 68)
+    out.append(" * Autogenerated file, do not edit.")
+    out.append(" " + "*" * 67 + "/")
+    out.append("")
+    out.append("#ifndef __GATT_DB_H")
+    out.append("#define __GATT_DB_H")
+    out.append("")
+    out.append('#include "sli_bt_gattdb_def.h"')
+    out.append("")
+    out.append("extern const sli_bt_gattdb_t gattdb;")
+    out.append("")
+    for ident, handle in db.ids:
+        out.append("#define %s%d" % ((prefix + ident).ljust(38), handle))
+    out.append("")
+    out.append("")
+    out.append("#endif // __GATT_DB_H")
+    return "\n".join(out) + "\n"
+
+
+def build(btconf_dir):
+    root = ET.parse(os.path.join(btconf_dir,
+                                 "gatt_configuration.btconf")).getroot()
+    db = Database()
+    gatt = ET.fromstring(GATT_SERVICE)
+    if root.get("generic_attribute_service") == "true":
+        if root.get("gatt_caching") != "true":
+            for ch in gatt.findall("characteristic[@caching='true']"):
+                gatt.remove(ch)
+        db.service(gatt, deferred=True)
+
+    for svc in root.findall("service"):
+        db.service(svc)
+    for name in sorted(os.listdir(btconf_dir)):
+        if name.endswith(".xml"):
+            contrib = ET.parse(os.path.join(btconf_dir, name)).getroot()
+            for svc in contrib.findall("service"):
+                db.service(svc)
+    db.resolve()
+    return db, root.get("prefix", "gattdb_"), root
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write("usage: %s btconf_dir out_dir\n" % sys.argv[0])
+        return 1
+    db, prefix, root = build(sys.argv[1])
+    with open(os.path.join(sys.argv[2], root.get("out", "gatt_db.c")),
+              "w") as f:
+        f.write(emit_c(db))
+    with open(os.path.join(sys.argv[2], root.get("header", "gatt_db.h")),
+              "w") as f:
+        f.write(emit_h(db, prefix))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# @file   nn_convert.py
+# @brief  Converts a float model description (JSON) into const int8 tables
+#         for the src/nn.c runtime
+# @author Jake Michael, jami1063@colorado.edu
+#
+# usage: tools/nn_convert.py tools/fall_model.json src/fall_model
+#        writes src/fall_model.c and src/fall_model.h
+#
+# Model file:
+#   name            C identifier of the model
+#   in_len, in_ch   input shape, channels-last
+#   in_scale        real value of one input step
+#   classes         output class names
+#   layers[]        type "conv1d" (kernel, stride) or "dense", out_ch, relu,
+#                   weights [out_ch][kernel][in_ch] (dense: [out_ch][in]),
+#                   bias [out_ch] and out_scale (real value of one output step)
+#
+# Weights are quantized symmetric per layer, biases to int32 at the
+# accumulator scale, and in_scale * w_scale / out_scale becomes a Q31
+# multiplier plus right shift.
+# -----------------------------------------------------------------------------
+
+import json
+import math
+import sys
+
+
+def flatten(v):
+    if isinstance(v, list):
+        return [x for e in v for x in flatten(e)]
+    return [float(v)]
+
+
+def quantize_multiplier(m):
+    # m = mant * 2^exp, mant in [0.5, 1)
+    if m <= 0:
+        raise ValueError("requantization scale must be positive")
+    mant, exp = math.frexp(m)
+    q = int(round(mant * (1 << 31)))
+    if q == (1 << 31):
+        q //= 2
+        exp += 1
+    shift = -exp
+    if 31 + shift < 1 or 31 + shift > 62:
+        raise ValueError("requantization scale %g out of range" % m)
+    return q, shift
+
+
+def convert(model):
+    name = model["name"]
+    in_len, in_ch = model["in_len"], model["in_ch"]
+    scale = float(model["in_scale"])
+    tables, layers = [], []
+    max_act = 0
+
+    for i, l in enumerate(model["layers"]):
+        out_ch = l["out_ch"]
+        if l["type"] == "conv1d":
+            kernel, stride = l["kernel"], l["stride"]
+            out_len = (in_len - kernel) // stride + 1
+            window = kernel * in_ch
+            ltype = "NN_CONV1D"
+        elif l["type"] == "dense":
+            kernel, stride, out_len = 0, 0, 1
+            window = in_len * in_ch
+            ltype = "NN_DENSE"
+        else:
+            raise ValueError("layer %d: unknown type %s" % (i, l["type"]))
+
+        w = flatten(l["weights"])
+        if len(w) != out_ch * window:
+            raise ValueError("layer %d: expected %d weights, got %d"
+                             % (i, out_ch * window, len(w)))
+        b = flatten(l["bias"])
+        if len(b) != out_ch:
+            raise ValueError("layer %d: expected %d biases" % (i, out_ch))
+
+        w_scale = max(abs(x) for x in w) / 127.0 or 1.0
+        wq = [max(-127, min(127, int(round(x / w_scale)))) for x in w]
+        acc_scale = scale * w_scale
+        bq = [int(round(x / acc_scale)) for x in b]
+        out_scale = float(l["out_scale"])
+        mult, shift = quantize_multiplier(acc_scale / out_scale)
+
+        tables.append((i, wq, bq))
+        layers.append((ltype, in_len, in_ch, out_len, out_ch, kernel, stride,
+                       bool(l.get("relu", False)), mult, shift))
+        max_act = max(max_act, out_len * out_ch)
+        in_len, in_ch, scale = out_len, out_ch, out_scale
+
+    return name, tables, layers, in_len * in_ch, 2 * max_act
+
+
+def c_array(values, per_line=16):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append("  " + ", ".join(str(v) for v in values[i:i + per_line]))
+    return ",\n".join(lines)
+
+
+def emit(model, base):
+    name, tables, layers, out_size, scratch = convert(model)
+    in_size = model["in_len"] * model["in_ch"]
+    guard = "_" + name.upper() + "_H_"
+    upper = name.upper()
+    src = "tools/nn_convert.py"
+
+    h = []
+    h.append("/* " + "-" * 77)
+    h.append(" * @file   %s.h" % name)
+    h.append(" * @brief  int8 model tables, generated by %s" % src)
+    h.append(" *         from %s, do not edit" % model.get("source", name + ".json"))
+    h.append(" * " + "-" * 76 + "*/\n")
+    h.append("#ifndef %s\n#define %s\n" % (guard, guard))
+    h.append('#include "nn.h"\n')
+    h.append("#define %s_IN_LEN        (%d)" % (upper, model["in_len"]))
+    h.append("#define %s_IN_CH         (%d)" % (upper, model["in_ch"]))
+    h.append("#define %s_IN_STEPS      (%d) // input steps per unit, 1/in_scale"
+             % (upper, int(round(1.0 / float(model["in_scale"])))))
+    h.append("#define %s_SCRATCH_SIZE  (%d)" % (upper, scratch))
+    h.append("")
+    h.append("typedef enum\n{")
+    for i, c in enumerate(model["classes"]):
+        h.append("  %s_CLASS_%s = %d," % (upper, c.upper(), i))
+    h.append("  %s_NUM_CLASSES\n} %s_class;\n" % (upper, name))
+    h.append("extern const nn_model %s;\n" % name)
+    h.append("#endif // %s" % guard)
+
+    c = []
+    c.append("/* " + "-" * 77)
+    c.append(" * @file   %s.c" % name)
+    c.append(" * @brief  int8 model tables, generated by %s" % src)
+    c.append(" *         from %s, do not edit" % model.get("source", name + ".json"))
+    c.append(" * " + "-" * 76 + "*/\n")
+    c.append('#include "%s.h"\n' % name)
+    for i, wq, bq in tables:
+        c.append("static const int8_t layer%d_weights[%d] = {\n%s\n};\n"
+                 % (i, len(wq), c_array(wq)))
+        c.append("static const int32_t layer%d_bias[%d] = {\n%s\n};\n"
+                 % (i, len(bq), c_array(bq, 8)))
+    c.append("static const nn_layer layers[] = {")
+    for i, l in enumerate(layers):
+        ltype, il, ic, ol, oc, k, s, relu, mult, shift = l
+        c.append("  { %s, %d, %d, %d, %d, %d, %d, %s, layer%d_weights, "
+                 "layer%d_bias, %d, %d }," % (ltype, il, ic, ol, oc, k, s,
+                 "true" if relu else "false", i, i, mult, shift))
+    c.append("};\n")
+    c.append("const nn_model %s = {" % name)
+    c.append("  .layers = layers,")
+    c.append("  .n_layers = %d," % len(layers))
+    c.append("  .in_size = %d," % in_size)
+    c.append("  .out_size = %d," % out_size)
+    c.append("  .scratch_size = %s_SCRATCH_SIZE" % upper)
+    c.append("};")
+
+    with open(base + ".h", "w") as f:
+        f.write("\n".join(h) + "\n")
+    with open(base + ".c", "w") as f:
+        f.write("\n".join(c) + "\n")
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write("usage: %s model.json out_base\n" % sys.argv[0])
+        return 1
+    with open(sys.argv[1]) as f:
+        model = json.load(f)
+    model.setdefault("source", sys.argv[1])
+    emit(model, sys.argv[2])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())